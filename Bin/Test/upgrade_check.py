@@ -0,0 +1,179 @@
+#!/usr/bin/python3
+#coding=utf-8
+"""
+hot upgrade check (linux): handoff of listeners and drain of the old process.
+run in Bin/ with Server.bin, eg:
+    python3 Test/upgrade_check.py 8000
+    python3 Test/upgrade_check.py 8000 --kill-child   # also kill a worker while upgrading
+exit code is 0 if no request failed, the old process exited and the new one serves.
+with --kill-child, the links on the killed worker may fail, but no link is refused.
+"""
+import os
+import signal
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+PORT = int(sys.argv[1]) if len(sys.argv) > 1 and sys.argv[1].isdigit() else 8000
+KILL_CHILD = "--kill-child" in sys.argv
+PID_FILE = "Log/pid.txt"
+REQ_CLOSE = b"GET /index.html HTTP/1.1\r\nHost: loc.cn\r\nConnection: close\r\n\r\n"
+REQ_KEEP = b"GET /index.html HTTP/1.1\r\nHost: loc.cn\r\nConnection: keep-alive\r\n\r\n"
+
+LOAD_TIME = 3.0  # seconds of load after SIGUSR2, then the old process can drain
+stats = {"ok": 0, "bad": 0, "refused": 0}
+lock = threading.Lock()
+running = True
+
+
+def count(key, err=None):
+    with lock:
+        stats[key] += 1
+        if "bad" == key and stats["bad"] <= 5:
+            print("upgrade_check>>bad: %r" % err)
+
+
+def read_pid(wait=10.0):
+    end = time.time() + wait
+    while time.time() < end:
+        try:
+            with open(PID_FILE) as fp:
+                return int(fp.read().strip())
+        except (OSError, ValueError):
+            time.sleep(0.1)
+    return 0
+
+
+def alive(pid):
+    try:
+        os.kill(pid, 0)
+    except OSError:
+        return False
+    # a zombie is not alive
+    try:
+        with open("/proc/%d/stat" % pid) as fp:
+            return fp.read().split(")")[-1].split()[0] != "Z"
+    except OSError:
+        return False
+
+
+def read_resp(sock, buf):
+    """@return (status line, rest of buf), status is None if the link closed"""
+    while True:
+        pos = buf.find(b"\r\n\r\n")
+        if pos >= 0:
+            head = buf[:pos].decode(errors="ignore")
+            if "transfer-encoding: chunked" in head.lower():
+                end = buf.find(b"\r\n0\r\n\r\n", pos)
+                end = end + 7 if end >= 0 else len(buf) + 1
+            else:
+                end = pos + 4
+                for line in head.split("\r\n"):
+                    if line.lower().startswith("content-length:"):
+                        end += int(line.split(":")[1])
+            if len(buf) >= end:
+                return head.split("\r\n")[0], buf[end:]
+        dat = sock.recv(65536)
+        if not dat:
+            return None, b""
+        buf += dat
+
+
+def short_links():
+    while running:
+        try:
+            sock = socket.create_connection(("127.0.0.1", PORT), timeout=10)
+            sock.sendall(REQ_CLOSE)
+            line, _ = read_resp(sock, b"")
+            sock.close()
+            count("ok" if line and " 200 " in line else "bad", line)
+        except ConnectionRefusedError:
+            count("refused")
+        except OSError as err:
+            count("bad", err)
+        time.sleep(0.005)  # don't run out of local ports
+
+
+def keep_alive():
+    # the old process finishes this link, then closes it while draining
+    while running:
+        try:
+            sock = socket.create_connection(("127.0.0.1", PORT), timeout=10)
+            buf = b""
+            for _ in range(100):
+                sock.sendall(REQ_KEEP)
+                line, buf = read_resp(sock, buf)
+                if line is None:
+                    break  # closed by the draining process, reconnect
+                count("ok" if " 200 " in line else "bad", line)
+            sock.close()
+        except ConnectionRefusedError:
+            count("refused")
+        except (ConnectionResetError, BrokenPipeError):
+            pass  # reused link closed by the draining process, a client retries it
+        except OSError as err:
+            count("bad", err)
+
+
+def main():
+    global running
+    if os.path.exists(PID_FILE):
+        os.remove(PID_FILE)  # left by the last run
+    proc = subprocess.Popen(["./Server.bin"], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    old = read_pid()
+    time.sleep(1)
+    if not old or not alive(old):
+        print("upgrade_check>>server not started")
+        return 1
+    workers = [threading.Thread(target=short_links) for _ in range(4)]
+    workers += [threading.Thread(target=keep_alive) for _ in range(4)]
+    for it in workers:
+        it.start()
+    time.sleep(0.5)
+
+    os.kill(old, signal.SIGUSR2)
+    if KILL_CHILD:
+        kids = subprocess.run(["pgrep", "-P", str(old)], capture_output=True, text=True).stdout.split()
+        if kids:
+            os.kill(int(kids[0]), signal.SIGKILL)
+            print("upgrade_check>>killed child pid=%s" % kids[0])
+
+    time.sleep(LOAD_TIME)
+    running = False
+    for it in workers:
+        it.join()
+    new = old
+    end = time.time() + 90
+    while time.time() < end and (new == old or alive(old)):
+        time.sleep(0.2)
+        new = read_pid(1) or old
+
+    served = False
+    try:
+        sock = socket.create_connection(("127.0.0.1", PORT), timeout=5)
+        sock.sendall(REQ_CLOSE)
+        line, _ = read_resp(sock, b"")
+        served = line is not None and " 200 " in line
+        sock.close()
+    except OSError:
+        pass
+    old_alive = alive(old)
+    print("upgrade_check>>old=%d new=%d old_alive=%s served=%s ok=%d bad=%d refused=%d" % (
+        old, new, old_alive, served, stats["ok"], stats["bad"], stats["refused"]))
+
+    if new != old and alive(new):
+        os.kill(new, signal.SIGINT)
+    if old_alive:
+        os.kill(old, signal.SIGKILL)
+    proc.wait()
+    # the links on the killed worker are lost, don't count them
+    lost = 0 if KILL_CHILD else stats["bad"]
+    passed = new != old and not old_alive and served and stats["ok"] > 0 and 0 == lost + stats["refused"]
+    print("upgrade_check>>%s" % ("pass" if passed else "FAIL"))
+    return 0 if passed else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,167 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#ifndef APP_BUFFERPOOL_H
+#define APP_BUFFERPOOL_H
+
+#include "Nocopy.h"
+#include "MemAccount.h"
+#include "ThreadLocal.h"
+
+namespace app {
+
+struct BufferPoolStats {
+    s64 mAllocs;    // total allocated
+    s64 mHits;      // allocated from cache
+    s64 mFrees;     // total released by this thread
+    s64 mDrops;     // released to heap because the cache is full
+    s64 mLarge;     // allocated out of size classes, never cached
+    usz mCached;    // bytes of idle buffers in cache
+    usz mPeak;      // max of mCached
+    usz mHugeBytes; // bytes of hugepage chunks mapped by this thread, @see HugePage::logStats()
+};
+
+
+/**
+ * @brief 每个线程(即每个Loop)自有的缓冲块池, 按2的幂分级, 分配与释放无锁.
+ * 每个2的幂有两级: 2^n + G_HEAD_ROOM 与 2^n + G_HEAD_ROOM_IOV 字节, 多出的空间放请求头,
+ * 取两者中能装下的较小者, 所以 RequestFD::newRequest(4K) 与 HttpLayer::createMemIOV(4K) 都落在4K级,
+ * 而小请求不必为 RequestIOV 的头付出空间.
+ * 其它线程释放的缓冲块进入该线程自己的池, 缓冲块之间没有归属关系.
+ * 空闲缓冲块的总字节数超过 mMaxCached 时释放回堆.
+ * 可选的大页后备: 缺页时从2MB大页块中切分, 大页块保留到进程退出, 总量不超过 mMaxHuge.
+ * 使用中的缓冲块按标签计入 MemAccount, 空闲的计入 BufferPoolStats::mCached.
+ */
+class BufferPool : public Nocopy {
+public:
+    static const u32 G_MIN_SHIFT = 6;       // 64 bytes
+    static const u32 G_CLASS_COUNT = 22;    // 64B ~ 64KB, two head rooms of each
+    static const usz G_HEAD_ROOM = 256;     // room of request head, sizeof(RequestUDP) fits in
+    static const usz G_HEAD_ROOM_IOV = 576; // room of request head, sizeof(RequestIOV) fits in
+    static const usz G_HUGE_CHUNK = 2 * 1024 * 1024;
+
+    /**
+     * @return pool of current thread, nullptr if the thread is exiting.
+     */
+    static BufferPool* getLocal() {
+        return ThreadLocal<BufferPool>::get();
+    }
+
+    /**
+     * @brief allocate from pool of current thread, fallback to heap if the thread is exiting.
+     * @param tag user of buffer, @see EMemUsage
+     */
+    static void* allocBuf(usz size, s32 tag = EMU_NET) {
+        BufferPool* pool = getLocal();
+        return pool ? pool->allocate(size, tag) : allocHeap(size, tag);
+    }
+
+    /**
+     * @brief release to pool of current thread, may be allocated by any thread.
+     */
+    static void releaseBuf(void* it);
+
+    /**
+     * @brief log stats of pool of current thread, called by loop thread before exit.
+     */
+    static void logThread(const s8* tag);
+
+    /**
+     * @param cls 2n for 2^(n+G_MIN_SHIFT) + G_HEAD_ROOM, 2n+1 for 2^(n+G_MIN_SHIFT) + G_HEAD_ROOM_IOV
+     */
+    static usz getClassSize(u32 cls) {
+        return ((usz)1 << (G_MIN_SHIFT + (cls >> 1))) + ((cls & 1) ? G_HEAD_ROOM_IOV : G_HEAD_ROOM);
+    }
+
+    /**
+     * @param maxCached max bytes of idle buffers kept by this pool.
+     * @param maxHuge max bytes of hugepage chunks mapped by this pool, 0=disable hugepage.
+     */
+    void setConfig(usz maxCached, usz maxHuge);
+
+    void* allocate(usz size, s32 tag = EMU_NET);
+
+    void release(void* it);
+
+    // release all idle buffers to heap, the hugepage ones are kept.
+    void clear();
+
+    const BufferPoolStats& getStats() const {
+        return mStats;
+    }
+
+private:
+    enum EBlockFlag {
+        EBF_HUGE = 1 // carved from a hugepage chunk, never released to heap
+    };
+
+    struct Block {
+        Block* mNext; // link of idle blocks
+        u32 mSize;    // bytes of user room
+        u8 mClass;    // G_CLASS_COUNT if large
+        u8 mFlags;    // EBlockFlag bits
+        u16 mTag;     // EMemUsage of user
+    };
+
+    Block* mIdle[G_CLASS_COUNT];
+    s8* mChunkPos;
+    s8* mChunkEnd;
+    usz mMaxCached;
+    usz mMaxHuge;
+    BufferPoolStats mStats;
+
+    friend class ThreadLocal<BufferPool>;
+
+    BufferPool();
+
+    ~BufferPool();
+
+    static void* allocHeap(usz size, s32 tag);
+
+    // the smaller one which fits, of both head rooms
+    static u32 getClass(usz size) {
+        u32 cls = 0;
+        while (cls < G_CLASS_COUNT && getClassSize(cls) < size) {
+            cls += 2;
+        }
+        u32 iov = 1;
+        while (iov < G_CLASS_COUNT && getClassSize(iov) < size) {
+            iov += 2;
+        }
+        if (iov < G_CLASS_COUNT && (cls >= G_CLASS_COUNT || getClassSize(iov) < getClassSize(cls))) {
+            cls = iov;
+        }
+        return cls;
+    }
+
+    Block* createBlock(u32 cls);
+
+    bool mapChunk();
+};
+
+} // namespace app
+
+#endif // APP_BUFFERPOOL_H
@@ -0,0 +1,521 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#ifndef APP_COROUTINE_H
+#define APP_COROUTINE_H
+
+#include "Config.h"
+
+/**
+ * @brief 可选的C++20协程层, 仅当编译器启用C++20协程时有效(cmake -DUSE_COROUTINE=ON), 否则本文件为空.
+ * 协程直接挂在RequestFD/Handle的回调上, 不改动Loop和Handle, 不使用时没有任何开销.
+ * eg:
+ *     CoTask echo(net::HandleTCP* hnd, RequestFD* req) {
+ *         while (EE_OK == co_await CoRead(*hnd, req)) {
+ *             if (EE_OK != co_await CoWrite(*hnd, req)) {
+ *                 break;
+ *             }
+ *             req->mUsed = 0;
+ *         }
+ *         co_await CoClose(*hnd);
+ *         RequestFD::delRequest(req);
+ *         delete hnd;
+ *         co_return EE_OK;
+ *     }
+ *     echo(hnd, req).launch();
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define DUSE_COROUTINE
+
+#include <coroutine>
+#include <exception>
+#include "Engine.h"
+#include "HandleFile.h"
+#include "ThreadLocal.h"
+
+namespace app {
+
+/**
+ * @brief 协程帧分配器, 每个线程(即每个Loop)一份按大小分级的空闲链表, 分配和释放无锁.
+ * 帧的头部记录级别, 所以帧可以在其它线程释放(eg: CoSwitch后), 此时归还给释放线程的链表.
+ * 线程退出过程中(链表已析构)的分配与释放直接走堆.
+ */
+class CoFrame {
+public:
+    static const u32 G_CLASS_COUNT = 5;  // 256, 512, 1K, 2K, 4K
+    static const u32 G_MIN_SHIFT = 8;
+    static const u32 G_MAX_CACHED = 256; // max idle frames of each class
+
+    static void* allocate(usz size) {
+        size += sizeof(Head);
+        u32 idx = getClass(size);
+        Head* ret;
+        if (idx >= G_CLASS_COUNT) {
+            ret = reinterpret_cast<Head*>(::operator new(size));
+        } else {
+            Cache* cache = ThreadLocal<Cache>::get();
+            ret = cache ? cache->mIdle[idx] : nullptr;
+            if (ret) {
+                cache->mIdle[idx] = ret->mNext;
+                --cache->mCount[idx];
+            } else {
+                ret = reinterpret_cast<Head*>(::operator new((usz)1 << (idx + G_MIN_SHIFT)));
+            }
+        }
+        ret->mClass = idx;
+        return ret + 1;
+    }
+
+    static void release(void* it) {
+        if (!it) {
+            return;
+        }
+        Head* nd = reinterpret_cast<Head*>(it) - 1;
+        const u32 idx = nd->mClass;
+        if (idx < G_CLASS_COUNT) {
+            Cache* cache = ThreadLocal<Cache>::get();
+            if (cache && cache->mCount[idx] < G_MAX_CACHED) {
+                nd->mNext = cache->mIdle[idx];
+                cache->mIdle[idx] = nd;
+                ++cache->mCount[idx];
+                return;
+            }
+        }
+        ::operator delete(nd);
+    }
+
+private:
+    union alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Head {
+        Head* mNext; // link of idle frames
+        u32 mClass;  // class of frame in use
+    };
+
+    // @see ThreadLocal
+    struct Cache {
+        Head* mIdle[G_CLASS_COUNT];
+        u32 mCount[G_CLASS_COUNT];
+        Cache() {
+            for (u32 i = 0; i < G_CLASS_COUNT; ++i) {
+                mIdle[i] = nullptr;
+                mCount[i] = 0;
+            }
+        }
+        ~Cache() {
+            for (u32 i = 0; i < G_CLASS_COUNT; ++i) {
+                for (Head* nd = mIdle[i]; nd; nd = mIdle[i]) {
+                    mIdle[i] = nd->mNext;
+                    ::operator delete(nd);
+                }
+            }
+        }
+    };
+
+    static u32 getClass(usz size) {
+        u32 ret = 0;
+        while (ret < G_CLASS_COUNT && ((usz)1 << (ret + G_MIN_SHIFT)) < size) {
+            ++ret;
+        }
+        return ret;
+    }
+};
+
+
+/**
+ * @brief 协程的返回类型, 协程的返回值为错误码(EE_OK=成功).
+ * 创建时挂起, 被co_await时在等待者的线程中开始执行, 结束后恢复等待者;
+ * 或者调用launch()立即执行且不再等待, 结束后自行释放协程帧.
+ */
+class CoTask : public Nocopy {
+public:
+    class promise_type {
+    public:
+        struct FinalAwaiter {
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> it) noexcept {
+                promise_type& pms = it.promise();
+                if (pms.mNext) {
+                    return pms.mNext;
+                }
+                if (pms.mDetached) {
+                    it.destroy();
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {
+            }
+        };
+
+        promise_type() : mResult(EE_OK), mDetached(false) {
+        }
+
+        CoTask get_return_object() noexcept {
+            return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() const noexcept {
+            return {};
+        }
+
+        FinalAwaiter final_suspend() const noexcept {
+            return {};
+        }
+
+        void return_value(s32 it) noexcept {
+            mResult = it;
+        }
+
+        void unhandled_exception() const noexcept {
+            Logger::log(ELL_CRITICAL, "CoTask::unhandled_exception>>abort");
+            std::terminate();
+        }
+
+        static void* operator new(size_t size) {
+            return CoFrame::allocate(size);
+        }
+
+        static void operator delete(void* it) {
+            CoFrame::release(it);
+        }
+
+    private:
+        friend class CoTask;
+        std::coroutine_handle<> mNext; // the awaiter
+        s32 mResult;
+        bool mDetached;
+    };
+
+    struct Awaiter {
+        std::coroutine_handle<promise_type> mHandle;
+
+        bool await_ready() const noexcept {
+            return !mHandle || mHandle.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> it) noexcept {
+            mHandle.promise().mNext = it;
+            return mHandle;
+        }
+
+        s32 await_resume() const noexcept {
+            return mHandle ? mHandle.promise().mResult : EE_ERROR;
+        }
+    };
+
+    CoTask(CoTask&& it) noexcept : mHandle(it.mHandle) {
+        it.mHandle = nullptr;
+    }
+
+    ~CoTask() {
+        if (mHandle) {
+            mHandle.destroy();
+        }
+    }
+
+    Awaiter operator co_await() const noexcept {
+        return Awaiter{mHandle};
+    }
+
+    /**
+     * @brief start the coroutine in current thread and forget it, the frame is released by itself at the end.
+     */
+    void launch() {
+        if (mHandle) {
+            std::coroutine_handle<promise_type> hnd = mHandle;
+            mHandle = nullptr;
+            hnd.promise().mDetached = true;
+            hnd.resume();
+        }
+    }
+
+private:
+    std::coroutine_handle<promise_type> mHandle;
+
+    explicit CoTask(std::coroutine_handle<promise_type> it) : mHandle(it) {
+    }
+};
+
+
+/**
+ * @brief 等待一个RequestFD完成的基类, 等待期间借用RequestFD::mUser和mCall, 恢复前还原.
+ * co_await的结果为RequestFD::mError, 0=成功.
+ */
+class CoRequest {
+public:
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    s32 await_resume() noexcept {
+        mRequest->mUser = mUser;
+        mRequest->mCall = mCall;
+        return mRequest->mError;
+    }
+
+protected:
+    RequestFD* mRequest;
+    void* mUser;
+    FuncReqCallback mCall;
+
+    explicit CoRequest(RequestFD* it) : mRequest(it), mUser(it->mUser), mCall(it->mCall) {
+    }
+
+    void bind(std::coroutine_handle<> it) {
+        mRequest->mUser = it.address();
+        mRequest->mCall = CoRequest::funcOnDone;
+    }
+
+    /**
+     * @param ret result of posting the request
+     * @return true to suspend, false if the request failed without callback.
+     */
+    bool land(s32 ret) {
+        if (EE_OK == ret && 0 == mRequest->mError) {
+            return true;
+        }
+        if (0 == mRequest->mError) {
+            mRequest->mError = ret;
+        }
+        return false;
+    }
+
+    static void funcOnDone(RequestFD* it) {
+        std::coroutine_handle<>::from_address(it->mUser).resume();
+    }
+};
+
+
+/**
+ * @brief co_await CoRead(tcp, req), read into [req->mData + req->mUsed, req->mData + req->mAllocated).
+ * @note req must has cache, the multishot read(req->mAllocated=0) of io_uring is not supported.
+ */
+class CoRead : public CoRequest {
+public:
+    CoRead(net::HandleTCP& hnd, RequestFD* it) : CoRequest(it), mHandle(hnd) {
+    }
+
+    bool await_suspend(std::coroutine_handle<> it) {
+        if (0 == mRequest->mAllocated) {
+            mRequest->mError = EE_INVALID_PARAM;
+            return false;
+        }
+        bind(it);
+        return land(mHandle.read(mRequest));
+    }
+
+private:
+    net::HandleTCP& mHandle;
+};
+
+
+// @brief co_await CoWrite(tcp, req), write [req->mData, req->mData + req->mUsed)
+class CoWrite : public CoRequest {
+public:
+    CoWrite(net::HandleTCP& hnd, RequestFD* it) : CoRequest(it), mHandle(hnd) {
+    }
+
+    bool await_suspend(std::coroutine_handle<> it) {
+        bind(it);
+        return land(mHandle.write(mRequest));
+    }
+
+private:
+    net::HandleTCP& mHandle;
+};
+
+
+/**
+ * @brief co_await CoConnect(tcp, "127.0.0.1:80", req), open the handle in current loop and connect.
+ * @note set the close callback(Handle::setClose) before, or use CoClose to wait the handle closed.
+ */
+class CoConnect : public CoRequest {
+public:
+    CoConnect(net::HandleTCP& hnd, const String& addr, RequestFD* it) : CoRequest(it), mHandle(hnd), mAddr(addr) {
+    }
+
+    bool await_suspend(std::coroutine_handle<> it) {
+        bind(it);
+        return land(mHandle.open(mAddr, mRequest));
+    }
+
+private:
+    net::HandleTCP& mHandle;
+    const String& mAddr;
+};
+
+
+// @brief co_await CoFileRead(file, req, offset)
+class CoFileRead : public CoRequest {
+public:
+    CoFileRead(HandleFile& hnd, RequestFD* it, usz offset = 0) : CoRequest(it), mHandle(hnd), mOffset(offset) {
+    }
+
+    bool await_suspend(std::coroutine_handle<> it) {
+        bind(it);
+        return land(mHandle.read(mRequest, mOffset));
+    }
+
+private:
+    HandleFile& mHandle;
+    usz mOffset;
+};
+
+
+// @brief co_await CoFileWrite(file, req, offset)
+class CoFileWrite : public CoRequest {
+public:
+    CoFileWrite(HandleFile& hnd, RequestFD* it, usz offset = 0) : CoRequest(it), mHandle(hnd), mOffset(offset) {
+    }
+
+    bool await_suspend(std::coroutine_handle<> it) {
+        bind(it);
+        return land(mHandle.write(mRequest, mOffset));
+    }
+
+private:
+    HandleFile& mHandle;
+    usz mOffset;
+};
+
+
+/**
+ * @brief co_await CoClose(hnd), close the handle and resume when the close callback fired,
+ * then the handle can be deleted or reopened.
+ * @note the close callback and Handle::getUser() of the handle are replaced.
+ */
+class CoClose {
+public:
+    explicit CoClose(Handle& it) : mHandle(it) {
+    }
+
+    bool await_ready() const noexcept {
+        return mHandle.isClose() || (!mHandle.isOpen() && !mHandle.isClosing());
+    }
+
+    void await_suspend(std::coroutine_handle<> it) {
+        mHandle.setClose((EHandleType)mHandle.getType(), CoClose::funcOnClose, it.address());
+        mHandle.launchClose();
+    }
+
+    void await_resume() const noexcept {
+    }
+
+private:
+    Handle& mHandle;
+
+    static void funcOnClose(Handle* it) {
+        std::coroutine_handle<>::from_address(it->getUser()).resume();
+    }
+};
+
+
+/**
+ * @brief co_await CoSleep(ms), resume in the loop of current thread after ms milliseconds.
+ * the timer lives in the coroutine frame, no heap allocation.
+ */
+class CoSleep {
+public:
+    explicit CoSleep(s64 ms) : mLoop(Engine::getInstance().getLoop()), mWait(ms), mResult(EE_OK) {
+    }
+
+    CoSleep(Loop& loop, s64 ms) : mLoop(loop), mWait(ms), mResult(EE_OK) {
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> it) {
+        mTime.setClose(EHT_TIME, CoSleep::funcOnClose, it.address());
+        mTime.setTime(CoSleep::funcOnTime, mWait, 0, 0);
+        mResult = mLoop.openHandle(&mTime);
+        return EE_OK == mResult;
+    }
+
+    s32 await_resume() const noexcept {
+        return mResult;
+    }
+
+private:
+    Loop& mLoop;
+    HandleTime mTime;
+    s64 mWait;
+    s32 mResult;
+
+    static s32 funcOnTime(HandleTime* it) {
+        return EE_OK; // fire once, then closed
+    }
+
+    static void funcOnClose(Handle* it) {
+        std::coroutine_handle<>::from_address(it->getUser()).resume();
+    }
+};
+
+
+/**
+ * @brief co_await CoSwitch(loop), resume in the thread of loop by Loop::postTask().
+ * co_await CoSwitch(Engine::getInstance().getLoop()) yields to the other tasks of current loop.
+ */
+class CoSwitch {
+public:
+    explicit CoSwitch(Loop& it) : mLoop(it), mResult(EE_OK) {
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> it) {
+        // the coroutine may be resumed by the other thread before return, so no member touched if posted
+        s32 ret = mLoop.postTask(CoSwitch::funcOnTask, it.address());
+        if (EE_OK != ret) {
+            mResult = ret;
+            return false;
+        }
+        return true;
+    }
+
+    s32 await_resume() const noexcept {
+        return mResult;
+    }
+
+private:
+    Loop& mLoop;
+    s32 mResult;
+
+    static void funcOnTask(void* it) {
+        std::coroutine_handle<>::from_address(it).resume();
+    }
+};
+
+} // namespace app
+
+#endif // __cpp_impl_coroutine
+
+#endif // APP_COROUTINE_H
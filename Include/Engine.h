@@ -27,13 +27,15 @@
 #define	APP_ENGINE_H
 
 #include <atomic>
+#include <mutex>
 #include "TString.h"
 #include "TVector.h"
 #include "EngineConfig.h"
 #include "Loop.h"
 #include "Logger.h"
 #include "MapFile.h"
-#include "MemSlabPool.h"
+#include "ShareAllocator.h"
+#include "MemAccount.h"
 #include "Net/TlsContext.h"
 #include "Script/ScriptManager.h"
 
@@ -61,6 +63,11 @@ enum ECommandType {
     ECT_TASK = 3,
     ECT_RESPAWN = 4,
 
+    ECT_UPGRADE = 5,
+    ECT_UPGRADE_RESP = ECT_RESP_BIT | ECT_UPGRADE,
+
+    ECT_MEM_REPORT = 6, // log the memory report of each process, @see Engine::logMemory()
+
     ECT_VERSION = 0xF001
 };
 
@@ -116,6 +123,44 @@ struct CommandTask : public MsgHeader {
 };
 
 
+// max listeners of a process in hot upgrade, less than SCM_MAX_FD(253)
+const u32 G_MAX_HANDOFF = 128;
+
+/**
+ * @brief hot upgrade, sent by main process to child.
+ * step 1: reply CommandUpgradeResp, with the listeners attached by SCM_RIGHTS.
+ * step 2: stop accepting, and exit after all links closed or EngineConfig::mUpgradeDrain.
+ * @see Engine::upgrade()
+ */
+struct CommandUpgrade : public MsgHeader {
+    u32 mStep;
+
+    void pack(u32 step) {
+        init(ECT_UPGRADE, sizeof(*this), 0, ECT_VERSION);
+        mSN = ++gSharedSN;
+        mStep = step;
+    }
+};
+
+struct ListenerInfo {
+    u32 mSlot;    // worker slot of the loop which owns the listener, @see Engine::getWorkerSlot()
+    s8 mAddr[60]; // local address, eg: "0.0.0.0:80"
+};
+
+struct CommandUpgradeResp : public MsgHeader {
+    u32 mCount;
+    ListenerInfo mListener[G_MAX_HANDOFF];
+
+    // @note pack before filling mListener, the payload will be cleared
+    void pack(u32 sn, u32 count) {
+        init(ECT_UPGRADE_RESP, (u16)(sizeof(MsgHeader) + sizeof(mCount) + count * sizeof(ListenerInfo)), 0,
+            ECT_VERSION);
+        mSN = sn;
+        mCount = count;
+    }
+};
+
+
 struct Process {
     s32 mID;
     s32 mStatus;
@@ -125,7 +170,11 @@ struct Process {
 };
 
 
-struct EngineStats {
+/**
+ * @brief counters of a loop, aligned to cache line, so loops of all processes never write the same line.
+ * A slot holds part of the counters only, @see Engine::sumEngineStats()
+ */
+struct alignas(64) EngineStats {
     std::atomic<ssz> mTotalHandles;
     std::atomic<ssz> mClosedHandles;
     std::atomic<ssz> mFlyRequests;
@@ -135,13 +184,32 @@ struct EngineStats {
     std::atomic<ssz> mOutPackets;
     std::atomic<ssz> mHeartbeat;
     std::atomic<ssz> mHeartbeatResp;
+    std::atomic<ssz> mFairDefers; // requests re-queued by fairness budget of loop
     void clear() {
         memset(this, 0, sizeof(*this));
     }
+    void add(const EngineStats& it) {
+        mTotalHandles += it.mTotalHandles.load(std::memory_order_relaxed);
+        mClosedHandles += it.mClosedHandles.load(std::memory_order_relaxed);
+        mFlyRequests += it.mFlyRequests.load(std::memory_order_relaxed);
+        mInBytes += it.mInBytes.load(std::memory_order_relaxed);
+        mOutBytes += it.mOutBytes.load(std::memory_order_relaxed);
+        mInPackets += it.mInPackets.load(std::memory_order_relaxed);
+        mOutPackets += it.mOutPackets.load(std::memory_order_relaxed);
+        mHeartbeat += it.mHeartbeat.load(std::memory_order_relaxed);
+        mHeartbeatResp += it.mHeartbeatResp.load(std::memory_order_relaxed);
+        mFairDefers += it.mFairDefers.load(std::memory_order_relaxed);
+    }
 };
 
+// slots of EngineStats, loops share a slot if (processes * loops) > G_STATS_SLOT_COUNT
+const u32 G_STATS_SLOT_COUNT = 256;
+
 struct EngineData {
-    EngineStats mStats;
+    EngineStats mStats[G_STATS_SLOT_COUNT];
+    MemUsage mMemUsage[G_STATS_SLOT_COUNT]; // same slots as mStats, @see MemAccount
+    LoopStats mLoopStats;
+    std::atomic<u32> mListenTurn; // worker slot which can listen now, @see Engine::lockListen()
     Process* mAllProcess;
     s32 mProcessCount;
 };
@@ -183,8 +251,23 @@ public:
         return mThreadPool;
     }
 
+    /**
+     * @return the loop of current thread, or the main loop if called by a non-loop thread.
+     */
     Loop& getLoop() {
-        return mLoop;
+        return gThreadLoop ? *gThreadLoop : mLoop;
+    }
+
+    /**
+     * @brief post works to a specific loop by getLoop(idx).postTask()
+     * @param idx [0, getLoopCount()), 0 is the main loop of process.
+     */
+    Loop& getLoop(u32 idx) {
+        return 0 == idx ? mLoop : *mLoops[idx - 1];
+    }
+
+    u32 getLoopCount() const {
+        return 1 + (u32)mLoops.size();
     }
 
     // @return the default TLS context
@@ -220,18 +303,97 @@ public:
         return mMain;
     }
 
-    /** @return Engine's statistics datas in shared mem. @see mMapfile. */
+    /**
+     * @return the counters slot of current loop in shared mem, for writers.
+     * Threads of no loop write the slot of main loop. @see sumEngineStats() for readers.
+     */
     EngineStats& getEngineStats() {
-        return reinterpret_cast<EngineData*>(mMapfile.getMem())->mStats;
+        if (!gThreadStats) {
+            gThreadStats = &getStatsSlot(0);
+        }
+        return *gThreadStats;
     }
 
-    MemSlabPool& getMemSlabPool() {
-        return *reinterpret_cast<MemSlabPool*>(mMapfile.getMem() + sizeof(EngineData));
+    /**
+     * @brief sum the counters of all processes and loops.
+     * @param out the totals
+     */
+    void sumEngineStats(EngineStats& out);
+
+    /**
+     * @brief sum the memory counters in shared mem.
+     * @param all true to sum all processes, else the loops of this process only.
+     */
+    void sumMemUsage(MemUsage& out, bool all);
+
+    /**
+     * @brief log the memory report of this process, called by main loop when got ECT_MEM_REPORT.
+     * The main process logs the totals of all processes and the shared mem too.
+     */
+    void logMemory();
+
+    /** @return Loop's cost statistics in shared mem, enabled by EngineConfig::mLoopStats. */
+    LoopStats& getLoopStats() {
+        return reinterpret_cast<EngineData*>(mMapfile.getMem())->mLoopStats;
+    }
+
+    /**
+     * @return the allocator of shared mem, the memory can be shared by all processes.
+     */
+    ShareAllocator& getShareAllocator() {
+        return mShareAllocator;
     }
 
-    usz getMemSlabPoolSize() const {
+    usz getShareAllocatorSize() const {
         return mConfig.mMemSize - sizeof(EngineData);
     }
+
+    /**
+     * @return the index of current thread's loop in this process, 0 if not a loop thread.
+     */
+    u32 getLoopIndex() const;
+
+    /**
+     * @return worker slot of the loop, = worker process index * EngineConfig::mMaxLoop + loop index
+     */
+    u32 getWorkerSlot(u32 loop) const;
+
+    /**
+     * @brief called by loop thread before opening it's listeners.
+     * if EngineConfig::mListenSteer is 2, wait until all the workers before this one listened, so the
+     * index of listener in reuseport group equal to it's worker slot.
+     * @see unlockListen()
+     */
+    void lockListen();
+
+    // @brief called by loop thread after opening it's listeners, @see lockListen()
+    void unlockListen();
+
+    /**
+     * @brief steer the new connections of reuseport group by cpu, called by loop thread after listen().
+     * @see EngineConfig::mListenSteer
+     */
+    void steerListener(net::Socket& sock);
+
+    /**
+     * @brief take the listener handed off by the old process of hot upgrade, called by loop thread.
+     * @param addr local address of listener
+     * @return the listening socket, or DINVALID_SOCKET if none, the caller owns it.
+     */
+    net::netsocket takeListener(const s8* addr);
+
+    // @brief called by loop thread after a listener opened or closed, @see upgrade()
+    void addListener(net::HandleTCP* it);
+    void removeListener(net::HandleTCP* it);
+
+    /**
+     * @brief hot upgrade, called by main process, @see ECT_UPGRADE.
+     * exec the new binary with all the listeners, then old workers stop accepting and exit after drained.
+     */
+    void upgrade(void* it);
+
+    // @brief called by loop of child process when got ECT_UPGRADE
+    void onUpgrade(const CommandUpgrade& cmd, net::Socket& sock);
 protected:
     Engine();
     ~Engine();
@@ -244,10 +406,16 @@ private:
     String mAppPath;
     String mAppName;
     Loop mLoop;
+    TVector<Loop*> mLoops;                  // loops on dedicated threads, @see EngineConfig::mMaxLoop
+    std::vector<std::thread> mLoopThreads;
+    static thread_local Loop* gThreadLoop;  // loop of current thread
+    static thread_local EngineStats* gThreadStats; // counters slot of current thread
     MapFile mMapfile;
+    ShareAllocator mShareAllocator;
     ThreadPool mThreadPool;
     s32 mPPID;
     s32 mPID;
+    u32 mProcIndex; // 0=main process, else child index + 1
     std::atomic<s32> mProcResponCount;
     s32 mProcStatus;
     bool mMain;
@@ -255,6 +423,25 @@ private:
     net::TlsContext mTlsENG;
     TVector<Process> mChild;
 
+    struct Listener {
+        net::HandleTCP* mHandle;
+        u32 mSlot;
+    };
+    struct ListenerFD {
+        net::netsocket mSock;
+        ListenerInfo mInfo;
+    };
+    std::mutex mListenMutex;
+    TVector<Listener> mListeners;   // listeners of all loops in this process
+    TVector<ListenerFD> mInherited; // listeners handed off by the old process, not taken yet
+    s32 mUpgradeReady;              // fd to notify the old process, -1 if not upgraded
+    std::atomic<s32> mUpgradeCount; // posted ECT_UPGRADE
+    std::atomic<s32> mUpgradePID;   // 0=none, -1=upgrading, else pid of the new binary
+    std::atomic<u32> mDrainedLoops;
+    // mChild is used by upgrade() on a pool thread, respawned by run(), and written by postCommand(),
+    // recursive as postCommand() runs in signal handler too, maybe on the thread holding it
+    std::recursive_mutex mChildMutex;
+
     CommandTask mProcessTask;
 
     bool createProcess();
@@ -262,8 +449,58 @@ private:
     bool runMainProcess();
     bool runChildProcess(net::Socket& readSock, net::Socket& writeSock);
 
+    /**
+     * @brief start (EngineConfig::mMaxLoop - 1) loops on dedicated threads, listeners of each
+     * loop are spread by SO_REUSEPORT.
+     */
+    bool startLoops();
+    void stopLoops();
+    void runLoop(Loop* it, u32 idx);
+
+    /**
+     * @brief bind current thread to the cpu of loop, and the numa node of the cpu if config.
+     * @param loop index of loop in this process, 0 is the loop of main thread.
+     */
+    void bindLoopCPU(u32 loop);
+    static void funcPoolThread();
+
+    // log MemStat of each arena of shared mem
+    void logShareMem();
+
+    u32 getStatsIndex(u32 loop) const {
+        return (mProcIndex * mConfig.mMaxLoop + loop) % G_STATS_SLOT_COUNT;
+    }
+
+    EngineStats& getStatsSlot(u32 loop) {
+        EngineData* dat = reinterpret_cast<EngineData*>(mMapfile.getMem());
+        return dat->mStats[getStatsIndex(loop)];
+    }
+
+    MemUsage& getMemUsageSlot(u32 loop) {
+        EngineData* dat = reinterpret_cast<EngineData*>(mMapfile.getMem());
+        return dat->mMemUsage[getStatsIndex(loop)];
+    }
+
     void initPath(const s8* fname);
     void initTask(void* it);
+
+    /**
+     * @brief hot upgrade: parse the listeners handed off by the old process from environment.
+     */
+    void initInherited();
+
+    /**
+     * @brief close the inherited listeners of worker slots in range [first, last).
+     */
+    void closeInherited(u32 first, u32 last);
+
+    /**
+     * @brief hot upgrade: close the listeners of current loop without shutdown(), then exit the process
+     * after all links closed, called by each loop of old worker.
+     */
+    void drainLoop(void* it);
+    static s32 funcOnDrain(HandleTime* it);
+    static void funcOnDrainClose(Handle* it);
 };
 
 
@@ -30,6 +30,7 @@
 #include "TVector.h"
 #include "HashDict.h"
 #include "Net/NetAddress.h"
+#include "Net/Socket.h"
 
 namespace app {
 
@@ -60,6 +61,7 @@ struct WebsiteCfg {
     TlsConfig mTLS;
     String mHost;
     net::NetAddress mLocal;
+    net::SocketOption mSockOpt; // options of listener
     HashDict* mDict; // cache of site
     WebsiteCfg() : mType(0), mTimeout(20 * 1000), mSpeed(1024 * 4), mDict(nullptr) {
     }
@@ -73,11 +75,15 @@ struct WebsiteCfg {
 
 
 struct ProxyCfg {
-    u8 mType;     // 0=[tcp-tcp], 1=[tls-tcp], 2=[tcp-tls], 3=[tls-tls]
-    u32 mTimeout; // in milliseconds
-    u32 mSpeed;   // in bytes per seconds
+    u8 mType;       // 0=[tcp-tcp], 1=[tls-tcp], 2=[tcp-tls], 3=[tls-tls]
+    u32 mTimeout;   // in milliseconds
+    u32 mSpeed;     // in bytes per seconds
+    u32 mWaterHigh; // in bytes, pause reading if the other side queued so many bytes to write, 0=disable
+    u32 mWaterLow;  // in bytes, resume reading if the other side drained to it
+    bool mFastOpen; // connect backend with TCP_FASTOPEN_CONNECT, @see net::HandleTCP::setFastOpen()
     net::NetAddress mLocal;
     net::NetAddress mRemote;
+    net::SocketOption mSockOpt; // options of listener
 };
 
 
@@ -92,15 +98,42 @@ public:
     bool save(const String& cfg);
 
     bool mDaemon;
+    bool mURingNet; // true: TCP/UDP go through io_uring completions, false: epoll readiness
+    bool mNumaBind; // true: loop threads allocate memory from the numa node of its cpu(linux)
     u8 mPrint;
     u8 mMaxPostAccept;
     u8 mMaxThread;
     s16 mMaxProcess;
+    u8 mHugePage;       // EHugePageMode, huge pages for pools, rings and share mem: 0=off, 1=THP, 2=hugetlb then THP
+    u8 mMaxLoop;        // count of loops per process, each loop runs on a dedicated thread
+    u8 mListenSteer;    // each loop has it's own listener in reuseport group, steer new connections by:
+                        // 0=kernel hash, 1=SO_INCOMING_CPU of loop's cpu, 2=classic BPF by cpu(linux)
+    u32 mURingBufCount; // io_uring mode: count of provided buffers, 0=disable multishot accept/recv
+    u32 mURingBufSize;  // bytes of each provided buffer
+    u32 mLoopStats;     // in microseconds, 0=disable LoopStats, else log the callbacks which cost more than it
+    u32 mBusyPoll;      // in microseconds, max spin budget of loop after activity, 0=always block in poll
+    u32 mBusyPollSock;  // in microseconds, SO_BUSY_POLL of TCP/UDP sockets, 0=not set
+    u32 mFairHandleBytes; // epoll mode: max bytes of a handle per loop step, then re-queue it to next step, 0=unlimited
+    u32 mFairHandleReqs;  // epoll mode: max requests of a handle per loop step, 0=unlimited
+    u32 mFairStepBytes;   // epoll mode: max bytes of all handles per loop step, 0=unlimited
+    u32 mFairStepReqs;    // epoll mode: max requests of all handles per loop step, 0=unlimited
+    u32 mUpgradeDrain;    // in seconds, hot upgrade: max time of old workers to finish their links, @see ECT_UPGRADE
     u64 mMemSize;
+    usz mBufPoolCache; // bytes of idle request buffers cached by each loop, @see BufferPool
+    usz mBufPoolHuge;  // bytes of hugepage chunks backing request buffers of each loop, 0=disable
+    usz mHugePageArena; // bytes reserved for the small pieces of huge pages, @see HugePage::allocPiece()
     String mLogPath;
     String mPidFile;
     String mMemName;
+    String mCpuLoop; // cpus of loops, ""=not bind, "auto"=by cpu topology, or cpulist, eg: "0-7,16-23"
+    String mCpuPool; // cpus of thread pool, same format as mCpuLoop
+    String mCpuSkip; // cpus never used by "auto", eg: the cpus handling NIC IRQs
+    TVector<u16> mLoopCPUs; // cpu of each loop, index = worker process index * mMaxLoop + loop index
+    TVector<u16> mPoolCPUs; // cpus shared by all threads of thread pool
     TlsConfig mEngTlsConfig; // the default cfg for engine
+
+private:
+    void initCPUs();
 };
 
 
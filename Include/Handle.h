@@ -30,6 +30,7 @@
 #include <string>
 #include "Node.h"
 #include "Nocopy.h"
+#include "TimerWheel.h"
 #include "Logger.h"
 
 
@@ -48,6 +49,11 @@ typedef void (*FunCloseCallback)(Handle*);
  */
 typedef s32(*FunTimeCallback)(HandleTime*);
 
+/**
+ * @brief called when queued write bytes fall to the low watermark after reached the high.
+ * @see WriteWater */
+typedef void (*FunDrainCallback)(Handle*);
+
 
 enum EHandleType {
     EHT_UNKNOWN = 0,
@@ -69,6 +75,9 @@ enum EHandleFlag {
     EHF_WRITEABLE = 0x00000010,
     EHF_SYNC_READ = 0x00000020,
     EHF_SYNC_WRITE = 0x00000040,
+    EHF_DEFER_READ = 0x00000080,  // read request re-queued to next step by fairness budget, @see Loop::deferPending()
+    EHF_DEFER_WRITE = 0x00000100, // write request re-queued to next step by fairness budget
+    EHF_HANDOFF = 0x00000200,     // listener handed off to the upgraded process, close it without shutdown()
     EHF_INIT = 0x0
 };
 
@@ -147,6 +156,9 @@ public:
 
     s32 launchClose();
 
+    // @brief close a listener handed off to the new process without shutdown(), @see EHF_HANDOFF
+    s32 launchHandoff();
+
     s32 getType() const {
         return mType;
     }
@@ -180,6 +192,42 @@ protected:
 };
 
 
+/**
+ * @brief watermarks of the bytes queued in write requests but not landed yet.
+ * full if bytes >= high, and notify once it drains to low.
+ */
+struct WriteWater {
+    usz mBytes;
+    u32 mHigh; // 0=disabled
+    u32 mLow;
+    bool mFull;
+    FunDrainCallback mCallDrain;
+
+    WriteWater() : mBytes(0), mHigh(0), mLow(0), mFull(false), mCallDrain(nullptr) {
+    }
+
+    void add(usz bytes) {
+        mBytes += bytes;
+        if (mHigh > 0 && mBytes >= mHigh) {
+            mFull = true;
+        }
+    }
+
+    /**
+     * @param bytes of a landed write request
+     * @return true if drained to low and need to notify
+     */
+    bool land(usz bytes) {
+        mBytes = bytes < mBytes ? mBytes - bytes : 0;
+        if (mFull && mBytes <= mLow) {
+            mFull = false;
+            return nullptr != mCallDrain;
+        }
+        return false;
+    }
+};
+
+
 class HandleTime : public Handle {
 public:
     HandleTime() :
@@ -252,7 +300,8 @@ protected:
     friend class Loop;
 
     s32 mRepeat;  // <0为永循环, >0为循环次数, 0为触发一次
-    Node3 mLink;
+    Node3 mLink;  // EHT_TIME: 精确定时, 位于Loop的最小堆
+    TimerWheel::STimeNode mWheel; // 其它句柄的空闲超时, 位于Loop的时间轮
     s64 mTimeout;
     s64 mTimeGap;
     FunTimeCallback mCallTime;
@@ -0,0 +1,128 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#ifndef APP_HUGEPAGE_H
+#define APP_HUGEPAGE_H
+
+#include <atomic>
+#include "Config.h"
+
+namespace app {
+
+enum EHugePageMode {
+    EHPM_OFF = 0,    // normal pages
+    EHPM_THP = 1,    // transparent huge pages, madvise(MADV_HUGEPAGE)
+    EHPM_HUGETLB = 2 // reserved huge pages, MAP_HUGETLB, fallback to THP if none
+};
+
+struct HugePageStats {
+    std::atomic<s64> mTLBBytes;   // bytes mapped by MAP_HUGETLB
+    std::atomic<s64> mTHPBytes;   // bytes advised as THP
+    std::atomic<s64> mTLBFails;   // MAP_HUGETLB failed, fallback to THP
+    std::atomic<s64> mPieceUsed;  // bytes of pieces in use
+    std::atomic<s64> mPieceTotal; // bytes of piece arena refilled
+};
+
+
+/**
+ * @brief 大页内存, 降低TLB缺失. 两种用法:
+ * 1. mapMem()直接映射大块内存, 如io_uring缓冲区, 共享内存, BufferPool的大页块.
+ * 2. allocPiece()从预留的大页区域(piece arena)切分小块, 如MemoryPool的页, RingBuffer的节点.
+ *    区域按2MB大块补充, 释放的小块按大小挂空闲链表复用, 不归还系统.
+ *    每个线程缓存自己的空闲小块, 与全局空闲链表成批交换, 只有换批时才加全局锁.
+ * 大页不可用时平稳回退: HUGETLB -> THP -> 普通页(调用者自行malloc).
+ */
+class HugePage {
+public:
+    static const usz G_CHUNK_SIZE = 2 * 1024 * 1024;
+
+    /**
+     * @brief set mode and reserve the piece arena, call once at startup.
+     * @param mode EHugePageMode
+     * @param arena bytes of virtual space reserved for pieces, 0=disable allocPiece()
+     */
+    static void init(s32 mode, usz arena);
+
+    static s32 getMode() {
+        return gMode;
+    }
+
+    static usz roundSize(usz size) {
+        return AppAlignSize(size, G_CHUNK_SIZE);
+    }
+
+    /**
+     * @brief map anonymous memory, backed by huge pages if enabled.
+     * @param size in: bytes wanted, out: bytes mapped, rounded to G_CHUNK_SIZE if hugepage enabled.
+     * @param shared true to share with child processes.
+     * @param mode EHugePageMode, -1 means getMode().
+     * @return nullptr if failed.
+     */
+    static void* mapMem(usz& size, bool shared = false, s32 mode = -1);
+
+    static void unmapMem(void* mem, usz size);
+
+    /**
+     * @brief advise a mapped range as THP, eg: a shared file mapping.
+     */
+    static void adviseMem(void* mem, usz size);
+
+    /**
+     * @brief allocate a piece from the piece arena, thread safe, lock free if cached by current thread.
+     * @return nullptr if disabled or the arena is used up, the caller should fallback to heap.
+     */
+    static void* allocPiece(usz size);
+
+    /**
+     * @return false if \p mem is not a piece, the caller should free it to heap.
+     */
+    static bool releasePiece(void* mem, usz size);
+
+    static bool isPiece(const void* mem) {
+        return (const s8*)mem >= gArena && (const s8*)mem < gArenaEnd;
+    }
+
+    static HugePageStats& getStats() {
+        return gStats;
+    }
+
+    /**
+     * @brief log the stats, and the huge pages in use read from system, eg: /proc/self/smaps_rollup.
+     */
+    static void logStats(const s8* tag);
+
+private:
+    static s32 gMode;
+    static s8* gArena;
+    static s8* gArenaEnd;
+    static HugePageStats gStats;
+
+    static bool refill(s8* end);
+};
+
+} // namespace app
+
+#endif // APP_HUGEPAGE_H
@@ -26,6 +26,7 @@
 #ifndef APP_IOURING_H
 #define APP_IOURING_H
 
+#include <atomic>
 #include "Nocopy.h"
 #include "Linux/Request.h"
 
@@ -33,6 +34,7 @@ namespace app {
 
 enum IORingSetupFlag {
     IORING_SETUP_SQPOLL = 2u, // SQPOLL mode, make the kernal create SQ thread, and add io_uring FD in epoll
+    IORING_SETUP_NO_MMAP = 1u << 14, // linux v6.5, the rings are in user's memory, @see HugePage
 };
 
 enum {
@@ -58,6 +60,30 @@ enum {
 };
 
 
+enum {
+    IOSQE_BUFFER_SELECT = 32u, // select a buffer from provided-buffer ring
+};
+
+
+enum {
+    IORING_ACCEPT_MULTISHOT = 1u, // sqe->ioprio of IORING_OP_ACCEPT, linux v5.19
+    IORING_RECV_MULTISHOT = 2u,   // sqe->ioprio of IORING_OP_RECV, linux v6.0
+};
+
+
+enum {
+    IORING_ASYNC_CANCEL_ALL = 1u, // sqe->cancel_flags of IORING_OP_ASYNC_CANCEL, linux v5.19
+    IORING_ASYNC_CANCEL_FD = 2u,  // match by sqe->fd, not user_data
+};
+
+
+enum {
+    IORING_CQE_F_BUFFER = 1u, // the upper 16 bits of cqe->flags is buffer ID
+    IORING_CQE_F_MORE = 2u,   // multishot SQE is still armed, more CQEs will come
+    IORING_CQE_BUFFER_SHIFT = 16u,
+};
+
+
 /**
  * @beief must keep in order
  */
@@ -143,6 +169,66 @@ public:
 
     s32 postReq(RequestFD* req);
 
+    /**
+     * @brief queue a TCP/UDP request, it's SQE will be filled at next postQueue().
+     * @note the fly request of handle must be bound by caller, @see Loop::addPending()
+     */
+    void postNet(RequestFD* req);
+
+    /**
+     * @brief fill SQEs with the waiting requests, and wakeup the SQ thread if need.
+     */
+    void postQueue();
+
+    /**
+     * @brief cancel all the requests in flight on a fd, their CQEs land with -ECANCELED.
+     * unlike shutdown(), the socket is untouched for other processes, eg: listener handed off.
+     * @return true if the cancel SQE queued, need linux v5.19.
+     */
+    bool cancelFD(s32 fd);
+
+    u32 getWaitCount() const {
+        return mWaitPostSize;
+    }
+
+    /**
+     * @return true if any CQE landed, peek the CQ ring without syscall.
+     */
+    bool hasCQE() const {
+        return -1 != mRingFD
+               && *mHeadCQ
+                      != std::atomic_load_explicit(
+                          reinterpret_cast<std::atomic<u32>*>(mTailCQ), std::memory_order_acquire);
+    }
+
+    /**
+     * @brief register a provided-buffer ring(group 0), used by multishot recv.
+     * @param count buffers count, will be up to power of 2, max 32768.
+     * @param bsize size of each buffer.
+     * @return true if success, else failed(need linux v5.19).
+     */
+    bool openBufRing(u32 count, u32 bsize);
+
+    /**
+     * @return true if provided-buffer ring opened, multishot accept/recv enabled.
+     */
+    bool isMultishot() const {
+        return nullptr != mBufRing;
+    }
+
+    s8* getRingBuf(u16 bid) const {
+        return mBufs + (usz)bid * mBufSize;
+    }
+
+    u32 getRingBufSize() const {
+        return mBufSize;
+    }
+
+    /**
+     * @brief give the buffer back to kernel.
+     */
+    void recycleRingBuf(u16 bid);
+
     s32 getRingFD() const {
         return mRingFD;
     }
@@ -176,10 +262,15 @@ private:
     u32 mFlags;
     u32 mWaitPostSize;         // count of RequestFDs in \p mWaitPostQueue
     RequestFD* mWaitPostQueue; // point to tail,mWaitPostQueue->mNext is head
+    void* mBufRing;            // provided-buffer ring shared with kernel
+    s8* mBufs;                 // buffers of mBufRing
+    u32 mBufCount;
+    u32 mBufSize;
+    u16 mBufTail;
 
     void* getSQE();
     void wakeupThreadSQ();
-    void postQueue();
+    void closeBufRing();
 };
 
 } // namespace app
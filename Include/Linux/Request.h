@@ -3,9 +3,11 @@
 
 #include "Config.h"
 #include "Nocopy.h"
+#include "BufferPool.h"
 #include "TString.h"
 #include "Net/NetAddress.h"
 #include "Net/Socket.h"
+#include <sys/socket.h>
 
 namespace app {
 class Handle;
@@ -22,10 +24,18 @@ enum ERequestType {
     ERT_COUNT
 };
 
+enum ERequestFlag {
+    ERF_CONNECTED = 1,  //UDP: had connected
+    ERF_MULTISHOT = 2,  //io_uring: multishot SQE armed, request is owned by loop until the final callback
+    ERF_RING_BUF = 4,   //io_uring: mData point to a buffer of provided-buffer ring, valid in callback only
+    ERF_IOV = 8         //scatter/gather write, the request is a RequestIOV
+};
+
 class RequestFD : public Nocopy {
 public:
-    static RequestFD* newRequest(u32 cache_size) {
-        RequestFD* it = reinterpret_cast<RequestFD*>(new s8[sizeof(RequestFD) + cache_size]);
+    // @param tag user of request, @see EMemUsage
+    static RequestFD* newRequest(u32 cache_size, s32 tag = EMU_NET) {
+        RequestFD* it = reinterpret_cast<RequestFD*>(BufferPool::allocBuf(sizeof(RequestFD) + cache_size, tag));
         new ((void*)it) RequestFD();
         it->mAllocated = cache_size;
         it->mData = reinterpret_cast<s8*>(it + 1);
@@ -33,7 +43,7 @@ public:
     }
 
     static void delRequest(RequestFD* it) {
-        delete[] reinterpret_cast<s8*>(it);
+        BufferPool::releaseBuf(it);
     }
 
     RequestFD() {
@@ -76,6 +86,16 @@ public:
         return mAllocated - mUsed;
     }
 
+    //io_uring: detach the buffer which borrowed from provided-buffer ring
+    void detachRingBuf() {
+        if (ERF_RING_BUF & mFlags) {
+            mFlags &= ~ERF_RING_BUF;
+            mData = nullptr;
+            mAllocated = 0;
+            mUsed = 0;
+        }
+    }
+
     void clearData(u32 used) {
         if (used >= mUsed) {
             mUsed = 0;
@@ -91,6 +111,7 @@ public:
     s32 mType;      //ERequestType
     s32 mError;     //0=success,else failed code
     u32 mStepSize;
+    u32 mFlags;     //ERequestFlag bits
     u64 mOffset;
     FuncReqCallback mCall;
     s8* mData;
@@ -101,11 +122,13 @@ public:
 
 class RequestUDP : public RequestFD {
 public:
-    u32 mFlags;   //bits: [1=had connected, ...]
     net::NetAddress mRemote;
+    struct msghdr mMsg; //io_uring RECVMSG/SENDMSG, must keep alive until completion
+    struct iovec mVec;
 
-    static RequestUDP* newRequest(u32 cache_size) {
-        RequestUDP* it = reinterpret_cast<RequestUDP*>(new s8[sizeof(RequestUDP) + cache_size]);
+    // @param tag user of request, @see EMemUsage
+    static RequestUDP* newRequest(u32 cache_size, s32 tag = EMU_NET) {
+        RequestUDP* it = reinterpret_cast<RequestUDP*>(BufferPool::allocBuf(sizeof(RequestUDP) + cache_size, tag));
         new ((void*)it) RequestUDP();
         it->mAllocated = cache_size;
         it->mData = reinterpret_cast<s8*>(it + 1);
@@ -113,7 +136,7 @@ public:
     }
 
     static void delRequest(RequestUDP* it) {
-        delete[] reinterpret_cast<s8*>(it);
+        BufferPool::releaseBuf(it);
     }
 
     RequestUDP(){
@@ -125,15 +148,107 @@ public:
 };
 
 
+typedef void (*FuncSliceRelease)(void* user);
+
+struct SliceIOV {
+    const s8* mData;
+    u32 mLen;
+    FuncSliceRelease mRelease;  //optional, @see RequestIOV::releaseSlices()
+    void* mUser;
+};
+
+/**
+ * @brief scatter/gather write request, all the slices are sent in order as one stream.
+ * mData/mAllocated is a small cache(eg: http head), mUsed is the total size of slices.
+ * @note slices must keep alive until mCall, and mCall should call releaseSlices().
+ */
+class RequestIOV : public RequestFD {
+public:
+    static const u32 MAX_SLICE = 8;
+
+    SliceIOV mSlices[MAX_SLICE];
+    u32 mSliceCount;
+    struct msghdr mMsg; //io_uring SENDMSG, must keep alive until completion
+    struct iovec mVecs[MAX_SLICE];
+
+    RequestIOV() : mSliceCount(0) {
+        // RequestFD is cleared by it's constructor
+        memset(mSlices, 0, sizeof(mSlices));
+        memset(&mMsg, 0, sizeof(mMsg));
+        memset(mVecs, 0, sizeof(mVecs));
+        mFlags = ERF_IOV;
+    }
+
+    ~RequestIOV() {
+    }
+
+    /**
+    * @brief take the filled cache [mData, mData+mUsed) as the first slice.
+    */
+    void commitCache() {
+        DASSERT(0 == mSliceCount);
+        u32 len = mUsed;
+        mUsed = 0;
+        addSlice(mData, len);
+    }
+
+    bool addSlice(const void* data, u32 len, FuncSliceRelease release = nullptr, void* user = nullptr) {
+        if (mSliceCount >= MAX_SLICE) {
+            return false;
+        }
+        SliceIOV& it = mSlices[mSliceCount++];
+        it.mData = reinterpret_cast<const s8*>(data);
+        it.mLen = len;
+        it.mRelease = release;
+        it.mUser = user;
+        mUsed += len;
+        return true;
+    }
+
+    void releaseSlices() {
+        for (u32 i = 0; i < mSliceCount; ++i) {
+            if (mSlices[i].mRelease) {
+                mSlices[i].mRelease(mSlices[i].mUser);
+            }
+        }
+        mSliceCount = 0;
+        mUsed = 0;
+    }
+
+    /**
+    * @brief fill the unsent part(from mStepSize) into vec.
+    * @return count of iovec filled */
+    u32 fillVec(struct iovec* vec, u32 max) const {
+        u32 skip = mStepSize;
+        u32 cnt = 0;
+        for (u32 i = 0; i < mSliceCount && cnt < max; ++i) {
+            if (skip >= mSlices[i].mLen) {
+                skip -= mSlices[i].mLen;
+                continue;
+            }
+            vec[cnt].iov_base = const_cast<s8*>(mSlices[i].mData) + skip;
+            vec[cnt++].iov_len = mSlices[i].mLen - skip;
+            skip = 0;
+        }
+        return cnt;
+    }
+};
+
+static_assert(sizeof(RequestUDP) <= BufferPool::G_HEAD_ROOM, "the head of request must fit in BufferPool::G_HEAD_ROOM");
+static_assert(sizeof(RequestIOV) <= BufferPool::G_HEAD_ROOM_IOV, "the head of request must fit in BufferPool::G_HEAD_ROOM_IOV");
+
+
 class RequestAccept : public RequestFD {
 public:
     net::Socket mSocket;
     net::NetAddress mLocal;
     net::NetAddress mRemote;
+    socklen_t mAddrSize; //io_uring ACCEPT, must keep alive until completion
 
     RequestAccept(FuncReqCallback func, void* iUser, s32 addrSize) {
         mLocal.setAddrSize(addrSize);
         mRemote.setAddrSize(addrSize);
+        mAddrSize = addrSize;
         mUser = iUser;
         mCall = func;
         mData = (s8*)(this + 1);
@@ -31,10 +31,13 @@
 #include "MsgHeader.h"
 #include "BinaryHeap.h"
 #include "Spinlock.h"
+#include "ThreadLocal.h"
 #include "ThreadPool.h"
 #include "Handle.h"
 #include "Net/HandleTCP.h"
 #include "Packet.h"
+#include "Timer.h"
+#include "LoopStats.h"
 #include "Net/EventPoller.h"
 
 #if defined(DOS_WINDOWS)
@@ -68,6 +71,20 @@ public:
         return mGrabCount;
     }
 
+    /**
+    * @return count of TCP links(accepted or connected) in this loop, the cmd link excluded.
+    */
+    s32 getLinkCount()const {
+        s32 ret = 0;
+        for (const Node2* nd = mHandleActive.mNext; &mHandleActive != nd; nd = nd->mNext) {
+            const s32 tp = reinterpret_cast<const Handle*>(nd)->getType();
+            if ((EHT_TCP_LINK == tp || EHT_TCP_CONNECT == tp) && &mCMD != nd) {
+                ++ret;
+            }
+        }
+        return ret;
+    }
+
     s32 grab()const {
         return ++mGrabCount;
     }
@@ -103,8 +120,9 @@ public:
     }
 
     /**
+    * @param opt options template of listener, EHT_TCP_ACCEPT only, set before listen(), @see net::SocketOption
     * @return EE_OK if success, else ecode. */
-    s32 openHandle(Handle* it);
+    s32 openHandle(Handle* it, const net::SocketOption* opt = nullptr);
 
     s32 closeHandle(Handle* it);
 
@@ -143,16 +161,103 @@ public:
 
 #if defined(DOS_LINUX) || defined(DOS_ANDROID)
     s32 postRequest(RequestFD* it);
+
+    /**
+    * @return true if TCP/UDP requests are completed by io_uring, else by epoll.
+    * @see EngineConfig::mURingNet */
+    bool isURingNet()const {
+        return mURingNet;
+    }
+
+    /**
+    * @return true if multishot accept/recv enabled in io_uring mode.
+    * A read request without cache(mAllocated=0) get data from provided-buffer ring.
+    * @see EngineConfig::mURingBufCount */
+    bool isURingMultishot()const {
+        return mURingNet && mPoller.getIOURing().isMultishot();
+    }
+
+    /**
+    * @brief completion of TCP/UDP request in io_uring mode, @see IOURing::updatePending()
+    * @param it the landed request
+    * @param res result of CQE, bytes or accepted socket if >= 0, else -errno
+    * @param flags flags of CQE, IORING_CQE_F_* */
+    void onURingNet(RequestFD* it, s32 res, u32 flags);
 #endif
 
 protected:
     void updatePending();
     u32 updateTimeHub();
+    void updateTimeWheel();
     void updateClosed();
     u32 getWaitTime();
+
+    // @return true if the loop should spin on a zero-timeout poll, @see EngineConfig::mBusyPoll
+    bool isBusyPoll() const {
+        return mBusyPoll > 0 && Timer::getRelativeMicro() < mBusyUntil;
+    }
+
+    /**
+    * @brief adapt the spin budget of busy poll, called after each step.
+    * A spin that catches events doubles the budget(up to EngineConfig::mBusyPoll),
+    * a spin that times out for nothing halves it.
+    * @param spun true if this step was a zero-timeout poll for spinning
+    * @param active true if got events or tasks in this step */
+    void updateBusyPoll(bool spun, bool active) {
+        s64 now = Timer::getRelativeMicro();
+        if (active) {
+            if (spun) {
+                mBusyBudget = mBusyBudget < mBusyPoll / 2 ? mBusyBudget * 2 : mBusyPoll;
+            }
+            mBusyUntil = now + mBusyBudget;
+        } else if (spun && now >= mBusyUntil) {
+            mBusyBudget = mBusyBudget > mBusyPoll / 16 + 1 ? mBusyBudget / 2 : mBusyPoll / 16 + 1;
+        }
+    }
+
+    // @return now, and add the cost since \p last to phase
+    s64 markPhase(ELoopPhase phase, s64 last) {
+        s64 now = Timer::getRelativeMicro();
+        mStats->mPhase[phase].add(now - last);
+        return now;
+    }
+
+    // add the cost of a request callback when leaving scope, @see EngineConfig::mLoopStats
+    class StatsCall {
+    public:
+        StatsCall(const Loop& it, const RequestFD* req) :
+            mStats(it.mStats), mSlow(it.mStatsSlow), mTick(0), mHandleType(0), mReqType(0) {
+            if (mStats) {
+                mTick = Timer::getRelativeMicro();
+                mHandleType = req->mHandle->getType();
+                mReqType = req->mType;
+            }
+        }
+        ~StatsCall() {
+            if (mStats) {
+                mStats->addCall(mHandleType, mReqType, Timer::getRelativeMicro() - mTick, mSlow);
+            }
+        }
+
+    private:
+        LoopStats* mStats;
+        u32 mSlow;
+        s64 mTick;
+        s32 mHandleType;
+        s32 mReqType;
+    };
     void addClose(Handle* it);
     void relinkTime(HandleTime* it);
 
+    // callback of a landed write request on TCP, then notify if drained, @see HandleTCP::setWaterMark()
+    void landWrite(net::HandleTCP* hnd, RequestFD* it) {
+        const bool drained = hnd->mWater.land(it->mUsed);
+        it->mCall(it);
+        if (drained && (EHF_WRITEABLE & hnd->mFlag)) {
+            hnd->mWater.mCallDrain(hnd);
+        }
+    }
+
     void bindHandle(Handle* it);
     void unbindHandle(Handle* it);
 
@@ -168,26 +273,72 @@ protected:
         }
     }
 
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    //io_uring mode: post the next queued request, or mark handle as no request in flight
+    void postNextRead(Handle* it);
+    void postNextWrite(Handle* it);
+
+    //epoll mode: gather the queued write requests of TCP handle into one sendmsg()
+    void writeGather(net::HandleTCP* hnd, RequestFD* nd);
+
+    /**
+    * @brief epoll mode: fairness budget of updatePending(), @see EngineConfig::mFairHandleBytes
+    * @param bytes bytes done by the handle in this step
+    * @param reqs requests done by the handle in this step
+    * @return true if the handle or the whole step used up the budget */
+    bool isOverBudget(usz bytes, u32 reqs) const {
+        return (mFairHandleReqs > 0 && reqs >= mFairHandleReqs) || (mFairHandleBytes > 0 && bytes >= mFairHandleBytes)
+               || (mFairStepReqs > 0 && mStepReqs >= mFairStepReqs)
+               || (mFairStepBytes > 0 && mStepBytes >= mFairStepBytes);
+    }
+
+    /**
+    * @brief epoll mode: re-queue the next request of a handle which used up the budget to next step.
+    * The handle keeps readable/writeable, and it's edge events are ignored until the request resumes.
+    * @param it the next request of handle
+    * @param flag EHF_DEFER_READ or EHF_DEFER_WRITE */
+    void deferPending(RequestFD* it, u32 flag);
+#endif
+
 private:
     s64 mTime;
     mutable s32 mFlyRequest;
     mutable s32 mGrabCount; //=HandleCount
     s32 mMaxEvents;
     s32 mStop;
-    BinaryHeap mTimeHub;    //最小堆用于管理超时事件
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    bool mURingNet;
+    u32 mFairHandleBytes; // budget of a handle per step, 0=unlimited, @see EngineConfig
+    u32 mFairHandleReqs;
+    u32 mFairStepBytes;   // budget of all handles per step
+    u32 mFairStepReqs;
+    usz mStepBytes;       // bytes done in current updatePending()
+    u32 mStepReqs;        // requests done in current updatePending()
+#endif
+    BinaryHeap mTimeHub;    //最小堆用于管理EHT_TIME的精确超时事件
+    TimerWheel mTimeWheel;  //时间轮用于管理其它句柄的空闲超时, 每步10ms
     Node2 mHandleActive;
     Node2 mHandleClose;
     RequestFD* mRequest;
+    LoopStats* mStats; // nullptr if disabled, @see EngineConfig::mLoopStats
+    u32 mStatsSlow;
+    u32 mBusyPoll;     // max spin budget in microseconds, 0=disabled
+    u32 mBusyPollSock; // SO_BUSY_POLL of sockets
+    u32 mBusyBudget;   // current spin budget in microseconds
+    s64 mBusyUntil;    // spin until this time, @see Timer::getRelativeMicro()
     EventPoller mPoller;
     EventPoller::SEvent* mEvents;
 
     // for task queue
-    Spinlock mTaskLock;
-    Spinlock mTaskIdleLock;
-    void** mTaskTailPos;
-    TaskNode* mTaskHead;
-    TaskNode* mTaskHeadIdle;
-    s32 mTaskIdleCount;
+    enum ETaskWake {
+        ETW_AWAKE = 0, //loop is running, no need to wake up
+        ETW_SLEEP = 1, //loop will block in getEvents()
+        ETW_POSTED = 2 //wake event posted
+    };
+    TaskQueue mTasks;
+    TaskQueue mTaskIdle;
+    std::atomic<s32> mTaskIdleCount;
+    std::atomic<s32> mTaskWake;
     s32 mTaskIdleMax;
 
     net::HandleTCP mCMD;
@@ -219,52 +370,97 @@ private:
     //cmd timeout
     s32 onTimeout(HandleTime& it);
 
-    void onTask(void* it);
+    /**
+    * @brief run all the posted tasks, called by loop thread each step
+    * @return count of tasks */
+    s32 onTask();
     s32 postTask(TaskNode* task);
 
-    TaskNode* popTaskNode() {
-        TaskNode* ret = nullptr;
+    /**
+    * @brief called by loop thread before getEvents()
+    * @return true if no task posted, and the loop can sleep. */
+    bool sleepTask() {
+        mTaskWake.store(ETW_SLEEP);
+        return mTasks.empty();
+    }
+
+    void wakeTask() {
+        mTaskWake.store(ETW_AWAKE);
+    }
 
-        mTaskIdleLock.lock();
-        if (mTaskHeadIdle) {
-            ret = mTaskHeadIdle;
-            mTaskHeadIdle = ret->mNext;
-            --mTaskIdleCount;
+    //free TaskNodes of posting thread, so no lock for popTaskNode(), @see ThreadLocal
+    struct TaskCache {
+        TaskNode* mHead;
+        TaskCache() : mHead(nullptr) {
+        }
+        ~TaskCache() {
+            for (TaskNode* nd = mHead; nd; nd = mHead) {
+                mHead = nd->mNext;
+                delete nd;
+            }
         }
-        mTaskIdleLock.unlock();
+    };
 
+    TaskNode* popTaskNode() {
+        TaskCache* cache = ThreadLocal<TaskCache>::get();
+        if (!cache) {
+            return new TaskNode(); // posted while thread exiting
+        }
+        if (!cache->mHead) {
+            // take all idle nodes recycled by loop thread
+            s32 cnt = 0;
+            cache->mHead = mTaskIdle.popAll();
+            for (TaskNode* nd = cache->mHead; nd; nd = nd->mNext) {
+                ++cnt;
+            }
+            mTaskIdleCount -= cnt;
+        }
+        TaskNode* ret = cache->mHead;
         if (ret) {
+            cache->mHead = ret->mNext;
             ret->clear();
             return ret;
         }
         return new TaskNode();
     }
 
+    //give back a node which failed to post, by posting thread
     void pushTaskNode(TaskNode* it) {
         DASSERT(it);
-
-        mTaskIdleLock.lock();
-        if (mTaskIdleCount < mTaskIdleMax) {
-            it->mNext = mTaskHeadIdle;
-            mTaskHeadIdle = it;
-            ++mTaskIdleCount;
-            it = nullptr;
+        TaskCache* cache = ThreadLocal<TaskCache>::get();
+        if (!cache) {
+            delete it;
+            return;
         }
-        mTaskIdleLock.unlock();
+        it->mNext = cache->mHead;
+        cache->mHead = it;
+    }
 
-        if (it) {
-            delete it;
+    //recycle the nodes of finished tasks, by loop thread
+    void pushTaskNode(TaskNode* head, TaskNode* tail, s32 cnt) {
+        if (mTaskIdleCount.load() < mTaskIdleMax) {
+            mTaskIdleCount += cnt;
+            mTaskIdle.pushList(head, tail);
+            return;
+        }
+        for (TaskNode* nd = head; nd; nd = head) {
+            head = nd->mNext;
+            delete nd;
         }
     }
 
     void freeAllTaskNode() {
-        mTaskIdleLock.lock();
-        for (TaskNode* nd = mTaskHeadIdle; nd; nd = mTaskHeadIdle) {
-            mTaskHeadIdle = nd->mNext;
+        for (TaskNode* nd = mTaskIdle.popAll(); nd;) {
+            TaskNode* next = nd->mNext;
+            delete nd;
+            nd = next;
+        }
+        for (TaskNode* nd = mTasks.popAll(); nd;) {
+            TaskNode* next = nd->mNext;
             delete nd;
+            nd = next;
         }
         mTaskIdleCount = 0;
-        mTaskIdleLock.unlock();
     }
 };
 
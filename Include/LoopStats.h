@@ -0,0 +1,173 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#ifndef APP_LOOPSTATS_H
+#define APP_LOOPSTATS_H
+
+#include <atomic>
+#include <string.h>
+#include "Handle.h"
+
+#if defined(DOS_WINDOWS)
+#include <intrin.h>
+#include "Windows/Request.h"
+#else
+#include "Linux/Request.h"
+#endif
+
+namespace app {
+
+/**
+ * @brief HDR风格的直方图, 按2的幂分段, 每段再线性分为8个子桶, 相对精度1/8.
+ * 单位微秒, 位于共享内存, 由所有进程的Loop无锁更新, 外部工具可直接读取.
+ */
+struct Histogram {
+    static const u32 SUB_BITS = 3;
+    static const u32 SUB_COUNT = 1U << SUB_BITS;
+    static const u32 SLOT_COUNT = (32 - SUB_BITS + 1) * SUB_COUNT; // values up to 0xFFFFFFFF us
+
+    std::atomic<u64> mCount;
+    std::atomic<u64> mTotal;
+    std::atomic<u64> mMax;
+    std::atomic<u64> mSlots[SLOT_COUNT];
+
+    static u32 getSlot(u64 val) {
+        if (val < SUB_COUNT) {
+            return (u32)val;
+        }
+        if (val > 0xFFFFFFFFULL) {
+            val = 0xFFFFFFFFULL;
+        }
+#if defined(DOS_WINDOWS)
+        unsigned long msb;
+        _BitScanReverse(&msb, (unsigned long)val);
+#else
+        u32 msb = 31 - __builtin_clz((u32)val);
+#endif
+        u32 shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_COUNT + (u32)(val >> shift) - SUB_COUNT;
+    }
+
+    // @return the lowest value of slot
+    static u64 getSlotValue(u32 slot) {
+        if (slot < SUB_COUNT) {
+            return slot;
+        }
+        u32 shift = slot / SUB_COUNT - 1;
+        return (u64)(SUB_COUNT + slot % SUB_COUNT) << shift;
+    }
+
+    void add(u64 val) {
+        mCount.fetch_add(1, std::memory_order_relaxed);
+        mTotal.fetch_add(val, std::memory_order_relaxed);
+        mSlots[getSlot(val)].fetch_add(1, std::memory_order_relaxed);
+        u64 old = mMax.load(std::memory_order_relaxed);
+        while (val > old && !mMax.compare_exchange_weak(old, val, std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * @param percent [0-100]
+     * @return the lowest value of slot which holds the percentile
+     */
+    u64 getPercentile(f64 percent) const {
+        u64 cnt = mCount.load(std::memory_order_relaxed);
+        u64 want = (u64)(cnt * percent / 100.0);
+        u64 sum = 0;
+        for (u32 i = 0; i < SLOT_COUNT; ++i) {
+            sum += mSlots[i].load(std::memory_order_relaxed);
+            if (sum > want) {
+                return getSlotValue(i);
+            }
+        }
+        return mMax.load(std::memory_order_relaxed);
+    }
+};
+
+
+enum ELoopPhase {
+    ELP_TIME = 0, // Loop::getWaitTime(), timeout callbacks
+    ELP_POLL,     // blocked in EventPoller::getEvents()
+    ELP_EVENTS,   // dispatch events, include io_uring completions
+    ELP_TASK,     // Loop::onTask(), posted tasks
+    ELP_PENDING,  // Loop::updatePending(), IO and user callbacks
+    ELP_CLOSED,   // Loop::updateClosed(), close callbacks
+    ELP_BUSY,     // a whole step except ELP_POLL
+    ELP_COUNT
+};
+
+
+// cost of request callbacks, grouped by EHT_* or ERT_*
+struct LoopCallStat {
+    std::atomic<u64> mCount;
+    std::atomic<u64> mTotal;
+    std::atomic<u64> mMax;
+    std::atomic<u64> mSlow;
+
+    void add(u64 val, bool slow) {
+        mCount.fetch_add(1, std::memory_order_relaxed);
+        mTotal.fetch_add(val, std::memory_order_relaxed);
+        if (slow) {
+            mSlow.fetch_add(1, std::memory_order_relaxed);
+        }
+        u64 old = mMax.load(std::memory_order_relaxed);
+        while (val > old && !mMax.compare_exchange_weak(old, val, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+
+/**
+ * @brief 事件循环的耗时统计, 位于EngineData, @see EngineConfig::mLoopStats
+ * 按阶段统计每轮耗时, 按句柄与请求类型统计回调耗时.
+ */
+struct LoopStats {
+    std::atomic<u64> mSteps;    // count of Loop::run()
+    std::atomic<u64> mEvents;   // count of poller events
+    std::atomic<u64> mRequests; // count of requests done by Loop::updatePending()
+    std::atomic<u64> mTasks;    // count of posted tasks
+    Histogram mPhase[ELP_COUNT];
+    Histogram mCall; // cost of each request in Loop::updatePending()
+    LoopCallStat mByHandle[EHT_COUNT];
+    LoopCallStat mByRequest[ERT_COUNT];
+
+    void clear() {
+        memset(this, 0, sizeof(*this));
+    }
+
+    /**
+     * @brief add the cost of a request callback.
+     * @param slow threshold in microseconds, the callback will be logged if cost > slow
+     */
+    void addCall(s32 htype, s32 rtype, u64 cost, u64 slow);
+
+    // log percentiles of each phase
+    void log() const;
+};
+
+} // namespace app
+
+#endif // APP_LOOPSTATS_H
@@ -87,7 +87,8 @@ protected:
         EMF_WRITE = 0x2,
         EMF_SHARE = 0x4,
         EMF_NEED_DEL = 0x8,       //del file when close
-        EMF_CREATOR = 0x10
+        EMF_CREATOR = 0x10,
+        EMF_LARGE_PAGE = 0x20     //backed by huge pages, @see HugePage
     };
 
 private:
@@ -0,0 +1,160 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#ifndef APP_MEMACCOUNT_H
+#define APP_MEMACCOUNT_H
+
+#include <atomic>
+#include <string.h>
+#include "Config.h"
+
+namespace app {
+
+/**
+ * @brief 内存记账的子系统标签, @see MemAccount
+ */
+enum EMemUsage {
+    EMU_OTHER = 0, // untagged
+    EMU_NET,       // request buffers of links which have no tag
+    EMU_HTTP,      // http layers, messages and their buffers
+    EMU_TLS,       // OpenSSL, @see AppInitTlsLib()
+    EMU_REDIS,     // redis clients, commands and responses
+    EMU_LUA,       // lua VMs
+    EMU_PROXY,     // tcp proxy and it's buffers
+    EMU_COUNT
+};
+
+
+struct MemUsageItem {
+    std::atomic<s64> mLive;   // bytes in use
+    std::atomic<s64> mPeak;   // max of mLive
+    std::atomic<s64> mAllocs; // total allocated
+    std::atomic<s64> mBytes;  // total bytes allocated
+};
+
+
+/**
+ * @brief counters of a loop, in shared mem, @see EngineData::mMemUsage
+ * @note a block may be released by another thread, so mLive of a slot may be negative, sum the slots of a process.
+ */
+struct alignas(64) MemUsage {
+    MemUsageItem mItems[EMU_COUNT];
+
+    void clear() {
+        memset(this, 0, sizeof(*this));
+    }
+
+    // @note mPeak is the sum of slots' peaks
+    void add(const MemUsage& it) {
+        for (u32 i = 0; i < EMU_COUNT; ++i) {
+            const MemUsageItem& src = it.mItems[i];
+            MemUsageItem& dest = mItems[i];
+            dest.mLive += src.mLive.load(std::memory_order_relaxed);
+            dest.mPeak += src.mPeak.load(std::memory_order_relaxed);
+            dest.mAllocs += src.mAllocs.load(std::memory_order_relaxed);
+            dest.mBytes += src.mBytes.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+
+/**
+ * @brief 按子系统标签统计内存, 计数写入当前线程的槽位(每个Loop一个, 在共享内存中), 无锁.
+ * 没有槽位的线程写默认槽位(本进程主Loop的槽位), 共享内存创建之前写进程内的临时槽位.
+ * 各内存池只统计自己持有的字节: MemoryHub/BufferPool 按块, MemoryPool 按页.
+ */
+class MemAccount {
+public:
+    static void onAlloc(s32 tag, usz bytes) {
+        DASSERT(tag >= 0 && tag < EMU_COUNT);
+        MemUsageItem& it = getSlot().mItems[tag];
+        const s64 live = it.mLive.fetch_add((s64)bytes, std::memory_order_relaxed) + (s64)bytes;
+        it.mAllocs.fetch_add(1, std::memory_order_relaxed);
+        it.mBytes.fetch_add((s64)bytes, std::memory_order_relaxed);
+        if (live > it.mPeak.load(std::memory_order_relaxed)) {
+            it.mPeak.store(live, std::memory_order_relaxed);
+        }
+    }
+
+    static void onFree(s32 tag, usz bytes) {
+        DASSERT(tag >= 0 && tag < EMU_COUNT);
+        getSlot().mItems[tag].mLive.fetch_sub((s64)bytes, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief a block is resized in place or moved (eg: realloc), it's not a new allocation,
+     * so only mLive and mPeak are changed.
+     */
+    static void onResize(s32 tag, usz old, usz now) {
+        DASSERT(tag >= 0 && tag < EMU_COUNT);
+        MemUsageItem& it = getSlot().mItems[tag];
+        const s64 diff = (s64)now - (s64)old;
+        const s64 live = it.mLive.fetch_add(diff, std::memory_order_relaxed) + diff;
+        if (live > it.mPeak.load(std::memory_order_relaxed)) {
+            it.mPeak.store(live, std::memory_order_relaxed);
+        }
+    }
+
+    static const s8* getName(s32 tag);
+
+    /**
+     * @brief set the slot of current thread, nullptr to write the default slot.
+     */
+    static void setThreadSlot(MemUsage* it) {
+        gThreadSlot = it;
+    }
+
+    /**
+     * @brief set the default slot, the counters of old default slot are added to it,
+     * as the memory held by process is not changed (eg: forked child, or shared mem created).
+     * @param it nullptr to use the process-local slot, must be called before the shared mem closed.
+     */
+    static void setDefaultSlot(MemUsage* it);
+
+    static MemUsage* getDefaultSlot() {
+        return gDefaultSlot.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief log a report of the counters, with the rates since last report of this process.
+     * @param who tag of report
+     * @param sum the counters summed by caller
+     */
+    static void log(const s8* who, const MemUsage& sum);
+
+private:
+    static thread_local MemUsage* gThreadSlot;
+    static std::atomic<MemUsage*> gDefaultSlot;
+
+    static MemUsage& getSlot() {
+        MemUsage* ret = gThreadSlot;
+        return ret ? *ret : *gDefaultSlot.load(std::memory_order_relaxed);
+    }
+};
+
+} // namespace app
+
+#endif // APP_MEMACCOUNT_H
@@ -0,0 +1,154 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#ifndef APP_MEMARENA_H
+#define APP_MEMARENA_H
+
+#include "Nocopy.h"
+#include "TString.h"
+
+namespace app {
+class MemPool;
+
+/**
+ * @brief 线性分配器(bump allocator), 用于生命周期相同的一组小对象, 如一个HTTP请求.
+ * 单个释放无操作, reset()时一次性释放所有内存块.
+ * 内存块来自MemPool(如连接的内存池), 或者堆.
+ */
+class MemArena : public Nocopy {
+public:
+    /**
+     * @param blocksz bytes of each block, the big allocations take a dedicated block.
+     */
+    MemArena(usz blocksz = 2048) :
+        mHead(nullptr), mPool(nullptr), mBlockSize(blocksz), mBlocks(0), mAllocs(0) {
+    }
+
+    ~MemArena() {
+        reset();
+    }
+
+    /**
+     * @brief set the source of blocks and take the first block from it, so the pool is kept until reset().
+     * @param it nullptr to use heap.
+     */
+    void init(MemPool* it);
+
+    void* allocate(usz size, usz align = sizeof(void*));
+
+    /**
+     * @brief free all the blocks at once, the objects in arena must be destructed before.
+     */
+    void reset();
+
+    /** @return count of blocks allocated. */
+    u32 getBlockCount() const {
+        return mBlocks;
+    }
+
+    /** @return count of allocations served. */
+    u32 getAllocCount() const {
+        return mAllocs;
+    }
+
+private:
+    struct Block {
+        Block* mNext;
+        MemPool* mPool; // source of this block, nullptr=heap
+        usz mSize;      // bytes after header
+        usz mUsed;
+    };
+    Block* mHead;
+    MemPool* mPool;
+    usz mBlockSize;
+    u32 mBlocks;
+    u32 mAllocs;
+
+    Block* createBlock(usz size);
+};
+
+
+/**
+ * @brief allocator for TString and TVector, allocate from a MemArena, or heap if no arena.
+ * the arena is carried by move construction, not by copy, so a copy is always allocated by heap.
+ * move assignment keeps the arena of target, and copies the data if the arenas differ.
+ */
+template <typename T>
+class TAllocatorArena {
+public:
+    TAllocatorArena(MemArena* it = nullptr) : mArena(it) {
+    }
+
+    MemArena* getArena() const {
+        return mArena;
+    }
+
+    // the memory can be freed by each other
+    bool operator==(const TAllocatorArena<T>& it) const {
+        return mArena == it.mArena;
+    }
+
+    // allocate memory for an array of objects
+    T* allocate(usz cnt) {
+        return mArena ? (T*)mArena->allocate(cnt * sizeof(T), alignof(T) > sizeof(void*) ? alignof(T) : sizeof(void*))
+                      : (T*)operator new(cnt * sizeof(T));
+    }
+
+    // deallocate memory for an array of objects, freed by MemArena::reset() if in arena
+    void deallocate(T* ptr) {
+        if (!mArena) {
+            operator delete(ptr);
+        }
+    }
+
+    // construct an element
+    void construct(T* ptr) {
+        new ((void*)ptr) T();
+    }
+
+    // construct an element
+    void construct(T* ptr, const T& e) {
+        new ((void*)ptr) T(e);
+    }
+
+    void construct(T* ptr, T&& e) {
+        new ((void*)ptr) T(std::move(e));
+    }
+
+    // destruct an element
+    void destruct(T* ptr) {
+        ptr->~T();
+    }
+
+private:
+    MemArena* mArena;
+};
+
+using StringArena = TString<s8, TAllocatorArena<s8>>;
+
+} // namespace app
+
+#endif // APP_MEMARENA_H
@@ -29,11 +29,18 @@
 #include <mutex>
 #include <atomic>
 #include "MemoryPool.h"
+#include "MemAccount.h"
 
 #define D_THREADSAFE_MEMPOOL
 
 namespace app {
 
+struct MemHubStats {
+    u64 mHits;    // served by thread cache
+    u64 mMisses;  // thread cache empty, refilled from shared pool in batch
+    u64 mFlushes; // thread cache full, flushed to shared pool in batch
+};
+
 ///allocate some number of bytes from pools.  Uses the heap if necessary.
 class MemoryHub {
 public:
@@ -69,6 +76,27 @@ public:
 
     void drop();
 
+    /**
+     * @brief enable the thread caches(default), set before any allocate.
+     * disable it if the hub is used by one thread only, or to save memory. */
+    void setThreadCache(bool on) {
+#ifdef D_THREADSAFE_MEMPOOL
+        mThreadCache = on;
+#endif
+    }
+
+    /**
+     * @brief the blocks are counted by MemAccount with this tag, default EMU_OTHER.
+     * @param tag user of hub, @see EMemUsage */
+    void setTag(s32 tag) {
+        mTag = tag;
+    }
+
+    /**
+     * @brief stats of the thread caches, sum of all threads.
+     * @param tp size class, EMT_128 ~ EMT_10K */
+    void getStats(EMemType tp, MemHubStats& out);
+
 protected:
     
     struct SMemHead {
@@ -85,24 +113,69 @@ protected:
     CMemoryPool10K mPool10K;
 
 #ifdef D_THREADSAFE_MEMPOOL
-    std::mutex mMutex128;
-    std::mutex mMutex256;
-    std::mutex mMutex512;
-    std::mutex mMutex1024;
-    std::mutex mMutex2048;
-    std::mutex mMutex4096;
-    std::mutex mMutex8192;
-    std::mutex mMutex10K;
+    static const u32 G_CACHE_MAX = 64; // max blocks of each class in a thread cache
+    static const u32 G_MAX_HUBS = 8;   // max hubs cached by a thread, others use the shared pools directly
+
+    /**
+     * @brief 每个线程的缓存(magazine), 分配和释放先走缓存, 无锁;
+     * 缓存空了从共享池批量取, 满了批量还回一半, 每批只锁一次.
+     */
+    struct ThreadCache {
+        ThreadCache* mNext;   // link of all caches of hub
+        bool mUsed;           // hold by a thread
+        u32 mCount[EMT_DEFAULT];
+        void* mSlot[EMT_DEFAULT][G_CACHE_MAX];
+        std::atomic<u64> mHits[EMT_DEFAULT]; // written by owner thread only
+        std::atomic<u64> mMisses[EMT_DEFAULT];
+        std::atomic<u64> mFlushes[EMT_DEFAULT];
+    };
+
+    struct CacheEntry {
+        MemoryHub* mHub;
+        u64 mID; // the address of hub maybe reused after deleted, so match by ID
+        ThreadCache* mCache;
+    };
+
+    // caches of current thread, give back to hubs when thread exit, @see ThreadLocal
+    struct ThreadCaches {
+        CacheEntry mItems[G_MAX_HUBS];
+        ThreadCaches();
+        ~ThreadCaches();
+    };
+
+    std::mutex mMutex[EMT_DEFAULT];
+    std::mutex mCacheMutex;
+    ThreadCache* mCaches;
+    MemoryHub* mNextHub; // link of all alive hubs
+    const u64 mID;
+    bool mThreadCache;
 #endif
 
 private:
     std::atomic<s64> mReferenceCount;
+    s32 mTag;
 
     MemoryHub(const MemoryHub&) = delete;
     MemoryHub(const MemoryHub&&) = delete;
     MemoryHub& operator=(const MemoryHub&) = delete;
     MemoryHub& operator=(const MemoryHub&&) = delete;
 
+    void* popBlock(EMemType tp);
+    void pushBlock(EMemType tp, void* it);
+
+    // access the shared pools, locked by caller
+    void* popPool(EMemType tp);
+    void pushPool(EMemType tp, void* it);
+
+#ifdef D_THREADSAFE_MEMPOOL
+    ThreadCache* getCache();
+    ThreadCache* createCache();
+    void flushCache(ThreadCache& it, EMemType tp, u32 keep);
+    static bool isAlive(const CacheEntry& it);
+    static std::mutex& getHubsMutex();
+    static MemoryHub*& getHubs();
+#endif
+
     DFINLINE s8* getUserPointer(s8* real, const u64 align, const EMemType tp)const {
         s8* user = AppAlignPoint(real, align);
         user = user >= real + sizeof(SMemHead) ? user : user + align;
@@ -123,4 +196,3 @@ private:
 
 
 #endif //ANT_MEMORYHUB_H
-
@@ -29,6 +29,8 @@
 #include <stdlib.h>
 #include <mutex>
 #include "Config.h"
+#include "HugePage.h"
+#include "MemAccount.h"
 
 // D_MEMPOOL_MAX_PAGE must be > 1
 #define D_MEMPOOL_MAX_PAGE 4
@@ -68,6 +70,14 @@ public:
 
     void setPageSize(s32 size); // Defaults to 16*1024 bytes
 
+    /**
+     * @brief count the pages by MemAccount, set before any allocate.
+     * @param tag user of pool, @see EMemUsage, -1 is not counted(default)
+     */
+    void setTag(s32 tag) {
+        mTag = tag;
+    }
+
     MemoryBlockType* allocate();
 
     void release(MemoryBlockType* it);
@@ -93,6 +103,16 @@ protected:
 
     bool initPage(SMemoryPage* page, SMemoryPage* iPrevious);
 
+    // the blocks of page may be a piece of HugePage
+    void releaseBlock(SMemoryWithPage* it) {
+        if (mTag >= 0) {
+            MemAccount::onFree(mTag, mMemoryPoolPageSize);
+        }
+        if (!HugePage::releasePiece(it, mMemoryPoolPageSize)) {
+            ::free(it);
+        }
+    }
+
     // mAvailablePages contains pages which have room to give the user new blocks.  We return these blocks from the head
     // of the list mUnavailablePages are pages which are totally full, and from which we do not return new blocks. Pages
     // move from the head of mUnavailablePages to the tail of mAvailablePages, and from the head of mAvailablePages to
@@ -102,6 +122,7 @@ protected:
     s32 mAvailablePagesSize;
     s32 mUnavailablePagesSize;
     s32 mMemoryPoolPageSize;
+    s32 mTag;
 };
 
 
@@ -111,6 +132,7 @@ MemoryPool<MemoryBlockType>::MemoryPool() {
     // allocateFirst();
     mAvailablePagesSize = 0;
     mUnavailablePagesSize = 0;
+    mTag = -1;
     setPageSize(16 * 1024);
 #endif
 }
@@ -225,7 +247,7 @@ void MemoryPool<MemoryBlockType>::release(MemoryBlockType* m) {
             curPage->mNext->mPrevious = curPage->mPrevious;
             mAvailablePagesSize--;
             ::free(curPage->mAvailableStack);
-            ::free(curPage->mBlock);
+            releaseBlock(curPage->mBlock);
             ::free(curPage);
         }
     }
@@ -247,7 +269,7 @@ void MemoryPool<MemoryBlockType>::clear() {
 #endif
         while (true) {
             free(cur->mAvailableStack);
-            free(cur->mBlock);
+            releaseBlock(cur->mBlock);
             freed = cur;
             cur = cur->mNext;
             if (cur == mAvailablePages) {
@@ -262,7 +284,7 @@ void MemoryPool<MemoryBlockType>::clear() {
         cur = mUnavailablePages;
         while (1) {
             free(cur->mAvailableStack);
-            free(cur->mBlock);
+            releaseBlock(cur->mBlock);
             freed = cur;
             cur = cur->mNext;
             if (cur == mUnavailablePages) {
@@ -288,14 +310,20 @@ s32 MemoryPool<MemoryBlockType>::blocksPerPage(void) const {
 template <class MemoryBlockType>
 bool MemoryPool<MemoryBlockType>::initPage(SMemoryPage* page, SMemoryPage* iPrevious) {
     const s32 bpp = blocksPerPage();
-    page->mBlock = (SMemoryWithPage*)::malloc(mMemoryPoolPageSize);
+    page->mBlock = (SMemoryWithPage*)HugePage::allocPiece(mMemoryPoolPageSize);
+    if (!page->mBlock) {
+        page->mBlock = (SMemoryWithPage*)::malloc(mMemoryPoolPageSize);
+    }
 
     if (page->mBlock == 0) {
         return false;
     }
+    if (mTag >= 0) {
+        MemAccount::onAlloc(mTag, mMemoryPoolPageSize);
+    }
     page->mAvailableStack = (SMemoryWithPage**)::malloc(sizeof(SMemoryWithPage*) * bpp);
     if (page->mAvailableStack == 0) {
-        ::free(page->mBlock);
+        releaseBlock(page->mBlock);
         return false;
     }
     SMemoryWithPage* curBlock = page->mBlock;
@@ -334,7 +362,11 @@ typedef MemoryPool<u8[10240]> CMemoryPool10K;
  */
 class MemPool {
 public:
-    static MemPool* createMemPool(s32 psz);
+    /**
+     * @param psz bytes of zone
+     * @param tag user of zone, the whole zone is counted, @see EMemUsage
+     */
+    static MemPool* createMemPool(s32 psz, s32 tag = EMU_OTHER);
     static void releaseMemPool(MemPool* it);
     MemPool(const MemPool&) = delete;
     MemPool(const MemPool&&) = delete;
@@ -357,6 +389,11 @@ public:
     void checkPool();
     s32 getAvailable();
 
+    // @return true if no block in use
+    bool isEmpty() const {
+        return 0 == mUsed && 0 == mCountNew;
+    }
+
 private:
     MemPool();
     ~MemPool();
@@ -388,7 +425,7 @@ private:
     s32 mUsed;  // total bytes used
     s32 mCountNew;
     s16 mPoolID; // pool's ID
-    s16 mPad;    // reserve
+    s16 mUsage;  // EMemUsage
     std::mutex mMutex;
     MemBlock mBlockList; // start/end cap for linked list
     MemBlock* mRover;
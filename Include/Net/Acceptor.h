@@ -88,6 +88,13 @@ public:
         mTCP.setRemote(addr);
     }
 
+    /**
+    * @brief set options template before open(), the accepted links inherit them from listener.
+    * @note set between bind() and listen(), so the first SYN takes them too */
+    void setOption(const SocketOption& it) {
+        mOption = it;
+    }
+
 
     net::HandleTCP& getHandleTCP() {
         return mTCP;
@@ -116,6 +123,7 @@ private:
     RequestAccept* mFlyRequests[GMaxFly];
     Loop& mLoop;
     net::HandleTCP mTCP;
+    SocketOption mOption;
 };
 
 } //namespace net
@@ -161,14 +161,30 @@ public:
     bool remove(s32 fd);
     bool remove(const net::Socket& iSock);
 
+    /**
+    * @brief wake up the thread blocked in getEvents() by an eventfd.
+    * @note the content of iEvent is ignored, @see isWakeEvent()
+    */
     bool postEvent(SEvent& iEvent);
 
+    bool isWakeEvent(const SEvent& it) const {
+        return &mWakeFD == it.mData.mPointer;
+    }
+
+    //reset the eventfd after a wake event launched
+    void clearWakeEvent();
+
     IOURing& getIOURing() {
         return mIOUR;
     }
 
+    const IOURing& getIOURing() const {
+        return mIOUR;
+    }
+
 protected:
     s32 mEpollFD;
+    s32 mWakeFD;
     IOURing mIOUR;
 };
 
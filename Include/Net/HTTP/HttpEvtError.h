@@ -7,6 +7,8 @@ namespace app {
 
 class HttpEvtError : public net::HttpEventer {
 public:
+    DDECLARE_OBJECT_POOL_TAG(HttpEvtError, EMU_HTTP)
+
     HttpEvtError(s32 err);
     virtual ~HttpEvtError();
 
@@ -8,6 +8,8 @@ namespace app {
 
 class HttpEvtFile : public net::HttpEventer {
 public:
+    DDECLARE_OBJECT_POOL_TAG(HttpEvtFile, EMU_HTTP)
+
     HttpEvtFile(bool readonly);
     virtual ~HttpEvtFile();
 
@@ -9,6 +9,8 @@ namespace app {
 
 class HttpEvtLua : public net::HttpEventer {
 public:
+    DDECLARE_OBJECT_POOL_TAG(HttpEvtLua, EMU_HTTP)
+
     enum ERespStep {
         RSTEP_INIT = 0,
         RSTEP_MASK = 0x7,
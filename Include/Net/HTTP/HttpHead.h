@@ -28,21 +28,28 @@
 
 #include "TString.h"
 #include "TVector.h"
+#include "MemArena.h"
 
 namespace app {
 namespace net {
 
 class HeadLine {
 public:
-    String mKey;
-    String mVal;
+    StringArena mKey;
+    StringArena mVal;
     HeadLine() {
     }
     ~HeadLine() {
     }
-    HeadLine(const StringView& kk, const StringView& vv) : mKey(kk), mVal(vv) {
+    HeadLine(const StringView& kk, const StringView& vv, MemArena* arena = nullptr) :
+        mKey(TAllocatorArena<s8>(arena)), mVal(TAllocatorArena<s8>(arena)) {
+        mKey = kk;
+        mVal = vv;
     }
-    HeadLine(const String& kk, const String& vv) : mKey(kk), mVal(vv) {
+    HeadLine(const String& kk, const String& vv, MemArena* arena = nullptr) :
+        mKey(TAllocatorArena<s8>(arena)), mVal(TAllocatorArena<s8>(arena)) {
+        mKey = kk;
+        mVal = vv;
     }
     HeadLine(const HeadLine& it) : mKey(it.mKey), mVal(it.mVal) {
     }
@@ -72,6 +79,23 @@ public:
 
     ~HttpHead();
 
+    // the copy is allocated by heap, @see TAllocatorArena
+    HttpHead(const HttpHead& it) : mData(it.mData), mDataLen(it.mDataLen), mChunked(it.mChunked) {
+    }
+
+    // the arena is carried
+    HttpHead(HttpHead&& it) noexcept :
+        mData(std::move(it.mData)), mArena(it.mArena), mDataLen(it.mDataLen), mChunked(it.mChunked) {
+        it.mDataLen = 0;
+        it.mChunked = false;
+    }
+
+    // keep my arena, copy the headlines into it
+    HttpHead& operator=(const HttpHead& it);
+
+    // keep my arena, the headlines are copied if the arenas differ
+    HttpHead& operator=(HttpHead&& it) noexcept;
+
     void setLength(usz sz) {
         s8 tmp[128];
         StringView key("Content-Length", sizeof("Content-Length") - 1);
@@ -128,7 +152,15 @@ public:
         mData.clear();
     }
 
-    TVector<HeadLine>& getData() {
+    /**
+     * @brief allocate the headlines from arena, set before add().
+     */
+    void setArena(MemArena* it) {
+        mArena = it;
+        mData.setAllocator(TAllocatorArena<HeadLine>(it));
+    }
+
+    TVector<HeadLine, TAllocatorArena<HeadLine>>& getData() {
         return mData;
     }
 
@@ -155,7 +187,8 @@ public:
 
 
 private:
-    TVector<HeadLine> mData;
+    TVector<HeadLine, TAllocatorArena<HeadLine>> mData;
+    MemArena* mArena = nullptr;
     usz mDataLen = 0;
     bool mChunked = false;
 };
@@ -30,7 +30,7 @@
 #include "EngineConfig.h"
 #include "Loop.h"
 #include "System.h"
-#include "MemoryPool.h"
+#include "ObjectPool.h"
 #include "Net/HandleTLS.h"
 #include "Net/HTTP/HttpMsg.h"
 #include "Net/TlsContext.h"
@@ -43,6 +43,8 @@ class Website;
 
 class HttpLayer : public RefCount {
 public:
+    DDECLARE_OBJECT_POOL_TAG(HttpLayer, EMU_HTTP)
+
     HttpLayer(EHttpParserType tp = EHTTP_BOTH, bool https = false, TlsContext* tlsContext = nullptr);
 
     virtual ~HttpLayer();
@@ -85,10 +87,25 @@ public:
         return getErrStr(mHttpError);
     }
 
+    /**
+     * @brief create a request with cache, from the BufferPool of current loop.
+     * @param len size of the cache */
     RequestFD* createMem(usz len);
 
+    /**
+     * @brief create a scatter/gather request, @see RequestIOV
+     * @param len size of the cache for head */
+    RequestIOV* createMemIOV(usz len);
+
+    /**
+     * @brief release the request, and the slices of RequestIOV if not released yet. */
     void deleteMem(RequestFD* it);
 
+    /**
+     * @brief the memory pool of this link, created if none, @see HttpMsg's arena.
+     */
+    MemPool* getMemPool();
+
 private:
     s32 onTimeout(HandleTime& it);
 
@@ -100,6 +117,11 @@ private:
 
     void onRead(RequestFD* it);
 
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    // parse the data in ring buffer, keep the leftover in mCache
+    bool onReadRing(RequestFD* it);
+#endif
+
     void postClose();
 
     DFINLINE s32 writeIF(RequestFD* it) {
@@ -146,6 +168,10 @@ private:
     HandleTLS mTCP;
     HttpMsg* mMsg;
     MemPool* mPool = nullptr;
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    RequestFD mReadReq;          // read without cache, @see Loop::isURingMultishot()
+    RequestFD* mCache = nullptr; // leftover of mReadReq
+#endif
 
     // parser
 private:
@@ -27,6 +27,7 @@
 #define APP_HTTPMSG_H
 
 #include "RefCount.h"
+#include "ObjectPool.h"
 #include "Packet.h"
 #include "Net/HTTP/HttpURL.h"
 #include "Net/HTTP/HttpHead.h"
@@ -35,6 +36,7 @@
 
 namespace app {
 class RequestFD;
+class RequestIOV;
 
 namespace net {
 
@@ -273,6 +275,8 @@ public:
 
 class HttpMsg : public RefCount {
 public:
+    DDECLARE_OBJECT_POOL_TAG(HttpMsg, EMU_HTTP)
+
     enum ERespStep {
         RSTEP_INIT = 0,
         RSTEP_MASK = 0x7,
@@ -461,6 +465,16 @@ protected:
     s32 dumpLine(RequestFD* it);
     usz dumpBody(RequestFD* it);
 
+    /**
+     * @brief send mBody in place as a slice of request, without memcpy.
+     * mBody is swapped into mBodyFly until the request finished, so it's free to fill mBody again.
+     * @return 0 if body in flight, or the size of body slice */
+    usz dumpBody(RequestIOV* it);
+
+    static void funcOnBodySent(void* it) {
+        reinterpret_cast<HttpMsg*>(it)->mBodyFly.resize(0);
+    }
+
     friend class HttpLayer;
 
     u16 mStatusCode = HTTP_STATUS_OK;
@@ -469,8 +483,10 @@ protected:
     EHttpParserType mType = EHTTP_BOTH;
     EHttpMethod mMethod = HTTP_GET;
 
+    MemArena mArena; // headlines and url, freed at once with this msg
     HttpHead mHead;
     Packet mBody;
+    Packet mBodyFly; // body in flight, @see dumpBody(RequestIOV*)
 
     HttpURL mURL;     // request only
     String mRealPath; // request only
@@ -27,7 +27,7 @@
 #define APP_HTTPURL_H
 
 
-#include "TString.h"
+#include "MemArena.h"
 
 namespace app {
 namespace net {
@@ -54,10 +54,17 @@ public:
 
     ~HttpURL();
 
-    const String& data() const {
+    const StringArena& data() const {
         return mData;
     }
 
+    /**
+     * @brief allocate the buffer from arena, set before any write.
+     */
+    void setArena(MemArena* it) {
+        mData.setAllocator(TAllocatorArena<s8>(it));
+    }
+
     bool encode(const s8* uri, usz len);
 
     bool decode(const s8* uri, usz len);
@@ -92,7 +99,7 @@ public:
 
 
 private:
-    String mData;
+    StringArena mData;
 
     u16 mFieldSet; /* Bitmask of (1 << UF_*) values */
     u16 mPort;     /* Converted UF_PORT string */
@@ -39,7 +39,7 @@ namespace net {
 
 class HandleTCP : public HandleTime {
 public:
-    HandleTCP() {
+    HandleTCP() : mFastOpen(false) {
         //memset(this, 0, DOFFSETP(this, mSock));
         mType = EHT_TCP_CONNECT;
     }
@@ -78,6 +78,38 @@ public:
         mSock = it;
     }
 
+    /**
+    * @brief set watermarks of queued write bytes, for backpressure.
+    * @param high isWriteFull() is true when queued bytes reach it, 0=disable
+    * @param low notify by \p fn when queued bytes fall to it after full
+    * @param fn the callback of writable again, user is getUser(), maybe nullptr */
+    void setWaterMark(u32 high, u32 low, FunDrainCallback fn) {
+        mWater.mHigh = high;
+        mWater.mLow = low < high ? low : high / 2;
+        mWater.mCallDrain = fn;
+    }
+
+    // @return bytes of write requests queued but not landed
+    usz getWriteBytes() const {
+        return mWater.mBytes;
+    }
+
+    bool isWriteFull() const {
+        return mWater.mFull;
+    }
+
+    /**
+    * @brief connect with TCP_FASTOPEN_CONNECT, set before open(addr, it).
+    * the first write after connected carries its data in SYN, saves a RTT for the protocols which client speaks first.
+    * @see Socket::setFastOpenConnect() */
+    void setFastOpen(bool it) {
+        mFastOpen = it;
+    }
+
+    bool isFastOpen() const {
+        return mFastOpen;
+    }
+
     s32 accept(RequestAccept* it);
 
     s32 connect(RequestFD* it);
@@ -111,6 +143,8 @@ protected:
     NetAddress mLocal;
     NetAddress mRemote;
     Socket mSock;
+    WriteWater mWater;
+    bool mFastOpen;
 };
 
 
@@ -105,6 +105,23 @@ public:
         return mTlsSession;
     }
 
+    /**
+     * @brief set watermarks of queued plaintext write bytes, @see HandleTCP::setWaterMark()
+     * @param fn the callback of writable again, with this HandleTLS */
+    void setWaterMark(u32 high, u32 low, FunDrainCallback fn) {
+        mWater.mHigh = high;
+        mWater.mLow = low < high ? low : high / 2;
+        mWater.mCallDrain = fn;
+    }
+
+    usz getWriteBytes() const {
+        return mWater.mBytes;
+    }
+
+    bool isWriteFull() const {
+        return mWater.mFull;
+    }
+
 protected:
     s32 handshake();
 
@@ -175,11 +192,14 @@ protected:
 
     // 回调写完的明文
     void landWrites() {
-        landQueue(mLandWrites);
+        landWriteQueue(mLandWrites);
     }
 
     static void landQueue(RequestFD*& que);
 
+    // 回调写请求, 并在降到低水位时通知, @see setWaterMark()
+    void landWriteQueue(RequestFD*& que);
+
     HandleTCP mTCP;
     RequestFD mRead;
     RequestFD mWrite;
@@ -193,6 +213,7 @@ protected:
     RingBuffer mInBuffers;
     RingBuffer mOutBuffers;
     SRingBufPos mCommitPos;
+    WriteWater mWater;
 };
 
 
@@ -89,6 +89,11 @@ public:
         return 28 == mSize;
     }
 
+    /**
+    *@return true if IP is 0.0.0.0 or [::]
+    */
+    bool isAnyIP()const;
+
     //@return IPV6 = sizeof(sockaddr_in6)=28, IPV4 = sizeof(sockaddr_in)=16
     s32 getAddrSize()const {
         return mSize;
@@ -29,6 +29,10 @@
 
 #include "NetAddress.h"
 
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+struct iovec;
+#endif
+
 namespace app {
 class RequestFD;
 
@@ -47,6 +51,25 @@ typedef s32 netsocket;
 #endif 
 
 
+/**
+* @brief options template of a listening socket, set on listener once and the accepted sockets
+* inherit them from listener (linux, and windows after SO_UPDATE_ACCEPT_CONTEXT), so no syscall per link.
+* value < 0 means keep the system default. */
+struct SocketOption {
+    s32 mNoDelay;       // TCP_NODELAY, 1=on, 0=off
+    s32 mKeepAlive;     // seconds of idle before keepalive probes, 0=off
+    s32 mKeepInterval;  // seconds between keepalive probes
+    s32 mKeepCount;     // keepalive probes before drop the link
+    s32 mSendCache;     // SO_SNDBUF in bytes
+    s32 mReceiveCache;  // SO_RCVBUF in bytes
+    s32 mDeferAccept;   // listener only, TCP_DEFER_ACCEPT seconds, wake up accept() after data arrived, 0=off
+    s32 mFastOpen;      // listener only, TCP_FASTOPEN queue length of pending SYN+data, 0=off
+    SocketOption() :
+        mNoDelay(-1), mKeepAlive(-1), mKeepInterval(-1), mKeepCount(-1), mSendCache(-1), mReceiveCache(-1),
+        mDeferAccept(-1), mFastOpen(-1) {
+    }
+};
+
 
 class Socket {
 public:
@@ -184,6 +207,52 @@ public:
     */
     s32 setReusePort(bool on);
 
+    /**
+    *@brief Set SO_INCOMING_CPU, the reuseport group prefers the listener whose cpu received the packet,
+    * linux(4.4+, reuseport select by it since 6.2) only.
+    *@param cpu The cpu id.
+    *@return 0 if successed, else failed.
+    */
+    s32 setIncomingCPU(s32 cpu);
+
+    /**
+    *@brief Attach a classic BPF to the reuseport group, steer the new connection to the listener
+    * by the cpu which received it. The index of listener in group is the order of listen(), linux only.
+    *@param cpus cpus[i] is the cpu of the i-th listener of group, if nullptr, use (cpu % cnt) as index.
+    *@param cnt The count of listeners in group.
+    *@return 0 if successed, else failed.
+    */
+    s32 setReusePortCPU(const u16* cpus, u32 cnt);
+
+    /**
+    *@brief Set SO_BUSY_POLL, busy poll the device queue when no data on socket, linux only.
+    *@param usec Time of busy poll in microseconds, need CAP_NET_ADMIN if greater than net.core.busy_read
+    *@return 0 if successed, else failed.
+    */
+    s32 setBusyPoll(u32 usec);
+
+    /**
+    *@brief Set TCP_DEFER_ACCEPT on listener, the link is accepted after it's first data arrived,
+    * so don't use it for the protocols which server speaks first, linux only.
+    *@param seconds Max seconds to wait the first data, 0=off.
+    *@return 0 if successed, else failed.
+    */
+    s32 setDeferAccept(s32 seconds);
+
+    /**
+    *@brief Set TCP_FASTOPEN on listener, accept the data in SYN, need sysctl net.ipv4.tcp_fastopen&2, linux only.
+    *@param qlen Max count of pending SYN+data, 0=off.
+    *@return 0 if successed, else failed.
+    */
+    s32 setFastOpen(s32 qlen);
+
+    /**
+    *@brief Set TCP_FASTOPEN_CONNECT before connect(), the first write carries data in SYN if a cookie cached,
+    * else connect as usual, need sysctl net.ipv4.tcp_fastopen&1, linux(4.11+) only.
+    *@return 0 if successed, else failed.
+    */
+    s32 setFastOpenConnect(bool on);
+
     /**
     *@brief Set send cache size of socket.
     *@param size The socket cache size.
@@ -198,6 +267,21 @@ public:
     */
     s32 setReceiveCache(s32 size);
 
+    /**
+    *@brief Set TCP keepalive.
+    *@param idle Seconds of idle before keepalive probes, 0=disable keepalive.
+    *@param interval Seconds between probes, ignored if <= 0.
+    *@param count Probes before drop the link, ignored if <= 0.
+    *@return 0 if success, else if failed.
+    */
+    s32 setKeepAlive(s32 idle, s32 interval, s32 count);
+
+    /**
+    *@brief Set options of template, @see SocketOption
+    *@return 0 if success, else the count of failed options.
+    */
+    s32 setOption(const SocketOption& it);
+
     /**
     *@brief Close socket.
     *@return true if success, else false.
@@ -296,6 +380,14 @@ public:
     */
     Socket accept(NetAddress& it);
 
+    /**
+    *@brief Accpet a new client, the new socket is non-blocking and close-on-exec.
+    * By accept4() on linux, no extra syscall for flags.
+    *@param it net address of remote peer.
+    *@return A valid socket if successed, else invalid.
+    */
+    Socket acceptNonblock(NetAddress& it);
+
 
     bool isAlive();
 
@@ -360,6 +452,35 @@ public:
 
     void* getFunctionAcceptSockAddress()const;
 
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+    /**
+    *@brief Gather write, send all the buffers by one sendmsg().
+    *@param vec buffers to send, in order.
+    *@param cnt count of buffers, must not greater than IOV_MAX.
+    *@return bytes sent if success, else -1 and see System::getAppError().
+    */
+    s64 sendVector(const struct iovec* vec, s32 cnt);
+
+    /**
+    *@brief send data with file descriptors by SCM_RIGHTS, unix domain socket only.
+    *@param fds descriptors to send, the receiver gets duplicates of them.
+    *@param cnt count of fds, not greater than SCM_MAX_FD(253).
+    *@return bytes sent if success, else -1 and see System::getAppError().
+    */
+    s32 sendFDs(const void* iBuffer, s32 iSize, const s32* fds, s32 cnt);
+
+    /**
+    *@brief receive data with file descriptors by SCM_RIGHTS, never block.
+    *The descriptors ride on the first byte of data sent by sendFDs(), and have O_CLOEXEC.
+    *@param fds [out] the received descriptors.
+    *@param cnt [in,out] capacity of fds, and count of received.
+    *@return bytes received, 0 if peer closed, else -1 and see System::getAppError().
+    */
+    s32 receiveFDs(void* iBuffer, s32 iSize, s32* fds, s32& cnt);
+
+#endif//DOS_WINDOWS
+
+#if defined(DOS_WINDOWS)
 private:
     static void* mFunctionConnect;
     static void* mFunctionDisconnect;
@@ -27,6 +27,7 @@
 #define	APP_CONNECTOR_H
 
 #include "RefCount.h"
+#include "ObjectPool.h"
 #include "Loop.h"
 #include "EngineConfig.h"
 #include "Net/HandleTLS.h"
@@ -39,6 +40,8 @@ class TcpProxyHub;
 
 class TcpProxy :public RefCount {
 public:
+    DDECLARE_OBJECT_POOL_TAG(TcpProxy, EMU_PROXY)
+
     TcpProxy(Loop& loop);
 
     virtual ~TcpProxy();
@@ -61,6 +64,14 @@ private:
 
     void onConnect(RequestFD* it);
 
+    // front drained, resume reading backend
+    void onDrain(Handle* it);
+    // backend drained, resume reading front
+    void onDrain2(Handle* it);
+
+    s32 postRead();
+    s32 postRead2();
+
     static s32 funcOnTime(HandleTime* it) {
         TcpProxy& nd = *(TcpProxy*)it->getUser();
         return nd.onTimeout(*it);
@@ -107,10 +118,21 @@ private:
         nd.onConnect(it);
     }
 
+    static void funcOnDrain(Handle* it) {
+        TcpProxy& nd = *(TcpProxy*)it->getUser();
+        nd.onDrain(it);
+    }
+
+    static void funcOnDrain2(Handle* it) {
+        TcpProxy& nd = *(TcpProxy*)it->getUser();
+        nd.onDrain2(it);
+    }
+
     void unbind();
 
     //0=[tcp-tcp], 1=[tls-tcp], 2=[tcp-tls], 3=[tls-tls]
     u8 mType;
+    u8 mPause; //1=front reading paused, 2=backend reading paused
     Loop& mLoop;
     TcpProxyHub* mHub;
     net::HandleTLS mTLS;
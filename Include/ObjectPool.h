@@ -0,0 +1,273 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+#ifndef APP_OBJECTPOOL_H
+#define APP_OBJECTPOOL_H
+
+#include <atomic>
+#include <new>
+#include "MemoryPool.h"
+#include "ThreadLocal.h"
+#include "Logger.h"
+
+namespace app {
+
+struct ObjectPoolStats {
+    const s8* mName;
+    usz mSize;       // sizeof(object)
+    s64 mAllocs;     // total allocated
+    s64 mFrees;      // total released by owner thread
+    s64 mRemoteFrees; // total released by other threads
+    s32 mLive;       // objects in use
+    s32 mPeak;       // max of mLive
+    s32 mPages;      // pages hold by MemoryPool
+};
+
+
+/**
+ * @brief 每个线程(即每个Loop)自有的对象池基类, 同一线程的对象池串成链表, 用于统计输出.
+ */
+class ObjectPoolBase {
+public:
+    virtual void getStats(ObjectPoolStats& out) const = 0;
+
+    /**
+     * @brief log stats of all object pools of current thread, called by loop thread before exit.
+     */
+    static void logThread(const s8* tag) {
+        ObjectPoolStats st;
+        for (ObjectPoolBase* nd = getHead(); nd; nd = nd->mNext) {
+            nd->getStats(st);
+            Logger::log(ELL_INFO,
+                "ObjectPool::logThread>>%s, %s[size=%llu, alloc=%lld, free=%lld, remote=%lld, live=%d, peak=%d, "
+                "pages=%d]",
+                tag, st.mName, (u64)st.mSize, st.mAllocs, st.mFrees, st.mRemoteFrees, st.mLive, st.mPeak, st.mPages);
+        }
+    }
+
+protected:
+    ObjectPoolBase* mNext;
+
+    ObjectPoolBase() : mNext(nullptr) {
+    }
+
+    virtual ~ObjectPoolBase() {
+    }
+
+    static ObjectPoolBase*& getHead() {
+        static thread_local ObjectPoolBase* ret = nullptr;
+        return ret;
+    }
+
+    void link() {
+        ObjectPoolBase*& head = getHead();
+        mNext = head;
+        head = this;
+    }
+
+    void unlink() {
+        for (ObjectPoolBase** nd = &getHead(); *nd; nd = &(*nd)->mNext) {
+            if (*nd == this) {
+                *nd = mNext;
+                break;
+            }
+        }
+        mNext = nullptr;
+    }
+};
+
+
+/**
+ * @brief 类型化的对象池, 每个线程一个实例, 分配无锁.
+ * 对象可以被其它线程释放, 此时挂到所属池的无锁链表上, 由所属线程下次分配时回收.
+ * 线程退出时若仍有对象未释放, 池内存不回收(遗留), 保证迟到的释放是安全的;
+ * 线程退出过程中(池已析构)的分配退回到堆上.
+ * 通过 DDECLARE_OBJECT_POOL(T) 给类加上 operator new/delete.
+ * @note 子类未声明自己的对象池时, 因大小不同会退回全局的 new/delete.
+ */
+template <class T>
+class ObjectPool : public ObjectPoolBase {
+public:
+    // @param tag user of pool, the pages are counted by MemAccount, @see EMemUsage
+    static void* allocObject(usz size, const s8* name, s32 tag = EMU_OTHER) {
+        if (sizeof(T) != size) {
+            return ::operator new(size);
+        }
+        ObjectPool* pool = getLocal(name, tag);
+        if (!pool) {
+            // the thread is exiting, no owner
+            Block* blk = reinterpret_cast<Block*>(::operator new(sizeof(Block)));
+            blk->mOwner = nullptr;
+            return blk->mData;
+        }
+        return pool->allocate();
+    }
+
+    static void releaseObject(void* it, usz size) {
+        if (!it) {
+            return;
+        }
+        if (sizeof(T) != size) {
+            ::operator delete(it);
+            return;
+        }
+        Block* blk = DGET_HOLDER(it, Block, mData);
+        if (!blk->mOwner) {
+            ::operator delete(blk);
+            return;
+        }
+        blk->mOwner->release(blk);
+    }
+
+    virtual void getStats(ObjectPoolStats& out) const override {
+        out.mName = mName;
+        out.mSize = sizeof(T);
+        out.mAllocs = mAllocs;
+        out.mFrees = mFrees;
+        out.mRemoteFrees = mRemoteFrees;
+        out.mLive = mLive;
+        out.mPeak = mPeak;
+        out.mPages = mPool.getAvailablePagesSize() + mPool.getUnavailablePagesSize();
+    }
+
+private:
+    struct Block {
+        ObjectPool* mOwner;
+        Block* mNext; // link of remote released blocks
+        alignas(T) u8 mData[sizeof(T)];
+    };
+
+    // pool of current thread, created by the first allocation, @see ThreadLocal
+    struct Local {
+        ObjectPool* mPool;
+        Local() : mPool(nullptr) {
+        }
+        ~Local() {
+            if (mPool) {
+                mPool->unlink();
+                mPool->collect();
+                if (0 == mPool->mLive) {
+                    delete mPool;
+                }
+            }
+        }
+    };
+
+    MemoryPool<Block> mPool;
+    std::atomic<Block*> mRemote;
+    const s8* mName;
+    s64 mAllocs;
+    s64 mFrees;
+    s64 mRemoteFrees;
+    s32 mLive;
+    s32 mPeak;
+
+    ObjectPool(const s8* name, s32 tag) :
+        mRemote(nullptr), mName(name), mAllocs(0), mFrees(0), mRemoteFrees(0), mLive(0), mPeak(0) {
+        mPool.setPageSize(DMAX(16 * 1024, 8 * (s32)sizeof(Block)));
+        mPool.setTag(tag);
+    }
+
+    virtual ~ObjectPool() {
+        DASSERT(0 == mLive);
+    }
+
+    // @return nullptr if the thread is exiting
+    static ObjectPool* getLocal(const s8* name, s32 tag) {
+        Local* loc = ThreadLocal<Local>::get();
+        if (loc && !loc->mPool) {
+            loc->mPool = new ObjectPool(name, tag);
+            loc->mPool->link();
+        }
+        return loc ? loc->mPool : nullptr;
+    }
+
+    void* allocate() {
+        if (mRemote.load(std::memory_order_relaxed)) {
+            collect();
+        }
+        Block* blk = mPool.allocate();
+        if (!blk) {
+            throw std::bad_alloc();
+        }
+        blk->mOwner = this;
+        blk->mNext = nullptr;
+        ++mAllocs;
+        if (++mLive > mPeak) {
+            mPeak = mLive;
+        }
+        return blk->mData;
+    }
+
+    void release(Block* blk) {
+        const Local* loc = ThreadLocal<Local>::get();
+        if (loc && this == loc->mPool) {
+            ++mFrees;
+            --mLive;
+            mPool.release(blk);
+            return;
+        }
+        Block* old = mRemote.load(std::memory_order_relaxed);
+        do {
+            blk->mNext = old;
+        } while (!mRemote.compare_exchange_weak(old, blk, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // take back all the blocks released by other threads
+    void collect() {
+        for (Block* blk = mRemote.exchange(nullptr, std::memory_order_acquire); blk;) {
+            Block* next = blk->mNext;
+            ++mRemoteFrees;
+            --mLive;
+            mPool.release(blk);
+            blk = next;
+        }
+    }
+};
+
+
+/**
+ * @brief 在类声明中使用, 使该类的对象从所在线程的对象池中分配, eg:
+ *        class HttpMsg : public RefCount {
+ *        public:
+ *            DDECLARE_OBJECT_POOL(HttpMsg)
+ *        };
+ */
+#define DDECLARE_OBJECT_POOL(T) DDECLARE_OBJECT_POOL_TAG(T, app::EMU_OTHER)
+
+/**
+ * @brief 同 DDECLARE_OBJECT_POOL, 对象池的内存页按 tag 计入 MemAccount, @see EMemUsage
+ */
+#define DDECLARE_OBJECT_POOL_TAG(T, tag)                                                                               \
+    static void* operator new(size_t size) {                                                                           \
+        return app::ObjectPool<T>::allocObject(size, #T, tag);                                                         \
+    }                                                                                                                  \
+    static void operator delete(void* it, size_t size) {                                                               \
+        app::ObjectPool<T>::releaseObject(it, size);                                                                   \
+    }
+
+} // namespace app
+
+#endif // APP_OBJECTPOOL_H
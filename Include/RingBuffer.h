@@ -28,6 +28,7 @@
 
 #include "Nocopy.h"
 #include "TString.h"
+#include "HugePage.h"
 
 #define D_RBUF_BLOCK_SIZE (4 * 1024)
 
@@ -40,6 +41,15 @@ struct SRingBufNode {
     }
     ~SRingBufNode() {
     }
+    static void* operator new(size_t size) {
+        void* ret = HugePage::allocPiece(size);
+        return ret ? ret : ::operator new(size);
+    }
+    static void operator delete(void* it, size_t size) {
+        if (!HugePage::releasePiece(it, size)) {
+            ::operator delete(it);
+        }
+    }
 };
 
 struct SRingBufPos {
@@ -0,0 +1,203 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#ifndef APP_SHAREALLOCATOR_H
+#define APP_SHAREALLOCATOR_H
+
+#include <atomic>
+#include "MemSlabPool.h"
+
+namespace app {
+
+/**
+ * @brief 共享内存中对象的句柄, 跨进程传递时只能保存句柄, 不能保存指针.
+ * 格式: [arena:8][generation:24][offset/8:32], 0=invalid
+ */
+using ShareHandle = u64;
+
+// max arenas in shared mem, @see ShareAllocator::create()
+const u32 G_SHARE_MAX_ARENA = 64;
+
+
+/**
+ * @brief 跨进程的锁, 位于共享内存, 锁值为持有者的pid, 0=unlocked.
+ * 持有者进程崩溃后, 可由其它进程接管.
+ */
+class ShareLock : public Nocopy {
+public:
+    ShareLock() : mOwner(0) {
+    }
+
+    ~ShareLock() {
+    }
+
+    /**
+     * @brief lock by a process, not recursive.
+     * @param pid the caller process
+     * @return 0 if locked, else the pid of dead owner which is taken over, the protected data may be broken.
+     */
+    s32 lock(s32 pid);
+
+    bool tryLock(s32 pid) {
+        s32 val = 0;
+        return mOwner.compare_exchange_strong(val, pid);
+    }
+
+    void unlock(s32 pid) {
+        mOwner.compare_exchange_strong(pid, 0);
+    }
+
+    /**
+     * @brief unlock if it's locked by the dead process.
+     * @return true if the dead process was holding the lock.
+     */
+    bool forceUnlock(s32 pid) {
+        return pid > 0 && mOwner.compare_exchange_strong(pid, 0);
+    }
+
+    s32 getOwner() const {
+        return mOwner.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<s32> mOwner;
+};
+
+
+/**
+ * @brief 多进程共享的内存分配器, 位于Engine的共享内存(ShareMem)中.
+ * 每个进程一个arena(MemSlabPool), 进程优先从自己的arena分配, 可以释放其它进程的内存.
+ * 进程间传递ShareHandle(基于偏移), 用getPointer()取得本进程的地址.
+ * 进程持锁崩溃后, arena被重置, generation增加, 该arena上的旧句柄全部失效,
+ * 所以只适合存放可丢失的数据, 如缓存/计数器, 每次使用前都应通过句柄重新取地址.
+ * @note MemSlabPool内部链表为绝对地址, 要求各进程的映射地址相同(linux fork继承),
+ *       映射地址不同的进程(windows子进程)只能读写数据, 不能分配与释放.
+ */
+class ShareAllocator : public Nocopy {
+public:
+    ShareAllocator();
+
+    ~ShareAllocator();
+
+    /**
+     * @brief format the shared region by main process.
+     * @param mem start of region
+     * @param size bytes of region
+     * @param arenas count of arenas, reduced if the region is too small
+     * @return true if success
+     */
+    bool create(s8* mem, usz size, u32 arenas);
+
+    /**
+     * @brief attach the region formatted by main process, needless for the forked childs.
+     * @return true if success
+     */
+    bool attach(s8* mem);
+
+    /**
+     * @brief set the arena of current process, called after fork().
+     * @param idx index of process, 0=main process, child[i]=i+1
+     */
+    void setArena(u32 idx);
+
+    ShareHandle allocate(usz size);
+
+    ShareHandle callocate(usz size);
+
+    /**
+     * @brief free the memory, stale handle is ignored.
+     */
+    void release(ShareHandle it);
+
+    /**
+     * @return the address in current process, nullptr if the handle is invalid or stale.
+     */
+    void* getPointer(ShareHandle it) const;
+
+    template <class T>
+    T* getPointer(ShareHandle it) const {
+        return reinterpret_cast<T*>(getPointer(it));
+    }
+
+    /**
+     * @brief the handle of a pointer returned by getPointer().
+     */
+    ShareHandle getHandle(const void* it) const;
+
+    /**
+     * @brief called by main process after a child process exited, before respawn it.
+     * the arena of the dead process and the arenas it locked are reset.
+     * @param pid the dead process
+     * @param idx index of the dead process, @see setArena()
+     * @return count of arenas reset, 0 if idx is out of range
+     */
+    u32 recover(s32 pid, u32 idx);
+
+    u32 getArenaCount() const;
+
+    /**
+     * @brief read stats of arena without lock.
+     */
+    MemSlabPool* getArena(u32 idx) const;
+
+    /**
+     * @return the generation of arena, increased when the arena was reset.
+     */
+    u32 getGeneration(u32 idx) const;
+
+    bool isLinked() const {
+        return mLinked;
+    }
+
+private:
+    struct Arena {
+        ShareLock mLock;
+        std::atomic<u32> mGeneration;
+        usz mOffset; // MemSlabPool, from start of region
+        usz mSize;
+    };
+    struct Header {
+        u32 mMagic;
+        u32 mArenaCount;
+        usz mSize;
+        const s8* mBase; // address of region in creator
+        Arena mArenas[G_SHARE_MAX_ARENA];
+    };
+
+    Header* mHead;
+    u32 mArena;
+    s32 mPID;
+    bool mLinked;
+
+    u32 getArenaIndex(const void* it) const;
+    void lockArena(u32 idx);
+    void unlockArena(u32 idx);
+    void resetArena(u32 idx);
+};
+
+} // namespace app
+
+#endif // APP_SHAREALLOCATOR_H
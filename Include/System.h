@@ -39,6 +39,13 @@ public:
     s8 mFileName[260];
 };
 
+struct CpuInfo {
+    u16 mID;   // logic cpu id
+    u16 mNode; // numa node
+    u16 mCore; // the first cpu of the thread siblings(SMT), mCore==mID means a physical core
+};
+
+
 class System {
 public:
 
@@ -58,6 +65,54 @@ public:
 
     static u32 getCoreCount();
 
+    /**
+     * @brief get the online cpus and topology, sorted by cpu id.
+     */
+    static void getCpuInfo(TVector<CpuInfo>& out);
+
+    /**
+     * @brief bind current thread to the cpus.
+     * @return EE_OK if success, else failed.
+     */
+    static s32 bindCPU(const u16* cpus, usz cnt);
+
+    /**
+     * @brief allocate memory from the numa node first, for current thread, linux only.
+     * @return EE_OK if success, else failed.
+     */
+    static s32 bindNode(u32 node);
+
+    /**
+     * @brief parse cpu list, eg: "0-3,8,10-11", the format of linux cpulist.
+     * other chars are separators, the bad items are skipped: "3-1", "3-", ids >= 0xFFFF.
+     * @return count of cpus appended to out.
+     */
+    static usz parseCpuList(const s8* str, TVector<u16>& out) {
+        usz ret = 0;
+        while (str && *str) {
+            if (*str < '0' || *str > '9') {
+                ++str;
+                continue;
+            }
+            u32 low = parseCpuID(str);
+            u32 high = low;
+            if ('-' == *str) {
+                ++str;
+                if (*str < '0' || *str > '9') {
+                    continue;
+                }
+                high = parseCpuID(str);
+            }
+            if (high >= 0xFFFF) {
+                continue;
+            }
+            for (; low <= high; ++low, ++ret) {
+                out.pushBack((u16)low);
+            }
+        }
+        return ret;
+    }
+
     static u32 getPageSize();
 
     /**
@@ -100,8 +155,23 @@ public:
 
 
     static s32 createProcess(usz socket, void*& handle);
+
+    /**
+     * @brief run a new binary in a new process, the caller process keeps running.
+     * @param file full path of the binary
+     * @param keep the fds inherited by the new process, others are closed.
+     * @param envs extra environment variables, eg: "KEY=VALUE"
+     * @return pid of the new process if success, else < 0.
+     */
+    static s32 spawnProcess(const String& file, const TVector<s32>& keep, const TVector<String>& envs);
     static void waitProcess(void* handle);
 
+    /**
+     * @brief check if a process is still running, by pid.
+     * @return true if the process exists.
+     */
+    static bool isProcessAlive(s32 pid);
+
     static String getWorkingPath();
 
 private:
@@ -112,6 +182,15 @@ private:
     System& operator=(const System&) = delete;
     System& operator=(const System&&) = delete;
 
+    // @return the number at str, saturated to 0xFFFF
+    static u32 parseCpuID(const s8*& str) {
+        u32 ret = 0;
+        for (; *str >= '0' && *str <= '9'; ++str) {
+            ret = ret < 0xFFFF ? ret * 10 + (*str - '0') : 0xFFFF;
+        }
+        return ret < 0xFFFF ? ret : 0xFFFF;
+    }
+
     static s32 gSignal;
 };
 
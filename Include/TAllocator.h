@@ -42,6 +42,11 @@ class TAllocator {
 public:
     virtual ~TAllocator() { }
 
+    //stateless, memory of any one can be freed by others
+    bool operator==(const TAllocator<T>& it) const {
+        return true;
+    }
+
     //allocate memory for an array of objects
     T* allocate(usz cnt) {
         return (T*)innerNew(cnt * sizeof(T));
@@ -88,6 +93,11 @@ template<typename T>
 class TAllocatorFast {
 public:
 
+    //stateless, memory of any one can be freed by others
+    bool operator==(const TAllocatorFast<T>& it) const {
+        return true;
+    }
+
     //allocate memory for an array of objects
     T* allocate(usz cnt) {
         return (T*)operator new(cnt * sizeof(T));
@@ -294,6 +294,13 @@ public:
         initSmall();
     }
 
+    /**
+     * @brief constructor with a stateful allocator, eg: TAllocatorArena
+     */
+    explicit TString(const TAlloc& it) noexcept : mAllocator(it) {
+        initSmall();
+    }
+
     TString(usz reserve) noexcept {
         if (reserve > G_SMALL_CAPACITY) {
             mBigStr.mCapacity = (reserve + 1) & G_ALLOC_MASK;
@@ -316,7 +323,7 @@ public:
     }
 
 
-    TString<T, TAlloc>(const TStrView<T>& other) noexcept {
+    TString(const TStrView<T>& other) noexcept {
         initStr<T>(other.mData, other.mLen);
     }
 
@@ -328,7 +335,7 @@ public:
     }
 
     template <class B>
-    TString<T, TAlloc>(const TStrView<B>& other) noexcept {
+    TString(const TStrView<B>& other) noexcept {
         initStr<B>(other.mData, other.mLen);
     }
 
@@ -348,6 +355,18 @@ public:
         *this = c;
     }
 
+    /**
+     * @brief change the allocator before any allocation.
+     */
+    void setAllocator(const TAlloc& it) {
+        DASSERT(!isAllocated());
+        mAllocator = it;
+    }
+
+    const TAlloc& getAllocator() const {
+        return mAllocator;
+    }
+
     ~TString() {
         if (isAllocated()) {
             mAllocator.deallocate(mBigStr.mBuffer);
@@ -370,11 +389,14 @@ public:
 
     TString<T, TAlloc>& operator=(TString<T, TAlloc>&& it) noexcept {
         if (&it != this) {
+            if (!(mAllocator == it.mAllocator)) {
+                // the buffer can't be freed by my allocator, eg: in the arena of other msg
+                return *this = static_cast<const TString<T, TAlloc>&>(it);
+            }
             if (isAllocated()) {
                 mAllocator.deallocate(mBigStr.mBuffer);
             }
             mBigStr = it.mBigStr;
-            AppSwap(mAllocator, it.mAllocator);
             it.initSmall();
         }
         return *this;
@@ -71,6 +71,7 @@ public:
     TVector(TVector<T, TAlloc>&& it)noexcept : mData(it.mData)
         , mAllocated(it.mAllocated)
         , mUsed(it.mUsed)
+        , mAllocator(it.mAllocator)
         , mStrategy(it.mStrategy)
         , mSorted(it.mSorted) {
         it.mUsed = 0;
@@ -252,6 +253,18 @@ public:
         mSorted = true;
     }
 
+    /**
+    * @brief 设置分配器, 必须在分配内存之前, eg: TAllocatorArena
+    */
+    void setAllocator(const TAlloc& it) {
+        DASSERT(!mData);
+        mAllocator = it;
+    }
+
+    const TAlloc& getAllocator() const {
+        return mAllocator;
+    }
+
     /**
     * @brief 析构所有元素并删除数组空间
     */
@@ -308,10 +321,13 @@ public:
 
     TVector<T, TAlloc>& operator=(TVector<T, TAlloc>&& other)noexcept {
         if (&other != this) {
+            if (!(mAllocator == other.mAllocator)) {
+                // 内存不属于本分配器(如其它消息的arena), 只能复制
+                return *this = static_cast<const TVector<T, TAlloc>&>(other);
+            }
             AppSwap(mData, other.mData);
             AppSwap(mAllocated, other.mAllocated);
             AppSwap(mUsed, other.mUsed);
-            AppSwap(mAllocator, other.mAllocator);
 
             // can't use AppSwap with bitfields
             EAllocStrategy estra = mStrategy;
@@ -0,0 +1,94 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#ifndef APP_THREADLOCAL_H
+#define APP_THREADLOCAL_H
+
+#include "Config.h"
+
+namespace app {
+
+/**
+ * @brief 线程私有对象, 每个线程一份, 在该线程首次 get() 时构造, 线程退出时析构.
+ * 析构开始后 get() 返回 nullptr 且不会再构造, 所以其它 thread_local 的析构函数中仍可安全调用,
+ * 调用者须退回到共享(加锁)或堆上的路径.
+ * 状态: 0=未构造, 1=存活, 2=已析构.
+ * eg:
+ *     BufferPool* pool = ThreadLocal<BufferPool>::get();
+ *     return pool ? pool->allocate(size, tag) : allocHeap(size, tag);
+ * @note T 须可默认构造, 私有构造函数的类须声明 friend class ThreadLocal<T>.
+ */
+template <class T>
+class ThreadLocal {
+public:
+    enum EState {
+        ETS_INIT = 0,
+        ETS_LIVING = 1,
+        ETS_DESTROYED = 2
+    };
+
+    /**
+     * @return object of current thread, nullptr if the thread is exiting and it's destroyed.
+     */
+    static T* get() {
+        if (ETS_INIT == gState) {
+            static thread_local Holder ret;
+        }
+        return gItem;
+    }
+
+    static s32 getState() {
+        return gState;
+    }
+
+private:
+    struct Holder {
+        T mItem;
+        Holder() {
+            gItem = &mItem;
+            gState = ETS_LIVING;
+        }
+        ~Holder() {
+            gState = ETS_DESTROYED;
+            gItem = nullptr; // before ~T(), so T is unavailable while destructing
+        }
+    };
+
+    static thread_local s32 gState;
+    static thread_local T* gItem;
+
+    ThreadLocal() = delete;
+};
+
+template <class T>
+thread_local s32 ThreadLocal<T>::gState = ThreadLocal<T>::ETS_INIT;
+
+template <class T>
+thread_local T* ThreadLocal<T>::gItem = nullptr;
+
+} // namespace app
+
+#endif // APP_THREADLOCAL_H
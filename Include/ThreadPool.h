@@ -62,7 +62,7 @@ public:
 
     template <class P>
     void pack(void (*func)(P*), P* dat) {
-        mCall = func;
+        mCall = reinterpret_cast<FuncTask>(func);
         mThis = nullptr;
         mData = dat;
     }
@@ -85,6 +85,73 @@ public:
 };
 
 
+/**
+ * @brief 无锁的多生产者单消费者任务队列, 侵入式的链接TaskNode::mNext.
+ * 生产者CAS入栈, 消费者一次性取走全部任务, 所以没有ABA问题.
+ */
+class TaskQueue {
+public:
+    TaskQueue() : mHead(nullptr) {
+    }
+
+    ~TaskQueue() {
+    }
+
+    TaskQueue(const TaskQueue&) = delete;
+    TaskQueue& operator=(const TaskQueue&) = delete;
+
+    bool empty() const {
+        return nullptr == mHead.load();
+    }
+
+    /**
+     * @brief thread safe, push by any thread.
+     * @return true if the queue was empty before push.
+     */
+    bool push(TaskNode* it) {
+        return pushList(it, it);
+    }
+
+    /**
+     * @brief thread safe, push a linked list, from head to tail by TaskNode::mNext.
+     * @return true if the queue was empty before push.
+     */
+    bool pushList(TaskNode* head, TaskNode* tail) {
+        TaskNode* old = mHead.load(std::memory_order_relaxed);
+        do {
+            tail->mNext = old;
+        } while (!mHead.compare_exchange_weak(old, head, std::memory_order_seq_cst, std::memory_order_relaxed));
+        return nullptr == old;
+    }
+
+    /**
+     * @brief take all the tasks at once.
+     * @return the newest task, a linked list in LIFO order.
+     */
+    TaskNode* popAll() {
+        return mHead.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    /**
+     * @brief take all the tasks at once.
+     * @return the oldest task, a linked list in FIFO order.
+     */
+    TaskNode* popAllFIFO() {
+        TaskNode* ret = nullptr;
+        for (TaskNode* nd = popAll(); nd;) {
+            TaskNode* next = nd->mNext;
+            nd->mNext = ret;
+            ret = nd;
+            nd = next;
+        }
+        return ret;
+    }
+
+private:
+    std::atomic<TaskNode*> mHead;
+};
+
+
 class ThreadPool {
 public:
     ThreadPool() :
@@ -104,6 +104,11 @@ public:
     */
     static s64 getRelativeTime();
 
+    /**
+    * @return monotonic time in microseconds, for measuring durations
+    */
+    static s64 getRelativeMicro();
+
     static u32 getMonthMaxDay(u32 iYear, u32 iMonth);
 
     /**
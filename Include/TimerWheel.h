@@ -27,7 +27,7 @@
 #define APP_TIMERWHEEL_H
 
 #include "Node.h"
-#include "Spinlock.h"
+#include "Nocopy.h"
 
 namespace app {
 
@@ -39,19 +39,23 @@ namespace app {
 #define APP_TIME_SLOT_MASK		    (APP_TIME_SLOT_SIZE - 1)
 #define APP_TIME_ROOT_SLOT_MASK		(APP_TIME_ROOT_SLOT_SIZE - 1)
 
-typedef void(*AppTimeoutCallback) (void*);
-
-class TimerWheel {
+/**
+* @brief hierarchical timer wheel, O(1) add & remove, not thread safe.
+* The wheel only collect the expired nodes, it's the owner to fire them or to re-add them,
+* so a "touch" can just move the owner's deadline forward and re-slot the node lazily
+* when it's slot expired, @see Loop::updateTimeHub()
+*/
+class TimerWheel : public Nocopy {
 public:
     struct STimeNode {
         Node2 mLinker;
-        AppTimeoutCallback mCallback;
-        void* mCallbackData;
         s32 mTimeoutStep;           //Absolute timeout step
-        s32 mCycleStep;             //cycle step,relatively
-        s32 mMaxRepeat;
         STimeNode();
         ~STimeNode();
+
+        bool isLinked()const {
+            return !mLinker.empty();
+        }
     };
 
     /**
@@ -64,31 +68,36 @@ public:
 
     ~TimerWheel();
 
-    void update(s64 currentTime);
-
     /**
-    *@param period The timeout stamp, relative with current time.
-    *@param repeat repeat times.-1=ever
+    * @brief collect the expired nodes.
+    * @param currentTime Current time stamp, in millisecond.
+    * @param expired all expired nodes will be moved into this queue.
     */
-    void add(STimeNode& node, u32 period, s32 repeat);
-
-    void add(STimeNode& node);
-
-    bool remove(STimeNode& node);
-
-    s32 getCurrentStep()const {
-        return mCurrentStep;
-    }
+    void update(s64 currentTime, Node2& expired);
 
-    void setCurrentStep(s32 step) {
-        mCurrentStep = step;
+    /**
+    * @param node the node to add, it will be removed first if linked.
+    * @param timeout absolute timeout stamp, in millisecond.
+    */
+    void add(STimeNode& node, s64 timeout);
+
+    bool remove(STimeNode& node) {
+        if (node.isLinked()) {
+            node.mLinker.delink();
+            return true;
+        }
+        return false;
     }
 
     /**
-    * @param interval time interval of timewheel.
+    * @param currentTime Current time stamp, in millisecond.
+    * @param limit max wait time, in millisecond.
+    * @return milliseconds to the next none empty slot or cascade, max= \p limit
     */
-    void setInterval(s32 interval) {
-        mInterval = (interval > 0 ? interval : 1);
+    s64 getWaitTime(s64 currentTime, s64 limit)const;
+
+    s32 getCurrentStep()const {
+        return mCurrentStep;
     }
 
     s32 getInterval()const {
@@ -99,12 +108,8 @@ public:
         return mCurrent;
     }
 
-    void setCurrent(s64 time) {
-        mCurrent = time;
-    }
-
     /**
-    * @brief Clear all tasks, every task will be called back.
+    * @brief Unlink all nodes.
     */
     void clear();
 
@@ -118,7 +123,6 @@ public:
 
 private:
     void init();
-    void initSlot(Node2 all[], u32 size);
     void clearSlot(Node2 all[], u32 size);
 
     enum {
@@ -129,7 +133,7 @@ private:
         //ESLOT_FORCE_32BIT = 0xFFFFFFFF
     };
 
-    void innerUpdate();
+    void innerUpdate(Node2& expired);
 
     inline s32 getIndex(s32 jiffies, s32 level)const {
         return (jiffies >> (APP_TIME_ROOT_SLOT_BITS + level * APP_TIME_SLOT_BITS)) & APP_TIME_SLOT_MASK;
@@ -142,7 +146,6 @@ private:
     s32 mInterval;
     s32 mCurrentStep;
     s64 mCurrent;
-    Spinlock mSpinlock;
     Node2 mSlot_0[APP_TIME_ROOT_SLOT_SIZE];
     Node2 mSlot_1[APP_TIME_SLOT_SIZE];
     Node2 mSlot_2[APP_TIME_SLOT_SIZE];
@@ -33,6 +33,7 @@
 #include <MSWSock.h>
 #endif
 #include "Nocopy.h"
+#include "BufferPool.h"
 #include "TString.h"
 #include "Net/NetAddress.h"
 
@@ -51,10 +52,16 @@ enum ERequestType {
     ERT_COUNT
 };
 
+enum ERequestFlag {
+    ERF_CONNECTED = 1,  //UDP: had connected
+    ERF_IOV = 8         //scatter/gather write, the request is a RequestIOV
+};
+
 class RequestFD : public Nocopy {
 public:
-    static RequestFD* newRequest(u32 cache_size) {
-        RequestFD* it = (RequestFD*)(new s8[sizeof(RequestFD) + cache_size]);
+    // @param tag user of request, @see EMemUsage
+    static RequestFD* newRequest(u32 cache_size, s32 tag = EMU_NET) {
+        RequestFD* it = reinterpret_cast<RequestFD*>(BufferPool::allocBuf(sizeof(RequestFD) + cache_size, tag));
         new ((void*)it) RequestFD();
         it->mAllocated = cache_size;
         it->mData = (s8*)(it + 1);
@@ -62,7 +69,7 @@ public:
     }
 
     static void delRequest(RequestFD* it) {
-        delete[] reinterpret_cast<s8*>(it);
+        BufferPool::releaseBuf(it);
     }
 
     RequestFD() {
@@ -76,6 +83,7 @@ public:
     void* mUser;
     s32 mType;      //ERequestType
     s32 mError;     //0=success,else failed code
+    u32 mFlags;     //ERequestFlag bits
     FuncReqCallback mCall;
     s8* mData;
     u32 mAllocated;
@@ -144,11 +152,11 @@ public:
 
 class RequestUDP : public RequestFD {
 public:
-    u32 mFlags;   //bits: [1=had connected, ...]
     net::NetAddress mRemote;
 
-    static RequestUDP* newRequest(u32 cache_size) {
-        RequestUDP* it = reinterpret_cast<RequestUDP*>(new s8[sizeof(RequestUDP) + cache_size]);
+    // @param tag user of request, @see EMemUsage
+    static RequestUDP* newRequest(u32 cache_size, s32 tag = EMU_NET) {
+        RequestUDP* it = reinterpret_cast<RequestUDP*>(BufferPool::allocBuf(sizeof(RequestUDP) + cache_size, tag));
         new ((void*)it) RequestUDP();
         it->mAllocated = cache_size;
         it->mData = reinterpret_cast<s8*>(it + 1);
@@ -156,7 +164,7 @@ public:
     }
 
     static void delRequest(RequestUDP* it) {
-        delete[] reinterpret_cast<s8*>(it);
+        BufferPool::releaseBuf(it);
     }
 
     RequestUDP() {
@@ -168,6 +176,87 @@ public:
 };
 
 
+typedef void (*FuncSliceRelease)(void* user);
+
+struct SliceIOV {
+    const s8* mData;
+    u32 mLen;
+    FuncSliceRelease mRelease;  //optional, @see RequestIOV::releaseSlices()
+    void* mUser;
+};
+
+/**
+ * @brief scatter/gather write request, all the slices are sent in order as one stream.
+ * mData/mAllocated is a small cache(eg: http head), mUsed is the total size of slices.
+ * @note slices must keep alive until mCall, and mCall should call releaseSlices().
+ */
+class RequestIOV : public RequestFD {
+public:
+    static const u32 MAX_SLICE = 8;
+
+    SliceIOV mSlices[MAX_SLICE];
+    u32 mSliceCount;
+
+    RequestIOV() : mSliceCount(0) {
+        // RequestFD is cleared by it's constructor
+        memset(mSlices, 0, sizeof(mSlices));
+        mFlags = ERF_IOV;
+    }
+
+    ~RequestIOV() {
+    }
+
+    /**
+    * @brief take the filled cache [mData, mData+mUsed) as the first slice.
+    */
+    void commitCache() {
+        DASSERT(0 == mSliceCount);
+        u32 len = mUsed;
+        mUsed = 0;
+        addSlice(mData, len);
+    }
+
+    bool addSlice(const void* data, u32 len, FuncSliceRelease release = nullptr, void* user = nullptr) {
+        if (mSliceCount >= MAX_SLICE) {
+            return false;
+        }
+        SliceIOV& it = mSlices[mSliceCount++];
+        it.mData = reinterpret_cast<const s8*>(data);
+        it.mLen = len;
+        it.mRelease = release;
+        it.mUser = user;
+        mUsed += len;
+        return true;
+    }
+
+    void releaseSlices() {
+        for (u32 i = 0; i < mSliceCount; ++i) {
+            if (mSlices[i].mRelease) {
+                mSlices[i].mRelease(mSlices[i].mUser);
+            }
+        }
+        mSliceCount = 0;
+        mUsed = 0;
+    }
+
+#if defined(DOS_WINDOWS)
+    /**
+    * @return count of WSABUF filled */
+    u32 fillBuf(WSABUF* buf, u32 max) const {
+        u32 cnt = 0;
+        for (u32 i = 0; i < mSliceCount && cnt < max; ++i) {
+            buf[cnt].buf = const_cast<s8*>(mSlices[i].mData);
+            buf[cnt++].len = (ULONG)mSlices[i].mLen;
+        }
+        return cnt;
+    }
+#endif
+};
+
+static_assert(sizeof(RequestUDP) <= BufferPool::G_HEAD_ROOM, "the head of request must fit in BufferPool::G_HEAD_ROOM");
+static_assert(sizeof(RequestIOV) <= BufferPool::G_HEAD_ROOM_IOV, "the head of request must fit in BufferPool::G_HEAD_ROOM_IOV");
+
+
 class RequestAccept : public RequestFD {
 public:
     net::Socket mSocket;
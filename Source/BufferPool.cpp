@@ -0,0 +1,201 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#include "BufferPool.h"
+#include "Logger.h"
+#include "HugePage.h"
+#include <new>
+
+namespace app {
+
+BufferPool::BufferPool() :
+    mChunkPos(nullptr), mChunkEnd(nullptr), mMaxCached(1024 * 1024), mMaxHuge(0) {
+    memset(mIdle, 0, sizeof(mIdle));
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+
+BufferPool::~BufferPool() {
+    clear();
+}
+
+
+void BufferPool::setConfig(usz maxCached, usz maxHuge) {
+    mMaxCached = maxCached;
+    mMaxHuge = maxHuge;
+    if (mStats.mCached > mMaxCached) {
+        clear();
+    }
+}
+
+
+void* BufferPool::allocHeap(usz size, s32 tag) {
+    Block* blk = reinterpret_cast<Block*>(new s8[sizeof(Block) + size]);
+    blk->mNext = nullptr;
+    blk->mSize = (u32)size;
+    blk->mClass = G_CLASS_COUNT;
+    blk->mFlags = 0;
+    blk->mTag = (u16)tag;
+    MemAccount::onAlloc(tag, size);
+    return blk + 1;
+}
+
+
+void* BufferPool::allocate(usz size, s32 tag) {
+    ++mStats.mAllocs;
+    u32 cls = getClass(size);
+    if (cls >= G_CLASS_COUNT) {
+        ++mStats.mLarge;
+        return allocHeap(size, tag);
+    }
+    Block* blk = mIdle[cls];
+    if (blk) {
+        mIdle[cls] = blk->mNext;
+        mStats.mCached -= getClassSize(cls);
+        ++mStats.mHits;
+    } else {
+        blk = createBlock(cls);
+    }
+    blk->mNext = nullptr;
+    blk->mTag = (u16)tag;
+    MemAccount::onAlloc(tag, blk->mSize);
+    return blk + 1;
+}
+
+
+void BufferPool::releaseBuf(void* it) {
+    if (!it) {
+        return;
+    }
+    BufferPool* pool = getLocal();
+    if (pool) {
+        pool->release(it);
+        return;
+    }
+    Block* blk = reinterpret_cast<Block*>(it) - 1;
+    MemAccount::onFree(blk->mTag, blk->mSize);
+    if (0 == (EBF_HUGE & blk->mFlags)) {
+        delete[] reinterpret_cast<s8*>(blk);
+    }
+}
+
+
+void BufferPool::release(void* it) {
+    Block* blk = reinterpret_cast<Block*>(it) - 1;
+    ++mStats.mFrees;
+    MemAccount::onFree(blk->mTag, blk->mSize);
+    if (blk->mClass >= G_CLASS_COUNT) {
+        delete[] reinterpret_cast<s8*>(blk);
+        return;
+    }
+    usz bsz = getClassSize(blk->mClass);
+    if (0 == (EBF_HUGE & blk->mFlags) && mStats.mCached + bsz > mMaxCached) {
+        ++mStats.mDrops;
+        delete[] reinterpret_cast<s8*>(blk);
+        return;
+    }
+    blk->mNext = mIdle[blk->mClass];
+    mIdle[blk->mClass] = blk;
+    mStats.mCached += bsz;
+    if (mStats.mCached > mStats.mPeak) {
+        mStats.mPeak = mStats.mCached;
+    }
+}
+
+
+void BufferPool::clear() {
+    for (u32 i = 0; i < G_CLASS_COUNT; ++i) {
+        Block* keep = nullptr;
+        for (Block* blk = mIdle[i]; blk;) {
+            Block* next = blk->mNext;
+            if (EBF_HUGE & blk->mFlags) {
+                blk->mNext = keep;
+                keep = blk;
+            } else {
+                mStats.mCached -= getClassSize(i);
+                delete[] reinterpret_cast<s8*>(blk);
+            }
+            blk = next;
+        }
+        mIdle[i] = keep;
+    }
+}
+
+
+BufferPool::Block* BufferPool::createBlock(u32 cls) {
+    usz bsz = AppAlignSize(sizeof(Block) + getClassSize(cls), 64);
+    if (mMaxHuge > 0 && (usz)(mChunkEnd - mChunkPos) < bsz) {
+        mapChunk(); // the tail of old chunk is dropped
+    }
+    if ((usz)(mChunkEnd - mChunkPos) >= bsz) {
+        Block* blk = reinterpret_cast<Block*>(mChunkPos);
+        mChunkPos += bsz;
+        blk->mSize = (u32)getClassSize(cls);
+        blk->mClass = (u8)cls;
+        blk->mFlags = EBF_HUGE;
+        return blk;
+    }
+    Block* blk = reinterpret_cast<Block*>(new s8[sizeof(Block) + getClassSize(cls)]);
+    blk->mSize = (u32)getClassSize(cls);
+    blk->mClass = (u8)cls;
+    blk->mFlags = 0;
+    return blk;
+}
+
+
+bool BufferPool::mapChunk() {
+    if (mStats.mHugeBytes + G_HUGE_CHUNK > mMaxHuge) {
+        return false;
+    }
+    // MAP_HUGETLB if any reserved, else THP, whatever HugePage::getMode()
+    usz size = G_HUGE_CHUNK;
+    void* mem = HugePage::mapMem(size, false, EHPM_HUGETLB);
+    if (!mem) {
+        mMaxHuge = 0;
+        Logger::log(ELL_ERROR, "BufferPool::mapChunk>>fail, disable hugepage");
+        return false;
+    }
+    mStats.mHugeBytes += size;
+    mChunkPos = reinterpret_cast<s8*>(mem);
+    mChunkEnd = mChunkPos + size;
+    return true;
+}
+
+
+void BufferPool::logThread(const s8* tag) {
+    BufferPool* pool = getLocal();
+    if (!pool) {
+        return;
+    }
+    const BufferPoolStats& st = pool->mStats;
+    Logger::log(ELL_INFO,
+        "BufferPool::logThread>>%s, alloc=%lld, hit=%lld, free=%lld, drop=%lld, large=%lld, cached=%llu, "
+        "peak=%llu, huge=%lluKB",
+        tag, st.mAllocs, st.mHits, st.mFrees, st.mDrops, st.mLarge, (u64)st.mCached, (u64)st.mPeak,
+        (u64)(st.mHugeBytes >> 10));
+}
+
+} // namespace app
@@ -78,6 +78,8 @@ s32 AppTicker::onTimeout(HandleTime* it) {
     if (!Engine::getInstance().isMainProcess()) {
         return EE_OK;
     }
+    EngineStats sum;
+    Engine::getInstance().sumEngineStats(sum);
 
     s32 ch = 0;
 #ifdef DOS_WINDOWS
@@ -85,9 +87,9 @@ s32 AppTicker::onTimeout(HandleTime* it) {
     if (!_kbhit() || (ch = _getch()) != 27)
 #endif
     {
-        printf("Handle=%lld, Fly=%lld, In=%lld/%lld, Out=%lld/%lld, Active=%lld/%lld\n", estat.mTotalHandles.load(),
-            estat.mFlyRequests.load(), estat.mInPackets.load(), estat.mInBytes.load(), estat.mOutPackets.load(),
-            estat.mOutBytes.load(), estat.mHeartbeat.load(), estat.mHeartbeatResp.load());
+        printf("Handle=%lld, Fly=%lld, In=%lld/%lld, Out=%lld/%lld, Active=%lld/%lld\n", sum.mTotalHandles.load(),
+            sum.mFlyRequests.load(), sum.mInPackets.load(), sum.mInBytes.load(), sum.mOutPackets.load(),
+            sum.mOutBytes.load(), sum.mHeartbeat.load(), sum.mHeartbeatResp.load());
         if (++G_LOG_FLUSH_CNT >= 20) {
             G_LOG_FLUSH_CNT = 0;
             Logger::flush();
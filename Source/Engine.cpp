@@ -27,17 +27,32 @@
 #include "System.h"
 #include "Timer.h"
 #include "FileRWriter.h"
+#include "Converter.h"
+#include "ObjectPool.h"
+#include "BufferPool.h"
+#include "HugePage.h"
 #include "Net/TcpProxy.h"
 #include "Net/Acceptor.h"
 #include "Net/HTTP/Website.h"
 
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#endif
+
 
 namespace app {
 
 const s8* G_CFGFILE = "Config/config.json";
 u32 MsgHeader::gSharedSN = 0;
+thread_local Loop* Engine::gThreadLoop = nullptr;
+thread_local EngineStats* Engine::gThreadStats = nullptr;
 
-Engine::Engine() : mPPID(0), mPID(0), mChild(32), mProcStatus(EPS_INIT), mProcResponCount(0), mMain(true) {
+Engine::Engine() :
+    mPPID(0), mPID(0), mProcIndex(0), mChild(32), mProcStatus(EPS_INIT), mProcResponCount(0), mMain(true),
+    mUpgradeReady(-1), mUpgradeCount(0), mUpgradePID(0), mDrainedLoops(0) {
     setProcessTask(&Engine::initTask, this, (void*)(nullptr));
 }
 
@@ -46,7 +61,9 @@ Engine::~Engine() {
 
 void Engine::clear() {
     // Logger::clear();
-    System::removeFile(mConfig.mPidFile.c_str());
+    if (mMain && mUpgradePID <= 0) { // else the pid file belongs to the new process
+        System::removeFile(mConfig.mPidFile.c_str());
+    }
 }
 
 
@@ -63,6 +80,11 @@ void Engine::postCommand(s32 val) {
         cmd.finish(ECT_ACTIVE, ++cmd.gSharedSN, ECT_VERSION);
         break;
     }
+    case ECT_MEM_REPORT:
+    {
+        cmd.finish(ECT_MEM_REPORT, ++cmd.gSharedSN, ECT_VERSION);
+        break;
+    }
     case ECT_RESPAWN:
     {
         if (mMain && mConfig.mMaxProcess > 0) {
@@ -70,28 +92,42 @@ void Engine::postCommand(s32 val) {
         }
         return;
     }
+    case ECT_UPGRADE:
+    {
+        if (mMain) {
+            ++mUpgradeCount; // @see Engine::run()
+        } else {
+            Logger::log(ELL_INFO, "Engine::postCommand>>upgrade by main process only, pid=%d", mPID);
+        }
+        return;
+    }
     default:
         Logger::log(ELL_INFO, "Engine::postCommand>>invalid cmd = %d", val);
         return;
     }
     if (mMain) {
+        // the sockets are shared with upgrade(), which sends and waits the listeners on them
+        std::lock_guard<std::recursive_mutex> ak(mChildMutex);
         for (usz i = 0; i < mChild.size(); ++i) {
-            /** TODO: keep send is thread/process safe
-             *  @see Loop::postTask
-             */
-
             if (sizeof(cmd) != mChild[i].mSocket.sendAll(&cmd, sizeof(cmd))) { // block send
                 Logger::log(ELL_INFO, "Engine::postCommand>>fail post cmd = %d, pid=%d", val, mChild[i].mID);
             }
         }
     }
+    if (ECT_MEM_REPORT == val) {
+        mLoop.postTask(cmd);
+    }
     if (ECT_EXIT == val) {
         mProcStatus = EPS_EXITING;
-        EngineStats& estat = Engine::getInstance().getEngineStats();
+        EngineStats estat;
+        sumEngineStats(estat);
         DLOG(ELL_INFO, "Engine::postCommand>> handles count = %lld", estat.mTotalHandles.load());
         //if (!mMain || (mMain && 0 == mConfig.mMaxProcess)) {
         Logger::log(ELL_INFO, "Engine::postCommand>> %s process exit...", mMain ? "main" : "child");
         mLoop.postTask(cmd);
+        for (usz i = 0; i < mLoops.size(); ++i) {
+            mLoops[i]->postTask(cmd);
+        }
     }
 }
 
@@ -136,6 +172,11 @@ bool Engine::init(const s8* fname, bool child, const s8* cfg) {
     }
     mPID = System::getPID();
     Logger::getInstance().setPID(mPID);
+#if defined(DOS_WINDOWS)
+    if (!mMain) { // spawned child has no index, pick a stats slot by pid
+        mProcIndex = 1 + (u32)mPID % (G_STATS_SLOT_COUNT - 1);
+    }
+#endif
     MsgHeader::gSharedSN = 0;
     Timer::getTimeZone();
     System::getCoreCount();
@@ -147,6 +188,7 @@ bool Engine::init(const s8* fname, bool child, const s8* cfg) {
         loger = Logger::addPrintReceiver();
     }
     Logger::addFileReceiver();
+    HugePage::init(mConfig.mHugePage, mConfig.mHugePageArena);
 
     script::ScriptManager::getInstance();
 
@@ -188,11 +230,25 @@ bool Engine::init(const s8* fname, bool child, const s8* cfg) {
         }
     }
 
+    if (!mMain) { // spawned child, the forked childs inherit allocator from main process
+        mShareAllocator.attach(mMapfile.getMem() + sizeof(EngineData));
+        mShareAllocator.setArena(mProcIndex);
+        MemAccount::setDefaultSlot(&getMemUsageSlot(0));
+    }
     if (mMain) {
-        MemSlabPool& mpool = getMemSlabPool();
-        new (&mpool) MemSlabPool(getMemSlabPoolSize()); // mpool.initSlabSize();
-        // mpool.mLock.tryUnlock();  TODO clear lock when ...
-        getEngineStats().clear();
+        // arena[0] for main process, arena[i+1] for child[i]
+        const u32 arenas = 1 + (mConfig.mMaxProcess > 0 ? mConfig.mMaxProcess : 0);
+        if (!mShareAllocator.create(mMapfile.getMem() + sizeof(EngineData), getShareAllocatorSize(), arenas)) {
+            return false;
+        }
+        EngineData* dat = reinterpret_cast<EngineData*>(mMapfile.getMem());
+        for (u32 i = 0; i < G_STATS_SLOT_COUNT; ++i) {
+            dat->mStats[i].clear();
+            dat->mMemUsage[i].clear();
+        }
+        MemAccount::setDefaultSlot(&getMemUsageSlot(0));
+        getLoopStats().clear();
+        dat->mListenTurn = 0;
 
         System::removeFile(mConfig.mPidFile.c_str());
         FileRWriter file;
@@ -203,7 +259,12 @@ bool Engine::init(const s8* fname, bool child, const s8* cfg) {
             return false;
         }
         Logger::log(ELL_INFO, "Engine::init>>pid = %d, main = %c", mPID, mMain ? 'Y' : 'N');
+        HugePage::logStats("init");
+        initInherited();
         ret = createProcess();
+        if (mMain && mChild.size() > 0) {
+            closeInherited(0, 0xFFFFFFFF); // listen by childs only
+        }
     }
 
     if (mMain) { // check again after fork()
@@ -231,33 +292,54 @@ bool Engine::init(const s8* fname, bool child, const s8* cfg) {
     if (ret) {
         script::ScriptManager::getInstance().loadFirstScript();
     }
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    if (mMain && mUpgradeReady >= 0) { // tell the old process to stop accepting, @see upgrade()
+        if (ret && 1 != ::write(mUpgradeReady, "R", 1)) {
+            Logger::log(ELL_ERROR, "Engine::init>>upgrade ready fail, ecode=%d", System::getError());
+        }
+        ::close(mUpgradeReady);
+        mUpgradeReady = -1;
+    }
+#endif
     return ret;
 }
 
 bool Engine::uninit() {
     if (mMain) {
-        MemSlabPool& mpool = getMemSlabPool();
-        EngineStats& engStats = getEngineStats();
+        EngineStats engStats;
+        sumEngineStats(engStats);
 
-        Logger::log(ELL_INFO, "Engine::uninit>>share stats[total=%ld, closed=%ld, in=%lu, out=%lu]",
+        Logger::log(ELL_INFO, "Engine::uninit>>share stats[total=%ld, closed=%ld, in=%lu, out=%lu, defer=%ld]",
             engStats.mTotalHandles.load(), engStats.mClosedHandles.load(), engStats.mInBytes.load(),
-            engStats.mOutBytes.load());
+            engStats.mOutBytes.load(), engStats.mFairDefers.load());
 
-        u32 cnt = mpool.getStateCount();
-        for (u32 i = 0; i < cnt; i++) {
-            MemStat& mstat = *(mpool.getStats() + i);
-            Logger::log(ELL_INFO, "Engine::uninit>>share mem[%u][used/total=%lu/%lu, req=%lu, fail=%lu]", i,
-                mstat.mUsed, mstat.mTotal, mstat.mRequests, mstat.mFails);
+        logShareMem();
+        if (mConfig.mLoopStats > 0) {
+            getLoopStats().log();
         }
     }
     Logger::log(ELL_INFO, "Engine::uninit>>pid = %d, main = %c, script=%llu", mPID, mMain ? 'Y' : 'N',
         script::ScriptManager::getInstance().getMemory());
     script::ScriptManager::getInstance().removeAll();
+    stopLoops();
+    s8 tag[32];
+    snprintf(tag, sizeof(tag), "pid=%d, loop=0", mPID);
+    ObjectPoolBase::logThread(tag);
+    BufferPool::logThread(tag);
+    HugePage::logStats(tag);
     Logger::flush();
     mMapfile.flush();
     mThreadPool.stop();
+    closeInherited(0, 0xFFFFFFFF);
+    if (mUpgradePID > 0 && App4Char2S32("GMEM") != App4Char2S32(mConfig.mMemName.c_str())) {
+        String oldmem = mConfig.mMemName;
+        oldmem += '.';
+        oldmem += mPID;
+        System::removeFile(oldmem); // renamed by upgrade()
+    }
     clear();
     mTlsENG.uninit();
+    MemAccount::setDefaultSlot(nullptr);
     mMapfile.closeAll();
     net::AppUninitTlsLib();
     return 0 == System::unloadNetLib();
@@ -267,10 +349,35 @@ void Engine::run() {
     if (mMain) {
         static std::chrono::milliseconds gap(100);
         while (EPS_RUNNING == mProcStatus) {
-            if (mProcResponCount > 0) {
+            if (mUpgradeCount > 0) {
+                mUpgradeCount = 0;
+                s32 idle = 0;
+                if (mUpgradePID.compare_exchange_strong(idle, -1)) {
+                    mThreadPool.postTask(&Engine::upgrade, this, static_cast<void*>(nullptr));
+                } else {
+                    Logger::log(ELL_INFO, "Engine::run>> upgrade is going, pid=%d", mUpgradePID.load());
+                }
+            }
+            if (mUpgradePID > 0 && mChild.size() > 0) {
+                // old childs are draining, never respawn, and exit with the last one
+                mProcResponCount = 0;
+                bool alive = false;
+                for (usz i = 0; i < mChild.size(); ++i) {
+                    alive = alive || mChild[i].mAlive;
+                }
+                if (!alive) {
+                    Logger::log(ELL_INFO, "Engine::run>> upgraded, all childs exited");
+                    postCommand(ECT_EXIT);
+                    break;
+                }
+                mLoop.run();
+            } else if (mProcResponCount > 0 && 0 == mUpgradePID) {
+                // no respawn while upgrade() is going, the new binary will take over, or retry if it failed
+                std::lock_guard<std::recursive_mutex> ak(mChildMutex);
                 --mProcResponCount;
                 for (usz i = 0; i < mChild.size(); i++) {
                     if (!mChild[i].mAlive && EPS_RESPAWN == mChild[i].mStatus) {
+                        mShareAllocator.recover(mChild[i].mID, (u32)i + 1);
                         if (createProcess(i)) {
                             if (!mMain) { // fork on linux
                                 mProcResponCount = 0;
@@ -300,6 +407,7 @@ GT_PROC_CHILD:
     // if have no child processes, the main process is the only worker.
     while (mLoop.run()) {
     }
+    stopLoops();
 }
 
 bool Engine::step() {
@@ -321,8 +429,13 @@ bool Engine::runMainProcess() {
         Logger::log(ELL_ERROR, "Engine::runMainProcess>> fail to open SocketPair");
         return false;
     }
+    mThreadPool.setThreadCalls(Engine::funcPoolThread, nullptr);
     mThreadPool.start(mConfig.mMaxThread);
     bool ret = mLoop.start(pair.getSocketB(), pair.getSocketA());
+    if (ret && 0 == mChild.size()) {
+        bindLoopCPU(0);
+        ret = startLoops(); // the main process is the only worker
+    }
     if (ret) {
         mProcStatus = EPS_RUNNING;
         mProcessTask();
@@ -334,8 +447,10 @@ bool Engine::runMainProcess() {
 }
 
 bool Engine::runChildProcess(net::Socket& cmdsock, net::Socket& write) {
+    mThreadPool.setThreadCalls(Engine::funcPoolThread, nullptr);
     mThreadPool.start(mConfig.mMaxThread);
-    bool ret = mLoop.start(cmdsock, write);
+    bindLoopCPU(0);
+    bool ret = mLoop.start(cmdsock, write) && startLoops();
     if (ret) {
         mProcStatus = EPS_RUNNING;
         mProcessTask();
@@ -346,6 +461,247 @@ bool Engine::runChildProcess(net::Socket& cmdsock, net::Socket& write) {
 }
 
 
+bool Engine::startLoops() {
+    String unpath = Engine::getInstance().getConfig().mLogPath;
+    unpath += System::getPID();
+    unpath += ".unpath";
+
+    // all loops are created before any thread start, so mLoops is readonly to loop threads
+    for (u8 i = 1; i < mConfig.mMaxLoop; ++i) {
+        net::SocketPair pair;
+        Loop* nd = nullptr;
+        if (!pair.open(unpath.c_str())) {
+            Logger::log(ELL_ERROR, "Engine::startLoops>> fail to open SocketPair, loop=%u", i);
+        } else {
+            nd = new Loop();
+            if (!nd->start(pair.getSocketB(), pair.getSocketA())) {
+                Logger::log(ELL_ERROR, "Engine::startLoops>> start loop fail, loop=%u", i);
+                mLoops.pushBack(nd);
+                nd = nullptr;
+            }
+        }
+        if (!nd) {
+            // no thread started yet, close the loops here
+            for (usz k = 0; k < mLoops.size(); ++k) {
+                mLoops[k]->stop();
+                while (mLoops[k]->run()) {
+                }
+            }
+            stopLoops();
+            return false;
+        }
+        mLoops.pushBack(nd);
+    }
+    for (usz i = 0; i < mLoops.size(); ++i) {
+        mLoopThreads.emplace_back(&Engine::runLoop, this, mLoops[i], (u32)(i + 1));
+    }
+    if (mLoops.size() > 0) {
+        Logger::log(ELL_INFO, "Engine::startLoops>> pid=%d, loops=%u", mPID, getLoopCount());
+    }
+    return true;
+}
+
+
+void Engine::stopLoops() {
+    // child process got ECT_EXIT by mLoop's cmd socket only, so tell other loops here
+    MsgHeader cmd;
+    cmd.finish(ECT_EXIT, ++cmd.gSharedSN, ECT_VERSION);
+    for (usz i = 0; i < mLoopThreads.size(); ++i) {
+        mLoops[i]->postTask(cmd);
+    }
+    for (std::thread& it : mLoopThreads) {
+        it.join();
+    }
+    mLoopThreads.resize(0);
+    for (usz i = 0; i < mLoops.size(); ++i) {
+        delete mLoops[i];
+    }
+    mLoops.clear();
+}
+
+
+void Engine::runLoop(Loop* it, u32 idx) {
+    gThreadLoop = it;
+    gThreadStats = &getStatsSlot(idx);
+    MemAccount::setThreadSlot(&getMemUsageSlot(idx));
+    bindLoopCPU(idx);
+    BufferPool::getLocal()->setConfig(mConfig.mBufPoolCache, mConfig.mBufPoolHuge);
+    // lua VM is not thread safe, each loop thread has it's own VM
+    script::ScriptManager::getInstance().loadFirstScript();
+    while (it->run()) {
+    }
+    script::ScriptManager::getInstance().removeAll();
+    s8 tag[32];
+    snprintf(tag, sizeof(tag), "pid=%d, loop=%u", mPID, idx);
+    ObjectPoolBase::logThread(tag);
+    BufferPool::logThread(tag);
+    gThreadLoop = nullptr;
+    gThreadStats = nullptr;
+    MemAccount::setThreadSlot(nullptr);
+}
+
+
+u32 Engine::getLoopIndex() const {
+    for (usz i = 0; gThreadLoop && i < mLoops.size(); ++i) {
+        if (gThreadLoop == mLoops[i]) {
+            return (u32)i + 1;
+        }
+    }
+    return 0;
+}
+
+
+u32 Engine::getWorkerSlot(u32 loop) const {
+    // worker index: the child[i] has mProcIndex=i+1, the main process works alone has mProcIndex=0
+    return (mProcIndex > 0 ? mProcIndex - 1 : 0) * mConfig.mMaxLoop + loop;
+}
+
+
+void Engine::lockListen() {
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    if (2 != mConfig.mListenSteer) {
+        return;
+    }
+    EngineData* dat = reinterpret_cast<EngineData*>(mMapfile.getMem());
+    const u32 slot = getWorkerSlot(getLoopIndex());
+    // a respawned worker joins the group at tail, and never waits
+    for (u32 i = 0; dat->mListenTurn.load() < slot; ++i) {
+        if (i >= 5000) {
+            Logger::log(ELL_ERROR, "Engine::lockListen>>timeout, slot=%u, turn=%u", slot, dat->mListenTurn.load());
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+#endif
+}
+
+
+void Engine::unlockListen() {
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    u32 turn = getWorkerSlot(getLoopIndex());
+    closeInherited(turn, turn + 1); // not taken, the listener was removed from config
+    if (2 != mConfig.mListenSteer) {
+        return;
+    }
+    EngineData* dat = reinterpret_cast<EngineData*>(mMapfile.getMem());
+    dat->mListenTurn.compare_exchange_strong(turn, turn + 1);
+#endif
+}
+
+
+void Engine::steerListener(net::Socket& sock) {
+    const TVector<u16>& cpus = mConfig.mLoopCPUs;
+    s32 ret = 0;
+    switch (mConfig.mListenSteer) {
+    case 1:
+        if (cpus.size() > 0) {
+            ret = sock.setIncomingCPU(cpus[getWorkerSlot(getLoopIndex()) % cpus.size()]);
+        }
+        break;
+    case 2:
+    {
+        const u32 workers = (mConfig.mMaxProcess > 0 ? mConfig.mMaxProcess : 1) * mConfig.mMaxLoop;
+        TVector<u16> table(workers);
+        for (u32 i = 0; cpus.size() > 0 && i < workers; ++i) {
+            table.pushBack(cpus[i % cpus.size()]);
+        }
+        ret = sock.setReusePortCPU(table.size() > 0 ? table.getPointer() : nullptr, workers);
+        break;
+    }
+    default:
+        break;
+    }
+    if (0 != ret) {
+        Logger::log(ELL_ERROR, "Engine::steerListener>>steer=%u, sock=%d, ecode=%d", mConfig.mListenSteer,
+            sock.getValue(), System::getError());
+    }
+}
+
+
+void Engine::bindLoopCPU(u32 loop) {
+    const TVector<u16>& cpus = mConfig.mLoopCPUs;
+    if (0 == cpus.size()) {
+        return;
+    }
+    const u16 cpu = cpus[getWorkerSlot(loop) % cpus.size()];
+    s32 ret = System::bindCPU(&cpu, 1);
+    u32 node = 0;
+    if (EE_OK == ret && mConfig.mNumaBind) {
+        TVector<CpuInfo> all;
+        System::getCpuInfo(all);
+        for (usz i = 0; i < all.size(); ++i) {
+            if (all[i].mID == cpu) {
+                node = all[i].mNode;
+                break;
+            }
+        }
+        ret = System::bindNode(node);
+    }
+    Logger::log(EE_OK == ret ? ELL_INFO : ELL_ERROR, "Engine::bindLoopCPU>>pid=%d, loop=%u, cpu=%u, node=%u, ret=%d",
+        mPID, loop, cpu, node, ret);
+}
+
+
+void Engine::funcPoolThread() {
+    const TVector<u16>& cpus = Engine::getInstance().getConfig().mPoolCPUs;
+    if (cpus.size() > 0) {
+        s32 ret = System::bindCPU(cpus.getPointer(), cpus.size());
+        if (EE_OK != ret) {
+            Logger::log(ELL_ERROR, "Engine::funcPoolThread>>bind cpu fail, ret=%d", ret);
+        }
+    }
+}
+
+
+void Engine::sumEngineStats(EngineStats& out) {
+    out.clear();
+    EngineData* dat = reinterpret_cast<EngineData*>(mMapfile.getMem());
+    for (u32 i = 0; i < G_STATS_SLOT_COUNT; ++i) {
+        out.add(dat->mStats[i]);
+    }
+}
+
+
+void Engine::sumMemUsage(MemUsage& out, bool all) {
+    out.clear();
+    EngineData* dat = reinterpret_cast<EngineData*>(mMapfile.getMem());
+    const u32 cnt = all ? G_STATS_SLOT_COUNT : DMIN((u32)mConfig.mMaxLoop, G_STATS_SLOT_COUNT);
+    for (u32 i = 0; i < cnt; ++i) {
+        out.add(dat->mMemUsage[all ? i : getStatsIndex(i)]);
+    }
+}
+
+
+void Engine::logMemory() {
+    s8 tag[32];
+    snprintf(tag, sizeof(tag), "pid=%d, %s", mPID, mMain ? "all" : "child");
+    MemUsage sum;
+    sumMemUsage(sum, mMain); // the childs log themselves
+    MemAccount::log(tag, sum);
+    if (mMain) {
+        logShareMem();
+    }
+    BufferPool::logThread(tag);
+    HugePage::logStats(tag);
+}
+
+
+void Engine::logShareMem() {
+    for (u32 a = 0; a < mShareAllocator.getArenaCount(); ++a) {
+        MemSlabPool& mpool = *mShareAllocator.getArena(a);
+        u32 cnt = mpool.getStateCount();
+        for (u32 i = 0; i < cnt; i++) {
+            MemStat& mstat = *(mpool.getStats() + i);
+            if (mstat.mRequests > 0) {
+                Logger::log(ELL_INFO,
+                    "Engine::logShareMem>>share mem[%u][%u][used/total=%lu/%lu, req=%lu, fail=%lu], gen=%u", a, i,
+                    mstat.mUsed, mstat.mTotal, mstat.mRequests, mstat.mFails, mShareAllocator.getGeneration(a));
+            }
+        }
+    }
+}
+
+
 bool Engine::createProcess() {
     bool ret = true;
     mChild.resize(mConfig.mMaxProcess);
@@ -383,9 +739,24 @@ bool Engine::createProcess(usz idx) {
 #if defined(DOS_LINUX)
         if (0 == nd.mID) { // child
             mMain = false;
+            mProcIndex = (u32)idx + 1;
+            mShareAllocator.setArena(mProcIndex);
+            gThreadStats = nullptr;
+            // the slots may be left by a dead child, the heap is inherited from main process
+            for (u32 i = 0; i < mConfig.mMaxLoop; ++i) {
+                getMemUsageSlot(i).clear();
+            }
+            MemAccount::setDefaultSlot(&getMemUsageSlot(0));
             // pair.getSocketA().close();
             mPID = System::getPID();
             Logger::getInstance().setPID(mPID);
+            // keep the inherited listeners of own worker slots only
+            closeInherited(0, getWorkerSlot(0));
+            closeInherited(getWorkerSlot(mConfig.mMaxLoop), 0xFFFFFFFF);
+            if (mUpgradeReady >= 0) {
+                ::close(mUpgradeReady);
+                mUpgradeReady = -1;
+            }
             runChildProcess(pair.getSocketB(), pair.getSocketA());
             return true;
         } else {
@@ -413,6 +784,354 @@ bool Engine::createProcess(usz idx) {
 }
 
 
+net::netsocket Engine::takeListener(const s8* addr) {
+    std::lock_guard<std::mutex> ak(mListenMutex);
+    const u32 slot = getWorkerSlot(getLoopIndex());
+    for (usz i = 0; i < mInherited.size(); ++i) {
+        if (slot == mInherited[i].mInfo.mSlot && 0 == strcmp(addr, mInherited[i].mInfo.mAddr)) {
+            net::netsocket ret = mInherited[i].mSock;
+            mInherited.erase(i);
+            Logger::log(ELL_INFO, "Engine::takeListener>>addr=%s, slot=%u, sock=%d", addr, slot, (s32)ret);
+            return ret;
+        }
+    }
+    return DINVALID_SOCKET;
+}
+
+
+void Engine::addListener(net::HandleTCP* it) {
+    Listener nd;
+    nd.mHandle = it;
+    nd.mSlot = getWorkerSlot(getLoopIndex());
+    std::lock_guard<std::mutex> ak(mListenMutex);
+    mListeners.pushBack(nd);
+}
+
+
+void Engine::removeListener(net::HandleTCP* it) {
+    std::lock_guard<std::mutex> ak(mListenMutex);
+    for (usz i = 0; i < mListeners.size(); ++i) {
+        if (it == mListeners[i].mHandle) {
+            mListeners.quickErase(i);
+            return;
+        }
+    }
+}
+
+
+void Engine::closeInherited(u32 first, u32 last) {
+    std::lock_guard<std::mutex> ak(mListenMutex);
+    for (usz i = 0; i < mInherited.size();) {
+        ListenerFD& nd = mInherited[i];
+        if (nd.mInfo.mSlot >= first && nd.mInfo.mSlot < last) {
+            net::Socket sock(nd.mSock);
+            sock.close();
+            mInherited.erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+static const s8* G_ENV_LISTENERS = "ANT_LISTENERS"; // "fd,slot,addr;fd,slot,addr"
+static const s8* G_ENV_READY = "ANT_UPGRADE_READY";
+static const s32 G_UPGRADE_WAIT = 30 * 1000; // max time of the new process to init, in milliseconds
+
+
+/**
+ * @brief ask a child for it's listeners, the reply carries dups of them by SCM_RIGHTS.
+ * @return true if success.
+ */
+static bool AppRecvListeners(Process& proc, TVector<s32>& socks, TVector<ListenerInfo>& infos) {
+    CommandUpgrade cmd;
+    cmd.pack(1);
+    if (sizeof(cmd) != proc.mSocket.sendAll(&cmd, sizeof(cmd))) {
+        return false;
+    }
+    CommandUpgradeResp resp;
+    s32 fds[G_MAX_HANDOFF];
+    s32 nfds = 0;
+    u32 got = 0;
+    const s64 deadline = Timer::getTime() + 5000;
+    while (got < sizeof(MsgHeader) || got < resp.mSize) {
+        struct pollfd pfd;
+        pfd.fd = proc.mSocket.getValue();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        s64 wait = deadline - Timer::getTime();
+        if (wait <= 0 || ::poll(&pfd, 1, (s32)wait) < 0) {
+            if (wait > 0 && EINTR == errno) {
+                continue;
+            }
+            break;
+        }
+        s32 cnt = (s32)G_MAX_HANDOFF - nfds;
+        s32 ret = proc.mSocket.receiveFDs((s8*)&resp + got, (s32)(sizeof(resp) - got), fds + nfds, cnt);
+        if (ret <= 0) {
+            if (ret < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                continue;
+            }
+            break;
+        }
+        nfds += cnt;
+        got += ret;
+    }
+    bool ret = got >= sizeof(MsgHeader) && got == resp.mSize && ECT_UPGRADE_RESP == resp.mType
+               && (u32)nfds == resp.mCount;
+    for (s32 i = 0; i < nfds; ++i) {
+        if (ret) {
+            socks.pushBack(fds[i]);
+            infos.pushBack(resp.mListener[i]);
+        } else {
+            ::close(fds[i]);
+        }
+    }
+    Logger::log(ret ? ELL_INFO : ELL_ERROR, "AppRecvListeners>>pid=%d, listeners=%d, got=%u", proc.mID, nfds, got);
+    return ret;
+}
+#endif
+
+
+void Engine::upgrade(void* it) {
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    TVector<s32> socks(G_MAX_HANDOFF);
+    TVector<ListenerInfo> infos(G_MAX_HANDOFF);
+    if (0 == mChild.size()) {
+        std::lock_guard<std::mutex> ak(mListenMutex);
+        for (usz i = 0; i < mListeners.size() && socks.size() < G_MAX_HANDOFF; ++i) {
+            s32 fd = ::dup(mListeners[i].mHandle->getSock().getValue());
+            if (fd >= 0) {
+                ListenerInfo info;
+                info.mSlot = mListeners[i].mSlot;
+                snprintf(info.mAddr, sizeof(info.mAddr), "%s", mListeners[i].mHandle->getLocal().getStr());
+                socks.pushBack(fd);
+                infos.pushBack(info);
+            }
+        }
+    } else {
+        std::lock_guard<std::recursive_mutex> ak(mChildMutex);
+        for (usz i = 0; i < mChild.size(); ++i) {
+            if (mChild[i].mAlive && !AppRecvListeners(mChild[i], socks, infos)) {
+                Logger::log(ELL_ERROR, "Engine::upgrade>>fail to get listeners of child[%lu], pid=%d", i,
+                    mChild[i].mID);
+            }
+        }
+    }
+
+    TVector<String> envs;
+    String env(G_ENV_LISTENERS);
+    env += '=';
+    s8 tmp[128];
+    for (usz i = 0; i < socks.size(); ++i) {
+        snprintf(tmp, sizeof(tmp), "%s%d,%u,%s", 0 == i ? "" : ";", socks[i], infos[i].mSlot, infos[i].mAddr);
+        env += tmp;
+    }
+    envs.pushBack(env);
+    s32 ready[2];
+    if (0 != ::pipe2(ready, O_CLOEXEC)) {
+        ready[0] = -1;
+        ready[1] = -1;
+    }
+    snprintf(tmp, sizeof(tmp), "%s=%d", G_ENV_READY, ready[1]);
+    envs.pushBack(tmp);
+    TVector<s32> keep(socks);
+    keep.pushBack(ready[1]);
+
+    // file backed shared mem: old workers keep the renamed one, the new process creates it's own
+    const bool mapfile = App4Char2S32("GMEM") != App4Char2S32(mConfig.mMemName.c_str());
+    String oldmem = mConfig.mMemName;
+    oldmem += '.';
+    oldmem += mPID;
+    if (mapfile && 0 != ::rename(mConfig.mMemName.c_str(), oldmem.c_str())) {
+        Logger::log(ELL_ERROR, "Engine::upgrade>>rename %s fail, ecode=%d", mConfig.mMemName.c_str(),
+            System::getError());
+    }
+
+    s32 pid = ready[0] >= 0 ? System::spawnProcess(mAppPath + mAppName, keep, envs) : -1;
+    ::close(ready[1]);
+    for (usz i = 0; i < socks.size(); ++i) {
+        ::close(socks[i]);
+    }
+    bool ret = false;
+    if (pid > 0) {
+        struct pollfd pfd;
+        pfd.fd = ready[0];
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        s8 ch = 0;
+        s32 cnt;
+        while ((cnt = ::poll(&pfd, 1, G_UPGRADE_WAIT)) < 0 && EINTR == errno) {
+        }
+        // EOF if the new process failed to exec or init
+        ret = cnt > 0 && 1 == ::read(ready[0], &ch, 1) && 'R' == ch;
+    }
+    if (ready[0] >= 0) {
+        ::close(ready[0]);
+    }
+    if (!ret) {
+        Logger::log(ELL_ERROR, "Engine::upgrade>>fail, file=%s%s, pid=%d, listeners=%lu", mAppPath.c_str(),
+            mAppName.c_str(), pid, socks.size());
+        if (pid > 0) {
+            ::kill(pid, SIGTERM);
+        }
+        if (mapfile) {
+            ::rename(oldmem.c_str(), mConfig.mMemName.c_str());
+        }
+        mUpgradePID = 0;
+        return;
+    }
+    Logger::log(ELL_INFO, "Engine::upgrade>>success, new pid=%d, listeners=%lu, drain...", pid, socks.size());
+    mUpgradePID = pid;
+    if (0 == mChild.size()) {
+        for (u32 i = 0; i < getLoopCount(); ++i) {
+            getLoop(i).postTask(&Engine::drainLoop, this, static_cast<void*>(nullptr));
+        }
+    } else {
+        CommandUpgrade cmd;
+        cmd.pack(2);
+        std::lock_guard<std::recursive_mutex> ak(mChildMutex);
+        for (usz i = 0; i < mChild.size(); ++i) {
+            if (mChild[i].mAlive && sizeof(cmd) != mChild[i].mSocket.sendAll(&cmd, sizeof(cmd))) {
+                Logger::log(ELL_ERROR, "Engine::upgrade>>fail to drain child[%lu], pid=%d", i, mChild[i].mID);
+            }
+        }
+    }
+#else
+    Logger::log(ELL_ERROR, "Engine::upgrade>>unsupported");
+    mUpgradePID = 0;
+#endif
+}
+
+
+void Engine::onUpgrade(const CommandUpgrade& cmd, net::Socket& sock) {
+    Logger::log(ELL_INFO, "Engine::onUpgrade>>pid=%d, step=%u", mPID, cmd.mStep);
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    if (1 == cmd.mStep) {
+        CommandUpgradeResp resp;
+        s32 fds[G_MAX_HANDOFF];
+        // hold the lock until sent, so no listener closed by other loops
+        std::lock_guard<std::mutex> ak(mListenMutex);
+        const u32 cnt = (u32)(mListeners.size() < G_MAX_HANDOFF ? mListeners.size() : G_MAX_HANDOFF);
+        resp.pack(cmd.mSN, cnt);
+        for (u32 i = 0; i < cnt; ++i) {
+            fds[i] = mListeners[i].mHandle->getSock().getValue();
+            resp.mListener[i].mSlot = mListeners[i].mSlot;
+            snprintf(resp.mListener[i].mAddr, sizeof(resp.mListener[i].mAddr), "%s",
+                mListeners[i].mHandle->getLocal().getStr());
+        }
+        if ((s32)resp.mSize != sock.sendFDs(&resp, resp.mSize, fds, (s32)cnt)) {
+            Logger::log(ELL_ERROR, "Engine::onUpgrade>>send listeners fail, ecode=%d", System::getError());
+        }
+    } else if (2 == cmd.mStep) {
+        for (u32 i = 0; i < getLoopCount(); ++i) {
+            getLoop(i).postTask(&Engine::drainLoop, this, static_cast<void*>(nullptr));
+        }
+    }
+#endif
+}
+
+
+void Engine::initInherited() {
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    const s8* ready = getenv(G_ENV_READY);
+    if (ready) {
+        mUpgradeReady = App10StrToS32(ready);
+        ::unsetenv(G_ENV_READY);
+    }
+    const s8* env = getenv(G_ENV_LISTENERS);
+    if (!env) {
+        return;
+    }
+    std::lock_guard<std::mutex> ak(mListenMutex);
+    for (const s8* pos = env; *pos;) {
+        const s8* end = strchr(pos, ';');
+        usz len = end ? end - pos : strlen(pos);
+        s8 item[128];
+        snprintf(item, sizeof(item), "%.*s", (s32)len, pos);
+        ListenerFD nd;
+        s32 fd = -1;
+        s32 offset = 0;
+        if (2 == sscanf(item, "%d,%u,%n", &fd, &nd.mInfo.mSlot, &offset) && offset > 0 && fd >= 0) {
+            nd.mSock = fd;
+            snprintf(nd.mInfo.mAddr, sizeof(nd.mInfo.mAddr), "%s", item + offset);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+            mInherited.pushBack(nd);
+        }
+        pos += end ? len + 1 : len;
+    }
+    ::unsetenv(G_ENV_LISTENERS);
+    Logger::log(ELL_INFO, "Engine::initInherited>>listeners=%lu, ready=%d", mInherited.size(), mUpgradeReady);
+    // the config changed, drop the listeners of none worker slots
+    const u32 workers = (mConfig.mMaxProcess > 0 ? mConfig.mMaxProcess : 1) * mConfig.mMaxLoop;
+    for (usz i = 0; i < mInherited.size();) {
+        if (mInherited[i].mInfo.mSlot >= workers) {
+            ::close(mInherited[i].mSock);
+            mInherited.erase(i);
+        } else {
+            ++i;
+        }
+    }
+#endif
+}
+
+
+/**
+ * @brief timer of a draining loop, @see Engine::drainLoop()
+ */
+class EngineDrain : public HandleTime {
+public:
+    s64 mDeadline;
+};
+
+
+void Engine::drainLoop(void* it) {
+    Loop& loop = getLoop();
+    TVector<net::HandleTCP*> mine(8);
+    {
+        std::lock_guard<std::mutex> ak(mListenMutex);
+        for (usz i = 0; i < mListeners.size(); ++i) {
+            if (&loop == mListeners[i].mHandle->getLoop()) {
+                mine.pushBack(mListeners[i].mHandle);
+            }
+        }
+    }
+    for (usz i = 0; i < mine.size(); ++i) {
+        mine[i]->launchHandoff();
+    }
+    EngineDrain* nd = new EngineDrain();
+    nd->mDeadline = Timer::getTime() + 1000LL * mConfig.mUpgradeDrain;
+    nd->setClose(EHT_TIME, Engine::funcOnDrainClose, this);
+    nd->setTime(Engine::funcOnDrain, 100, 200, -1);
+    if (EE_OK != loop.openHandle(nd)) {
+        delete nd;
+    }
+    Logger::log(ELL_INFO, "Engine::drainLoop>>pid=%d, loop=%u, listeners=%lu, links=%d", mPID, getLoopIndex(),
+        mine.size(), loop.getLinkCount());
+}
+
+
+s32 Engine::funcOnDrain(HandleTime* it) {
+    EngineDrain* nd = static_cast<EngineDrain*>(it);
+    const s32 links = it->getLoop()->getLinkCount();
+    if (links > 0 && Timer::getTime() < nd->mDeadline) {
+        return EE_OK;
+    }
+    Engine& eng = *reinterpret_cast<Engine*>(it->getUser());
+    Logger::log(ELL_INFO, "Engine::funcOnDrain>>pid=%d, loop=%u, links=%d", eng.mPID, eng.getLoopIndex(), links);
+    if (++eng.mDrainedLoops == eng.getLoopCount()) {
+        eng.postCommand(ECT_EXIT);
+    }
+    return EE_ERROR; // close the timer
+}
+
+
+void Engine::funcOnDrainClose(Handle* it) {
+    delete static_cast<EngineDrain*>(it);
+}
+
+
 void Engine::initTask(void* it) {
     Logger::log(ELL_INFO, "The default task do nothing, pid = %d", getPID());
 }
@@ -58,7 +58,12 @@ static DictFunctions gDictCalls
 
 
 EngineConfig::EngineConfig() :
-    mDaemon(false), mPrint(1), mMaxPostAccept(10), mMaxThread(3), mMaxProcess(0), mMemSize(1024 * 1024 * 1),
+    mDaemon(false), mURingNet(false), mNumaBind(false), mPrint(1), mMaxPostAccept(10), mMaxThread(3), mMaxProcess(0), mHugePage(0), mMaxLoop(1), mListenSteer(0),
+    mURingBufCount(0), mURingBufSize(4 * 1024), mLoopStats(0), mBusyPoll(0), mBusyPollSock(0),
+    mFairHandleBytes(0), mFairHandleReqs(0), mFairStepBytes(0), mFairStepReqs(0),
+    mUpgradeDrain(60),
+    mMemSize(1024 * 1024 * 1), mBufPoolCache(8 * 1024 * 1024), mBufPoolHuge(0),
+    mHugePageArena(256 * 1024 * 1024),
     mLogPath("Log/"), mPidFile("Log/PID.txt"), mMemName("GMAP/MainMem.map") {
     // memset(this, 0, sizeof(*this));
 
@@ -87,6 +92,27 @@ bool EngineConfig::save(const String& cfg) {
     val["AcceptPost"] = mMaxPostAccept;
     val["ThreadPool"] = mMaxThread;
     val["Process"] = mMaxProcess;
+    val["Loop"] = mMaxLoop;
+    val["ListenSteer"] = mListenSteer;
+    val["IOURingNet"] = mURingNet;
+    val["IOURingBufCount"] = mURingBufCount;
+    val["IOURingBufSize"] = mURingBufSize / 1024;
+    val["LoopStats"] = mLoopStats;
+    val["BusyPoll"] = mBusyPoll;
+    val["BusyPollSock"] = mBusyPollSock;
+    val["FairHandleKB"] = mFairHandleBytes / 1024;
+    val["FairHandleReq"] = mFairHandleReqs;
+    val["FairStepKB"] = mFairStepBytes / 1024;
+    val["FairStepReq"] = mFairStepReqs;
+    val["CpuLoop"] = mCpuLoop.c_str();
+    val["CpuPool"] = mCpuPool.c_str();
+    val["CpuSkip"] = mCpuSkip.c_str();
+    val["NumaBind"] = mNumaBind;
+    val["UpgradeDrain"] = mUpgradeDrain;
+    val["BufPoolKB"] = (Json::Value::UInt64)mBufPoolCache / 1024;
+    val["BufPoolHugeMB"] = (Json::Value::UInt64)mBufPoolHuge / (1024 * 1024);
+    val["HugePage"] = mHugePage;
+    val["HugePageMB"] = (Json::Value::UInt64)mHugePageArena / (1024 * 1024);
 
     Json::StreamWriterBuilder builder;
     builder["emitUTF8"] = true;
@@ -178,9 +204,166 @@ bool EngineConfig::load(const String& runPath, const String& cfg, bool mainProce
     mMaxPostAccept = AppClamp<u8>(val["AcceptPost"].asInt(), 1, 255);
     mMaxThread = AppClamp<u8>(val["ThreadPool"].asInt(), 1, 255);
     mMaxProcess = AppClamp<s16>(val["Process"].asInt(), -1024, 1024);
+    if (val.isMember("Loop")) {
+        mMaxLoop = AppClamp<u8>(val["Loop"].asInt(), 1, 64);
+    }
+    if (val.isMember("ListenSteer")) {
+        mListenSteer = AppClamp<u8>(val["ListenSteer"].asInt(), 0, 2);
+    }
+    if (val.isMember("IOURingNet")) {
+        mURingNet = val["IOURingNet"].asBool();
+    }
+    if (val.isMember("IOURingBufCount")) {
+        mURingBufCount = AppClamp<u32>(val["IOURingBufCount"].asUInt(), 0, 32768);
+    }
+    if (val.isMember("IOURingBufSize")) {
+        mURingBufSize = 1024 * AppClamp<u32>(val["IOURingBufSize"].asUInt(), 1, 64);
+    }
+    if (val.isMember("LoopStats")) {
+        mLoopStats = AppClamp<u32>(val["LoopStats"].asUInt(), 0, 60 * 1000 * 1000);
+    }
+    if (val.isMember("BusyPoll")) {
+        mBusyPoll = AppClamp<u32>(val["BusyPoll"].asUInt(), 0, 1000 * 1000);
+    }
+    if (val.isMember("BusyPollSock")) {
+        mBusyPollSock = AppClamp<u32>(val["BusyPollSock"].asUInt(), 0, 1000 * 1000);
+    }
+    if (val.isMember("FairHandleKB")) {
+        mFairHandleBytes = 1024 * AppClamp<u32>(val["FairHandleKB"].asUInt(), 0, 1024 * 1024);
+    }
+    if (val.isMember("FairHandleReq")) {
+        mFairHandleReqs = AppClamp<u32>(val["FairHandleReq"].asUInt(), 0, 1000 * 1000);
+    }
+    if (val.isMember("FairStepKB")) {
+        mFairStepBytes = 1024 * AppClamp<u32>(val["FairStepKB"].asUInt(), 0, 1024 * 1024);
+    }
+    if (val.isMember("FairStepReq")) {
+        mFairStepReqs = AppClamp<u32>(val["FairStepReq"].asUInt(), 0, 1000 * 1000);
+    }
+    if (val.isMember("CpuLoop")) {
+        mCpuLoop = val["CpuLoop"].asCString();
+    }
+    if (val.isMember("CpuPool")) {
+        mCpuPool = val["CpuPool"].asCString();
+    }
+    if (val.isMember("CpuSkip")) {
+        mCpuSkip = val["CpuSkip"].asCString();
+    }
+    if (val.isMember("NumaBind")) {
+        mNumaBind = val["NumaBind"].asBool();
+    }
+    if (val.isMember("UpgradeDrain")) {
+        mUpgradeDrain = AppClamp<u32>(val["UpgradeDrain"].asUInt(), 1, 24 * 3600);
+    }
+    if (val.isMember("BufPoolKB")) {
+        mBufPoolCache = 1024ULL * AppClamp<u64>(val["BufPoolKB"].asUInt64(), 0, 1024 * 1024);
+    }
+    if (val.isMember("BufPoolHugeMB")) {
+        mBufPoolHuge = 1024ULL * 1024 * AppClamp<u64>(val["BufPoolHugeMB"].asUInt64(), 0, 64 * 1024);
+    }
+    if (val.isMember("HugePage")) {
+        mHugePage = AppClamp<u8>(val["HugePage"].asUInt(), 0, 2);
+    }
+    if (val.isMember("HugePageMB")) {
+        mHugePageArena = 1024ULL * 1024 * AppClamp<u64>(val["HugePageMB"].asUInt64(), 0, 64 * 1024);
+    }
+    initCPUs();
     func_loadtls(val, mEngTlsConfig);
     return ret;
 }
 
 
+void EngineConfig::initCPUs() {
+    mLoopCPUs.resize(0);
+    mPoolCPUs.resize(0);
+    const bool autoLoop = mCpuLoop == "auto";
+    const bool autoPool = mCpuPool == "auto";
+    if (!autoLoop) {
+        System::parseCpuList(mCpuLoop.c_str(), mLoopCPUs);
+    }
+    if (!autoPool) {
+        System::parseCpuList(mCpuPool.c_str(), mPoolCPUs);
+    }
+    if (!autoLoop && !autoPool) {
+        return;
+    }
+
+    TVector<u16> skip;
+    System::parseCpuList(mCpuSkip.c_str(), skip);
+    TVector<CpuInfo> all;
+    System::getCpuInfo(all);
+    u32 nodes = 0;
+    for (usz i = 0; i < all.size(); ++i) {
+        for (usz k = 0; k < skip.size(); ++k) {
+            if (skip[k] == all[i].mID) {
+                all.erase(i--);
+                break;
+            }
+        }
+    }
+    for (usz i = 0; i < all.size(); ++i) {
+        nodes = DMAX(nodes, all[i].mNode + 1U);
+    }
+    if (0 == all.size()) {
+        Logger::log(ELL_ERROR, "EngineConfig::initCPUs>>no cpu left, skip=%s", mCpuSkip.c_str());
+        return;
+    }
+
+    // 按节点分组, 组内物理核在前, SMT兄弟线程在后
+    TVector<u16> order(all.size());
+    TVector<usz> nodeBegin(nodes + 1);
+    for (u32 n = 0; n < nodes; ++n) {
+        nodeBegin.pushBack(order.size());
+        for (u32 pass = 0; pass < 2; ++pass) {
+            for (usz i = 0; i < all.size(); ++i) {
+                if (n == all[i].mNode && (0 == pass) == (all[i].mCore == all[i].mID)) {
+                    order.pushBack(all[i].mID);
+                }
+            }
+        }
+    }
+    nodeBegin.pushBack(order.size());
+
+    TVector<u16> used;
+    if (autoLoop) {
+        // 每个进程的事件循环放在同一节点上, 进程间轮流使用各节点
+        const u32 procs = mMaxProcess > 0 ? mMaxProcess : 1;
+        TVector<usz> cursor(nodes);
+        cursor.resize(nodes);
+        for (u32 n = 0; n < nodes; ++n) {
+            cursor[n] = 0;
+        }
+        u32 node = 0;
+        for (u32 p = 0; p < procs; ++p) {
+            while (nodeBegin[node] == nodeBegin[node + 1]) { // skip empty node
+                node = (node + 1) % nodes;
+            }
+            const usz cnt = nodeBegin[node + 1] - nodeBegin[node];
+            for (u32 l = 0; l < mMaxLoop; ++l) {
+                u16 cpu = order[nodeBegin[node] + cursor[node]++ % cnt];
+                mLoopCPUs.pushBack(cpu);
+                used.pushBack(cpu);
+            }
+            node = (node + 1) % nodes;
+        }
+    } else {
+        for (usz i = 0; i < mLoopCPUs.size(); ++i) {
+            used.pushBack(mLoopCPUs[i]);
+        }
+    }
+    if (autoPool) {
+        // 线程池使用事件循环剩下的cpu, 没有剩余则不绑定
+        for (usz i = 0; i < order.size(); ++i) {
+            bool hit = false;
+            for (usz k = 0; k < used.size() && !hit; ++k) {
+                hit = used[k] == order[i];
+            }
+            if (!hit) {
+                mPoolCPUs.pushBack(order[i]);
+            }
+        }
+    }
+}
+
+
 } // namespace app
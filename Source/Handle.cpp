@@ -32,6 +32,11 @@ s32 Handle::launchClose() {
     return mLoop->closeHandle(this);
 }
 
+s32 Handle::launchHandoff() {
+    mFlag |= EHF_HANDOFF;
+    return launchClose();
+}
+
 #if defined(DOS_ANDROID) || defined(DOS_LINUX)
 #include "Linux/Request.h"
 
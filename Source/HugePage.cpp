@@ -0,0 +1,386 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#include "HugePage.h"
+#include "Spinlock.h"
+#include "ThreadLocal.h"
+#include "Logger.h"
+#include <stdio.h>
+#include <string.h>
+#if defined(DOS_WINDOWS)
+#include <Windows.h>
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+#include <errno.h>
+#include <sys/mman.h>
+#endif
+
+namespace app {
+
+s32 HugePage::gMode = EHPM_OFF;
+s8* HugePage::gArena = nullptr;
+s8* HugePage::gArenaEnd = nullptr;
+HugePageStats HugePage::gStats;
+
+// pieces of same size are linked in a free list, pieces of other sizes fallback to heap if table is full
+static const s32 G_PIECE_CLASS_MAX = 32;
+static const usz G_PIECE_BATCH = 64 * 1024; // bytes moved between a thread cache and the global lists at once
+struct PieceList {
+    usz mSize;
+    void* mHead;
+};
+static PieceList gPieces[G_PIECE_CLASS_MAX];
+static std::atomic<s32> gPieceCount(0); // the classes are added only, mSize is read without lock
+static s8* gArenaPos = nullptr;         // next piece
+static s8* gArenaMapped = nullptr;      // end of refilled chunks
+static Spinlock gPieceLock;             // guards gPieces[].mHead and the arena
+
+// free pieces cached by a thread, so the global lock is taken once per batch, @see ThreadLocal
+struct PieceCache {
+    void* mHead[G_PIECE_CLASS_MAX];
+    u32 mCount[G_PIECE_CLASS_MAX];
+    PieceCache();
+    ~PieceCache();
+};
+
+
+// @return count of pieces moved at once, a thread caches 2 batches at most
+static u32 getPieceBatch(usz size) {
+    return size >= G_PIECE_BATCH ? 1 : (u32)(G_PIECE_BATCH / size);
+}
+
+
+static s32 findPiece(usz size) {
+    const s32 cnt = gPieceCount.load(std::memory_order_acquire);
+    for (s32 i = 0; i < cnt; ++i) {
+        if (gPieces[i].mSize == size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+// give back the pieces except the newest \p keep ones
+static void flushPieces(PieceCache& it, s32 idx, u32 keep) {
+    if (it.mCount[idx] <= keep) {
+        return;
+    }
+    void** link = &it.mHead[idx];
+    for (u32 i = 0; i < keep; ++i) {
+        link = (void**)*link;
+    }
+    void* first = *link;
+    void* last = first;
+    while (*(void**)last) {
+        last = *(void**)last;
+    }
+    *link = nullptr;
+    it.mCount[idx] = keep;
+    gPieceLock.lock();
+    *(void**)last = gPieces[idx].mHead;
+    gPieces[idx].mHead = first;
+    gPieceLock.unlock();
+}
+
+
+PieceCache::PieceCache() {
+    memset(mHead, 0, sizeof(mHead));
+    memset(mCount, 0, sizeof(mCount));
+}
+
+
+PieceCache::~PieceCache() {
+    for (s32 i = 0; i < G_PIECE_CLASS_MAX; ++i) {
+        flushPieces(*this, i, 0);
+    }
+}
+
+
+void HugePage::init(s32 mode, usz arena) {
+    if (gArena) {
+        return;
+    }
+    gMode = mode;
+    if (EHPM_OFF == mode || 0 == arena) {
+        return;
+    }
+    arena = roundSize(arena);
+#if defined(DOS_WINDOWS)
+    // large pages can't be committed partially, so the arena is committed by normal pages
+    gArena = (s8*)VirtualAlloc(nullptr, arena, MEM_RESERVE, PAGE_READWRITE);
+    if (!gArena) {
+        Logger::log(ELL_ERROR, "HugePage::init>>reserve arena = %llu, ecode=%d", (u64)arena, (s32)GetLastError());
+        return;
+    }
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+    // reserve only, chunks are mapped by refill()
+    s8* raw = (s8*)mmap(nullptr, arena + G_CHUNK_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (MAP_FAILED == (void*)raw) {
+        Logger::log(ELL_ERROR, "HugePage::init>>reserve arena = %llu, ecode=%d", (u64)arena, errno);
+        return;
+    }
+    gArena = AppAlignPoint(raw, G_CHUNK_SIZE);
+    if (gArena > raw) {
+        munmap(raw, gArena - raw);
+    }
+    munmap(gArena + arena, raw + G_CHUNK_SIZE - gArena);
+#else
+    return;
+#endif
+    gArenaEnd = gArena + arena;
+    gArenaPos = gArena;
+    gArenaMapped = gArena;
+}
+
+
+void* HugePage::mapMem(usz& size, bool shared, s32 mode) {
+    if (mode < 0) {
+        mode = gMode;
+    }
+    if (EHPM_OFF != mode) {
+        size = roundSize(size);
+    }
+#if defined(DOS_WINDOWS)
+    void* mem = nullptr;
+    if (EHPM_HUGETLB == mode && !shared) {
+        usz lpage = GetLargePageMinimum();
+        if (lpage > 0 && 0 == size % lpage) {
+            // need SeLockMemoryPrivilege
+            mem = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        }
+        if (mem) {
+            gStats.mTLBBytes += size;
+            return mem;
+        }
+        ++gStats.mTLBFails;
+    }
+    mem = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!mem) {
+        Logger::log(ELL_ERROR, "HugePage::mapMem>>size = %llu, ecode=%d", (u64)size, (s32)GetLastError());
+    }
+    return mem;
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+    s32 flag = (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_ANONYMOUS;
+    void* mem;
+    if (EHPM_HUGETLB == mode) {
+        mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, flag | MAP_HUGETLB, -1, 0);
+        if (MAP_FAILED != mem) {
+            gStats.mTLBBytes += size;
+            return mem;
+        }
+        ++gStats.mTLBFails;
+    }
+    if (EHPM_OFF == mode) {
+        mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, flag, -1, 0);
+        if (MAP_FAILED == mem) {
+            Logger::log(ELL_ERROR, "HugePage::mapMem>>size = %llu, ecode=%d", (u64)size, errno);
+            return nullptr;
+        }
+        return mem;
+    }
+    // THP needs 2MB aligned address, map one more chunk then trim
+    s8* raw = (s8*)mmap(nullptr, size + G_CHUNK_SIZE, PROT_READ | PROT_WRITE, flag, -1, 0);
+    if (MAP_FAILED == (void*)raw) {
+        Logger::log(ELL_ERROR, "HugePage::mapMem>>size = %llu, ecode=%d", (u64)size, errno);
+        return nullptr;
+    }
+    s8* pos = AppAlignPoint(raw, G_CHUNK_SIZE);
+    if (pos > raw) {
+        munmap(raw, pos - raw);
+    }
+    munmap(pos + size, raw + G_CHUNK_SIZE - pos);
+    adviseMem(pos, size);
+    return pos;
+#else
+    return nullptr;
+#endif
+}
+
+
+void HugePage::unmapMem(void* mem, usz size) {
+    if (!mem) {
+        return;
+    }
+#if defined(DOS_WINDOWS)
+    VirtualFree(mem, 0, MEM_RELEASE);
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+    munmap(mem, size);
+#endif
+}
+
+
+void HugePage::adviseMem(void* mem, usz size) {
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    if (0 == madvise(mem, size, MADV_HUGEPAGE)) {
+        gStats.mTHPBytes += size;
+    }
+#endif
+}
+
+
+bool HugePage::refill(s8* end) {
+    while (gArenaMapped < end) {
+        if (gArenaMapped + G_CHUNK_SIZE > gArenaEnd) {
+            return false;
+        }
+#if defined(DOS_WINDOWS)
+        if (!VirtualAlloc(gArenaMapped, G_CHUNK_SIZE, MEM_COMMIT, PAGE_READWRITE)) {
+            return false;
+        }
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+        bool tlb = false;
+        if (EHPM_HUGETLB == gMode) {
+            tlb = MAP_FAILED != mmap(gArenaMapped, G_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+            if (tlb) {
+                gStats.mTLBBytes += G_CHUNK_SIZE;
+            } else {
+                ++gStats.mTLBFails;
+            }
+        }
+        // remap the range, it may be unmapped by the failed MAP_HUGETLB
+        if (!tlb) {
+            if (MAP_FAILED == mmap(gArenaMapped, G_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0)) {
+                return false;
+            }
+            adviseMem(gArenaMapped, G_CHUNK_SIZE);
+        }
+#endif
+        gArenaMapped += G_CHUNK_SIZE;
+        gStats.mPieceTotal += G_CHUNK_SIZE;
+    }
+    return true;
+}
+
+
+void* HugePage::allocPiece(usz size) {
+    if (!gArena) {
+        return nullptr;
+    }
+    size = AppAlignSize(size, 64);
+    void* ret = nullptr;
+    PieceCache* cache = ThreadLocal<PieceCache>::get();
+    s32 i = findPiece(size);
+    if (cache && i >= 0 && cache->mHead[i]) {
+        ret = cache->mHead[i];
+        cache->mHead[i] = *(void**)ret;
+        --cache->mCount[i];
+        gStats.mPieceUsed += size;
+        return ret;
+    }
+    gPieceLock.lock();
+    if (i < 0) {
+        i = findPiece(size); // may be added by other thread
+        const s32 cnt = gPieceCount.load(std::memory_order_relaxed);
+        if (i < 0 && cnt < G_PIECE_CLASS_MAX) {
+            i = cnt;
+            gPieces[i].mSize = size;
+            gPieces[i].mHead = nullptr;
+            gPieceCount.store(cnt + 1, std::memory_order_release);
+        }
+    }
+    // take a batch, from the free list first, then from the arena
+    const u32 batch = (i >= 0 && cache) ? getPieceBatch(size) : 1;
+    for (u32 n = 0; i >= 0 && n < batch; ++n) {
+        void* nd = gPieces[i].mHead;
+        if (nd) {
+            gPieces[i].mHead = *(void**)nd;
+        } else if (refill(gArenaPos + size)) {
+            nd = gArenaPos;
+            gArenaPos += size;
+        } else {
+            break;
+        }
+        if (!ret) {
+            ret = nd;
+        } else {
+            *(void**)nd = cache->mHead[i];
+            cache->mHead[i] = nd;
+            ++cache->mCount[i];
+        }
+    }
+    gPieceLock.unlock();
+    if (ret) {
+        gStats.mPieceUsed += size;
+    }
+    return ret;
+}
+
+
+bool HugePage::releasePiece(void* mem, usz size) {
+    if (!isPiece(mem)) {
+        return false;
+    }
+    size = AppAlignSize(size, 64);
+    const s32 i = findPiece(size);
+    DASSERT(i >= 0);
+    gStats.mPieceUsed -= size;
+    PieceCache* cache = ThreadLocal<PieceCache>::get();
+    if (cache) {
+        *(void**)mem = cache->mHead[i];
+        cache->mHead[i] = mem;
+        const u32 batch = getPieceBatch(size);
+        if (++cache->mCount[i] > 2 * batch) {
+            flushPieces(*cache, i, batch);
+        }
+        return true;
+    }
+    gPieceLock.lock();
+    *(void**)mem = gPieces[i].mHead;
+    gPieces[i].mHead = mem;
+    gPieceLock.unlock();
+    return true;
+}
+
+
+void HugePage::logStats(const s8* tag) {
+    s64 anon = 0;
+    s64 tlb = 0;
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+    if (fp) {
+        s8 line[256];
+        s64 val;
+        while (fgets(line, sizeof(line), fp)) {
+            if (1 == sscanf(line, "AnonHugePages: %lld kB", &val)) {
+                anon += val;
+            } else if (1 == sscanf(line, "Shared_Hugetlb: %lld kB", &val)
+                || 1 == sscanf(line, "Private_Hugetlb: %lld kB", &val)) {
+                tlb += val;
+            }
+        }
+        fclose(fp);
+    }
+#endif
+    Logger::log(ELL_INFO,
+        "HugePage::logStats>>%s, mode=%d, hugetlb=%lldKB, thp=%lldKB, tlb_fail=%lld, piece=%lld/%lldKB, "
+        "in use[hugetlb=%lldKB, thp=%lldKB]",
+        tag, gMode, gStats.mTLBBytes.load() >> 10, gStats.mTHPBytes.load() >> 10, gStats.mTLBFails.load(),
+        gStats.mPieceUsed.load() >> 10, gStats.mPieceTotal.load() >> 10, tlb, anon);
+}
+
+} // namespace app
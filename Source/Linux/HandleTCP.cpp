@@ -98,6 +98,10 @@ s32 HandleTCP::accept(RequestAccept* it) {
     it->mHandle = this;
     it->mSocket.setInvalid();
 
+    if (ERF_MULTISHOT & it->mFlags) {
+        it->mError = 0;
+        return EE_OK; // still armed, the next link will come in same request
+    }
     if (0 == (EHF_READABLE & mFlag)) {
         it->mError = EE_NO_READABLE;
         return EE_NO_READABLE;
@@ -105,6 +109,12 @@ s32 HandleTCP::accept(RequestAccept* it) {
     it->mError = 0;
     mLoop->bindFly(this);
 
+    if (mLoop->isURingNet() && !mLoop->isURingMultishot()) {
+        // many accept SQEs can be in flight at the same time
+        mLoop->addPending(it);
+        return EE_OK;
+    }
+
     if (EHF_SYNC_READ & mFlag) {
         /* accept: Allow packets disorder
         if (mReadQueue) {
@@ -138,6 +148,11 @@ s32 HandleTCP::connect(RequestFD* it) {
     it->mError = 0;
     mLoop->bindFly(this);
 
+    if (mLoop->isURingNet()) {
+        mLoop->addPending(it); // IORING_OP_CONNECT
+        return EE_OK;
+    }
+
     if (EE_OK == mSock.connect(mRemote)) {
         // success right now
         mLoop->addPending(it);
@@ -160,6 +175,15 @@ s32 HandleTCP::read(RequestFD* it) {
     DASSERT(it);
     it->mType = ERT_READ;
     it->mHandle = this;
+    it->detachRingBuf();
+    if (ERF_MULTISHOT & it->mFlags) {
+        it->mError = 0;
+        return EE_OK; // still armed
+    }
+    if (0 == it->mAllocated && !mLoop->isURingMultishot()) {
+        it->mError = EE_INVALID_PARAM;
+        return EE_INVALID_PARAM;
+    }
     if (0 == (EHF_READABLE & mFlag)) {
         it->mError = EE_NO_READABLE;
         return EE_NO_READABLE;
@@ -196,6 +220,7 @@ s32 HandleTCP::write(RequestFD* it) {
 
     it->mError = 0;
     mLoop->bindFly(this);
+    mWater.add(it->mUsed);
 
     if (EHF_SYNC_WRITE & mFlag) {
         if (mWriteQueue) {
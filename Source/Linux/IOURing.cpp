@@ -27,8 +27,10 @@
 #include "System.h"
 #include "Net/Socket.h"
 #include "Logger.h"
+#include "HugePage.h"
 #include "Loop.h"
 #include "HandleFile.h"
+#include "Net/HandleUDP.h"
 
 #include <sys/epoll.h>
 #include <sys/mman.h>
@@ -62,6 +64,10 @@ const usz IORING_OFF_MMAP_MASK = 0xf8000000ULL;
 
 const u32 G_MAX_WAIT_REQ = 2000;
 
+const u32 IORING_REGISTER_PBUF_RING = 22;
+const u32 IORING_UNREGISTER_PBUF_RING = 23;
+const u32 G_MAX_RING_BUF = 32768;
+
 struct CQRingOffsets {
     u32 head;
     u32 tail;
@@ -114,6 +120,7 @@ struct URingSQE {
         u32 fsync_flags;
         u32 open_flags;
         u32 statx_flags;
+        u32 cancel_flags;
     };
     u64 user_data;
     union {
@@ -153,6 +160,28 @@ static_assert(40 == offsetof(URingParam, sq_off));
 static_assert(80 == offsetof(URingParam, cq_off));
 
 
+// entry of provided-buffer ring, the ring's tail overlap with resv of first entry
+struct URingBuf {
+    u64 addr;
+    u32 len;
+    u16 bid;
+    u16 resv;
+};
+
+static_assert(16 == sizeof(URingBuf));
+
+
+struct URingBufReg {
+    u64 ring_addr;
+    u32 ring_entries;
+    u16 bgid;
+    u16 flags;
+    u64 resv[3];
+};
+
+static_assert(40 == sizeof(URingBufReg));
+
+
 static s32 AppIOURing_setup(s32 entries, URingParam* params) {
     return syscall(__NR_io_uring_setup, entries, params);
 }
@@ -170,6 +199,109 @@ static s32 AppIOURing_register(s32 fd, u32 opcode, void* arg, u32 nargs) {
 }
 
 
+static void AppIOURing_prepFile(URingSQE* sqe, RequestFD* req) {
+    HandleFile* handle = reinterpret_cast<HandleFile*>(req->mHandle);
+    if (ERT_READ == req->mType) {
+        sqe->opcode = IORING_OP_READ;
+        sqe->addr = (u64)(req->mData + req->mUsed);
+        sqe->len = req->mAllocated - req->mUsed;
+    } else {
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->addr = (u64)(req->mData);
+        sqe->len = req->mUsed;
+    }
+    sqe->fd = handle->getHandle();
+    sqe->off = req->mOffset; // default set offset = -1
+}
+
+
+static void AppIOURing_prepNet(URingSQE* sqe, RequestFD* req, bool multishot) {
+    net::HandleTCP* handle = reinterpret_cast<net::HandleTCP*>(req->mHandle);
+    sqe->fd = (s32)handle->getSock().getValue();
+    switch (req->mType) {
+    case ERT_ACCEPT:
+    {
+        RequestAccept* nd = reinterpret_cast<RequestAccept*>(req);
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->rw_flags = SOCK_NONBLOCK | SOCK_CLOEXEC; // accept4() flags
+        if (multishot) {
+            // one SQE for all links, remote address will be got by getpeername()
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            nd->mFlags |= ERF_MULTISHOT;
+        } else {
+            nd->mAddrSize = nd->mRemote.getAddrSize();
+            sqe->addr = (u64)(nd->mRemote.getAddress6());
+            sqe->addr2 = (u64)(&nd->mAddrSize);
+        }
+        break;
+    }
+    case ERT_CONNECT:
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->addr = (u64)(handle->getRemote().getAddress6());
+        sqe->off = handle->getRemote().getAddrSize();
+        break;
+    case ERT_READ:
+        if (EHT_UDP == handle->getType() && 0 == (1 & reinterpret_cast<RequestUDP*>(req)->mFlags)) {
+            RequestUDP* nd = reinterpret_cast<RequestUDP*>(req);
+            nd->mVec.iov_base = nd->mData + nd->mUsed;
+            nd->mVec.iov_len = nd->mAllocated - nd->mUsed;
+            memset(&nd->mMsg, 0, sizeof(nd->mMsg));
+            nd->mMsg.msg_name = nd->mRemote.getAddress6();
+            nd->mMsg.msg_namelen = nd->mRemote.getAddrSize();
+            nd->mMsg.msg_iov = &nd->mVec;
+            nd->mMsg.msg_iovlen = 1;
+            sqe->opcode = IORING_OP_RECVMSG;
+            sqe->addr = (u64)(&nd->mMsg);
+            sqe->len = 1;
+        } else if (multishot && 0 == req->mAllocated) {
+            // no cache in request, the kernel pick a buffer from ring when data arrived
+            sqe->opcode = IORING_OP_RECV;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_index = 0; // buffer group ID
+            req->mFlags |= ERF_MULTISHOT;
+        } else {
+            sqe->opcode = IORING_OP_RECV;
+            sqe->addr = (u64)(req->mData + req->mUsed);
+            sqe->len = req->mAllocated - req->mUsed;
+        }
+        break;
+    case ERT_WRITE:
+        if (EHT_UDP == handle->getType() && 0 == (1 & reinterpret_cast<RequestUDP*>(req)->mFlags)) {
+            RequestUDP* nd = reinterpret_cast<RequestUDP*>(req);
+            nd->mVec.iov_base = nd->mData + nd->mStepSize;
+            nd->mVec.iov_len = nd->mUsed - nd->mStepSize;
+            memset(&nd->mMsg, 0, sizeof(nd->mMsg));
+            nd->mMsg.msg_name = nd->mRemote.getAddress6();
+            nd->mMsg.msg_namelen = nd->mRemote.getAddrSize();
+            nd->mMsg.msg_iov = &nd->mVec;
+            nd->mMsg.msg_iovlen = 1;
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = (u64)(&nd->mMsg);
+            sqe->len = 1;
+        } else if (ERF_IOV & req->mFlags) {
+            RequestIOV* nd = reinterpret_cast<RequestIOV*>(req);
+            memset(&nd->mMsg, 0, sizeof(nd->mMsg));
+            nd->mMsg.msg_iov = nd->mVecs;
+            nd->mMsg.msg_iovlen = nd->fillVec(nd->mVecs, RequestIOV::MAX_SLICE);
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = (u64)(&nd->mMsg);
+            sqe->len = 1;
+        } else {
+            sqe->opcode = IORING_OP_SEND;
+            sqe->addr = (u64)(req->mData + req->mStepSize);
+            sqe->len = req->mUsed - req->mStepSize;
+        }
+        sqe->rw_flags = MSG_NOSIGNAL;
+        break;
+    default:
+        DASSERT(0);
+        sqe->opcode = IORING_OP_NOP;
+        break;
+    }
+}
+
+
 IOURing::IOURing() {
     memset(this, 0, sizeof(*this));
     mRingFD = -1;
@@ -185,8 +317,8 @@ bool IOURing::open(s32 epollfd, u32 entries, u32 flags) {
     struct epoll_event evt;
     size_t cqlen;
     size_t sqlen;
-    size_t maxlen;
-    size_t sqelen;
+    size_t maxlen = 0; // mapped bytes of sq, set before sq mapped
+    size_t sqelen = 0; // mapped bytes of sqe, set before sqe mapped
     u32 i;
     s8* sq = (s8*)MAP_FAILED;
     s8* sqe = (s8*)MAP_FAILED;
@@ -200,8 +332,43 @@ bool IOURing::open(s32 epollfd, u32 entries, u32 flags) {
     if (flags & IORING_SETUP_SQPOLL)
         params.sq_thread_idle = 10; /* milliseconds */
 
+    /* IORING_SETUP_NO_MMAP(linux v6.5): the rings live in our huge pages, each must fit in one huge page.
+     * sq_off.user_addr=SQEs, cq_off.user_addr=SQ/CQ rings, retry without it if kernel refused.
+     */
+    const usz hlen = HugePage::G_CHUNK_SIZE;
+    s32 ringfd = -1;
+    if (EHPM_HUGETLB == HugePage::getMode() && entries * sizeof(URingSQE) <= hlen / 2) {
+        sq = (s8*)mmap(0, hlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        sqe = (s8*)mmap(0, hlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (sq != MAP_FAILED && sqe != MAP_FAILED) {
+            params.flags = flags | IORING_SETUP_NO_MMAP;
+            params.sq_off.reserved1 = (u64)sqe;
+            params.cq_off.reserved1 = (u64)sq;
+            ringfd = AppIOURing_setup(entries, &params);
+        }
+        if (ringfd == -1) {
+            ++HugePage::getStats().mTLBFails;
+            if (sq != MAP_FAILED) {
+                munmap(sq, hlen);
+                sq = (s8*)MAP_FAILED;
+            }
+            if (sqe != MAP_FAILED) {
+                munmap(sqe, hlen);
+                sqe = (s8*)MAP_FAILED;
+            }
+            memset(&params, 0, sizeof(params));
+            params.flags = flags;
+            if (flags & IORING_SETUP_SQPOLL)
+                params.sq_thread_idle = 10;
+        } else {
+            HugePage::getStats().mTLBBytes += 2 * hlen;
+        }
+    }
+
     /* Kernel returns a file descriptor with O_CLOEXEC flag set. */
-    s32 ringfd = AppIOURing_setup(entries, &params);
+    if (ringfd == -1) {
+        ringfd = AppIOURing_setup(entries, &params);
+    }
     if (ringfd == -1) {
         return false;
     }
@@ -224,9 +391,13 @@ bool IOURing::open(s32 epollfd, u32 entries, u32 flags) {
     maxlen = sqlen < cqlen ? cqlen : sqlen;
     sqelen = params.sq_entries * sizeof(URingSQE);
 
-    sq = (s8*)mmap(0, maxlen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
-
-    sqe = (s8*)mmap(0, sqelen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+    if (params.flags & IORING_SETUP_NO_MMAP) {
+        maxlen = hlen;
+        sqelen = hlen;
+    } else {
+        sq = (s8*)mmap(0, maxlen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+        sqe = (s8*)mmap(0, sqelen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+    }
 
     if (sq == MAP_FAILED || sqe == MAP_FAILED) {
         goto GT_INIT_FAIL;
@@ -275,6 +446,10 @@ bool IOURing::open(s32 epollfd, u32 entries, u32 flags) {
     return true;
 
 GT_INIT_FAIL:
+    if (params.flags & IORING_SETUP_NO_MMAP) {
+        maxlen = hlen;
+        sqelen = hlen;
+    }
     if (sq != MAP_FAILED) {
         munmap(sq, maxlen);
     }
@@ -288,6 +463,7 @@ GT_INIT_FAIL:
 
 void IOURing::close() {
     if (-1 != mRingFD) {
+        closeBufRing();
         munmap(mSQ, mLenMax);
         munmap(mSQE, mLenSQE);
         ::close(mRingFD);
@@ -297,6 +473,78 @@ void IOURing::close() {
 }
 
 
+bool IOURing::openBufRing(u32 count, u32 bsize) {
+    if (-1 == mRingFD || mBufRing || 0 == count || 0 == bsize) {
+        return false;
+    }
+    u32 cnt = 1;
+    while (cnt < count && cnt < G_MAX_RING_BUF) {
+        cnt <<= 1;
+    }
+    usz rlen = cnt * sizeof(URingBuf);
+    usz blen = (usz)cnt * bsize;
+    // page aligned, and the buffers will not take physical memory until the kernel write data in
+    void* ring = mmap(0, rlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ring) {
+        Logger::log(ELL_ERROR, "IOURing::openBufRing>>mmap ring, ecode=%d", System::getAppError());
+        return false;
+    }
+    s8* bufs = (s8*)HugePage::mapMem(blen);
+    if (!bufs) {
+        Logger::log(ELL_ERROR, "IOURing::openBufRing>>mmap buffers, ecode=%d", System::getAppError());
+        munmap(ring, rlen);
+        return false;
+    }
+    URingBufReg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (u64)ring;
+    reg.ring_entries = cnt;
+    reg.bgid = 0;
+    if (0 != AppIOURing_register(mRingFD, IORING_REGISTER_PBUF_RING, &reg, 1)) {
+        Logger::log(ELL_ERROR, "IOURing::openBufRing>>register, ecode=%d", System::getAppError());
+        HugePage::unmapMem(bufs, blen);
+        munmap(ring, rlen);
+        return false;
+    }
+    mBufRing = ring;
+    mBufs = bufs;
+    mBufCount = cnt;
+    mBufSize = bsize;
+    mBufTail = 0;
+    for (u32 i = 0; i < cnt; ++i) {
+        recycleRingBuf((u16)i);
+    }
+    return true;
+}
+
+
+void IOURing::closeBufRing() {
+    if (mBufRing) {
+        URingBufReg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.bgid = 0;
+        AppIOURing_register(mRingFD, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        usz blen = (usz)mBufCount * mBufSize;
+        HugePage::unmapMem(mBufs, EHPM_OFF == HugePage::getMode() ? blen : HugePage::roundSize(blen));
+        munmap(mBufRing, mBufCount * sizeof(URingBuf));
+        mBufRing = nullptr;
+        mBufs = nullptr;
+        mBufCount = 0;
+    }
+}
+
+
+void IOURing::recycleRingBuf(u16 bid) {
+    URingBuf* nd = reinterpret_cast<URingBuf*>(mBufRing) + (mBufTail & (mBufCount - 1));
+    nd->addr = (u64)getRingBuf(bid);
+    nd->len = mBufSize;
+    nd->bid = bid;
+    ++mBufTail;
+    std::atomic_store_explicit(reinterpret_cast<std::atomic<u16>*>((s8*)mBufRing + offsetof(URingBuf, resv)),
+        mBufTail, std::memory_order_release);
+}
+
+
 void IOURing::wakeupThreadSQ() {
     /* std::atomic_store_explicit(reinterpret_cast<std::atomic<u32>*>(mTailSQ), *mTailSQ + 1,
      * std::memory_order_release);*/
@@ -336,7 +584,6 @@ void IOURing::postQueue() {
     if (!mWaitPostQueue) {
         return;
     }
-    HandleFile* handle;
     URingSQE* sqe;
     RequestFD* req;
     // u32 cnt = 0;
@@ -346,22 +593,15 @@ void IOURing::postQueue() {
             break;
         }
         req = AppPopRingQueueHead_1(mWaitPostQueue);
-        handle = reinterpret_cast<HandleFile*>(req->mHandle);
         --mWaitPostSize;
         mFlyRequest++;
         //++cnt;
-        if (ERT_READ == req->mType) {
-            sqe->opcode = IORING_OP_READ;
-            sqe->addr = (u64)(req->mData + req->mUsed);
-            sqe->len = req->mAllocated - req->mUsed;
+        if (EHT_FILE == req->mHandle->getType()) {
+            AppIOURing_prepFile(sqe, req);
         } else {
-            sqe->opcode = IORING_OP_WRITE;
-            sqe->addr = (u64)(req->mData);
-            sqe->len = req->mUsed;
+            AppIOURing_prepNet(sqe, req, nullptr != mBufRing);
         }
         sqe->user_data = (u64)req;
-        sqe->fd = handle->getHandle();
-        sqe->off = req->mOffset; // default set offset = -1
         std::atomic_store_explicit(
             reinterpret_cast<std::atomic<u32>*>(mTailSQ), *mTailSQ + 1, std::memory_order_release);
     }
@@ -369,6 +609,22 @@ void IOURing::postQueue() {
 }
 
 
+bool IOURing::cancelFD(s32 fd) {
+    URingSQE* sqe = reinterpret_cast<URingSQE*>(getSQE());
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_FD;
+    sqe->user_data = 0; // no request, @see updatePending()
+    mFlyRequest++;
+    std::atomic_store_explicit(reinterpret_cast<std::atomic<u32>*>(mTailSQ), *mTailSQ + 1, std::memory_order_release);
+    wakeupThreadSQ();
+    return true;
+}
+
+
 s32 IOURing::postReq(RequestFD* req) {
     if (mWaitPostSize >= G_MAX_WAIT_REQ) {
         req->mError = EE_RETRY;
@@ -390,6 +646,12 @@ s32 IOURing::postReq(RequestFD* req) {
 }
 
 
+void IOURing::postNet(RequestFD* req) {
+    AppPushRingQueueTail_1(mWaitPostQueue, req);
+    ++mWaitPostSize;
+}
+
+
 void IOURing::updatePending() {
     u32 head = *mHeadCQ;
     u32 tail = std::atomic_load_explicit(reinterpret_cast<std::atomic<u32>*>(mTailCQ), std::memory_order_acquire);
@@ -401,9 +663,21 @@ void IOURing::updatePending() {
         nd = &cqe[i & mask];
 
         req = (RequestFD*)(u64)nd->user_data;
-        DASSERT(req->mHandle && req->mHandle->getType() == EHT_FILE);
+        if (0 == (IORING_CQE_F_MORE & nd->flags)) {
+            mFlyRequest--; // the multishot SQE is still in flight if F_MORE
+        }
+        if (!req) { // @see cancelFD()
+            if (nd->res < 0 && -ENOENT != nd->res) {
+                Logger::log(ELL_ERROR, "IOURing::updatePending>>cancel fail, ecode=%d", nd->res);
+            }
+            continue;
+        }
+        DASSERT(req->mHandle);
 
-        mFlyRequest--;
+        if (EHT_FILE != req->mHandle->getType()) {
+            req->mHandle->getLoop()->onURingNet(req, nd->res, nd->flags);
+            continue;
+        }
 
         // io_uring stores error codes as negative numbers
         if (nd->res >= 0) {
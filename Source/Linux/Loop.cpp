@@ -25,6 +25,9 @@
 
 #include "Loop.h"
 #include <sys/epoll.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
 #include "Timer.h"
 #include "System.h"
 #include "Engine.h"
@@ -34,7 +37,26 @@
 #include "Net/HandleUDP.h"
 
 
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define DMAX_WRITE_VEC IOV_MAX
+#else
+#define DMAX_WRITE_VEC 1024
+#endif
+
 namespace app {
+
+/**
+ * @brief fill the unsent data of a write request into iovec.
+ * @return count of iovec filled */
+static s32 AppFillWriteVec(RequestFD* it, struct iovec* vec, s32 max) {
+    if (ERF_IOV & it->mFlags) {
+        return (s32)reinterpret_cast<RequestIOV*>(it)->fillVec(vec, (u32)max);
+    }
+    vec->iov_base = it->mData + it->mStepSize;
+    vec->iov_len = it->mUsed - it->mStepSize;
+    return 1;
+}
+
 /**
  * @brief This function must be called after accept() fails. It returns true if 'err'
  * indicates accepted connection faced an error, and it's okay to continue
@@ -50,21 +72,45 @@ static bool AcceptNeedRetry(s32 err) {
 }
 
 
+/**
+ * @brief local address of the accepted link, copied from listener if it's bound to a specific IP,
+ * else getsockname() for the real IP of a wildcard listener. */
+static void AcceptLocal(const net::HandleTCP* hnd, RequestAccept* nd) {
+    if (hnd->getLocal().isAnyIP()) {
+        nd->mSocket.getLocalAddress(nd->mLocal);
+    } else {
+        nd->mLocal = hnd->getLocal();
+    }
+}
+
+
 Loop::Loop() :
-    mTimeHub(HandleTime::lessTime),
-    mRequest(nullptr),
     mTime(Timer::getTime()),
+    mFlyRequest(0),
+    mGrabCount(0),
+    mMaxEvents(128),
     mStop(0),
-    mTaskHead(nullptr),
-    mTaskHeadIdle(nullptr),
+    mURingNet(false),
+    mFairHandleBytes(0),
+    mFairHandleReqs(0),
+    mFairStepBytes(0),
+    mFairStepReqs(0),
+    mStepBytes(0),
+    mStepReqs(0),
+    mTimeHub(HandleTime::lessTime),
+    mTimeWheel(Timer::getTime(), 10),
+    mRequest(nullptr),
+    mStats(nullptr),
+    mStatsSlow(0),
+    mBusyPoll(0),
+    mBusyPollSock(0),
+    mBusyBudget(0),
+    mBusyUntil(0),
     mTaskIdleCount(0),
+    mTaskWake(ETW_AWAKE),
     mTaskIdleMax(1000),
-    mMaxEvents(128), 
-    mPackCMD(1024),
-    mFlyRequest(0),
-    mGrabCount(0) {
+    mPackCMD(1024) {
     mEvents = new EventPoller::SEvent[mMaxEvents];
-    mTaskTailPos = reinterpret_cast<void**>(&mTaskHead);
 }
 
 Loop::~Loop() {
@@ -107,12 +153,18 @@ void Loop::onRead(RequestFD* it) {
         case ECT_ACTIVE:
             Logger::logInfo("Loop::onCommands>>pid=%d, active", Engine::getInstance().getPID());
             break;
+        case ECT_MEM_REPORT:
+            Engine::getInstance().logMemory();
+            break;
         case ECT_TASK:
         {
             CommandTask* task = reinterpret_cast<CommandTask*>(cmd);
             (*task)();
             break;
         }
+        case ECT_UPGRADE:
+            Engine::getInstance().onUpgrade(*reinterpret_cast<CommandUpgrade*>(cmd), mCMD.getSock());
+            break;
         default:
             break;
         } // switch
@@ -135,8 +187,41 @@ void Loop::onRead(RequestFD* it) {
 
 bool Loop::run() {
     s32 ecode = 0;
+    const s64 start = mStats ? Timer::getRelativeMicro() : 0;
+    s64 tick = start;
+    s64 polled = 0;
     u32 timeout = getWaitTime();
-    s32 max = mPoller.getEvents(mEvents, mMaxEvents, timeout);
+    if (mStats) {
+        tick = markPhase(ELP_TIME, tick);
+    }
+    IOURing& uring = mPoller.getIOURing();
+    uring.postQueue(); // submit all SQEs of this round at once
+    if (uring.getWaitCount() > 0) {
+        timeout = 0; // SQ ring is full
+    }
+    bool spun = false;
+    if (timeout > 0) {
+        if (isBusyPoll()) {
+            spun = true;
+            timeout = 0; // spinning, no need to be woken by posters
+        } else if (!sleepTask()) {
+            timeout = 0; // tasks posted
+        }
+    }
+    s32 max = 0;
+    bool reaped = false;
+    if (spun && uring.hasCQE()) {
+        reaped = true; // busy poll: reap CQEs without epoll_wait()
+        uring.updatePending();
+    } else {
+        max = mPoller.getEvents(mEvents, mMaxEvents, timeout);
+    }
+    wakeTask();
+    if (mStats) {
+        polled = tick;
+        tick = markPhase(ELP_POLL, tick);
+        polled = tick - polled;
+    }
     if (max > 0) {
         for (s32 i = 0; i < max; ++i) {
             u32 eflag = mEvents[i].mEvent;
@@ -144,12 +229,15 @@ bool Loop::run() {
                 eflag |= (EPOLLIN | EPOLLOUT);
             }
             if (mEvents[i].mData.mPointer) {
-                if (&mPoller.getIOURing() == mEvents[i].mData.mPointer) {
-                    mPoller.getIOURing().updatePending();
+                if (&uring == mEvents[i].mData.mPointer) {
+                    uring.updatePending();
+                } else if (mPoller.isWakeEvent(mEvents[i])) {
+                    mPoller.clearWakeEvent(); // tasks are done by onTask() bellow
                 } else {
                     Handle& han = *(Handle*)(mEvents[i].mData.mPointer);
                     RequestFD* req;
-                    if (EPOLLIN & eflag) {
+                    // a deferred request resumes in updatePending(), and reads/writes until EAGAIN itself
+                    if ((EPOLLIN & eflag) && 0 == (EHF_DEFER_READ & han.mFlag)) {
                         req = han.popReadReq();
                         if (req) {
                             addPending(req);
@@ -157,7 +245,7 @@ bool Loop::run() {
                             han.mFlag |= EHF_SYNC_READ;
                         }
                     }
-                    if (EPOLLOUT & eflag) {
+                    if ((EPOLLOUT & eflag) && 0 == (EHF_DEFER_WRITE & han.mFlag)) {
                         req = han.popWriteReq();
                         if (req) {
                             addPending(req);
@@ -178,9 +266,28 @@ bool Loop::run() {
             Logger::log(ELL_ERROR, "Loop::run>>Poll=%d events, ecode=%d", max, ecode);
         }
     }
-    updatePending();
-    updateClosed();
-    return mGrabCount > 0 || mPoller.getIOURing().getSize();
+    s32 tasks;
+    if (mStats) {
+        tick = markPhase(ELP_EVENTS, tick);
+        tasks = onTask();
+        tick = markPhase(ELP_TASK, tick);
+        updatePending();
+        tick = markPhase(ELP_PENDING, tick);
+        updateClosed();
+        tick = markPhase(ELP_CLOSED, tick);
+        mStats->mPhase[ELP_BUSY].add(tick - start - polled);
+        mStats->mSteps.fetch_add(1, std::memory_order_relaxed);
+        mStats->mEvents.fetch_add(max > 0 ? max : 0, std::memory_order_relaxed);
+        mStats->mTasks.fetch_add(tasks, std::memory_order_relaxed);
+    } else {
+        tasks = onTask();
+        updatePending();
+        updateClosed();
+    }
+    if (mBusyPoll > 0) {
+        updateBusyPoll(spun, reaped || max > 0 || tasks > 0);
+    }
+    return mGrabCount > 0 || uring.getSize();
 }
 
 
@@ -191,9 +298,12 @@ void Loop::updatePending() {
     RequestFD* first = mRequest->mNext;
     RequestFD* next = first;
     mRequest = nullptr;
+    mStepBytes = 0;
+    mStepReqs = 0;
 
     for (RequestFD* req = next; next; req = next) {
         next = req->mNext != first ? req->mNext : nullptr;
+        StatsCall scall(*this, req);
         switch (req->mType) {
         case ERT_CONNECT:
         {
@@ -221,7 +331,10 @@ void Loop::updatePending() {
             net::HandleTCP* hnd = (net::HandleTCP*)(nd->mHandle);
             s32 err = 0;
             s32 rdsz = 0;
+            usz bytes = 0;
+            u32 reqs = 0;
             StringView buf;
+            hnd->mFlag &= ~EHF_DEFER_READ;
             while (nd) {
                 if (EHF_READABLE & hnd->mFlag) {
                     buf = nd->getWriteBuf();
@@ -236,6 +349,8 @@ void Loop::updatePending() {
                         rdsz = hnd->mSock.receive(buf.mData, (s32)buf.mLen);
                     }
                     if (rdsz > 0) {
+                        bytes += rdsz;
+                        mStepBytes += rdsz;
                         nd->mError = 0;
                         nd->mUsed += rdsz;
                         if (rdsz < buf.mLen) {
@@ -272,6 +387,12 @@ void Loop::updatePending() {
                 nd->mCall(nd);
                 nd = (RequestFD*)hnd->popReadReq();
                 unbindFly(hnd);
+                ++mStepReqs;
+                if (nd && (EHF_READABLE & hnd->mFlag) && isOverBudget(bytes, ++reqs)) {
+                    deferPending(nd, EHF_DEFER_READ);
+                    err = EE_RETRY; // nd is pending, not EHF_SYNC_READ
+                    break;
+                }
             }//while
 
             // set flag for next step
@@ -285,25 +406,31 @@ void Loop::updatePending() {
         {
             RequestFD* nd = (RequestFD*)req;
             net::HandleTCP* hnd = (net::HandleTCP*)(nd->mHandle);
+            if (EHT_UDP != hnd->mType) {
+                writeGather(hnd, nd);
+                break;
+            }
+            // UDP: one datagram per request
             StringView buf;
             s32 err = 0;
+            usz bytes = 0;
+            u32 reqs = 0;
+            hnd->mFlag &= ~EHF_DEFER_WRITE;
             while (nd) {
                 if (EHF_WRITEABLE & hnd->mFlag) {
                     buf = nd->getReadBuf();
                     buf.mData += nd->mStepSize;
                     buf.mLen -= nd->mStepSize;
                     s32 wdsz;
-                    if (EHT_UDP == hnd->mType) {
-                        RequestUDP* ndu = (RequestUDP*)req;
-                        if ((1 & ndu->mFlags) > 0) {
-                            wdsz = hnd->mSock.send(buf.mData, (s32)buf.mLen);
-                        } else {
-                            wdsz = hnd->mSock.sendTo(buf.mData, (s32)buf.mLen, ndu->mRemote);
-                        }
-                    } else { // TCP currently
+                    RequestUDP* ndu = (RequestUDP*)nd;
+                    if ((ERF_CONNECTED & ndu->mFlags) > 0) {
                         wdsz = hnd->mSock.send(buf.mData, (s32)buf.mLen);
+                    } else {
+                        wdsz = hnd->mSock.sendTo(buf.mData, (s32)buf.mLen, ndu->mRemote);
                     }
                     if (wdsz > 0) {
+                        bytes += wdsz;
+                        mStepBytes += wdsz;
                         nd->mError = 0;
                         nd->mStepSize += wdsz;
                         if (nd->mStepSize < nd->mUsed) {
@@ -339,6 +466,12 @@ void Loop::updatePending() {
                 nd->mCall(nd);
                 nd = (RequestFD*)hnd->popWriteReq();
                 unbindFly(hnd);
+                ++mStepReqs;
+                if (nd && (EHF_WRITEABLE & hnd->mFlag) && isOverBudget(bytes, ++reqs)) {
+                    deferPending(nd, EHF_DEFER_WRITE);
+                    err = EE_RETRY;
+                    break;
+                }
             }//while
 
             // set flag for next step
@@ -353,21 +486,15 @@ void Loop::updatePending() {
             RequestAccept* nd = (RequestAccept*)req;
             net::HandleTCP* hnd = (net::HandleTCP*)(nd->mHandle);
             s32 err = 0;
+            u32 reqs = 0;
+            hnd->mFlag &= ~EHF_DEFER_READ;
             while (nd) {
                 if (EHF_READABLE & hnd->mFlag) {
-                    nd->mSocket = hnd->mSock.accept(nd->mRemote);
+                    // accept4(), options inherited from listener, @see Acceptor::setOption()
+                    nd->mSocket = hnd->mSock.acceptNonblock(nd->mRemote);
                     if (nd->mSocket.isOpen()) {
                         nd->mError = 0;
-                        nd->mSocket.getLocalAddress(nd->mLocal);
-                        //nd->mSocket.getRemoteAddress(nd->mRemote);
-                        if (0 != nd->mSocket.setBlock(false)) {
-                            nd->mError = System::getAppError();
-                            Logger::log(ELL_ERROR, "Loop::updatePending>>accept unblock sock=%d,err=%d",
-                                nd->mSocket.getValue(), nd->mError);
-                            nd->mSocket.close();
-                            continue;
-                            //hnd->mFlag &= ~EHF_READABLE;
-                        }
+                        AcceptLocal(hnd, nd);
                     } else {
                         err = System::getError();
                         if (EINTR == err) {
@@ -395,6 +522,12 @@ void Loop::updatePending() {
                 nd->mCall(nd);
                 nd = (RequestAccept*)hnd->popReadReq();
                 unbindFly(hnd);
+                ++mStepReqs;
+                if (nd && (EHF_READABLE & hnd->mFlag) && isOverBudget(0, ++reqs)) {
+                    deferPending(nd, EHF_DEFER_READ);
+                    err = EE_RETRY;
+                    break;
+                }
             } //while
             
             // set flag for next step
@@ -426,6 +559,10 @@ void Loop::updateClosed() {
         curr = (Handle*)list.mNext;
         curr->delink();
         curr->mFlag |= EHF_CLOSE;
+        if (mURingNet && curr->mType >= EHT_TCP_ACCEPT && curr->mType <= EHT_UDP) {
+            // all SQEs landed, @see Loop::closeHandle()
+            reinterpret_cast<net::HandleTCP*>(curr)->close();
+        }
         if (curr->mCallClose) {
             curr->mCallClose(curr);
         }
@@ -436,12 +573,133 @@ void Loop::updateClosed() {
 }
 
 
+void Loop::writeGather(net::HandleTCP* hnd, RequestFD* nd) {
+    struct iovec vecs[DMAX_WRITE_VEC];
+    s32 err = 0;
+    usz bytes = 0;
+    u32 reqs = 0;
+    hnd->mFlag &= ~EHF_DEFER_WRITE;
+    while (nd) {
+        if (0 == (EHF_WRITEABLE & hnd->mFlag)) {
+            nd->mError = EE_NO_WRITEABLE;
+            landWrite(hnd, nd);
+            nd = (RequestFD*)hnd->popWriteReq();
+            unbindFly(hnd);
+            continue;
+        }
+
+        // nd is the head, then the queued requests in order, without pop
+        s32 cnt = AppFillWriteVec(nd, vecs, DMAX_WRITE_VEC);
+        s32 gathered = 1; // requests in this batch
+        for (RequestFD* it = hnd->mWriteQueue; it && cnt < DMAX_WRITE_VEC; ++gathered) {
+            it = it->mNext;
+            cnt += AppFillWriteVec(it, vecs + cnt, DMAX_WRITE_VEC - cnt);
+            if (it == hnd->mWriteQueue) {
+                ++gathered;
+                break;
+            }
+        }
+        s64 total = 0;
+        for (s32 i = 0; i < cnt; ++i) {
+            total += vecs[i].iov_len;
+        }
+
+        s64 wdsz = hnd->mSock.sendVector(vecs, cnt);
+        if (wdsz > 0) {
+            bytes += wdsz;
+            mStepBytes += wdsz;
+            // 按序记账: 完整发出的请求先摘出队列再回调, 防止回调中closeHandle()把它们当作未发送
+            const bool full = wdsz < total; //socket cache is full, wait EPOLLOUT
+            RequestFD* done = nullptr;
+            RequestFD* tail = nullptr;
+            RequestFD* curr = nd;
+            for (s32 i = 0; i < gathered; ++i) {
+                usz left = curr->mUsed - curr->mStepSize;
+                if ((u64)wdsz < left) {
+                    curr->mStepSize += (u32)wdsz;
+                    break;
+                }
+                wdsz -= left;
+                curr->mStepSize = curr->mUsed;
+                curr->mError = 0;
+                if (tail) {
+                    tail->mNext = curr;
+                } else {
+                    done = curr;
+                }
+                tail = curr;
+                curr = (i + 1 < gathered) ? (RequestFD*)hnd->popWriteReq() : nullptr;
+            }
+            if (curr && full) {
+                hnd->addWritePendingHead(curr);
+                hnd->mFlag &= ~EHF_SYNC_WRITE;
+                err = EE_RETRY;
+                curr = nullptr;
+            }
+            if (tail) {
+                tail->mNext = nullptr;
+            }
+            for (RequestFD* next; done; done = next) {
+                next = done->mNext;
+                landWrite(hnd, done);
+                unbindFly(hnd);
+                ++mStepReqs;
+                ++reqs; // requests of this handle done in current step
+            }
+            if (EE_RETRY == err) {
+                break;
+            }
+            // curr: the rest of a request which was gathered partly
+            nd = curr ? curr : (RequestFD*)hnd->popWriteReq();
+            if (nd && (EHF_WRITEABLE & hnd->mFlag) && isOverBudget(bytes, reqs)) {
+                deferPending(nd, EHF_DEFER_WRITE);
+                err = EE_RETRY;
+                break;
+            }
+            continue;
+        }
+
+        if (0 == wdsz) {
+            err = System::getAppError();
+            nd->mError = err;
+            hnd->mFlag &= ~(EHF_WRITEABLE | EHF_SYNC_WRITE);
+            closeHandle(hnd);
+        } else {
+            err = System::getAppError();
+            if (EE_INTR == err) {
+                err = 0;
+                continue;
+            } else if (EE_RETRY == err) {
+                hnd->mFlag &= ~EHF_SYNC_WRITE;
+                hnd->addWritePendingHead(nd);
+                break;
+            } else {
+                nd->mError = err;
+                hnd->mFlag &= ~(EHF_WRITEABLE | EHF_SYNC_WRITE);
+                closeHandle(hnd);
+            }
+        }
+        landWrite(hnd, nd);
+        nd = (RequestFD*)hnd->popWriteReq();
+        unbindFly(hnd);
+    } //while
+
+    // set flag for next step
+    if ((hnd->mFlag & EHF_WRITEABLE) && EE_RETRY != err) {
+        hnd->mFlag |= EHF_SYNC_WRITE;
+    }
+    relinkTime((HandleTime*)hnd);
+}
+
+
 u32 Loop::getWaitTime() {
     mTime = Timer::getTime();
     if (mRequest || !mHandleClose.empty()) {
         return 0;
     }
-    return updateTimeHub();
+    u32 ret = updateTimeHub();
+    // the expired timers closed just now, don't delay their close callback
+    return mHandleClose.empty() ? ret : 0;
 }
 
 
@@ -476,6 +734,17 @@ void Loop::unbindFly(Handle* it) {
 
 
 bool Loop::start(net::Socket& sock, net::Socket& sockW) {
+    const EngineConfig& cfg = Engine::getInstance().getConfig();
+    mURingNet = cfg.mURingNet;
+    mStatsSlow = cfg.mLoopStats;
+    mStats = cfg.mLoopStats > 0 ? &Engine::getInstance().getLoopStats() : nullptr;
+    mBusyPoll = cfg.mBusyPoll;
+    mBusyPollSock = cfg.mBusyPollSock;
+    mBusyBudget = cfg.mBusyPoll;
+    mFairHandleBytes = cfg.mFairHandleBytes;
+    mFairHandleReqs = cfg.mFairHandleReqs;
+    mFairStepBytes = cfg.mFairStepBytes;
+    mFairStepReqs = cfg.mFairStepReqs;
     mCMD.mSock = sock;
     mCMD.setClose(EHT_TCP_LINK, LoopOnClose, this);
     mCMD.setTime(LoopOnTime, 15 * 1000, 20 * 1000, -1);
@@ -485,6 +754,11 @@ bool Loop::start(net::Socket& sock, net::Socket& sockW) {
         sockW.close();
         return false;
     }
+    if (mURingNet && cfg.mURingBufCount > 0
+        && !mPoller.getIOURing().openBufRing(cfg.mURingBufCount, cfg.mURingBufSize)) {
+        Logger::log(ELL_ERROR, "Loop::start>>disable multishot, buffer ring count=%u, size=%u",
+            cfg.mURingBufCount, cfg.mURingBufSize);
+    }
     if (0 != mCMD.mSock.setBlock(false)) {
         sock.close();
         sockW.close();
@@ -540,22 +814,49 @@ void Loop::stop() {
 void Loop::relinkTime(HandleTime* handle) {
     DASSERT(handle);
     if (0 == (EHF_CLOSING & handle->mFlag)) {
-        mTimeHub.remove(&handle->mLink);
+        // just push the deadline forward, node will be re-slotted when it's slot expired
         handle->mTimeout = mTime + handle->mTimeGap;
-        mTimeHub.insert(&handle->mLink);
+        if (handle->mCallTime && !handle->mWheel.isLinked()) {
+            mTimeWheel.add(handle->mWheel, handle->mTimeout);
+        }
         //printf("Loop::relinkTime>>%lld, gap=%lld\n", handle->mTimeout, handle->mTimeGap / 1000);
     }
 }
 
 
+void Loop::updateTimeWheel() {
+    Node2 expired;
+    mTimeWheel.update(mTime, expired);
+    HandleTime* handle;
+    while (!expired.empty()) {
+        handle = DGET_HOLDER(expired.getNext(), HandleTime, mWheel.mLinker);
+        handle->mWheel.mLinker.delink();
+        if (handle->mTimeout > mTime) {
+            mTimeWheel.add(handle->mWheel, handle->mTimeout); // touched by relinkTime()
+            continue;
+        }
+        if (EE_OK == handle->mCallTime(handle) && 0 != handle->mRepeat) {
+            if (handle->mRepeat > 0) {
+                --handle->mRepeat;
+            }
+            handle->mTimeout = mTime + handle->mTimeGap;
+            mTimeWheel.add(handle->mWheel, handle->mTimeout);
+        } else {
+            closeHandle(handle);
+        }
+    }
+}
+
+
 u32 Loop::updateTimeHub() {
+    updateTimeWheel();
     HandleTime* handle;
     Node3* nd;
     for (nd = mTimeHub.getTop(); nd; nd = mTimeHub.getTop()) {
         handle = DGET_HOLDER(nd, HandleTime, mLink);
         if (handle->mTimeout > mTime) {
             s64 diff = handle->mTimeout - mTime;
-            return diff > 1000 ? 1000 : (u32)diff;
+            return (u32)mTimeWheel.getWaitTime(mTime, diff > 1000 ? 1000 : diff);
         }
         if (EE_OK == handle->mCallTime(handle)) {
             if (handle->mRepeat > 0) {
@@ -581,7 +882,7 @@ u32 Loop::updateTimeHub() {
             addClose(handle);*/
         }
     }
-    return 0;
+    return (u32)mTimeWheel.getWaitTime(mTime, 1000);
 }
 
 
@@ -608,14 +909,27 @@ s32 Loop::closeHandle(Handle* it) {
     {
         net::HandleTCP* nd = reinterpret_cast<net::HandleTCP*>(it);
         if (nd->mCallTime) {
-            mTimeHub.remove(&nd->mLink);
+            mTimeWheel.remove(nd->mWheel);
         }
-        if (mPoller.remove(nd->getSock())) {
-            //TODO>> CLEAR ALL requests
+        if (EHT_TCP_ACCEPT == it->mType) {
+            Engine::getInstance().removeListener(nd);
+        }
+        if (mURingNet) {
+            // wakeup the SQEs in flight, and close socket after all of them landed, @see Loop::updateClosed()
+            if (0 == (EHF_HANDOFF & it->mFlag)) {
+                nd->getSock().closeBoth();
+            } else if (!mPoller.getIOURing().cancelFD(nd->getSock().getValue())) {
+                // the listener is shared with the new process, never shutdown() it
+                Logger::log(ELL_ERROR, "Loop::closeHandle>>cancel listener=%d fail", nd->getSock().getValue());
+            }
         } else {
-            Logger::log(ELL_ERROR, "Loop::closeHandle>>remove tcp=%d, ecode=%d", nd->getSock().getValue(), System::getError());
+            if (mPoller.remove(nd->getSock())) {
+                //TODO>> CLEAR ALL requests
+            } else {
+                Logger::log(ELL_ERROR, "Loop::closeHandle>>remove tcp=%d, ecode=%d", nd->getSock().getValue(), System::getError());
+            }
+            nd->close();
         }
-        nd->close();
         addPendingAll(nd->mReadQueue);
         nd->mReadQueue = nullptr;
         addPendingAll(nd->mWriteQueue);
@@ -626,12 +940,16 @@ s32 Loop::closeHandle(Handle* it) {
     {
         net::HandleUDP* nd = reinterpret_cast<net::HandleUDP*>(it);
         if (nd->mCallTime) {
-            mTimeHub.remove(&nd->mLink);
+            mTimeWheel.remove(nd->mWheel);
         }
-        if (!mPoller.remove(nd->getSock())) {
-            Logger::log(ELL_ERROR, "Loop::closeHandle>>remove udp=%d, ecode=%d", nd->getSock().getValue(), System::getError());
+        if (mURingNet) {
+            nd->getSock().closeBoth();
+        } else {
+            if (!mPoller.remove(nd->getSock())) {
+                Logger::log(ELL_ERROR, "Loop::closeHandle>>remove udp=%d, ecode=%d", nd->getSock().getValue(), System::getError());
+            }
+            nd->close();
         }
-        nd->close();
         addPendingAll(nd->mReadQueue);
         nd->mReadQueue = nullptr;
         addPendingAll(nd->mWriteQueue);
@@ -649,7 +967,7 @@ s32 Loop::closeHandle(Handle* it) {
         HandleFile* nd = reinterpret_cast<HandleFile*>(it);
         ret = nd->close();
         if (nd->mCallTime) {
-            mTimeHub.remove(&nd->mLink);
+            mTimeWheel.remove(nd->mWheel);
         }
         break;
     }
@@ -665,7 +983,7 @@ s32 Loop::closeHandle(Handle* it) {
 }
 
 
-s32 Loop::openHandle(Handle* it) {
+s32 Loop::openHandle(Handle* it, const net::SocketOption* opt) {
     if (mStop > 0) {
         it->mFlag |= EHF_CLOSING;
         return EE_CLOSING;
@@ -682,7 +1000,16 @@ s32 Loop::openHandle(Handle* it) {
     {
         net::HandleTCP* nd = reinterpret_cast<net::HandleTCP*>(it);
         net::Socket& sock = nd->getSock();
-        if (!sock.openSeniorTCP()) {
+        bool listened = false;
+        net::netsocket inherit = Engine::getInstance().takeListener(nd->mLocal.getStr());
+        if (DINVALID_SOCKET != inherit) {
+            sock = inherit; // listening already, handed off by the old process of hot upgrade
+            listened = true;
+            if (opt && 0 != sock.setOption(*opt)) {
+                Logger::log(ELL_ERROR, "Loop::openHandle>>addr=%s,inherit option ecode=%d", nd->mLocal.getStr(),
+                    System::getAppError());
+            }
+        } else if (!sock.openSeniorTCP()) {
             ret = System::getAppError();
             Logger::log(ELL_ERROR, "Loop::openHandle>>addr=%s,tcp open ecode=%d", nd->mLocal.getStr(), ret);
         } else if (0 != sock.setReuseIP(true)) {
@@ -697,16 +1024,30 @@ s32 Loop::openHandle(Handle* it) {
             ret = System::getAppError();
             Logger::log(ELL_ERROR, "Loop::openHandle>>addr=%s,bind ecode=%d", nd->mLocal.getStr(), ret);
             sock.close();
-        } else if (0 != sock.listen(0x7FFFFFFF)) {
-            ret = System::getAppError();
-            Logger::log(ELL_ERROR, "Loop::openHandle>>addr=%s,listen ecode=%d", nd->mLocal.getStr(), ret);
-            sock.close();
         } else {
+            // before listen(), so the buffers, TCP_DEFER_ACCEPT and TCP_FASTOPEN apply to the first SYN
+            if (opt && 0 != sock.setOption(*opt)) {
+                Logger::log(ELL_ERROR, "Loop::openHandle>>addr=%s,option ecode=%d", nd->mLocal.getStr(),
+                    System::getAppError());
+            }
+            if (0 != sock.listen(0x7FFFFFFF)) {
+                ret = System::getAppError();
+                Logger::log(ELL_ERROR, "Loop::openHandle>>addr=%s,listen ecode=%d", nd->mLocal.getStr(), ret);
+                sock.close();
+            } else {
+                listened = true;
+            }
+        }
+        if (listened) {
+            Engine::getInstance().steerListener(sock);
+            // the listener is owned by this loop only, no EPOLLEXCLUSIVE
             EventPoller::SEvent evt;
-            evt.mEvent = EPOLLIN | EPOLLET | EPOLLERR | EPOLLHUP | EPOLLEXCLUSIVE;
+            evt.mEvent = EPOLLIN | EPOLLET | EPOLLERR | EPOLLHUP;
             evt.mData.mPointer = nd;
-            if (mPoller.add(sock, evt)) {
-                nd->mFlag |= EHF_READABLE;
+            if (mURingNet || mPoller.add(sock, evt)) {
+                // multishot: the first accept arm SQE, others wait in read queue as spares
+                nd->mFlag |= isURingMultishot() ? (EHF_READABLE | EHF_SYNC_READ) : EHF_READABLE;
+                Engine::getInstance().addListener(nd);
             } else {
                 ret = EE_NO_OPEN;
                 sock.close();
@@ -726,14 +1067,24 @@ s32 Loop::openHandle(Handle* it) {
             Logger::log(ELL_ERROR, "Loop::openHandle>>addr=%s,tcp.con unblock, ecode=%d", nd->mRemote.getStr(), ret);
             sock.close();
         } else {
+            if (nd->mFastOpen && 0 != sock.setFastOpenConnect(true)) {
+                Logger::log(ELL_WARN, "Loop::openHandle>>addr=%s,tcp.con fastopen, ecode=%d", nd->mRemote.getStr(),
+                    System::getAppError());
+            }
             EventPoller::SEvent evt;
             evt.mEvent = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLERR | EPOLLHUP;
             evt.mData.mPointer = nd;
-            if (mPoller.add(nd->getSock(), evt)) {
+            if (mURingNet) {
+                nd->mFlag |= (EHF_READABLE | EHF_WRITEABLE); // EHF_SYNC_* will be set after connected
+                if (nd->mCallTime) {
+                    nd->mTimeout += Timer::getTime();
+                    mTimeWheel.add(nd->mWheel, nd->mTimeout);
+                }
+            } else if (mPoller.add(nd->getSock(), evt)) {
                 nd->mFlag |= (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_WRITE);
                 if (nd->mCallTime) {
                     nd->mTimeout += Timer::getTime();
-                    mTimeHub.insert(&nd->mLink);
+                    mTimeWheel.add(nd->mWheel, nd->mTimeout);
                 }
             } else {
                 ret = System::getAppError();
@@ -750,11 +1101,13 @@ s32 Loop::openHandle(Handle* it) {
         EventPoller::SEvent evt;
         evt.mEvent = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLERR | EPOLLHUP;
         evt.mData.mPointer = nd;
-        if (mPoller.add(nd->getSock(), evt)) {
-            nd->mFlag |= (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_WRITE);
+        if (mURingNet || mPoller.add(nd->getSock(), evt)) {
+            // io_uring mode: EHF_SYNC_* means no request in flight
+            nd->mFlag |= mURingNet ? (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_READ | EHF_SYNC_WRITE)
+                                   : (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_WRITE);
             if (nd->mCallTime) {
                 nd->mTimeout += Timer::getTime();
-                mTimeHub.insert(&nd->mLink);
+                mTimeWheel.add(nd->mWheel, nd->mTimeout);
             }
         } else {
             ret = System::getAppError();
@@ -777,7 +1130,7 @@ s32 Loop::openHandle(Handle* it) {
         nd->mFlag |= (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_WRITE);
         if (nd->mCallTime) {
             nd->mTimeout += Timer::getTime();
-            mTimeHub.insert(&nd->mLink);
+            mTimeWheel.add(nd->mWheel, nd->mTimeout);
         }
         break;
     }
@@ -787,11 +1140,13 @@ s32 Loop::openHandle(Handle* it) {
         EventPoller::SEvent evt;
         evt.mEvent = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLERR | EPOLLHUP;
         evt.mData.mPointer = nd;
-        if (mPoller.add(nd->getSock(), evt)) {
-            nd->mFlag |= (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_WRITE);
+        if (mURingNet || mPoller.add(nd->getSock(), evt)) {
+            // io_uring mode: EHF_SYNC_* means no request in flight
+            nd->mFlag |= mURingNet ? (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_READ | EHF_SYNC_WRITE)
+                                   : (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_WRITE);
             if (nd->mCallTime) {
                 nd->mTimeout += Timer::getTime();
-                mTimeHub.insert(&nd->mLink);
+                mTimeWheel.add(nd->mWheel, nd->mTimeout);
             }
         } else {
             ret = System::getAppError();
@@ -808,6 +1163,10 @@ s32 Loop::openHandle(Handle* it) {
     }//switch
 
     if (EE_OK == ret) {
+        if (mBusyPollSock > 0 && it->mType >= EHT_TCP_CONNECT && it->mType <= EHT_UDP
+            && 0 != reinterpret_cast<net::HandleTCP*>(it)->getSock().setBusyPoll(mBusyPollSock)) {
+            DLOG(ELL_ERROR, "Loop::openHandle>>SO_BUSY_POLL=%u, ecode=%d", mBusyPollSock, System::getAppError());
+        }
         bindHandle(it);
         it->mFlag |= EHF_OPEN;
         mHandleActive.pushBack(*it);
@@ -819,7 +1178,18 @@ s32 Loop::openHandle(Handle* it) {
 }
 
 
+void Loop::deferPending(RequestFD* it, u32 flag) {
+    it->mHandle->mFlag |= flag;
+    addPending(it);
+    ++Engine::getInstance().getEngineStats().mFairDefers;
+}
+
+
 void Loop::addPending(RequestFD* it) {
+    if (mURingNet) {
+        mPoller.getIOURing().postNet(it);
+        return;
+    }
     if (mRequest) {
         it->mNext = mRequest->mNext;
         mRequest->mNext = it;
@@ -842,45 +1212,37 @@ s32 Loop::postTask(TaskNode* task) {
     if (!task || isStop()) {
         return EE_ERROR;
     }
+    mTasks.push(task);
 
-    mTaskLock.lock();
-    bool active = (nullptr == mTaskHead);
-    void** link = (void**)((s8*)task + DOFFSET(TaskNode, mNext));
-    *link = nullptr;
-    *mTaskTailPos = (void*)link;
-    mTaskTailPos = (void**)link;
-    mTaskLock.unlock();
-
-    if (active) {
-        CommandTask activeTask;
-        activeTask.pack(&Loop::onTask, this, (void*)nullptr);
-        if (activeTask.mSize != mSendCMD.send(&activeTask, activeTask.mSize)) {
-            Logger::log(ELL_ERROR, "Loop::postTask>>send cmd, failed to active the loop");
+    // only the 1st poster wakes the sleeping loop, @see Loop::sleepTask()
+    s32 expect = ETW_SLEEP;
+    if (mTaskWake.compare_exchange_strong(expect, ETW_POSTED)) {
+        EventPoller::SEvent evt;
+        evt.mEvent = 0;
+        evt.mData.mPointer = nullptr;
+        if (!mPoller.postEvent(evt)) {
+            Logger::log(ELL_ERROR, "Loop::postTask>>failed to active the loop, ecode=%d", System::getAppError());
         }
     }
     return EE_OK;
 }
 
 
-void Loop::onTask(void* it) {
-    void** head = nullptr;
-
-    mTaskLock.lock();
-    if (mTaskHead) {
-        head = (void**)(mTaskHead);
-        //clear queue
-        mTaskHead = nullptr;
-        mTaskTailPos = reinterpret_cast<void**>(&mTaskHead);
+s32 Loop::onTask() {
+    TaskNode* head = mTasks.popAllFIFO();
+    if (!head) {
+        return 0;
     }
-    mTaskLock.unlock();
-
-    //process all tasks
-    while (head) {
-        TaskNode* nd = reinterpret_cast<TaskNode*>((s8*)head - DOFFSET(TaskNode, mNext));
+    //process all tasks in batch
+    TaskNode* tail = head;
+    s32 cnt = 0;
+    for (TaskNode* nd = head; nd; nd = nd->mNext) {
         (*nd)();
-        head = (void**)(*head); //next
-        pushTaskNode(nd);
+        tail = nd;
+        ++cnt;
     }
+    pushTaskNode(head, tail, cnt);
+    return cnt;
 }
 
 
@@ -900,4 +1262,161 @@ s32 Loop::postRequest(RequestFD* it) {
     return EE_ERROR;
 }
 
+
+void Loop::postNextRead(Handle* it) {
+    if (EHF_READABLE & it->mFlag) {
+        RequestFD* nd = it->popReadReq();
+        if (nd) {
+            addPending(nd);
+        } else {
+            it->mFlag |= EHF_SYNC_READ;
+        }
+    }
+}
+
+
+void Loop::postNextWrite(Handle* it) {
+    if (EHF_WRITEABLE & it->mFlag) {
+        RequestFD* nd = it->popWriteReq();
+        if (nd) {
+            addPending(nd);
+        } else {
+            it->mFlag |= EHF_SYNC_WRITE;
+        }
+    }
+}
+
+
+void Loop::onURingNet(RequestFD* req, s32 res, u32 flags) {
+    StatsCall scall(*this, req);
+    net::HandleTCP* hnd = (net::HandleTCP*)(req->mHandle);
+    s32 err = res < 0 ? System::getAppError(-res) : EE_OK;
+    bool multishot = 0 != (ERF_MULTISHOT & req->mFlags);
+    bool more = 0 != (IORING_CQE_F_MORE & flags);
+    if (!more) {
+        req->mFlags &= ~ERF_MULTISHOT;
+    }
+
+    switch (req->mType) {
+    case ERT_CONNECT:
+    {
+        req->mError = err;
+        if (EE_OK == err) {
+            relinkTime((HandleTime*)hnd);
+        } else {
+            closeHandle(hnd);
+        }
+        req->mCall(req);
+        // post the requests queued before connected
+        postNextRead(hnd);
+        postNextWrite(hnd);
+        unbindFly(hnd);
+        break;
+    }
+    case ERT_READ:
+    {
+        IOURing& uring = mPoller.getIOURing();
+        u16 bid = (u16)(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (res > 0) {
+            req->mError = 0;
+            if (IORING_CQE_F_BUFFER & flags) {
+                // lend the ring buffer to request until callback returned
+                req->mFlags |= ERF_RING_BUF;
+                req->mData = uring.getRingBuf(bid);
+                req->mAllocated = uring.getRingBufSize();
+                req->mUsed = res;
+            } else {
+                req->mUsed += res;
+            }
+        } else if (0 == res) {
+            req->mError = EE_NO_READABLE;
+            closeHandle(hnd);
+        } else if ((EE_RETRY == err || EE_INTR == err || (multishot && -ENOBUFS == res))
+            && (EHF_READABLE & hnd->mFlag)) {
+            addPending(req); // multishot recv will be re-armed if ring buffers exhausted
+            return;
+        } else {
+            req->mError = err;
+            closeHandle(hnd);
+        }
+        req->mCall(req);
+        if (IORING_CQE_F_BUFFER & flags) {
+            uring.recycleRingBuf(bid);
+        }
+        if (more) {
+            // still armed, the request is owned by loop
+            req->detachRingBuf();
+            relinkTime((HandleTime*)hnd);
+            break;
+        }
+        postNextRead(hnd);
+        relinkTime((HandleTime*)hnd);
+        unbindFly(hnd);
+        break;
+    }
+    case ERT_WRITE:
+    {
+        if (res > 0) {
+            req->mError = 0;
+            req->mStepSize += res;
+            if (req->mStepSize < req->mUsed && (EHF_WRITEABLE & hnd->mFlag)) {
+                addPending(req); // send the rest
+                return;
+            }
+        } else if ((EE_RETRY == err || EE_INTR == err) && (EHF_WRITEABLE & hnd->mFlag)) {
+            addPending(req);
+            return;
+        } else {
+            req->mError = 0 == res ? EE_NO_WRITEABLE : err;
+            closeHandle(hnd);
+        }
+        if (EHT_UDP == hnd->getType()) {
+            req->mCall(req);
+        } else {
+            landWrite(hnd, req);
+        }
+        postNextWrite(hnd);
+        relinkTime((HandleTime*)hnd);
+        unbindFly(hnd);
+        break;
+    }
+    case ERT_ACCEPT:
+    {
+        RequestAccept* nd = (RequestAccept*)req;
+        if (res >= 0) {
+            nd->mError = 0;
+            nd->mSocket = res; // SOCK_NONBLOCK had been set
+            if (multishot) {
+                nd->mSocket.getRemoteAddress(nd->mRemote);
+            } else {
+                nd->mRemote.reverse();
+            }
+            AcceptLocal(hnd, nd);
+        } else if ((EE_INTR == err || AcceptNeedRetry(-res)) && (EHF_READABLE & hnd->mFlag)) {
+            addPending(req);
+            return;
+        } else {
+            nd->mError = err;
+            if (EE_OK == closeHandle(hnd)) {
+                Logger::log(ELL_ERROR, "Loop::onURingNet>>accept ecode=%d", err);
+            }
+        }
+        if (more) {
+            nd->mCall(nd); // accept() in callback is ignored while armed
+            break;
+        }
+        if (multishot) {
+            postNextRead(hnd); // arm a spare, or let the next accept() arm
+        }
+        nd->mCall(nd);
+        unbindFly(hnd);
+        break;
+    }
+    default:
+        DASSERT(0);
+        Logger::log(ELL_ERROR, "Loop::onURingNet>>invalid type=%d, handle=%p", req->mType, req);
+        break;
+    }//switch
+}
+
 } //namespace app
@@ -32,6 +32,7 @@
 #include "MapFile.h"
 #include "System.h"
 #include "Logger.h"
+#include "HugePage.h"
 
 namespace app {
 
@@ -224,10 +225,24 @@ bool MapFile::createMap(const s8* iMapName, usz iSize) {
     s32 flag = (EMF_WRITE & mFlag) ? PROT_READ | PROT_WRITE : PROT_READ;
     s32 flag2 = (EMF_SHARE & mFlag) ? MAP_SHARED : MAP_PRIVATE;
     flag2 |= (-1 == mFile) ? MAP_ANON : 0;
-    void* ret = mmap(nullptr, iSize, flag, flag2, mFile, 0);
-    if (MAP_FAILED == ret) {
-        Logger::logError("mmap(%llu) failed,ecode=%d", iSize, System::getAppError());
-        return false;
+    void* ret;
+    if (-1 == mFile && (EMF_WRITE & mFlag) && EHPM_OFF != HugePage::getMode()) {
+        // anonymous memory shared with forked workers, size is rounded to huge page
+        ret = HugePage::mapMem(iSize, 0 != (EMF_SHARE & mFlag));
+        if (!ret) {
+            return false;
+        }
+        mFlag |= EMF_LARGE_PAGE;
+    } else {
+        ret = mmap(nullptr, iSize, flag, flag2, mFile, 0);
+        if (MAP_FAILED == ret) {
+            Logger::logError("mmap(%llu) failed,ecode=%d", iSize, System::getAppError());
+            return false;
+        }
+        if (-1 != mFile && EHPM_OFF != HugePage::getMode()) {
+            // THP of tmpfs/shmem file, need /sys/kernel/mm/transparent_hugepage/shmem_enabled=advise
+            HugePage::adviseMem(ret, iSize);
+        }
     }
     mMemory = ret;
     mMemSize = iSize;
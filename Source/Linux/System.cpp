@@ -38,6 +38,8 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sched.h>
 #include "Logger.h"
 #include "Engine.h"
 
@@ -55,8 +57,10 @@ EngSignal gSignals[] = {
     {SIGCHLD, "SIGCHLD"},
     {SIGSYS, "SIGSYS, SIG_IGN"},
     {SIGPIPE, "SIGPIPE, SIG_IGN"},
+    {SIGUSR2, "SIGUSR2.upgrade"},
     {50, "ENG.kill-50"},   //should in range [SIGRTMIN-SIGRTMAX]
     {51, "ENG.kill-51"},
+    {52, "ENG.kill-52.mem"},
     {0, NULL}
 };
 
@@ -173,6 +177,10 @@ static void AppOnSignal(s32 val, siginfo_t* info, void* pit) {
         System_getStatus();
         break;
 
+    case SIGUSR2: //hot upgrade
+        Engine::getInstance().postCommand(ECT_UPGRADE);
+        break;
+
     case 50:
         Engine::getInstance().postCommand(ECT_ACTIVE);
         break;
@@ -181,6 +189,10 @@ static void AppOnSignal(s32 val, siginfo_t* info, void* pit) {
         printf("cmd=51-----------------\n");
         break;
 
+    case 52: //memory report
+        Engine::getInstance().postCommand(ECT_MEM_REPORT);
+        break;
+
     default:
         break;
     }
@@ -319,6 +331,99 @@ u32 System::getCoreCount() {
 }
 
 
+static bool AppReadSysFile(const s8* fname, s8* buf, usz size) {
+    s32 fd = ::open(fname, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t len = ::read(fd, buf, size - 1);
+    ::close(fd);
+    buf[len > 0 ? len : 0] = '\0';
+    return len > 0;
+}
+
+void System::getCpuInfo(TVector<CpuInfo>& out) {
+    out.resize(0);
+    s8 buf[1024];
+    TVector<u16> ids;
+    if (AppReadSysFile("/sys/devices/system/cpu/online", buf, sizeof(buf))) {
+        parseCpuList(buf, ids);
+    } else {
+        for (u32 i = 0; i < getCoreCount(); ++i) {
+            ids.pushBack((u16)i);
+        }
+    }
+    s8 fname[128];
+    for (usz i = 0; i < ids.size(); ++i) {
+        CpuInfo nd;
+        nd.mID = ids[i];
+        nd.mNode = 0;
+        nd.mCore = ids[i];
+        snprintf(fname, sizeof(fname), "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", nd.mID);
+        TVector<u16> sibs;
+        if (AppReadSysFile(fname, buf, sizeof(buf)) && parseCpuList(buf, sibs) > 0) {
+            nd.mCore = sibs[0];
+        }
+        out.pushBack(nd);
+    }
+
+    // 节点目录不存在时(未开启NUMA)全部视为node0
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (!dir) {
+        return;
+    }
+    u32 node;
+    for (struct dirent* it = readdir(dir); it; it = readdir(dir)) {
+        if (1 != sscanf(it->d_name, "node%u", &node)) {
+            continue;
+        }
+        snprintf(fname, sizeof(fname), "/sys/devices/system/node/node%u/cpulist", node);
+        TVector<u16> cpus;
+        if (!AppReadSysFile(fname, buf, sizeof(buf)) || 0 == parseCpuList(buf, cpus)) {
+            continue;
+        }
+        for (usz i = 0; i < cpus.size(); ++i) {
+            for (usz k = 0; k < out.size(); ++k) {
+                if (out[k].mID == cpus[i]) {
+                    out[k].mNode = (u16)node;
+                    break;
+                }
+            }
+        }
+    }
+    closedir(dir);
+}
+
+s32 System::bindCPU(const u16* cpus, usz cnt) {
+    if (!cpus || 0 == cnt) {
+        return EE_INVALID_PARAM;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (usz i = 0; i < cnt; ++i) {
+        if (cpus[i] < CPU_SETSIZE) {
+            CPU_SET(cpus[i], &mask);
+        }
+    }
+    // pid=0 means the calling thread
+    return 0 == sched_setaffinity(0, sizeof(mask), &mask) ? EE_OK : getAppError();
+}
+
+s32 System::bindNode(u32 node) {
+#if defined(SYS_set_mempolicy)
+    const s32 mpol_preferred = 1; // MPOL_PREFERRED of <numaif.h>, fall back to other nodes if no memory
+    unsigned long mask[4] = {0};
+    if (node >= sizeof(mask) * 8) {
+        return EE_INVALID_PARAM;
+    }
+    mask[node / (sizeof(mask[0]) * 8)] = 1UL << (node % (sizeof(mask[0]) * 8));
+    return 0 == syscall(SYS_set_mempolicy, mpol_preferred, mask, sizeof(mask) * 8 + 1) ? EE_OK : getAppError();
+#else
+    return EE_ERROR;
+#endif
+}
+
+
 u32 System::getPageSize() {
     static u32 ret = AppGetPageSize();
     return ret;
@@ -429,6 +534,13 @@ void System::waitProcess(void* handle) {
     
 }
 
+bool System::isProcessAlive(s32 pid) {
+    if (pid <= 0) {
+        return false;
+    }
+    return 0 == ::kill(pid, 0) || EPERM == errno;
+}
+
 s32 System::createProcess(usz socket, void*& handle) {
     handle = nullptr;
 
@@ -451,6 +563,45 @@ s32 System::createProcess(usz socket, void*& handle) {
     return pid;
 }
 
+s32 System::spawnProcess(const String& file, const TVector<s32>& keep, const TVector<String>& envs) {
+    // prepare all before fork(), the child of a multithreaded process can call async-signal-safe funcs only
+    TVector<const s8*> envp(64);
+    for (s8** env = environ; *env; ++env) {
+        envp.pushBack(*env);
+    }
+    for (usz i = 0; i < envs.size(); ++i) {
+        envp.pushBack(envs[i].c_str());
+    }
+    envp.pushBack(nullptr);
+    const s8* argv[] = {file.c_str(), nullptr};
+
+    s32 pid = fork();
+    if (pid < 0) {
+        Logger::logError("System::spawnProcess>>fork() failed,ecode=%d", getError());
+        return pid;
+    }
+    if (pid > 0) {
+        Logger::logInfo("System::spawnProcess>>fork() pid=%d, file=%s", pid, file.c_str());
+        return pid;
+    }
+
+    setsid();
+    // close_range(3, ~0U, CLOSE_RANGE_CLOEXEC), linux v5.11
+#if defined(SYS_close_range)
+    if (0 != syscall(SYS_close_range, 3U, ~0U, 4U))
+#endif
+    {
+        for (s32 fd = 3, max = (s32)sysconf(_SC_OPEN_MAX); fd < max; ++fd) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+    for (usz i = 0; i < keep.size(); ++i) {
+        fcntl(keep[i], F_SETFD, 0);
+    }
+    execve(argv[0], const_cast<s8* const*>(argv), const_cast<s8* const*>(envp.getPointer()));
+    _exit(2);
+}
+
 String System::getWorkingPath() {
     usz pathSize = 128;
     String wkpath(pathSize);
@@ -0,0 +1,78 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#include "LoopStats.h"
+#include "Logger.h"
+#include "System.h"
+
+namespace app {
+
+static const s8* G_PHASE_NAME[ELP_COUNT] = {"time", "poll", "events", "task", "pending", "closed", "busy"};
+
+
+void LoopStats::addCall(s32 htype, s32 rtype, u64 cost, u64 slow) {
+    bool isslow = cost > slow;
+    mRequests.fetch_add(1, std::memory_order_relaxed);
+    mCall.add(cost);
+    if (htype >= 0 && htype < EHT_COUNT) {
+        mByHandle[htype].add(cost, isslow);
+    }
+    if (rtype >= 0 && rtype < ERT_COUNT) {
+        mByRequest[rtype].add(cost, isslow);
+    }
+    if (isslow) {
+        Logger::log(ELL_WARN, "LoopStats::addCall>>slow callback, pid=%d, handle=%d, request=%d, cost=%llu us",
+            System::getPID(), htype, rtype, cost);
+    }
+}
+
+
+void LoopStats::log() const {
+    Logger::log(ELL_INFO, "LoopStats::log>>steps=%llu, events=%llu, requests=%llu, tasks=%llu", mSteps.load(),
+        mEvents.load(), mRequests.load(), mTasks.load());
+    for (s32 i = 0; i < ELP_COUNT; ++i) {
+        const Histogram& it = mPhase[i];
+        Logger::log(ELL_INFO, "LoopStats::log>>%s[count=%llu, p50=%llu, p99=%llu, p999=%llu, max=%llu] us",
+            G_PHASE_NAME[i], it.mCount.load(), it.getPercentile(50), it.getPercentile(99), it.getPercentile(99.9),
+            it.mMax.load());
+    }
+    for (s32 i = 0; i < EHT_COUNT; ++i) {
+        const LoopCallStat& it = mByHandle[i];
+        if (it.mCount.load() > 0) {
+            Logger::log(ELL_INFO, "LoopStats::log>>handle[%d][count=%llu, avg=%llu, max=%llu, slow=%llu] us", i,
+                it.mCount.load(), it.mTotal.load() / it.mCount.load(), it.mMax.load(), it.mSlow.load());
+        }
+    }
+    for (s32 i = 0; i < ERT_COUNT; ++i) {
+        const LoopCallStat& it = mByRequest[i];
+        if (it.mCount.load() > 0) {
+            Logger::log(ELL_INFO, "LoopStats::log>>request[%d][count=%llu, avg=%llu, max=%llu, slow=%llu] us", i,
+                it.mCount.load(), it.mTotal.load() / it.mCount.load(), it.mMax.load(), it.mSlow.load());
+        }
+    }
+}
+
+} // namespace app
@@ -0,0 +1,88 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#include "MemAccount.h"
+#include "Logger.h"
+#include "Timer.h"
+
+namespace app {
+
+// used before the shared mem created
+static MemUsage gLocalUsage;
+
+thread_local MemUsage* MemAccount::gThreadSlot = nullptr;
+std::atomic<MemUsage*> MemAccount::gDefaultSlot(&gLocalUsage);
+
+static const s8* const G_MEM_USAGE_NAME[EMU_COUNT] = {"other", "net", "http", "tls", "redis", "lua", "proxy"};
+
+
+const s8* MemAccount::getName(s32 tag) {
+    return tag >= 0 && tag < EMU_COUNT ? G_MEM_USAGE_NAME[tag] : "none";
+}
+
+
+void MemAccount::setDefaultSlot(MemUsage* it) {
+    MemUsage* old = gDefaultSlot.load();
+    it = it ? it : &gLocalUsage;
+    if (it == old) {
+        return;
+    }
+    if (it == &gLocalUsage) {
+        gLocalUsage.clear();
+    }
+    it->add(*old);
+    gDefaultSlot = it;
+}
+
+
+void MemAccount::log(const s8* who, const MemUsage& sum) {
+    // snapshot of last report, the rates are counted by it
+    static MemUsage last;
+    static s64 lastTime = 0;
+    const s64 now = Timer::getRelativeTime();
+    const s64 span = lastTime > 0 && now > lastTime ? now - lastTime : 0;
+    s64 live = 0;
+    for (u32 i = 0; i < EMU_COUNT; ++i) {
+        const MemUsageItem& it = sum.mItems[i];
+        MemUsageItem& old = last.mItems[i];
+        const s64 allocs = it.mAllocs.load();
+        const s64 bytes = it.mBytes.load();
+        live += it.mLive.load();
+        if (allocs > 0) {
+            Logger::log(ELL_INFO,
+                "MemAccount::log>>%s, %s[live=%lldKB, peak=%lldKB, alloc=%lld, %lld/s, %lldKB/s]", who, getName(i),
+                it.mLive.load() >> 10, it.mPeak.load() >> 10, allocs,
+                span > 0 ? (allocs - old.mAllocs.load()) * 1000 / span : 0,
+                span > 0 ? ((bytes - old.mBytes.load()) >> 10) * 1000 / span : 0);
+        }
+        old.mAllocs = allocs;
+        old.mBytes = bytes;
+    }
+    lastTime = now;
+    Logger::log(ELL_INFO, "MemAccount::log>>%s, total live=%lldKB, span=%lldms", who, live >> 10, span);
+}
+
+} // namespace app
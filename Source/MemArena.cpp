@@ -0,0 +1,101 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#include "MemArena.h"
+#include "MemoryPool.h"
+
+namespace app {
+
+void MemArena::init(MemPool* it) {
+    DASSERT(!mHead);
+    mPool = it;
+    if (it) {
+        mHead = createBlock(mBlockSize);
+    }
+}
+
+
+void* MemArena::allocate(usz size, usz align) {
+    ++mAllocs;
+    if (mHead) {
+        s8* base = reinterpret_cast<s8*>(mHead + 1);
+        s8* pos = AppAlignPoint(base + mHead->mUsed, align);
+        if (pos + size <= base + mHead->mSize) {
+            mHead->mUsed = pos + size - base;
+            return pos;
+        }
+    }
+    Block* blk;
+    if (size + align > mBlockSize / 2) { // dedicated block, keep the current one
+        blk = createBlock(size + align);
+        if (mHead) {
+            blk->mNext = mHead->mNext;
+            mHead->mNext = blk;
+        } else {
+            mHead = blk;
+        }
+        blk->mUsed = blk->mSize;
+        return AppAlignPoint(reinterpret_cast<s8*>(blk + 1), align);
+    }
+    blk = createBlock(mBlockSize);
+    blk->mNext = mHead;
+    mHead = blk;
+    s8* base = reinterpret_cast<s8*>(blk + 1);
+    s8* pos = AppAlignPoint(base, align);
+    blk->mUsed = pos + size - base;
+    return pos;
+}
+
+
+void MemArena::reset() {
+    for (Block* blk = mHead; blk;) {
+        Block* next = blk->mNext;
+        if (blk->mPool) {
+            blk->mPool->release(blk);
+        } else {
+            delete[] reinterpret_cast<s8*>(blk);
+        }
+        blk = next;
+    }
+    mHead = nullptr;
+    mPool = nullptr;
+    mBlocks = 0;
+    mAllocs = 0;
+}
+
+
+MemArena::Block* MemArena::createBlock(usz size) {
+    Block* ret = reinterpret_cast<Block*>(
+        mPool ? mPool->allocate((s32)(sizeof(Block) + size)) : new s8[sizeof(Block) + size]);
+    ret->mNext = nullptr;
+    ret->mPool = mPool;
+    ret->mSize = size;
+    ret->mUsed = 0;
+    ++mBlocks;
+    return ret;
+}
+
+} // namespace app
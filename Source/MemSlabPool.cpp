@@ -68,6 +68,7 @@ MemSlabPool::MemSlabPool(usz msz) {
 
 void MemSlabPool::initSlabSize() {
     G_PageSize = System::getPageSize();
+    G_PageSizeShift = 0;
     for (usz i = G_PageSize;
         i >>= 1; G_PageSizeShift++) {
         //
@@ -24,18 +24,58 @@
 
 
 #include "MemoryHub.h"
+#include "ThreadLocal.h"
 #include <memory.h>
 
 namespace app {
 
+#ifdef D_THREADSAFE_MEMPOOL
+// blocks of each class in a thread cache, about 64KB at most
+static const u32 G_CACHE_SIZE[MemoryHub::EMT_DEFAULT] = {64, 64, 64, 64, 32, 16, 8, 6};
+
+static std::atomic<u64> G_HUB_ID(0);
+#endif
+
+// bytes of each class, @see MemAccount
+static const u32 G_CLASS_BYTES[MemoryHub::EMT_DEFAULT] = {128, 256, 512, 1024, 2048, 4096, 8192, 10240};
+
+
 MemoryHub::MemoryHub() :
-    mReferenceCount(1) {
+#ifdef D_THREADSAFE_MEMPOOL
+    mCaches(nullptr),
+    mNextHub(nullptr),
+    mID(++G_HUB_ID),
+    mThreadCache(true),
+#endif
+    mReferenceCount(1),
+    mTag(EMU_OTHER) {
     setPageCount(16);
+#ifdef D_THREADSAFE_MEMPOOL
+    std::lock_guard<std::mutex> ak(getHubsMutex());
+    mNextHub = getHubs();
+    getHubs() = this;
+#endif
 }
 
 
 MemoryHub::~MemoryHub() {
     DASSERT(0 == mReferenceCount.load());
+#ifdef D_THREADSAFE_MEMPOOL
+    {
+        // the caches of threads still alive are dropped with the pools
+        std::lock_guard<std::mutex> ak(getHubsMutex());
+        for (MemoryHub** nd = &getHubs(); *nd; nd = &(*nd)->mNextHub) {
+            if (*nd == this) {
+                *nd = mNextHub;
+                break;
+            }
+        }
+    }
+    for (ThreadCache* nd = mCaches; nd; nd = mCaches) {
+        mCaches = nd->mNext;
+        delete nd;
+    }
+#endif
 }
 
 
@@ -82,89 +122,32 @@ s8* MemoryHub::allocate(u64 bytesWanted, u64 align/* = sizeof(void*)*/) {
 #ifdef APP_DISABLE_BYTE_POOL
     return malloc(bytesWanted);
 #endif
-    s8* out;
+    EMemType tp;
     if (bytesWanted <= 128) {
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex128.lock();
-#endif
-        out = (s8*)mPool128.allocate();
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex128.unlock();
-#endif
-        return getUserPointer(out, align, EMT_128);
+        tp = EMT_128;
+    } else if (bytesWanted <= 256) {
+        tp = EMT_256;
+    } else if (bytesWanted <= 512) {
+        tp = EMT_512;
+    } else if (bytesWanted <= 1024) {
+        tp = EMT_1024;
+    } else if (bytesWanted <= 2048) {
+        tp = EMT_2048;
+    } else if (bytesWanted <= 4096) {
+        tp = EMT_4096;
+    } else if (bytesWanted <= 8192) {
+        tp = EMT_8192;
+    } else if (bytesWanted <= 10240) {
+        tp = EMT_10K;
+    } else {
+        // the size is kept ahead of block for MemAccount
+        s8* out = (s8*) ::malloc(bytesWanted + sizeof(u64) + 1);
+        *reinterpret_cast<u64*>(out) = bytesWanted;
+        MemAccount::onAlloc(mTag, bytesWanted);
+        return getUserPointer(out + sizeof(u64), align, EMT_DEFAULT);
     }
-    if (bytesWanted <= 256) {
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex256.lock();
-#endif
-        out = (s8*)mPool256.allocate();
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex256.unlock();
-#endif
-        return getUserPointer(out, align, EMT_256);
-    }
-    if (bytesWanted <= 512) {
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex512.lock();
-#endif
-        out = (s8*)mPool512.allocate();
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex512.unlock();
-#endif
-        return getUserPointer(out, align, EMT_512);
-    }
-    if (bytesWanted <= 1024) {
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex1024.lock();
-#endif
-        out = (s8*)mPool1024.allocate();
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex1024.unlock();
-#endif
-        return getUserPointer(out, align, EMT_1024);
-    }
-    if (bytesWanted <= 2048) {
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex2048.lock();
-#endif
-        out = (s8*)mPool2048.allocate();
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex2048.unlock();
-#endif
-        return getUserPointer(out, align, EMT_2048);
-    }
-    if (bytesWanted <= 4096) {
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex4096.lock();
-#endif
-        out = (s8*)mPool4096.allocate();
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex4096.unlock();
-#endif
-        return getUserPointer(out, align, EMT_4096);
-    }
-    if (bytesWanted <= 8192) {
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex8192.lock();
-#endif
-        out = (s8*)mPool8192.allocate();
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex8192.unlock();
-#endif
-        return getUserPointer(out, align, EMT_8192);
-    }
-    if (bytesWanted <= 10240) {
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex10K.lock();
-#endif
-        out = (s8*)mPool10K.allocate();
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex10K.unlock();
-#endif
-        return getUserPointer(out, align, EMT_10K);
-    }
-    out = (s8*) ::malloc(bytesWanted + 1);
-    return getUserPointer(out, align, EMT_DEFAULT);
+    MemAccount::onAlloc(mTag, G_CLASS_BYTES[tp]);
+    return getUserPointer((s8*)popBlock(tp), align, tp);
 }
 
 
@@ -180,81 +163,132 @@ void MemoryHub::release(void* data) {
     ::free(data);
 #endif
     s8* realData;
-    switch (getRealPointer(data, realData)) {
-    case EMT_128:
+    const EMemType tp = getRealPointer(data, realData);
+    if (tp < EMT_DEFAULT) {
+        MemAccount::onFree(mTag, G_CLASS_BYTES[tp]);
+        pushBlock(tp, realData);
+    } else if (EMT_DEFAULT == tp) {
+        realData -= sizeof(u64);
+        MemAccount::onFree(mTag, *reinterpret_cast<u64*>(realData));
+        ::free(realData);
+    } else {
+        DASSERT(0);
+    }
+}
+
+
+void MemoryHub::clear() {
 #ifdef D_THREADSAFE_MEMPOOL
-        mMutex128.lock();
+    {
+        // the cached blocks belong to the pools, @note no thread should be using this hub
+        std::lock_guard<std::mutex> ak(mCacheMutex);
+        for (ThreadCache* nd = mCaches; nd; nd = nd->mNext) {
+            memset(nd->mCount, 0, sizeof(nd->mCount));
+        }
+    }
+    mPool128.clear();
+    mPool256.clear();
+    mPool512.clear();
+    mPool1024.clear();
+    mPool2048.clear();
+    mPool4096.clear();
+    mPool8192.clear();
+    mPool10K.clear();
+#endif //D_THREADSAFE_MEMPOOL
+}
+
+
+void* MemoryHub::popBlock(EMemType tp) {
+#ifdef D_THREADSAFE_MEMPOOL
+    ThreadCache* cache = getCache();
+    if (cache) {
+        u32& cnt = cache->mCount[tp];
+        if (cnt > 0) {
+            cache->mHits[tp].store(cache->mHits[tp].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return cache->mSlot[tp][--cnt];
+        }
+        cache->mMisses[tp].store(cache->mMisses[tp].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        const u32 batch = G_CACHE_SIZE[tp] / 2;
+        std::lock_guard<std::mutex> ak(mMutex[tp]);
+        for (; cnt < batch; ++cnt) {
+            cache->mSlot[tp][cnt] = popPool(tp);
+        }
+        return popPool(tp);
+    }
+    std::lock_guard<std::mutex> ak(mMutex[tp]);
 #endif
-        mPool128.release((u8(*)[128]) realData);
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex128.unlock();
+    return popPool(tp);
+}
+
+
+void MemoryHub::pushBlock(EMemType tp, void* it) {
+#ifdef D_THREADSAFE_MEMPOOL
+    ThreadCache* cache = getCache();
+    if (cache) {
+        if (cache->mCount[tp] >= G_CACHE_SIZE[tp]) {
+            cache->mFlushes[tp].store(
+                cache->mFlushes[tp].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            flushCache(*cache, tp, G_CACHE_SIZE[tp] / 2);
+        }
+        cache->mSlot[tp][cache->mCount[tp]++] = it;
+        return;
+    }
+    std::lock_guard<std::mutex> ak(mMutex[tp]);
 #endif
+    pushPool(tp, it);
+}
+
+
+void* MemoryHub::popPool(EMemType tp) {
+    switch (tp) {
+    case EMT_128:
+        return mPool128.allocate();
+    case EMT_256:
+        return mPool256.allocate();
+    case EMT_512:
+        return mPool512.allocate();
+    case EMT_1024:
+        return mPool1024.allocate();
+    case EMT_2048:
+        return mPool2048.allocate();
+    case EMT_4096:
+        return mPool4096.allocate();
+    case EMT_8192:
+        return mPool8192.allocate();
+    case EMT_10K:
+        return mPool10K.allocate();
+    default:
+        DASSERT(0);
+        return nullptr;
+    }
+}
+
+
+void MemoryHub::pushPool(EMemType tp, void* it) {
+    switch (tp) {
+    case EMT_128:
+        mPool128.release((u8(*)[128]) it);
         break;
     case EMT_256:
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex256.lock();
-#endif
-        mPool256.release((u8(*)[256]) realData);
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex256.unlock();
-#endif
+        mPool256.release((u8(*)[256]) it);
         break;
     case EMT_512:
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex512.lock();
-#endif
-        mPool512.release((u8(*)[512]) realData);
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex512.unlock();
-#endif
+        mPool512.release((u8(*)[512]) it);
         break;
     case EMT_1024:
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex1024.lock();
-#endif
-        mPool1024.release((u8(*)[1024]) realData);
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex1024.unlock();
-#endif
+        mPool1024.release((u8(*)[1024]) it);
         break;
     case EMT_2048:
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex2048.lock();
-#endif
-        mPool2048.release((u8(*)[2048]) realData);
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex2048.unlock();
-#endif
+        mPool2048.release((u8(*)[2048]) it);
         break;
     case EMT_4096:
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex4096.lock();
-#endif
-        mPool4096.release((u8(*)[4096]) realData);
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex4096.unlock();
-#endif
+        mPool4096.release((u8(*)[4096]) it);
         break;
     case EMT_8192:
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex8192.lock();
-#endif
-        mPool8192.release((u8(*)[8192]) realData);
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex8192.unlock();
-#endif
+        mPool8192.release((u8(*)[8192]) it);
         break;
     case EMT_10K:
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex10K.lock();
-#endif
-        mPool10K.release((u8(*)[10240]) realData);
-#ifdef D_THREADSAFE_MEMPOOL
-        mMutex10K.unlock();
-#endif
-        break;
-    case EMT_DEFAULT:
-        ::free(realData);
+        mPool10K.release((u8(*)[10240]) it);
         break;
     default:
         DASSERT(0);
@@ -263,17 +297,147 @@ void MemoryHub::release(void* data) {
 }
 
 
-void MemoryHub::clear() {
 #ifdef D_THREADSAFE_MEMPOOL
-    mPool128.clear();
-    mPool256.clear();
-    mPool512.clear();
-    mPool1024.clear();
-    mPool2048.clear();
-    mPool4096.clear();
-    mPool8192.clear();
-    mPool10K.clear();
-#endif //D_THREADSAFE_MEMPOOL
+
+void MemoryHub::getStats(EMemType tp, MemHubStats& out) {
+    out.mHits = 0;
+    out.mMisses = 0;
+    out.mFlushes = 0;
+    if (tp >= EMT_DEFAULT) {
+        return;
+    }
+    std::lock_guard<std::mutex> ak(mCacheMutex);
+    for (ThreadCache* nd = mCaches; nd; nd = nd->mNext) {
+        out.mHits += nd->mHits[tp].load(std::memory_order_relaxed);
+        out.mMisses += nd->mMisses[tp].load(std::memory_order_relaxed);
+        out.mFlushes += nd->mFlushes[tp].load(std::memory_order_relaxed);
+    }
+}
+
+
+// give back the oldest blocks, keep the newest (cache hot) ones
+void MemoryHub::flushCache(ThreadCache& it, EMemType tp, u32 keep) {
+    u32& cnt = it.mCount[tp];
+    if (cnt <= keep) {
+        return;
+    }
+    const u32 gone = cnt - keep;
+    {
+        std::lock_guard<std::mutex> ak(mMutex[tp]);
+        for (u32 i = 0; i < gone; ++i) {
+            pushPool(tp, it.mSlot[tp][i]);
+        }
+    }
+    memmove(it.mSlot[tp], it.mSlot[tp] + gone, keep * sizeof(it.mSlot[tp][0]));
+    cnt = keep;
+}
+
+
+MemoryHub::ThreadCache* MemoryHub::getCache() {
+    if (!mThreadCache) {
+        return nullptr;
+    }
+    ThreadCaches* caches = ThreadLocal<ThreadCaches>::get();
+    if (!caches) {
+        return nullptr; // used by other thread_local while thread exiting, use the shared pools
+    }
+    ThreadCaches& tls = *caches;
+    for (u32 i = 0; i < G_MAX_HUBS; ++i) {
+        CacheEntry& nd = tls.mItems[i];
+        if (nd.mHub == this && nd.mID == mID) {
+            return nd.mCache;
+        }
+    }
+    // 1st time of this thread, bind a cache
+    std::lock_guard<std::mutex> ak(getHubsMutex());
+    for (u32 i = 0; i < G_MAX_HUBS; ++i) {
+        CacheEntry& nd = tls.mItems[i];
+        if (nd.mHub && !isAlive(nd)) {
+            nd.mHub = nullptr; // the hub was deleted, and so the cache
+        }
+        if (!nd.mHub) {
+            nd.mCache = createCache();
+            nd.mID = mID;
+            nd.mHub = this;
+            return nd.mCache;
+        }
+    }
+    return nullptr; // too many hubs, use the shared pools
+}
+
+
+MemoryHub::ThreadCache* MemoryHub::createCache() {
+    std::lock_guard<std::mutex> ak(mCacheMutex);
+    for (ThreadCache* nd = mCaches; nd; nd = nd->mNext) {
+        if (!nd->mUsed) {
+            nd->mUsed = true; // left by an exited thread
+            return nd;
+        }
+    }
+    ThreadCache* ret = new ThreadCache();
+    ret->mUsed = true;
+    memset(ret->mCount, 0, sizeof(ret->mCount));
+    for (u32 i = 0; i < EMT_DEFAULT; ++i) {
+        ret->mHits[i].store(0);
+        ret->mMisses[i].store(0);
+        ret->mFlushes[i].store(0);
+    }
+    ret->mNext = mCaches;
+    mCaches = ret;
+    return ret;
+}
+
+
+bool MemoryHub::isAlive(const CacheEntry& it) {
+    for (MemoryHub* nd = getHubs(); nd; nd = nd->mNextHub) {
+        if (nd == it.mHub) {
+            return nd->mID == it.mID;
+        }
+    }
+    return false;
+}
+
+
+std::mutex& MemoryHub::getHubsMutex() {
+    static std::mutex ret;
+    return ret;
+}
+
+
+MemoryHub*& MemoryHub::getHubs() {
+    static MemoryHub* ret = nullptr;
+    return ret;
 }
 
+
+MemoryHub::ThreadCaches::ThreadCaches() {
+    memset(mItems, 0, sizeof(mItems));
+}
+
+
+MemoryHub::ThreadCaches::~ThreadCaches() {
+    std::lock_guard<std::mutex> ak(getHubsMutex());
+    for (u32 i = 0; i < G_MAX_HUBS; ++i) {
+        CacheEntry& nd = mItems[i];
+        if (nd.mHub && isAlive(nd)) {
+            for (u32 tp = 0; tp < EMT_DEFAULT; ++tp) {
+                nd.mHub->flushCache(*nd.mCache, (EMemType)tp, 0);
+            }
+            std::lock_guard<std::mutex> ak2(nd.mHub->mCacheMutex);
+            nd.mCache->mUsed = false;
+        }
+        nd.mHub = nullptr;
+    }
+}
+
+#else
+
+void MemoryHub::getStats(EMemType tp, MemHubStats& out) {
+    out.mHits = 0;
+    out.mMisses = 0;
+    out.mFlushes = 0;
+}
+
+#endif //D_THREADSAFE_MEMPOOL
+
 }//namespace app
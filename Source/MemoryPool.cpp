@@ -35,20 +35,30 @@ static s16 AppGenPoolID() {
     return ++ids;
 }
 
-MemPool* MemPool::createMemPool(s32 psz) {
+MemPool* MemPool::createMemPool(s32 psz, s32 tag) {
     psz += sizeof(MemPool);
-    MemPool* ret = (MemPool*)malloc(psz);
+    MemPool* ret = (MemPool*)HugePage::allocPiece(psz);
+    if (!ret) {
+        ret = (MemPool*)malloc(psz);
+    }
     new (ret) MemPool();
     ret->initPool(psz);
+    ret->mUsage = (s16)tag;
+    MemAccount::onAlloc(tag, psz);
     return ret;
 }
 
 void MemPool::releaseMemPool(MemPool* it) {
+    s32 psz = it->mTotal;
+    MemAccount::onFree(it->mUsage, psz);
     it->~MemPool();
-    free(it);
+    if (!HugePage::releasePiece(it, psz)) {
+        free(it);
+    }
 }
 
-MemPool::MemPool() : mTotal(0), mUsed(0), mCountNew(0), mPoolID(AppGenPoolID()), mRover(nullptr) {
+MemPool::MemPool() :
+    mTotal(0), mUsed(0), mCountNew(0), mPoolID(AppGenPoolID()), mUsage(EMU_OTHER), mRover(nullptr) {
 }
 
 MemPool::~MemPool() {
@@ -88,7 +88,7 @@ s32 Acceptor::open(const NetAddress& addr) {
     mFlyCount = 0;
     mTCP.setLocal(addr);
     const_cast<NetAddress&>(mTCP.getRemote()).setAddrSize(mTCP.getLocal().getAddrSize());
-    s32 ret = mLoop.openHandle(&mTCP);
+    s32 ret = mLoop.openHandle(&mTCP, &mOption);
     if (EE_OK == ret) {
         postAccept();
         Logger::log(ELL_INFO, "Acceptor::open>>listen=%s, backend=%s",
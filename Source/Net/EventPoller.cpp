@@ -32,6 +32,7 @@
 #include <Windows.h>
 #elif defined(DOS_LINUX) || defined(DOS_ANDROID)
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <errno.h>
 #endif
@@ -159,7 +160,7 @@ bool EventPoller::postEvent(SEvent& iEvent) {
 
 namespace app {
 
-EventPoller::EventPoller() :mEpollFD(-1) {
+EventPoller::EventPoller() :mEpollFD(-1), mWakeFD(-1) {
     DASSERT(sizeof(SEvent) == sizeof(epoll_event));
     DASSERT(DOFFSET(SEvent, mEvent) == DOFFSET(epoll_event, events));
     DASSERT(DOFFSET(SEvent, mData) == DOFFSET(epoll_event, data));
@@ -191,6 +192,20 @@ bool EventPoller::open() {
     if (-1 == mEpollFD) {
         return false;
     }
+    mWakeFD = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (-1 == mWakeFD) {
+        Logger::log(ELL_ERROR, "EventPoller::open>>eventfd ecode=%d", System::getAppError());
+        close();
+        return false;
+    }
+    SEvent evt;
+    evt.mEvent = EPOLLIN; // level triggered, read by clearWakeEvent()
+    evt.mData.mPointer = &mWakeFD;
+    if (!add(mWakeFD, evt)) {
+        Logger::log(ELL_ERROR, "EventPoller::open>>add eventfd ecode=%d", System::getAppError());
+        close();
+        return false;
+    }
     return mIOUR.open(mEpollFD, 256, IORING_SETUP_SQPOLL);
 }
 
@@ -200,6 +215,10 @@ void EventPoller::close() {
         mIOUR.close();
         mEpollFD = -1;
     }
+    if (-1 != mWakeFD) {
+        ::close(mWakeFD);
+        mWakeFD = -1;
+    }
 }
 
 s32 EventPoller::getEvent(SEvent& iEvent, u32 iTime) {
@@ -245,8 +264,16 @@ bool EventPoller::modify(s32 fd, SEvent& iEvent) {
 
 
 bool EventPoller::postEvent(SEvent& iEvent) {
-    return false;
-    //return sizeof(iEvent.mEvent) == mSocketPair.getSocketB().sendAll(&iEvent.mEvent, sizeof(iEvent.mEvent));
+    u64 val = 1;
+    return sizeof(val) == ::write(mWakeFD, &val, sizeof(val));
+}
+
+
+void EventPoller::clearWakeEvent() {
+    u64 val;
+    if (sizeof(val) != ::read(mWakeFD, &val, sizeof(val))) {
+        DLOG(ELL_ERROR, "EventPoller::clearWakeEvent>>ecode=%d", System::getAppError());
+    }
 }
 
 
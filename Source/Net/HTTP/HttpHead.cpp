@@ -36,6 +36,35 @@ HttpHead::~HttpHead() {
 }
 
 
+HttpHead& HttpHead::operator=(const HttpHead& it) {
+    if (&it != this) {
+        mData.clear();
+        mDataLen = 0;
+        for (usz i = 0; i < it.mData.size(); ++i) {
+            const HeadLine& nd = it.mData[i];
+            add(StringView(nd.mKey.c_str(), nd.mKey.size()), StringView(nd.mVal.c_str(), nd.mVal.size()));
+        }
+        mChunked = it.mChunked;
+    }
+    return *this;
+}
+
+
+HttpHead& HttpHead::operator=(HttpHead&& it) noexcept {
+    if (&it != this) {
+        if (mArena != it.mArena) {
+            return *this = static_cast<const HttpHead&>(it);
+        }
+        mData = std::move(it.mData);
+        mDataLen = it.mDataLen;
+        mChunked = it.mChunked;
+        it.mDataLen = 0;
+        it.mChunked = false;
+    }
+    return *this;
+}
+
+
 bool HttpHead::isChunked() const {
     return mChunked;
     //StringView nm("Transfer-Encoding", sizeof("Transfer-Encoding") - 1);
@@ -45,13 +74,13 @@ bool HttpHead::isChunked() const {
 
 void HttpHead::add(const StringView& key, const StringView& val) {
     mDataLen += key.mLen + val.mLen;
-    HeadLine nd = {key, val};
+    HeadLine nd(key, val, mArena);
     mData.emplaceBack(nd);
 }
 
 void HttpHead::add(const String& key, const String& val) {
     mDataLen += key.size() + val.size();
-    HeadLine nd = {key, val};
+    HeadLine nd(key, val, mArena);
     mData.emplaceBack(nd);
 }
 
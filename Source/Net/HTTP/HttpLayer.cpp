@@ -10,6 +10,9 @@ namespace net {
 
 u32 HttpLayer::GMAX_HEAD_SIZE = HTTP_MAX_HEADER_SIZE;
 
+// body not less than this is sent in place by RequestIOV, @see HttpLayer::sendOut()
+static const usz G_IOV_BODY_MIN = 1024;
+
 HttpLayer::HttpLayer(EHttpParserType tp, bool https, TlsContext* tlsContext) :
     mPType(tp), mWebSite(nullptr), mMsg(nullptr), mHttpError(HPE_OK), mHTTPS(https), mTlsContext(tlsContext) {
     clear();
@@ -21,14 +24,27 @@ HttpLayer::~HttpLayer() {
         mWebSite->drop();
         mWebSite = nullptr;
     }
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    if (mCache) {
+        BufferPool::releaseBuf(mCache);
+        mCache = nullptr;
+    }
+#endif
     if (mPool) {
         MemPool::releaseMemPool(mPool);
         mPool = nullptr;
     }
 }
 
+MemPool* HttpLayer::getMemPool() {
+    if (!mPool) {
+        mPool = MemPool::createMemPool(16 * 1024, EMU_HTTP);
+    }
+    return mPool;
+}
+
 RequestFD* HttpLayer::createMem(usz len) {
-    RequestFD* it = reinterpret_cast<RequestFD*>(mPool->allocate(sizeof(RequestFD) + len));
+    RequestFD* it = reinterpret_cast<RequestFD*>(BufferPool::allocBuf(sizeof(RequestFD) + len, EMU_HTTP));
     new ((void*)it) RequestFD();
     it->mAllocated = len;
     it->mData = (s8*)(it + 1);
@@ -36,14 +52,30 @@ RequestFD* HttpLayer::createMem(usz len) {
     return it;
 }
 
+RequestIOV* HttpLayer::createMemIOV(usz len) {
+    RequestIOV* it = reinterpret_cast<RequestIOV*>(BufferPool::allocBuf(sizeof(RequestIOV) + len, EMU_HTTP));
+    new ((void*)it) RequestIOV();
+    it->mAllocated = (u32)len;
+    it->mData = (s8*)(it + 1);
+    return it;
+}
+
 void HttpLayer::deleteMem(RequestFD* it) {
-    mPool->release(it);
+    if (ERF_IOV & it->mFlags) {
+        // not sent, the slices are still held, eg: mBodyFly of HttpMsg
+        reinterpret_cast<RequestIOV*>(it)->releaseSlices();
+    }
+    BufferPool::releaseBuf(it);
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    if (mReadReq.mHandle && mPool && mPool->isEmpty()) {
+        // idle link in multishot recv mode, hold nothing
+        MemPool::releaseMemPool(mPool);
+        mPool = nullptr;
+    }
+#endif
 }
 
 s32 HttpLayer::launch(HttpMsg* msg) {
-    if (!mPool) {
-        mPool = MemPool::createMemPool(16 * 1024);
-    }
     if (mMsg) {
         return EE_ERROR;
     }
@@ -179,10 +211,22 @@ bool HttpLayer::sendReq(RequestFD* nd) {
 
 s32 HttpLayer::sendOut(HttpMsg* msg) {
     bool chk = msg->getHead().isChunked();
-    RequestFD* it = createMem(msg->sumCacheSize());
-    msg->dumpLine(it);
-    msg->dumpHead(it);
-    msg->dumpBody(it);
+    RequestFD* it;
+    usz bodysz = msg->getBodySize();
+    if (bodysz >= G_IOV_BODY_MIN && 0 == msg->mBodyFly.size()) {
+        // head + body in place, no copy of body
+        RequestIOV* nd = createMemIOV(msg->sumCacheSize() - bodysz);
+        msg->dumpLine(nd);
+        msg->dumpHead(nd);
+        nd->commitCache();
+        msg->dumpBody(nd);
+        it = nd;
+    } else {
+        it = createMem(msg->sumCacheSize());
+        msg->dumpLine(it);
+        msg->dumpHead(it);
+        msg->dumpBody(it);
+    }
 
     // it->mUser = this;
     it->mUser = msg;
@@ -295,9 +339,6 @@ bool HttpLayer::onLink(RequestFD* it) {
         DLOG(ELL_ERROR, "HttpLayer::onLink>> invalid website");
         return false;
     }
-    if (!mPool) {
-        mPool = MemPool::createMemPool(16 * 1024);
-    }
     if (mHTTPS) {
         mTCP.setClose(EHT_TCP_LINK, HttpLayer::funcOnClose, this);
         mTCP.setTime(HttpLayer::funcOnTime, 20 * 1000, 30 * 1000, -1);
@@ -305,7 +346,16 @@ bool HttpLayer::onLink(RequestFD* it) {
         mTCP.getHandleTCP().setClose(EHT_TCP_LINK, HttpLayer::funcOnClose, this);
         mTCP.getHandleTCP().setTime(HttpLayer::funcOnTime, 20 * 1000, 30 * 1000, -1);
     }
-    RequestFD* nd = createMem(4 * 1024);
+    RequestFD* nd;
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    if (!mHTTPS && accp->getHandleTCP().getLoop()->isURingMultishot()) {
+        nd = &mReadReq; // the buffer will be attached when data arrived
+    } else {
+        nd = createMem(4 * 1024);
+    }
+#else
+    nd = createMem(4 * 1024);
+#endif
     nd->mUser = this;
     nd->mCall = HttpLayer::funcOnRead;
     s32 ret = mHTTPS ? mTCP.open(req, nd, mTlsContext) : mTCP.getHandleTCP().open(req, nd);
@@ -315,7 +365,13 @@ bool HttpLayer::onLink(RequestFD* it) {
         Logger::log(ELL_INFO, "HttpLayer::onLink>> [%s->%s]", mTCP.getRemote().getStr(), mTCP.getLocal().getStr());
     } else {
         mWebSite = nullptr;
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+        if (nd != &mReadReq) {
+            deleteMem(nd);
+        }
+#else
         deleteMem(nd);
+#endif
         Logger::log(ELL_ERROR, "HttpLayer::onLink>> [%s->%s], ecode=%d", mTCP.getRemote().getStr(),
             mTCP.getLocal().getStr(), ret);
     }
@@ -338,6 +394,9 @@ void HttpLayer::onConnect(RequestFD* it) {
 }
 
 void HttpLayer::onWrite(RequestFD* it, HttpMsg* msg) {
+    if (ERF_IOV & it->mFlags) {
+        reinterpret_cast<RequestIOV*>(it)->releaseSlices();
+    }
     if (EE_OK != it->mError) {
         DLOG(ELL_ERROR, "onWrite>>size=%u, ecode=%d, msg=%s", it->mUsed, it->mError, msg->getRealPath().data());
         if (msg->getEvent()) {
@@ -358,7 +417,56 @@ void HttpLayer::onWrite(RequestFD* it, HttpMsg* msg) {
 }
 
 
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+bool HttpLayer::onReadRing(RequestFD* it) {
+    const s8* dat = it->getBuf();
+    u32 datsz = it->mUsed;
+    u32 stepsz;
+    while (datsz > 0 && HPE_OK == mHttpError) {
+        if (mCache) {
+            stepsz = AppMin(datsz, mCache->getWriteSize());
+            memcpy(mCache->getBuf() + mCache->mUsed, dat, stepsz);
+            mCache->mUsed += stepsz;
+            dat += stepsz;
+            datsz -= stepsz;
+            mCache->clearData((u32)parseBuf(mCache->getBuf(), mCache->mUsed));
+            if (0 == mCache->mUsed) {
+                deleteMem(mCache);
+                mCache = nullptr;
+            } else if (0 == mCache->getWriteSize()) {
+                return false; // 可能受到超长header攻击
+            }
+        } else {
+            stepsz = (u32)parseBuf(dat, datsz);
+            dat += stepsz;
+            datsz -= stepsz;
+            if (datsz > 0 && HPE_OK == mHttpError) {
+                mCache = createMem(4 * 1024); // leftover
+            }
+        }
+    }
+    return HPE_OK == mHttpError;
+}
+#endif
+
+
 void HttpLayer::onRead(RequestFD* it) {
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    if (it == &mReadReq) {
+        if (it->mUsed > 0 && EE_OK == it->mError) {
+            if (onReadRing(it) && EE_OK == readIF(it)) {
+                return; // step success, go on...
+            }
+            DLOG(ELL_ERROR, "HttpLayer::onRead>> remote= %s, parser err= %d = %s, ecode = %d",
+                mTCP.getRemote().getStr(), mHttpError, getErrStr(), it->mError);
+        } else {
+            parseBuf(nullptr, 0); // make the http-msg-finish callback
+        }
+        // mReadReq is still owned by loop if armed, close and wait the final callback
+        postClose();
+        return;
+    }
+#endif
     const s8* dat = it->getBuf();
     if (it->mUsed > 0 && EE_OK == it->mError) {
         ssz datsz = it->mUsed;
@@ -15,11 +15,17 @@ HttpMsg::HttpMsg(HttpLayer* it) : mLayer(it) {
     if (it) {
         it->grab();
     }
+    // the first block holds the pool of link until this msg destructed
+    mArena.init(it ? it->getMemPool() : nullptr);
+    mHead.setArena(&mArena);
+    mURL.setArena(&mArena);
 }
 
 
 HttpMsg::~HttpMsg() {
     setEvent(nullptr);
+    mHead.clear();
+    mArena.reset(); // before drop the link which owns the pool
     if (mLayer) {
         mLayer->drop();
         mLayer = nullptr;
@@ -229,6 +235,22 @@ usz HttpMsg::dumpBody(RequestFD* it) {
     return len;
 }
 
+usz HttpMsg::dumpBody(RequestIOV* it) {
+    if ((RSTEP_BODY_END & mWriteStep) || mBodyFly.size() > 0) {
+        return 0;
+    }
+    if (mHead.isChunked()) {
+        mWriteStep |= RSTEP_BODY_PART;
+    } else {
+        mWriteStep |= RSTEP_BODY_END;
+    }
+    usz len = mBody.size();
+    mBodyFly.swap(mBody);
+    mBody.resize(0);
+    it->addSlice(mBodyFly.data(), (u32)len, HttpMsg::funcOnBodySent, this);
+    return len;
+}
+
 void HttpMsg::dumpHead(RequestFD* it) {
     if (RSTEP_HEAD_END & mWriteStep) {
         return;
@@ -35,6 +35,29 @@
 namespace app {
 namespace net {
 
+/**
+ * @brief encrypt the slices in order, stop at the first short write.
+ * @return bytes encrypted, or result of SSL_write if nothing encrypted */
+static s32 AppWriteSlices(TlsSession* tls, const RequestIOV* req) {
+    s32 ret = 0;
+    for (u32 i = 0; i < req->mSliceCount; ++i) {
+        const SliceIOV& it = req->mSlices[i];
+        if (0 == it.mLen) {
+            continue;
+        }
+        s32 wsz = tls->write(it.mData, (s32)it.mLen);
+        if (wsz <= 0) {
+            return ret > 0 ? ret : wsz;
+        }
+        ret += wsz;
+        if ((u32)wsz < it.mLen) {
+            break;
+        }
+    }
+    return ret;
+}
+
+
 HandleTLS::HandleTLS() :
     mTlsSession(nullptr), mFlyWrites(nullptr), mFlyReads(nullptr), mLandWrites(nullptr), mLandReads(nullptr) {
     mLoop = &Engine::getInstance().getLoop();
@@ -140,6 +163,21 @@ void HandleTLS::landQueue(RequestFD*& que) {
 }
 
 
+void HandleTLS::landWriteQueue(RequestFD*& que) {
+    bool drained = false;
+    for (RequestFD* nd = AppPopRingQueueHead_1(que); nd; nd = AppPopRingQueueHead_1(que)) {
+        DASSERT(nd->mCall);
+        if (ERT_WRITE == nd->mType && mWater.land(nd->mUsed)) {
+            drained = true;
+        }
+        nd->mCall(nd);
+    }
+    if (drained && (EHF_WRITEABLE & mFlag)) {
+        mWater.mCallDrain(this);
+    }
+}
+
+
 void HandleTLS::doRead() {
     TlsSession* session = mTlsSession;
     bool gogo = true;
@@ -267,6 +305,7 @@ s32 HandleTLS::write(RequestFD* req) {
     req->mError = 0;
     req->mType = ERT_WRITE;
     req->mHandle = this;
+    mWater.add(req->mUsed);
 
     if (mFlyWrites) {
         AppPushRingQueueTail_1(mFlyWrites, req);
@@ -274,7 +313,8 @@ s32 HandleTLS::write(RequestFD* req) {
         return EE_OK;
     }
 
-    s32 wsz = mTlsSession->write(req->mData, (s32)req->mUsed);
+    s32 wsz = (ERF_IOV & req->mFlags) ? AppWriteSlices(mTlsSession, reinterpret_cast<RequestIOV*>(req))
+                                      : mTlsSession->write(req->mData, (s32)req->mUsed);
     if (wsz > 0) {
         if ((u32)wsz >= req->mUsed) {
             // done
@@ -329,7 +369,7 @@ void HandleTLS::onClose(Handle* it) {
     mFlag = mTCP.getFlag();
     landReads();
     landWrites();
-    landQueue(mFlyWrites);
+    landWriteQueue(mFlyWrites);
     landQueue(mFlyReads);
     uninit();
     drop();
@@ -164,6 +164,14 @@ bool NetAddress::operator!=(const NetAddress& it) const {
 }
 
 
+bool NetAddress::isAnyIP()const {
+    if(isIPV6()) {
+        return IN6_IS_ADDR_UNSPECIFIED(&getAddress6()->sin6_addr);
+    }
+    return INADDR_ANY == getAddress4()->sin_addr.s_addr;
+}
+
+
 u16 NetAddress::getFamily()const {
     return (*(u16*)mAddress);
 }
@@ -147,7 +147,7 @@ s32 RedisClient::open() {
     }
     mStatus = 1;
 
-    RequestFD* it = RequestFD::newRequest(4 * 1024);
+    RequestFD* it = RequestFD::newRequest(4 * 1024, EMU_REDIS);
     it->mUser = this;
     it->mCall = funcOnConnect;
     s32 ret = mTCP.connect(it);
@@ -190,7 +190,7 @@ bool RedisClient::postTask(RedisCommand* it) {
     mCMD = static_cast<RedisRequest*>(it);
     mCMD->grab();
 
-    RequestFD* out = RequestFD::newRequest(0);
+    RequestFD* out = RequestFD::newRequest(0, EMU_REDIS);
     out->mData = (s8*)it->getRequestBuf();
     out->mAllocated = it->getRequestSize();
     out->mUsed = out->mAllocated;
@@ -217,7 +217,7 @@ void RedisClient::onPassword() {
             mPool->push(this);
         } else {
             mStatus |= 2;
-            RequestFD* out = RequestFD::newRequest(128);
+            RequestFD* out = RequestFD::newRequest(128, EMU_REDIS);
             out->mUser = this;
             out->mCall = RedisClient::funcOnWrite;
             out->mUsed = snprintf(out->mData, out->mAllocated, "%d", mPool->getDatabaseID());
@@ -268,7 +268,7 @@ void RedisClient::onConnect(RequestFD* it) {
                 mStatus &= ~1;
                 mPool->push(this);
             } else {
-                RequestFD* out = RequestFD::newRequest(128);
+                RequestFD* out = RequestFD::newRequest(128, EMU_REDIS);
                 out->mUser = this;
                 out->mCall = RedisClient::funcOnWrite;
                 if (pwd.size() > 0) {
@@ -43,6 +43,7 @@ RedisClientPool::RedisClientPool(Loop* loop, RedisClientCluster* cls) :
     mPassword(32),
     mMaxTCP(3) {
     mHub = new MemoryHub();
+    mHub->setTag(EMU_REDIS);
 }
 
 RedisClientPool::~RedisClientPool() {
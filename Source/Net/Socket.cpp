@@ -47,6 +47,7 @@
 #include <linux/if.h>
 #include <linux/if_ether.h>
 #include <linux/sockios.h>
+#include <linux/filter.h>
 #endif  //DOS_WINDOWS
 #include "System.h"
 
@@ -296,6 +297,90 @@ s32 Socket::setReusePort(bool it) {
 }
 
 
+s32 Socket::setIncomingCPU(s32 cpu) {
+#if defined(DOS_WINDOWS)
+    return 0;
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+    return ::setsockopt(mSocket, SOL_SOCKET, SO_INCOMING_CPU, (s8*)&cpu, sizeof(cpu));
+#endif
+}
+
+
+s32 Socket::setReusePortCPU(const u16* cpus, u32 cnt) {
+#if defined(DOS_WINDOWS)
+    return 0;
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+    if (0 == cnt || cnt > 1024) {
+        return -1;
+    }
+    // A = cpu; if (A == cpus[i]) return i; ...; return A % cnt;
+    struct sock_filter code[3 + 2 * 1024];
+    u32 pos = 0;
+    code[pos++] = BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (u32)(SKF_AD_OFF + SKF_AD_CPU));
+    for (u32 i = 0; cpus && i < cnt; ++i) {
+        code[pos++] = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, cpus[i], 0, 1);
+        code[pos++] = BPF_STMT(BPF_RET | BPF_K, i);
+    }
+    code[pos++] = BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, cnt);
+    code[pos++] = BPF_STMT(BPF_RET | BPF_A, 0);
+    struct sock_fprog prog;
+    prog.len = (unsigned short)pos;
+    prog.filter = code;
+    return ::setsockopt(mSocket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, (s8*)&prog, sizeof(prog));
+#endif
+}
+
+
+s32 Socket::setBusyPoll(u32 usec) {
+#if defined(DOS_WINDOWS)
+    return 0;
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+    s32 opt = (s32)usec;
+    return ::setsockopt(mSocket, SOL_SOCKET, SO_BUSY_POLL, (s8*)&opt, sizeof(opt));
+#endif
+}
+
+
+s32 Socket::setDeferAccept(s32 seconds) {
+#if defined(DOS_WINDOWS)
+    return 0;
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+    return ::setsockopt(mSocket, IPPROTO_TCP, TCP_DEFER_ACCEPT, (s8*)&seconds, sizeof(seconds));
+#endif
+}
+
+
+s32 Socket::setFastOpen(s32 qlen) {
+#if defined(DOS_WINDOWS)
+    return 0;
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+#ifndef TCP_FASTOPEN
+#define TCP_FASTOPEN 23
+#endif
+    return ::setsockopt(mSocket, IPPROTO_TCP, TCP_FASTOPEN, (s8*)&qlen, sizeof(qlen));
+#endif
+}
+
+
+s32 Socket::setFastOpenConnect(bool on) {
+#if defined(DOS_WINDOWS)
+    return 0;
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT 30
+#endif
+    s32 opt = on ? 1 : 0;
+    return ::setsockopt(mSocket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, (s8*)&opt, sizeof(opt));
+#endif
+}
+
+
 s32 Socket::setSendCache(s32 size) {
     return ::setsockopt(mSocket, SOL_SOCKET, SO_SNDBUF, (s8*)&size, sizeof(size));
 }
@@ -306,6 +391,58 @@ s32 Socket::setReceiveCache(s32 size) {
 }
 
 
+s32 Socket::setKeepAlive(s32 idle, s32 interval, s32 count) {
+    s32 opt = idle > 0 ? 1 : 0;
+    if (0 != ::setsockopt(mSocket, SOL_SOCKET, SO_KEEPALIVE, (s8*)&opt, sizeof(opt))) {
+        return -1;
+    }
+    if (0 == opt) {
+        return 0;
+    }
+#if defined(DOS_WINDOWS) && !defined(TCP_KEEPIDLE)
+    tcp_keepalive vals;
+    vals.onoff = 1;
+    vals.keepalivetime = idle * 1000;
+    vals.keepaliveinterval = (interval > 0 ? interval : 1) * 1000;
+    DWORD bytes = 0;
+    return ::WSAIoctl(mSocket, SIO_KEEPALIVE_VALS, &vals, sizeof(vals), nullptr, 0, &bytes, nullptr, nullptr);
+#else
+    s32 ret = ::setsockopt(mSocket, IPPROTO_TCP, TCP_KEEPIDLE, (s8*)&idle, sizeof(idle));
+    if (interval > 0) {
+        ret |= ::setsockopt(mSocket, IPPROTO_TCP, TCP_KEEPINTVL, (s8*)&interval, sizeof(interval));
+    }
+    if (count > 0) {
+        ret |= ::setsockopt(mSocket, IPPROTO_TCP, TCP_KEEPCNT, (s8*)&count, sizeof(count));
+    }
+    return ret;
+#endif
+}
+
+
+s32 Socket::setOption(const SocketOption& it) {
+    s32 ret = 0;
+    if (it.mNoDelay >= 0 && 0 != setDelay(0 == it.mNoDelay)) {
+        ++ret;
+    }
+    if (it.mKeepAlive >= 0 && 0 != setKeepAlive(it.mKeepAlive, it.mKeepInterval, it.mKeepCount)) {
+        ++ret;
+    }
+    if (it.mSendCache > 0 && 0 != setSendCache(it.mSendCache)) {
+        ++ret;
+    }
+    if (it.mReceiveCache > 0 && 0 != setReceiveCache(it.mReceiveCache)) {
+        ++ret;
+    }
+    if (it.mDeferAccept >= 0 && 0 != setDeferAccept(it.mDeferAccept)) {
+        ++ret;
+    }
+    if (it.mFastOpen >= 0 && 0 != setFastOpen(it.mFastOpen)) {
+        ++ret;
+    }
+    return ret;
+}
+
+
 s32 Socket::bind(const NetAddress& it) {
     return ::bind(mSocket, (sockaddr*)it.getAddress6(), it.getAddrSize());
 }
@@ -432,6 +569,81 @@ s32 Socket::send(const void* iBuffer, s32 iSize) {
 }
 
 
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+s64 Socket::sendVector(const struct iovec* vec, s32 cnt) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = const_cast<struct iovec*>(vec);
+    msg.msg_iovlen = cnt;
+    return ::sendmsg(mSocket, &msg, MSG_NOSIGNAL);
+}
+
+
+s32 Socket::sendFDs(const void* iBuffer, s32 iSize, const s32* fds, s32 cnt) {
+    struct iovec vec;
+    vec.iov_base = const_cast<void*>(iBuffer);
+    vec.iov_len = iSize;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &vec;
+    msg.msg_iovlen = 1;
+    TVector<s8> ctrl(CMSG_SPACE(sizeof(s32) * cnt));
+    if (cnt > 0) {
+        ctrl.resize(CMSG_SPACE(sizeof(s32) * cnt));
+        memset(ctrl.getPointer(), 0, ctrl.size());
+        msg.msg_control = ctrl.getPointer();
+        msg.msg_controllen = ctrl.size();
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(s32) * cnt);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(s32) * cnt);
+    }
+    s32 ret;
+    do {
+        ret = (s32)::sendmsg(mSocket, &msg, MSG_NOSIGNAL);
+    } while (ret < 0 && EINTR == errno);
+    return ret;
+}
+
+
+s32 Socket::receiveFDs(void* iBuffer, s32 iSize, s32* fds, s32& cnt) {
+    struct iovec vec;
+    vec.iov_base = iBuffer;
+    vec.iov_len = iSize;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &vec;
+    msg.msg_iovlen = 1;
+    TVector<s8> ctrl(CMSG_SPACE(sizeof(s32) * cnt));
+    ctrl.resize(CMSG_SPACE(sizeof(s32) * cnt));
+    msg.msg_control = ctrl.getPointer();
+    msg.msg_controllen = ctrl.size();
+    s32 ret;
+    do {
+        ret = (s32)::recvmsg(mSocket, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    } while (ret < 0 && EINTR == errno);
+    s32 got = 0;
+    for (struct cmsghdr* cmsg = ret > 0 ? CMSG_FIRSTHDR(&msg) : nullptr; cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (SOL_SOCKET == cmsg->cmsg_level && SCM_RIGHTS == cmsg->cmsg_type) {
+            s32 num = (s32)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(s32));
+            for (s32 i = 0; i < num; ++i) {
+                s32 fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + sizeof(s32) * i, sizeof(fd));
+                if (got < cnt) {
+                    fds[got++] = fd;
+                } else {
+                    ::close(fd);
+                }
+            }
+        }
+    }
+    cnt = got;
+    return ret;
+}
+#endif
+
+
 s32 Socket::receiveAll(void* iBuffer, s32 iSize) {
     s32 ret = 0;
     s32 step;
@@ -476,6 +688,24 @@ Socket Socket::accept(NetAddress& it) {
 }
 
 
+Socket Socket::acceptNonblock(NetAddress& it) {
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    socklen_t size = it.getAddrSize();
+    Socket ret = ::accept4(mSocket, (sockaddr*)it.getAddress6(), &size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (ret.isOpen()) {
+        it.reverse();
+    }
+    return ret;
+#else
+    Socket ret = accept(it);
+    if (ret.isOpen() && 0 != ret.setBlock(false)) {
+        ret.close();
+    }
+    return ret;
+#endif
+}
+
+
 #if defined(DOS_WINDOWS)
 void* Socket::mFunctionConnect = nullptr;
 void* Socket::mFunctionDisconnect = nullptr;
@@ -553,12 +783,19 @@ bool Socket::receiveFrom(RequestFD* iAction, NetAddress& addr)const {
 bool Socket::send(RequestFD* iAction)const {
     //DWORD bytes = 0;
     //DWORD flags = 0;
-    StringView vvv = iAction->getReadBuf();
-    WSABUF buf = {(ULONG)vvv.mLen, vvv.mData};
+    WSABUF bufs[RequestIOV::MAX_SLICE];
+    DWORD cnt = 1;
+    if (ERF_IOV & iAction->mFlags) {
+        cnt = reinterpret_cast<RequestIOV*>(iAction)->fillBuf(bufs, RequestIOV::MAX_SLICE);
+    } else {
+        StringView vvv = iAction->getReadBuf();
+        bufs[0].len = (ULONG)vvv.mLen;
+        bufs[0].buf = vvv.mData;
+    }
     iAction->clearOverlap();
     s32 ret = ::WSASend(mSocket,
-        &buf,
-        1,
+        bufs,
+        cnt,
         nullptr,    //&bytes,
         0,          //flags,
         &(iAction->mOverlapped),
@@ -34,7 +34,7 @@ const u32 gCacheSZ = 4 * 1024;
 
 
 TcpProxy::TcpProxy(Loop& loop) :
-    mLoop(loop), mType(0), mHub(nullptr) {
+    mLoop(loop), mType(0), mPause(0), mHub(nullptr) {
 
     //front
     mTLS.getHandleTCP().setClose(EHT_TCP_LINK, TcpProxy::funcOnClose, this);
@@ -106,19 +106,59 @@ void TcpProxy::onWrite2(RequestFD* it) {
 }
 
 
+s32 TcpProxy::postRead() {
+    RequestFD* out = RequestFD::newRequest(gCacheSZ, EMU_PROXY);
+    out->mUser = this;
+    out->mCall = TcpProxy::funcOnRead;
+    s32 ret = (1 & mType) > 0 ? mTLS.read(out) : mTLS.getHandleTCP().read(out);
+    if (0 != ret) {
+        RequestFD::delRequest(out);
+    }
+    return ret;
+}
+
+
+s32 TcpProxy::postRead2() {
+    RequestFD* out = RequestFD::newRequest(gCacheSZ, EMU_PROXY);
+    out->mUser = this;
+    out->mCall = TcpProxy::funcOnRead2;
+    s32 ret = (2 & mType) > 0 ? mTLS2.read(out) : mTLS2.getHandleTCP().read(out);
+    if (0 != ret) {
+        RequestFD::delRequest(out);
+    }
+    return ret;
+}
+
+
+void TcpProxy::onDrain(Handle* it) {
+    if (2 & mPause) {
+        mPause &= ~2;
+        postRead2();
+    }
+}
+
+
+void TcpProxy::onDrain2(Handle* it) {
+    if (1 & mPause) {
+        mPause &= ~1;
+        postRead();
+    }
+}
+
+
 void TcpProxy::onRead(RequestFD* it) {
     if (it->mUsed > 0) {
-        RequestFD* out = RequestFD::newRequest(gCacheSZ);
-        out->mUser = this;
-        out->mCall = TcpProxy::funcOnRead;
-        if (0 != ((1 & mType) > 0 ? mTLS.read(out) : mTLS.getHandleTCP().read(out))) {
-            RequestFD::delRequest(out);
-        }
         it->mCall = TcpProxy::funcOnWrite2;
         it->setStepSize(0);
         if (EE_OK != ((2 & mType) > 0 ? mTLS2.write(it) : mTLS2.getHandleTCP().write(it))) {
             RequestFD::delRequest(it);
         }
+        // backpressure: backend is slow, stop reading front until onDrain2()
+        if ((2 & mType) > 0 ? mTLS2.isWriteFull() : mTLS2.getHandleTCP().isWriteFull()) {
+            mPause |= 1;
+        } else {
+            postRead();
+        }
     } else {
         printf("TcpProxy::onRead>>read 0 bytes, ecode=%d\n", it->mError);
         RequestFD::delRequest(it);
@@ -128,18 +168,17 @@ void TcpProxy::onRead(RequestFD* it) {
 
 void TcpProxy::onRead2(RequestFD* it) {
     if (it->mUsed > 0) {
-        RequestFD* out = RequestFD::newRequest(gCacheSZ);
-        out->mUser = this;
-        out->mCall = TcpProxy::funcOnRead2;
-        if (0 != ((2 & mType) > 0 ? mTLS2.read(out) : mTLS2.getHandleTCP().read(out))) {
-            RequestFD::delRequest(out);
-        }
-
         it->mCall = TcpProxy::funcOnWrite;
         it->setStepSize(0);
         if (EE_OK != ((1 & mType) > 0 ? mTLS.write(it) : mTLS.getHandleTCP().write(it))) {
             RequestFD::delRequest(it);
         }
+        // backpressure: front is slow, stop reading backend until onDrain()
+        if ((1 & mType) > 0 ? mTLS.isWriteFull() : mTLS.getHandleTCP().isWriteFull()) {
+            mPause |= 2;
+        } else {
+            postRead2();
+        }
     } else {
         printf("TcpProxy::onRead2>>read 0 bytes, ecode=%d\n", it->mError);
         RequestFD::delRequest(it);
@@ -151,11 +190,7 @@ void TcpProxy::onConnect(RequestFD* it) {
     if (EE_OK == it->mError) {
         it->mCall = TcpProxy::funcOnRead2;
         if (0 == ((2 & mType) > 0 ? mTLS2.read(it) : mTLS2.getHandleTCP().read(it))) {
-            RequestFD* read = RequestFD::newRequest(gCacheSZ);
-            read->mUser = this;
-            read->mCall = TcpProxy::funcOnRead;
-            if (0 != ((1 & mType) > 0 ? mTLS.read(read) : mTLS.getHandleTCP().read(read))) {
-                RequestFD::delRequest(read);
+            if (0 != postRead()) {
                 mLoop.closeHandle(&mTLS.getHandleTCP());
                 mLoop.closeHandle(&mTLS2.getHandleTCP());
             }
@@ -211,6 +246,21 @@ void TcpProxy::onLink(RequestFD* it) {
     mTLS2.getHandleTCP().setLocal(accp->getHandleTCP().getLocal());
     mTLS2.getHandleTCP().setRemote(accp->getHandleTCP().getRemote());
 
+    const ProxyCfg& cfg = mHub->getConfig();
+    if (cfg.mWaterHigh > 0) {
+        if ((1 & mType) > 0) {
+            mTLS.setWaterMark(cfg.mWaterHigh, cfg.mWaterLow, TcpProxy::funcOnDrain);
+        } else {
+            mTLS.getHandleTCP().setWaterMark(cfg.mWaterHigh, cfg.mWaterLow, TcpProxy::funcOnDrain);
+        }
+        if ((2 & mType) > 0) {
+            mTLS2.setWaterMark(cfg.mWaterHigh, cfg.mWaterLow, TcpProxy::funcOnDrain2);
+        } else {
+            mTLS2.getHandleTCP().setWaterMark(cfg.mWaterHigh, cfg.mWaterLow, TcpProxy::funcOnDrain2);
+        }
+    }
+    mTLS2.getHandleTCP().setFastOpen(cfg.mFastOpen);
+
     if (0 == mTLS.getHandleTCP().getTimeGap()) {
         mTLS.getHandleTCP().setTimeCaller(nullptr);
     }
@@ -238,7 +288,7 @@ void TcpProxy::onLink(RequestFD* it) {
     mHub->grab();
 
     //backend start connect
-    RequestFD* conn = RequestFD::newRequest(gCacheSZ);
+    RequestFD* conn = RequestFD::newRequest(gCacheSZ, EMU_PROXY);
     conn->mUser = this;
     conn->mCall = funcOnConnect;
     if ((2 & mType) > 0) {
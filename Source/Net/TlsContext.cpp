@@ -43,6 +43,7 @@
 #include "Net/HandleTLS.h"
 #include "FileRWriter.h"
 #include "Packet.h"
+#include "MemAccount.h"
 
 #if (OPENSSL_VERSION_NUMBER < 0x10100000L) || defined(LIBRESSL_VERSION_NUMBER)
 #error "openssl version is too low"
@@ -71,11 +72,55 @@ void AppUninitTlsLib() {
     OPENSSL_cleanup();
 }
 
+// the size of block is kept in a header, aligned to 16 bytes
+static const usz G_TLS_MEM_HEAD = 16;
+
+static void* AppTlsMalloc(size_t size, const char* file, int line) {
+    s8* ret = (s8*)::malloc(size + G_TLS_MEM_HEAD);
+    if (!ret) {
+        return nullptr;
+    }
+    *(usz*)ret = size;
+    MemAccount::onAlloc(EMU_TLS, size);
+    return ret + G_TLS_MEM_HEAD;
+}
+
+static void AppTlsFree(void* mem, const char* file, int line) {
+    if (mem) {
+        s8* real = (s8*)mem - G_TLS_MEM_HEAD;
+        MemAccount::onFree(EMU_TLS, *(usz*)real);
+        ::free(real);
+    }
+}
+
+static void* AppTlsRealloc(void* mem, size_t size, const char* file, int line) {
+    if (!mem) {
+        return AppTlsMalloc(size, file, line);
+    }
+    if (0 == size) {
+        AppTlsFree(mem, file, line);
+        return nullptr;
+    }
+    s8* real = (s8*)mem - G_TLS_MEM_HEAD;
+    const usz old = *(usz*)real;
+    real = (s8*)::realloc(real, size + G_TLS_MEM_HEAD);
+    if (!real) {
+        return nullptr;
+    }
+    *(usz*)real = size;
+    MemAccount::onResize(EMU_TLS, old, size);
+    return real + G_TLS_MEM_HEAD;
+}
+
 // call once
 void AppInitTlsLib() {
     if (!G_TLS_LOCK.tryLock()) {
         return;
     }
+    // must be set before any allocation of OpenSSL
+    if (!CRYPTO_set_mem_functions(AppTlsMalloc, AppTlsRealloc, AppTlsFree)) {
+        Logger::log(ELL_WARN, "AppInitTlsLib>>fail to set mem functions, TLS memory is not counted");
+    }
     DLOG(ELL_WARN, "OpenSSL: init start[0x%X], version = %s", OPENSSL_VERSION_NUMBER, OPENSSL_VERSION_TEXT);
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
     OPENSSL_config(nullptr);
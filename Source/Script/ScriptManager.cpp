@@ -32,6 +32,24 @@ static s32 LuaWriter(lua_State* state, const void* p, usz sz, void* user) {
     return 0;
 }
 
+// same as the default allocator of lua, counted by MemAccount
+static void* LuaAlloc(void* user, void* ptr, size_t osize, size_t nsize) {
+    if (ptr) { // else osize is the type of object
+        MemAccount::onFree(EMU_LUA, osize);
+    }
+    if (0 == nsize) {
+        ::free(ptr);
+        return nullptr;
+    }
+    void* ret = ::realloc(ptr, nsize);
+    if (ret) {
+        MemAccount::onAlloc(EMU_LUA, nsize);
+    } else if (ptr) {
+        MemAccount::onAlloc(EMU_LUA, osize); // the old block is kept
+    }
+    return ret;
+}
+
 
 /**
  * LuaThread
@@ -58,7 +76,8 @@ ScriptManager::~ScriptManager() {
 }
 
 ScriptManager& ScriptManager::getInstance() {
-    static ScriptManager ret;
+    // lua VM is not thread safe, one VM per loop thread, @see Engine::runLoop()
+    static thread_local ScriptManager ret;
     return ret;
 }
 
@@ -77,6 +96,9 @@ void ScriptManager::initialize() {
     mScriptPath += "Script/";
 
     mRootVM = luaL_newstate();
+    // the blocks allocated by default allocator will be released by LuaAlloc, count them
+    MemAccount::onAlloc(EMU_LUA, lua_gc(mRootVM, LUA_GCCOUNT, 0) * 1024ULL + lua_gc(mRootVM, LUA_GCCOUNTB, 0));
+    lua_setallocf(mRootVM, LuaAlloc, nullptr);
     luaL_openlibs(mRootVM);
 
     // fix  package.path, package.cpath
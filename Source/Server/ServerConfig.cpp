@@ -99,6 +99,23 @@ bool ServerConfig::load(const String& runPath, const String& cfg, bool mainProce
         }
         return false;
     };
+
+    // func for SocketOption load, options of listener inherited by accepted links
+    auto func_loadsockopt = [](const Json::Value& val, net::SocketOption& out) {
+        if (val.isMember("SockOpt")) {
+            const Json::Value& opt = val["SockOpt"];
+            out.mNoDelay = opt.isMember("NoDelay") ? AppClamp(opt["NoDelay"].asInt(), -1, 1) : -1;
+            out.mKeepAlive = opt.isMember("KeepAlive") ? AppClamp(opt["KeepAlive"].asInt(), -1, 7200) : -1;
+            out.mKeepInterval = opt.isMember("KeepInterval") ? AppClamp(opt["KeepInterval"].asInt(), -1, 600) : -1;
+            out.mKeepCount = opt.isMember("KeepCount") ? AppClamp(opt["KeepCount"].asInt(), -1, 100) : -1;
+            out.mSendCache = opt.isMember("SendCache") ? opt["SendCache"].asInt() : -1;
+            out.mReceiveCache = opt.isMember("ReceiveCache") ? opt["ReceiveCache"].asInt() : -1;
+            out.mDeferAccept = opt.isMember("DeferAccept") ? AppClamp(opt["DeferAccept"].asInt(), -1, 3600) : -1;
+            out.mFastOpen = opt.isMember("FastOpen") ? AppClamp(opt["FastOpen"].asInt(), -1, 65535) : -1;
+        } else {
+            out = net::SocketOption();
+        }
+    };
     // TODO: try-catch below?
     if (val.isMember("Proxy")) {
         ProxyCfg nd;
@@ -107,8 +124,12 @@ bool ServerConfig::load(const String& runPath, const String& cfg, bool mainProce
             nd.mType = (u8)val["Proxy"][i]["Type"].asInt();
             nd.mSpeed = (u32)val["Proxy"][i]["MaxSpeed"].asInt();
             nd.mTimeout = 1000 * AppClamp<u32>(val["Proxy"][i]["Timeout"].asInt(), 0, 3600);
+            nd.mWaterHigh = 1024 * AppClamp<u32>(val["Proxy"][i]["WaterHigh"].asUInt(), 0, 1024 * 1024);
+            nd.mWaterLow = 1024 * AppClamp<u32>(val["Proxy"][i]["WaterLow"].asUInt(), 0, 1024 * 1024);
             nd.mLocal.setIPort(val["Proxy"][i]["Lisen"].asCString());
             nd.mRemote.setIPort(val["Proxy"][i]["Backend"].asCString());
+            nd.mFastOpen = val["Proxy"][i].isMember("FastOpen") ? val["Proxy"][i]["FastOpen"].asBool() : false;
+            func_loadsockopt(val["Proxy"][i], nd.mSockOpt);
             mProxy.pushBack(nd);
         }
     }
@@ -122,6 +143,7 @@ bool ServerConfig::load(const String& runPath, const String& cfg, bool mainProce
             nd.mRootPath = val["Website"][i]["Path"].asCString();
             nd.mRootPath.replace('\\', '/');
             nd.mHost = val["Website"][i]["Host"].asCString();
+            func_loadsockopt(val["Website"][i], nd.mSockOpt);
             if ('/' == nd.mRootPath.lastChar()) {
                 nd.mRootPath.resize(nd.mRootPath.size() - 1);
             }
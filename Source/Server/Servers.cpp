@@ -36,8 +36,12 @@ s32 Servers::start() {
         return EE_ERROR;
     }
     if (!eng.isMainProcess() || (0 == eng.getChildCount() && eng.isMainProcess())) {
-        s32 err = eng.getLoop().postTask(&Servers::processTask, this, static_cast<void*>(nullptr));
-        Logger::log(ELL_INFO, "Servers::start>> postTask %s, err = %d", EE_OK == err ? "success" : "fail", err);
+        // every loop opens it's own listeners, @see Loop::openHandle() SO_REUSEPORT
+        for (u32 i = 0; i < eng.getLoopCount(); ++i) {
+            s32 err = eng.getLoop(i).postTask(&Servers::processTask, this, static_cast<void*>(nullptr));
+            Logger::log(ELL_INFO, "Servers::start>> postTask loop[%u] %s, err = %d", i,
+                EE_OK == err ? "success" : "fail", err);
+        }
     }
     s32 ret = EE_OK;
     if (eng.isMainProcess()) {
@@ -51,12 +55,15 @@ s32 Servers::start() {
 
 
 void Servers::processTask(void* it) {
+    // listen in order of worker slot, @see EngineConfig::mListenSteer
+    Engine::getInstance().lockListen();
     for (usz i = 0; i < mConfig.mProxy.size(); ++i) {
         net::TcpProxyHub* pxhub = new net::TcpProxyHub(mConfig.mProxy[i]);
         net::Acceptor* nd = new net::Acceptor(Engine::getInstance().getLoop(), net::TcpProxyHub::funcOnLink, pxhub);
         pxhub->drop();
         nd->setTimeout(mConfig.mProxy[i].mTimeout);
         nd->setBackend(mConfig.mProxy[i].mRemote);
+        nd->setOption(mConfig.mProxy[i].mSockOpt);
         if (0 == nd->open(mConfig.mProxy[i].mLocal)) {
             Logger::log(ELL_INFO, "Engine::init>>start TcpProxy=[%s->%s]", mConfig.mProxy[i].mLocal.getStr(),
                 mConfig.mProxy[i].mRemote.getStr());
@@ -78,6 +85,7 @@ void Servers::processTask(void* it) {
             website->drop();
             nd->getHandleTCP().setTimeGap(mConfig.mWebsite[i].mTimeout);
             nd->getHandleTCP().setTimeout(mConfig.mWebsite[i].mTimeout);
+            nd->setOption(mConfig.mWebsite[i].mSockOpt);
             if (0 == nd->open(mConfig.mWebsite[i].mLocal)) {
                 Logger::log(ELL_INFO, "Engine::init>>start website=%s,path=%s", mConfig.mWebsite[i].mLocal.getStr(),
                     mConfig.mWebsite[i].mRootPath.c_str());
@@ -95,6 +103,7 @@ void Servers::processTask(void* it) {
         }
     }
 
+    Engine::getInstance().unlockListen();
     // mConfig.mWebsite.clear();
 }
 
@@ -108,7 +117,8 @@ void Servers::onClose(Handle* it) {
 
 
 s32 Servers::onTimeout(HandleTime* it) {
-    EngineStats& estat = Engine::getInstance().getEngineStats();
+    EngineStats estat;
+    Engine::getInstance().sumEngineStats(estat);
     s8 ch = 0;
 #ifdef DOS_WINDOWS
     // 32=blank,27=esc
@@ -78,7 +78,8 @@ void ClientNAT::onWrite(RequestUDP* it) {
 
 
 s32 ClientNAT::onTimeout(HandleTime* it) {
-    EngineStats& estat = Engine::getInstance().getEngineStats();
+    EngineStats estat;
+    Engine::getInstance().sumEngineStats(estat);
 
     if (!Engine::getInstance().isMainProcess()) {
     }
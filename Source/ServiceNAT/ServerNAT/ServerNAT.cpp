@@ -138,7 +138,8 @@ void ServerNAT::onWrite(RequestUDP* it) {
 
 
 s32 ServerNAT::onTimeout(HandleTime* it) {
-    EngineStats& estat = Engine::getInstance().getEngineStats();
+    EngineStats estat;
+    Engine::getInstance().sumEngineStats(estat);
 
     if (!Engine::getInstance().isMainProcess()) {
     }
@@ -0,0 +1,270 @@
+/***************************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2021 antmuse@live.cn/antmuse@qq.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+***************************************************************************************************/
+
+
+
+#include "ShareAllocator.h"
+#include <new>
+#include <thread>
+#include <string.h>
+#include "Logger.h"
+#include "System.h"
+
+namespace app {
+
+static const u32 G_SHARE_MAGIC = 0x45524853; // "SHRE"
+static const u32 G_SHARE_MIN_PAGES = 16;     // min pages of arena
+static const u32 G_SHARE_CHECK_OWNER = 1024; // check the owner per yields
+
+#define DSHARE_HANDLE(arena, gen, off) (((u64)(arena) << 56) | ((u64)((gen) & 0xFFFFFF) << 32) | ((off) >> 3))
+#define DSHARE_ARENA(it) ((u32)((it) >> 56))
+#define DSHARE_GEN(it) ((u32)((it) >> 32) & 0xFFFFFF)
+#define DSHARE_OFFSET(it) ((usz)((it)&0xFFFFFFFFULL) << 3)
+
+
+s32 ShareLock::lock(s32 pid) {
+    for (u32 i = 1;; ++i) {
+        s32 val = 0;
+        if (mOwner.compare_exchange_weak(val, pid)) {
+            return 0;
+        }
+        if (0 == (i & 7)) {
+            std::this_thread::yield();
+        }
+        if (0 == i % G_SHARE_CHECK_OWNER && val > 0 && val != pid && !System::isProcessAlive(val)) {
+            if (mOwner.compare_exchange_strong(val, pid)) {
+                return val;
+            }
+        }
+    }
+}
+
+
+ShareAllocator::ShareAllocator() : mHead(nullptr), mArena(0), mPID(0), mLinked(false) {
+}
+
+
+ShareAllocator::~ShareAllocator() {
+}
+
+
+bool ShareAllocator::create(s8* mem, usz size, u32 arenas) {
+    const usz psz = System::getPageSize();
+    const usz head = AppAlignPoint(mem + sizeof(Header), psz) - mem;
+    if (!mem || size < head + psz * G_SHARE_MIN_PAGES) {
+        Logger::log(ELL_ERROR, "ShareAllocator::create>>too small, size=%llu", (u64)size);
+        return false;
+    }
+    arenas = AppClamp<u32>(arenas, 1, G_SHARE_MAX_ARENA);
+    usz each = (size - head) / arenas / psz * psz;
+    while (arenas > 1 && each < psz * G_SHARE_MIN_PAGES) {
+        --arenas;
+        each = (size - head) / arenas / psz * psz;
+    }
+    Header* hd = new (mem) Header();
+    hd->mArenaCount = arenas;
+    hd->mSize = size;
+    hd->mBase = mem;
+    for (u32 i = 0; i < arenas; ++i) {
+        Arena& it = hd->mArenas[i];
+        it.mGeneration = 1;
+        it.mOffset = head + each * i;
+        it.mSize = each;
+        new (mem + it.mOffset) MemSlabPool(each);
+    }
+    hd->mMagic = G_SHARE_MAGIC;
+    mHead = hd;
+    mLinked = true;
+    mPID = System::getPID();
+    mArena = 0;
+    Logger::log(ELL_INFO, "ShareAllocator::create>>arenas=%u, arena size=%llu", arenas, (u64)each);
+    return true;
+}
+
+
+bool ShareAllocator::attach(s8* mem) {
+    Header* hd = reinterpret_cast<Header*>(mem);
+    if (!hd || G_SHARE_MAGIC != hd->mMagic) {
+        Logger::log(ELL_ERROR, "ShareAllocator::attach>>invalid region");
+        return false;
+    }
+    mHead = hd;
+    mLinked = hd->mBase == mem;
+    mPID = System::getPID();
+    if (!mLinked) {
+        Logger::log(ELL_WARN, "ShareAllocator::attach>>mapped at %p, creator at %p, alloc disabled", mem, hd->mBase);
+    }
+    return true;
+}
+
+
+void ShareAllocator::setArena(u32 idx) {
+    mPID = System::getPID();
+    mArena = mHead ? idx % mHead->mArenaCount : 0;
+}
+
+
+u32 ShareAllocator::getArenaCount() const {
+    return mHead ? mHead->mArenaCount : 0;
+}
+
+
+MemSlabPool* ShareAllocator::getArena(u32 idx) const {
+    if (!mHead || idx >= mHead->mArenaCount) {
+        return nullptr;
+    }
+    return reinterpret_cast<MemSlabPool*>((s8*)mHead + mHead->mArenas[idx].mOffset);
+}
+
+
+u32 ShareAllocator::getGeneration(u32 idx) const {
+    if (!mHead || idx >= mHead->mArenaCount) {
+        return 0;
+    }
+    return mHead->mArenas[idx].mGeneration.load(std::memory_order_acquire);
+}
+
+
+ShareHandle ShareAllocator::allocate(usz size) {
+    if (!mLinked || 0 == size) {
+        return 0;
+    }
+    lockArena(mArena);
+    Arena& it = mHead->mArenas[mArena];
+    void* ret = getArena(mArena)->allocMemNolock(size);
+    const u32 gen = it.mGeneration.load(std::memory_order_relaxed);
+    unlockArena(mArena);
+    return ret ? DSHARE_HANDLE(mArena, gen, (usz)((s8*)ret - (s8*)mHead)) : 0;
+}
+
+
+ShareHandle ShareAllocator::callocate(usz size) {
+    ShareHandle ret = allocate(size);
+    if (ret) {
+        memset(getPointer(ret), 0, size);
+    }
+    return ret;
+}
+
+
+void ShareAllocator::release(ShareHandle hnd) {
+    const u32 idx = DSHARE_ARENA(hnd);
+    if (!mLinked || 0 == hnd || idx >= mHead->mArenaCount) {
+        return;
+    }
+    lockArena(idx);
+    Arena& it = mHead->mArenas[idx];
+    if (DSHARE_GEN(hnd) == (it.mGeneration.load(std::memory_order_relaxed) & 0xFFFFFF)) {
+        getArena(idx)->freeMemNolock((s8*)mHead + DSHARE_OFFSET(hnd));
+    }
+    unlockArena(idx);
+}
+
+
+void* ShareAllocator::getPointer(ShareHandle hnd) const {
+    const u32 idx = DSHARE_ARENA(hnd);
+    if (!mHead || 0 == hnd || idx >= mHead->mArenaCount) {
+        return nullptr;
+    }
+    const Arena& it = mHead->mArenas[idx];
+    const usz off = DSHARE_OFFSET(hnd);
+    if (DSHARE_GEN(hnd) != (it.mGeneration.load(std::memory_order_acquire) & 0xFFFFFF) || off < it.mOffset
+        || off >= it.mOffset + it.mSize) {
+        return nullptr;
+    }
+    return (s8*)mHead + off;
+}
+
+
+ShareHandle ShareAllocator::getHandle(const void* ptr) const {
+    const u32 idx = getArenaIndex(ptr);
+    if (idx >= G_SHARE_MAX_ARENA) {
+        return 0;
+    }
+    const u32 gen = mHead->mArenas[idx].mGeneration.load(std::memory_order_acquire);
+    return DSHARE_HANDLE(idx, gen, (usz)((const s8*)ptr - (const s8*)mHead));
+}
+
+
+u32 ShareAllocator::recover(s32 pid, u32 idx) {
+    if (!mLinked) {
+        return 0;
+    }
+    if (idx >= mHead->mArenaCount) {
+        // the process was sharing an arena with others, @see setArena()
+        Logger::log(ELL_ERROR, "ShareAllocator::recover>>invalid arena=%u, pid=%d", idx, pid);
+        return 0;
+    }
+    u32 ret = 0;
+    for (u32 i = 0; i < mHead->mArenaCount; ++i) {
+        bool held = mHead->mArenas[i].mLock.forceUnlock(pid);
+        if (held || i == idx) {
+            lockArena(i);
+            resetArena(i);
+            unlockArena(i);
+            ++ret;
+            Logger::log(ELL_INFO, "ShareAllocator::recover>>pid=%d, arena=%u, locked=%c", pid, i, held ? 'Y' : 'N');
+        }
+    }
+    return ret;
+}
+
+
+u32 ShareAllocator::getArenaIndex(const void* ptr) const {
+    if (!mHead || !ptr) {
+        return G_SHARE_MAX_ARENA;
+    }
+    const s8* pos = (const s8*)ptr;
+    const s8* base = (const s8*)mHead;
+    for (u32 i = 0; i < mHead->mArenaCount; ++i) {
+        const Arena& it = mHead->mArenas[i];
+        if (pos >= base + it.mOffset && pos < base + it.mOffset + it.mSize) {
+            return i;
+        }
+    }
+    return G_SHARE_MAX_ARENA;
+}
+
+
+void ShareAllocator::lockArena(u32 idx) {
+    s32 dead = mHead->mArenas[idx].mLock.lock(mPID);
+    if (dead) {
+        Logger::log(ELL_ERROR, "ShareAllocator::lockArena>>owner dead, pid=%d, arena=%u", dead, idx);
+        resetArena(idx);
+    }
+}
+
+
+void ShareAllocator::unlockArena(u32 idx) {
+    mHead->mArenas[idx].mLock.unlock(mPID);
+}
+
+
+void ShareAllocator::resetArena(u32 idx) {
+    Arena& it = mHead->mArenas[idx];
+    new ((s8*)mHead + it.mOffset) MemSlabPool(it.mSize);
+    it.mGeneration.fetch_add(1, std::memory_order_release);
+}
+
+} // namespace app
@@ -48,6 +48,7 @@ s32 AppTestFile(s32 argc, s8** argv);
 s32 AppTestReadWriteLock(s32 argc, s8** argv);
 s32 AppTestFutex(s32 argc, s8** argv);
 s32 AppTestNode(s32 argc, s8** argv);
+s32 AppTestUnits(s32 argc, s8** argv);
 #if defined(DUSE_ZLIB)
 s32 AppTestZlib(s32 argc, s8** argv);
 s32 AppTestRingBlocks(s32 argc, s8** argv);
@@ -110,6 +111,10 @@ int main(int argc, char** argv) {
         // exe 8 127.0.0.1:5000 user passowrd
         ret = 5 == argc ? AppTestDBClient(argc, argv) : argc;
         break;
+    case 9:
+        // exe 9, unit tests, exit code is the count of failed checks
+        ret = AppTestUnits(argc, argv);
+        break;
     default:
         if (true) {
             AppTestMD5(argc, argv);
@@ -144,5 +149,5 @@ int main(int argc, char** argv) {
     Logger::flush();
     eng.uninit();
     printf("main>>stop\n");
-    return 0;
+    return 9 == cmd ? ret : 0;
 }
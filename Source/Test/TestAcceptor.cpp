@@ -0,0 +1,86 @@
+#include "Engine.h"
+#include "Net/Acceptor.h"
+#include "UnitTest.h"
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+namespace app {
+
+static const s32 G_ACCEPT_RCVBUF = 16 * 1024;
+
+struct AcceptUser : public RefCount {
+    s32 mLinks = 0;
+    net::NetAddress mLocal;
+    s32 mNoDelay = -1;
+    s32 mReceiveCache = -1;
+};
+
+static void AcceptOnLink(RequestFD* it) {
+    RequestAccept* req = (RequestAccept*)it;
+    AcceptUser& usr = *(AcceptUser*)((net::Acceptor*)it->mUser)->getUser();
+    ++usr.mLinks;
+    usr.mLocal = req->mLocal;
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    socklen_t len = sizeof(usr.mNoDelay);
+    getsockopt(req->mSocket.getValue(), IPPROTO_TCP, TCP_NODELAY, &usr.mNoDelay, &len);
+    len = sizeof(usr.mReceiveCache);
+    getsockopt(req->mSocket.getValue(), SOL_SOCKET, SO_RCVBUF, &usr.mReceiveCache, &len);
+#endif
+    req->mSocket.close();
+}
+
+
+s32 AppTestAcceptor(s32 argc, s8** argv) {
+    net::NetAddress any("0.0.0.0:0");
+    net::NetAddress ip6("[::]:0");
+    net::NetAddress lo("127.0.0.1:0");
+    DTEST_CHECK(any.isAnyIP() && ip6.isAnyIP() && !lo.isAnyIP());
+
+    // a free port for the wildcard listener
+    net::Socket tmp;
+    DTEST_CHECK(tmp.openTCP() && 0 == tmp.bind(lo));
+    tmp.getLocalAddress(lo);
+    tmp.close();
+    any.setPort(lo.getPort());
+
+    Loop& loop = Engine::getInstance().getLoop();
+    AcceptUser* usr = new AcceptUser();
+    net::Acceptor* acc = new net::Acceptor(loop, AcceptOnLink, usr);
+    net::SocketOption opt;
+    opt.mNoDelay = 1;
+    opt.mReceiveCache = G_ACCEPT_RCVBUF;
+    acc->setOption(opt);
+    if (EE_OK != acc->open(any)) {
+        DTEST_CHECK(0 && "listen");
+        acc->drop();
+        usr->drop();
+        return 0;
+    }
+
+    // the accepted link inherits the options, and reports the real local IP of the wildcard listener
+    net::Socket cli;
+    DTEST_CHECK(cli.openTCP() && 0 == cli.connect(lo));
+    for (s32 i = 0; i < 1000 && 0 == usr->mLinks; ++i) {
+        loop.run();
+    }
+    DTEST_CHECK(1 == usr->mLinks);
+    DTEST_CHECK(usr->mLocal == lo);
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    DTEST_CHECK(0 != usr->mNoDelay);
+    DTEST_CHECK(2 * G_ACCEPT_RCVBUF == usr->mReceiveCache); // doubled by kernel
+#endif
+    cli.close();
+
+    acc->close();
+    for (s32 i = 0; i < 1000 && usr->getRefCount() > 1; ++i) {
+        loop.run();
+    }
+    DTEST_CHECK(1 == usr->getRefCount());
+    usr->drop();
+    return 0;
+}
+
+} // namespace app
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <thread>
+#include "BufferPool.h"
+#include "Request.h"
+#include "UnitTest.h"
+
+namespace app {
+
+// size of the class which holds a buffer of size, by the idle bytes it adds to the empty cache
+static usz AppBufClass(BufferPool* pool, usz size) {
+    const BufferPoolStats& st = pool->getStats();
+    pool->clear();
+    const usz cached = st.mCached;
+    pool->release(pool->allocate(size));
+    return st.mCached - cached;
+}
+
+
+static void AppTestBufferPoolClass() {
+    BufferPool* pool = BufferPool::getLocal();
+    DTEST_CHECK(nullptr != pool);
+
+    // the request heads fit in the head rooms, so a 4K request is in 4K class
+    const usz cls4k = BufferPool::getClassSize(2 * 6);
+    DTEST_CHECK(4096 + BufferPool::G_HEAD_ROOM == cls4k);
+    DTEST_CHECK(cls4k == AppBufClass(pool, sizeof(RequestFD) + 4096));
+    DTEST_CHECK(cls4k == AppBufClass(pool, sizeof(RequestUDP) + 4096));
+    DTEST_CHECK(4096 + BufferPool::G_HEAD_ROOM_IOV == AppBufClass(pool, sizeof(RequestIOV) + 4096));
+
+    // the small ones don't pay for the head room of RequestIOV
+    DTEST_CHECK(64 + BufferPool::G_HEAD_ROOM == AppBufClass(pool, 1));
+    DTEST_CHECK(64 + BufferPool::G_HEAD_ROOM_IOV == AppBufClass(pool, sizeof(RequestIOV) + 64));
+
+    // a released buffer is reused by the same class
+    const BufferPoolStats& st = pool->getStats();
+    void* buf = pool->allocate(4096);
+    pool->release(buf);
+    const s64 hits = st.mHits;
+    DTEST_CHECK(buf == pool->allocate(4000));
+    DTEST_CHECK(hits + 1 == st.mHits);
+    pool->release(buf);
+
+    // out of size classes, never cached
+    const usz big = BufferPool::getClassSize(BufferPool::G_CLASS_COUNT - 1) + 1;
+    DTEST_CHECK(0 == AppBufClass(pool, big) && 1 == st.mLarge);
+
+    // the smallest class which fits
+    for (usz size = 1; size < big; size += 97) {
+        usz best = big;
+        for (u32 i = 0; i < BufferPool::G_CLASS_COUNT; ++i) {
+            if (BufferPool::getClassSize(i) >= size && BufferPool::getClassSize(i) < best) {
+                best = BufferPool::getClassSize(i);
+            }
+        }
+        DTEST_CHECK(best == AppBufClass(pool, size));
+    }
+
+    // the idle bytes are capped
+    pool->clear();
+    DTEST_CHECK(0 == st.mCached);
+    pool->setConfig(2 * cls4k, 0);
+    void* bufs[4];
+    for (void*& it : bufs) {
+        it = pool->allocate(4096);
+    }
+    for (void* it : bufs) {
+        pool->release(it);
+    }
+    DTEST_CHECK(2 == st.mDrops && 2 * cls4k == st.mCached && st.mPeak >= st.mCached);
+}
+
+
+static void AppTestBufferPoolHuge() {
+    BufferPool* pool = BufferPool::getLocal();
+    const BufferPoolStats& st = pool->getStats();
+    const usz cls4k = BufferPool::getClassSize(2 * 6);
+    pool->setConfig(cls4k, BufferPool::G_HUGE_CHUNK);
+    void* bufs[4];
+    for (void*& it : bufs) {
+        it = pool->allocate(4096);
+    }
+    if (0 == st.mHugeBytes) {
+        printf("AppTestBufferPoolHuge>>hugepage not available, skipped\n");
+        for (void* it : bufs) {
+            pool->release(it);
+        }
+        return;
+    }
+    DTEST_CHECK(BufferPool::G_HUGE_CHUNK == st.mHugeBytes);
+    // the hugepage buffers are kept whatever the cap
+    for (void* it : bufs) {
+        pool->release(it);
+    }
+    DTEST_CHECK(0 == st.mDrops && 4 * cls4k == st.mCached);
+    pool->clear();
+    DTEST_CHECK(4 * cls4k == st.mCached);
+    void* got = pool->allocate(4096);
+    DTEST_CHECK(1 == st.mHits && std::find(bufs, bufs + 4, got) != bufs + 4);
+    pool->release(got);
+}
+
+
+s32 AppTestBufferPool(s32 argc, s8** argv) {
+    std::thread wk(AppTestBufferPoolClass);
+    wk.join();
+
+    // released by other thread, the buffer goes to the pool of that thread
+    void* buf = nullptr;
+    std::thread owner([&buf]() {
+        buf = BufferPool::allocBuf(4096);
+    });
+    owner.join();
+    std::thread other([buf]() {
+        BufferPool* pool = BufferPool::getLocal();
+        const BufferPoolStats& st = pool->getStats();
+        BufferPool::releaseBuf(buf);
+        DTEST_CHECK(1 == st.mFrees && BufferPool::getClassSize(2 * 6) == st.mCached);
+        DTEST_CHECK(buf == BufferPool::allocBuf(4096));
+        DTEST_CHECK(1 == st.mHits);
+        BufferPool::releaseBuf(buf);
+    });
+    other.join();
+
+    std::thread huge(AppTestBufferPoolHuge);
+    huge.join();
+    return 0;
+}
+
+} // namespace app
@@ -0,0 +1,108 @@
+#include "Coroutine.h"
+#include "Timer.h"
+#include "UnitTest.h"
+
+namespace app {
+
+#if defined(DUSE_COROUTINE)
+struct CoEchoState {
+    s32 mStep = 0; // 1=connected, 2=echoed, 3=slept, 4=switched, 5=awaited a child, 6=closed
+    s32 mError = 0;
+    s64 mSlept = 0;
+};
+
+
+static CoTask AppCoChild(s32 val) {
+    co_await CoSleep(1);
+    co_return val + 1;
+}
+
+
+static CoTask AppCoEcho(net::HandleTCP* hnd, String addr, CoEchoState* st) {
+    RequestFD* req = RequestFD::newRequest(256);
+    req->mUser = st;
+    st->mError = co_await CoConnect(*hnd, addr, req);
+    if (EE_OK != st->mError) {
+        RequestFD::delRequest(req);
+        co_return st->mError;
+    }
+    st->mStep = 1;
+
+    memcpy(req->mData, "hello", 5);
+    req->mUsed = 5;
+    st->mError = co_await CoWrite(*hnd, req);
+    req->mUsed = 0;
+    while (EE_OK == st->mError && req->mUsed < 5) {
+        st->mError = co_await CoRead(*hnd, req);
+    }
+    DTEST_CHECK(st == req->mUser); // restored after each co_await
+    if (EE_OK == st->mError && 0 == memcmp(req->mData, "HELLO", 5)) {
+        st->mStep = 2;
+    }
+
+    const s64 start = Timer::getRelativeTime();
+    if (EE_OK == co_await CoSleep(20)) {
+        st->mSlept = Timer::getRelativeTime() - start;
+        st->mStep = 3;
+    }
+    if (EE_OK == co_await CoSwitch(Engine::getInstance().getLoop())) {
+        st->mStep = 4;
+    }
+    if (8 == co_await AppCoChild(7)) {
+        st->mStep = 5;
+    }
+    co_await CoClose(*hnd);
+    DTEST_CHECK(hnd->isClose());
+    st->mStep = 6;
+    RequestFD::delRequest(req);
+    co_return EE_OK;
+}
+#endif
+
+
+s32 AppTestCoroutine(s32 argc, s8** argv) {
+#if defined(DUSE_COROUTINE)
+    Loop& loop = Engine::getInstance().getLoop();
+    net::Socket listener;
+    net::NetAddress addr("127.0.0.1", 0);
+    DTEST_CHECK(listener.openTCP());
+    DTEST_CHECK(0 == listener.bind(addr));
+    DTEST_CHECK(0 == listener.listen(4));
+    listener.getLocalAddress(addr);
+
+    net::HandleTCP hnd;
+    CoEchoState st;
+    AppCoEcho(&hnd, addr.getStr(), &st).launch();
+
+    // the peer: upper the bytes and send them back
+    net::Socket peer;
+    s8 buf[16];
+    s32 got = 0;
+    for (s32 i = 0; i < 100000 && st.mStep < 6 && 0 == st.mError; ++i) {
+        loop.run();
+        if (st.mStep >= 1 && !peer.isOpen()) {
+            peer = listener.accept();
+            DTEST_CHECK(peer.isOpen() && 0 == peer.setBlock(false));
+        }
+        if (peer.isOpen() && got < 5) {
+            s32 rd = peer.receive(buf + got, 5 - got);
+            if (rd > 0 && 5 == (got += rd)) {
+                for (s32 k = 0; k < 5; ++k) {
+                    buf[k] = (s8)toupper(buf[k]);
+                }
+                DTEST_CHECK(5 == peer.send(buf, 5));
+            }
+        }
+    }
+    DTEST_CHECK(0 == st.mError);
+    DTEST_CHECK(6 == st.mStep);
+    DTEST_CHECK(st.mSlept >= 20);
+    peer.close();
+    listener.close();
+#else
+    printf("AppTestCoroutine>>skipped, build with -DUSE_COROUTINE=ON\n");
+#endif
+    return 0;
+}
+
+} // namespace app
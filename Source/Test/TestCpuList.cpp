@@ -0,0 +1,61 @@
+#include "System.h"
+#include "UnitTest.h"
+
+namespace app {
+
+// @return true if str is parsed to the cpus
+static bool AppCheckCpuList(const s8* str, const u16* cpus, usz cnt) {
+    TVector<u16> out;
+    out.pushBack(9999); // kept, parseCpuList() appends only
+    const usz ret = System::parseCpuList(str, out);
+    if (ret != cnt || out.size() != cnt + 1 || 9999 != out[0]) {
+        printf("AppCheckCpuList>>\"%s\" got %llu cpus, want %llu\n", str ? str : "null", (u64)ret, (u64)cnt);
+        return false;
+    }
+    for (usz i = 0; i < cnt; ++i) {
+        if (cpus[i] != out[i + 1]) {
+            printf("AppCheckCpuList>>\"%s\" [%llu]=%u, want %u\n", str, (u64)i, out[i + 1], cpus[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+s32 AppTestCpuList(s32 argc, s8** argv) {
+    const u16 c0123[] = {0, 1, 2, 3};
+    const u16 cmix[] = {0, 1, 2, 3, 8, 10, 11};
+    const u16 c3[] = {3};
+    const u16 c35[] = {3, 5};
+    const u16 cmax[] = {65533, 65534};
+
+    // good ones
+    DTEST_CHECK(AppCheckCpuList("0-3", c0123, 4));
+    DTEST_CHECK(AppCheckCpuList("0-3,8,10-11", cmix, 7));
+    DTEST_CHECK(AppCheckCpuList("0-3,8,10-11\n", cmix, 7)); // as read from sysfs
+    DTEST_CHECK(AppCheckCpuList("0,1,2,3", c0123, 4));
+    DTEST_CHECK(AppCheckCpuList("3-3", c3, 1));
+    DTEST_CHECK(AppCheckCpuList("65533-65534", cmax, 2));
+
+    // empty
+    DTEST_CHECK(AppCheckCpuList(nullptr, nullptr, 0));
+    DTEST_CHECK(AppCheckCpuList("", nullptr, 0));
+    DTEST_CHECK(AppCheckCpuList(",,-", nullptr, 0));
+    DTEST_CHECK(AppCheckCpuList("abc", nullptr, 0));
+
+    // malformed, skip the bad item only
+    DTEST_CHECK(AppCheckCpuList("3-1", nullptr, 0));   // reversed
+    DTEST_CHECK(AppCheckCpuList("0-", nullptr, 0));    // no high
+    DTEST_CHECK(AppCheckCpuList("3-,5", c35 + 1, 1));
+    DTEST_CHECK(AppCheckCpuList("-3", c3, 1));         // no low, read as 3
+    DTEST_CHECK(AppCheckCpuList(" 3 ; 5 ", c35, 2));   // any other separators
+    DTEST_CHECK(AppCheckCpuList("3,,5,", c35, 2));
+    DTEST_CHECK(AppCheckCpuList("3-x5", c35 + 1, 1));
+    DTEST_CHECK(AppCheckCpuList("65535", nullptr, 0)); // out of u16
+    DTEST_CHECK(AppCheckCpuList("3,99999999999999999999,5", c35, 2)); // no overflow to small ids
+    DTEST_CHECK(AppCheckCpuList("0-4294967299", nullptr, 0));      // no huge range
+    DTEST_CHECK(AppCheckCpuList("4294967299-3,3", c3, 1));
+    return 0;
+}
+
+} // namespace app
@@ -0,0 +1,110 @@
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "HugePage.h"
+#include "UnitTest.h"
+
+namespace app {
+
+static void AppTestHugePageMap() {
+    HugePageStats& st = HugePage::getStats();
+
+    usz size = 100;
+    void* mem = HugePage::mapMem(size, false, EHPM_OFF);
+    DTEST_CHECK(nullptr != mem && 100 == size);
+    HugePage::unmapMem(mem, size);
+
+    // MAP_HUGETLB fails if no huge page reserved, fallback to THP, 2MB aligned
+    const s64 fails = st.mTLBFails.load();
+    const s64 tlb = st.mTLBBytes.load();
+    size = 100;
+    mem = HugePage::mapMem(size, false, EHPM_HUGETLB);
+    DTEST_CHECK(nullptr != mem && HugePage::G_CHUNK_SIZE == size);
+    if (fails < st.mTLBFails.load()) {
+        DTEST_CHECK(tlb == st.mTLBBytes.load());
+        DTEST_CHECK(0 == (usz)mem % HugePage::G_CHUNK_SIZE);
+    } else {
+        DTEST_CHECK(tlb + (s64)size == st.mTLBBytes.load());
+    }
+    memset(mem, 1, size);
+    HugePage::unmapMem(mem, size);
+
+    size = HugePage::G_CHUNK_SIZE + 1;
+    mem = HugePage::mapMem(size, true, EHPM_THP);
+    DTEST_CHECK(nullptr != mem && 2 * HugePage::G_CHUNK_SIZE == size);
+    DTEST_CHECK(0 == (usz)mem % HugePage::G_CHUNK_SIZE);
+    HugePage::unmapMem(mem, size);
+}
+
+
+static void AppTestHugePagePiece() {
+    HugePageStats& st = HugePage::getStats();
+    const s64 used = st.mPieceUsed.load();
+
+    // a released piece is reused by the same thread
+    void* piece = HugePage::allocPiece(100);
+    DTEST_CHECK(nullptr != piece && HugePage::isPiece(piece));
+    DTEST_CHECK(used + 128 == st.mPieceUsed.load());
+    DTEST_CHECK(HugePage::releasePiece(piece, 100));
+    DTEST_CHECK(piece == HugePage::allocPiece(128));
+    DTEST_CHECK(HugePage::releasePiece(piece, 128));
+    DTEST_CHECK(used == st.mPieceUsed.load());
+    s8 heap[64];
+    DTEST_CHECK(!HugePage::isPiece(heap) && !HugePage::releasePiece(heap, sizeof(heap)));
+
+    // the pieces cached by a thread are given back at exit, and reused by others
+    const usz psz = 4096;
+    const s32 cnt = 100;
+    std::thread wk([psz, cnt]() {
+        std::vector<void*> all;
+        for (s32 i = 0; i < cnt; ++i) {
+            all.push_back(HugePage::allocPiece(psz));
+            DTEST_CHECK(nullptr != all.back());
+            memset(all.back(), 1, psz);
+        }
+        for (void* it : all) {
+            DTEST_CHECK(HugePage::releasePiece(it, psz));
+        }
+    });
+    wk.join();
+    DTEST_CHECK(used == st.mPieceUsed.load());
+    const s64 total = st.mPieceTotal.load();
+    std::vector<void*> all;
+    for (s32 i = 0; i < cnt; ++i) {
+        all.push_back(HugePage::allocPiece(psz));
+        DTEST_CHECK(nullptr != all.back());
+    }
+    DTEST_CHECK(total == st.mPieceTotal.load());
+    for (void* it : all) {
+        HugePage::releasePiece(it, psz);
+    }
+    DTEST_CHECK(used == st.mPieceUsed.load());
+
+    // the arena is used up, the caller fallback to heap
+    const usz big = HugePage::G_CHUNK_SIZE / 2;
+    all.clear();
+    for (void* it = HugePage::allocPiece(big); it; it = HugePage::allocPiece(big)) {
+        all.push_back(it);
+    }
+    DTEST_CHECK(all.size() > 0 && nullptr == HugePage::allocPiece(big));
+    for (void* it : all) {
+        HugePage::releasePiece(it, big);
+    }
+}
+
+
+s32 AppTestHugePage(s32 argc, s8** argv) {
+    AppTestHugePageMap();
+    void* piece = HugePage::allocPiece(64);
+    if (piece) {
+        HugePage::releasePiece(piece, 64);
+        printf("AppTestHugePage>>piece arena is in use, skipped\n");
+        return 0;
+    }
+    // MAP_HUGETLB of the arena fallback to THP if no huge page reserved
+    HugePage::init(EHPM_HUGETLB, 8 * HugePage::G_CHUNK_SIZE);
+    AppTestHugePagePiece();
+    return 0;
+}
+
+} // namespace app
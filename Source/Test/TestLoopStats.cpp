@@ -0,0 +1,58 @@
+#include <memory>
+#include "LoopStats.h"
+#include "UnitTest.h"
+
+namespace app {
+
+s32 AppTestLoopStats(s32 argc, s8** argv) {
+    // linear below SUB_COUNT, one value per slot
+    for (u64 i = 0; i < Histogram::SUB_COUNT; ++i) {
+        DTEST_CHECK(i == Histogram::getSlot(i));
+        DTEST_CHECK(i == Histogram::getSlotValue((u32)i));
+    }
+
+    // [8,16) still exact, then each power of 2 split into 8 sub buckets
+    DTEST_CHECK(8 == Histogram::getSlot(8));
+    DTEST_CHECK(15 == Histogram::getSlot(15));
+    DTEST_CHECK(16 == Histogram::getSlot(16));
+    DTEST_CHECK(16 == Histogram::getSlot(17));
+    DTEST_CHECK(17 == Histogram::getSlot(18));
+    DTEST_CHECK(23 == Histogram::getSlot(31));
+    DTEST_CHECK(24 == Histogram::getSlot(32));
+    DTEST_CHECK(24 == Histogram::getSlot(35));
+    DTEST_CHECK(25 == Histogram::getSlot(36));
+
+    // every slot: its lowest value maps back to it, and value-1 to the previous slot
+    for (u32 slot = 1; slot < Histogram::SLOT_COUNT; ++slot) {
+        const u64 low = Histogram::getSlotValue(slot);
+        DTEST_CHECK(slot == Histogram::getSlot(low));
+        DTEST_CHECK(slot - 1 == Histogram::getSlot(low - 1));
+        DTEST_CHECK(low > Histogram::getSlotValue(slot - 1));
+    }
+
+    // clamp to the last slot
+    DTEST_CHECK(Histogram::SLOT_COUNT - 1 == Histogram::getSlot(0xFFFFFFFFULL));
+    DTEST_CHECK(Histogram::SLOT_COUNT - 1 == Histogram::getSlot(0x100000000ULL));
+    DTEST_CHECK(Histogram::SLOT_COUNT - 1 == Histogram::getSlot(~0ULL));
+
+    // count, total, max and percentiles
+    std::unique_ptr<Histogram> hist(new Histogram());
+    DTEST_CHECK(0 == hist->getPercentile(50));
+    for (u64 i = 1; i <= 100; ++i) {
+        hist->add(i);
+    }
+    hist->add(1000000);
+    DTEST_CHECK(101 == hist->mCount.load());
+    DTEST_CHECK(5050 + 1000000 == hist->mTotal.load());
+    DTEST_CHECK(1000000 == hist->mMax.load());
+    DTEST_CHECK(1 == hist->mSlots[1].load());
+    DTEST_CHECK(1 == hist->mSlots[Histogram::getSlot(1000000)].load());
+    DTEST_CHECK(1 == hist->getPercentile(0));
+    const u64 mid = hist->getPercentile(50);
+    DTEST_CHECK(mid <= 51 && Histogram::getSlot(mid) == Histogram::getSlot(51));
+    DTEST_CHECK(Histogram::getSlotValue(Histogram::getSlot(1000000)) == hist->getPercentile(99.5));
+    DTEST_CHECK(1000000 == hist->getPercentile(100)); // falls through to max
+    return 0;
+}
+
+} // namespace app
@@ -0,0 +1,121 @@
+#include <thread>
+#include "MemAccount.h"
+#include "BufferPool.h"
+#include "MemoryHub.h"
+#include "MemoryPool.h"
+#include "UnitTest.h"
+
+namespace app {
+
+static void AppTestMemAccountSlot() {
+    MemUsage slot;
+    slot.clear();
+    MemAccount::setThreadSlot(&slot);
+    const MemUsageItem& it = slot.mItems[EMU_LUA];
+    MemAccount::onAlloc(EMU_LUA, 100);
+    MemAccount::onAlloc(EMU_LUA, 300);
+    MemAccount::onFree(EMU_LUA, 100);
+    DTEST_CHECK(300 == it.mLive && 400 == it.mPeak);
+    DTEST_CHECK(2 == it.mAllocs && 400 == it.mBytes);
+    MemAccount::onFree(EMU_LUA, 300);
+    DTEST_CHECK(0 == it.mLive && 400 == it.mPeak);
+    DTEST_CHECK(0 == slot.mItems[EMU_OTHER].mAllocs);
+
+    // a resize is not counted as an allocation
+    MemAccount::onAlloc(EMU_LUA, 100);
+    MemAccount::onResize(EMU_LUA, 100, 500);
+    DTEST_CHECK(500 == it.mLive && 500 == it.mPeak);
+    MemAccount::onResize(EMU_LUA, 500, 200);
+    DTEST_CHECK(200 == it.mLive && 500 == it.mPeak);
+    DTEST_CHECK(3 == it.mAllocs && 500 == it.mBytes);
+    MemAccount::onFree(EMU_LUA, 200);
+
+    // the slots are summed, the peaks too
+    MemUsage sum;
+    sum.clear();
+    sum.add(slot);
+    sum.add(slot);
+    DTEST_CHECK(0 == sum.mItems[EMU_LUA].mLive && 1000 == sum.mItems[EMU_LUA].mPeak);
+    DTEST_CHECK(6 == sum.mItems[EMU_LUA].mAllocs && 1000 == sum.mItems[EMU_LUA].mBytes);
+    MemAccount::setThreadSlot(nullptr);
+}
+
+
+static void AppTestMemAccountDefault() {
+    MemUsage* old = MemAccount::getDefaultSlot();
+    const s64 allocs = old->mItems[EMU_LUA].mAllocs.load();
+    MemUsage mine;
+    mine.clear();
+    MemAccount::setDefaultSlot(&mine);
+    DTEST_CHECK(&mine == MemAccount::getDefaultSlot());
+    DTEST_CHECK(allocs == mine.mItems[EMU_LUA].mAllocs);
+
+    // a thread without slot writes the default one
+    std::thread wk([]() {
+        MemAccount::onAlloc(EMU_LUA, 64);
+        MemAccount::onFree(EMU_LUA, 64);
+    });
+    wk.join();
+    DTEST_CHECK(allocs + 1 == mine.mItems[EMU_LUA].mAllocs);
+
+    // the counters are carried back
+    old->clear();
+    MemAccount::setDefaultSlot(old);
+    DTEST_CHECK(allocs + 1 == old->mItems[EMU_LUA].mAllocs);
+}
+
+
+// the pools count what they hold by tag
+static void AppTestMemAccountPools() {
+    MemUsage slot;
+    slot.clear();
+    MemAccount::setThreadSlot(&slot);
+
+    const MemUsageItem& redis = slot.mItems[EMU_REDIS];
+    void* buf = BufferPool::allocBuf(4096, EMU_REDIS);
+    DTEST_CHECK(BufferPool::getClassSize(2 * 6) == (usz)redis.mLive && 1 == redis.mAllocs);
+    BufferPool::releaseBuf(buf);
+    DTEST_CHECK(0 == redis.mLive && redis.mPeak > 0);
+
+    const MemUsageItem& lua = slot.mItems[EMU_LUA];
+    MemoryHub* hub = new MemoryHub();
+    hub->setTag(EMU_LUA);
+    s8* small = hub->allocate(100);
+    DTEST_CHECK(128 == lua.mLive);
+    s8* large = hub->allocate(20000);
+    DTEST_CHECK(lua.mLive > 20000 && 2 == lua.mAllocs);
+    hub->release(small);
+    hub->release(large);
+    DTEST_CHECK(0 == lua.mLive && lua.mPeak > 20000);
+    hub->drop();
+
+    const MemUsageItem& http = slot.mItems[EMU_HTTP];
+    MemPool* zone = MemPool::createMemPool(16 * 1024, EMU_HTTP);
+    DTEST_CHECK(http.mLive > 16 * 1024);
+    MemPool::releaseMemPool(zone);
+    DTEST_CHECK(0 == http.mLive);
+
+    const MemUsageItem& proxy = slot.mItems[EMU_PROXY];
+    MemoryPool<u8[256]>* pool = new MemoryPool<u8[256]>();
+    pool->setTag(EMU_PROXY);
+    u8(*blk)[256] = pool->allocate();
+    DTEST_CHECK(pool->getMemoryPoolPageSize() == proxy.mLive);
+    pool->release(blk);
+    delete pool;
+    DTEST_CHECK(0 == proxy.mLive && proxy.mPeak > 0);
+
+    DTEST_CHECK(0 == slot.mItems[EMU_OTHER].mAllocs);
+    MemAccount::setThreadSlot(nullptr);
+}
+
+
+s32 AppTestMemAccount(s32 argc, s8** argv) {
+    AppTestMemAccountSlot();
+    AppTestMemAccountDefault();
+    // a new thread, so the pools are fresh
+    std::thread wk(AppTestMemAccountPools);
+    wk.join();
+    return 0;
+}
+
+} // namespace app
@@ -0,0 +1,143 @@
+#include "MemArena.h"
+#include "MemoryPool.h"
+#include "Net/HTTP/HttpHead.h"
+#include "UnitTest.h"
+
+namespace app {
+
+static const s8* const G_ARENA_LONG = "a string longer than the small buffer of TString, so it's allocated";
+
+
+static void AppTestMemArenaBlock(MemPool* pool) {
+    MemArena arena(1024);
+    arena.init(pool);
+    DTEST_CHECK((pool ? 1U : 0U) == arena.getBlockCount());
+
+    // small allocations share a block
+    s8* p1 = (s8*)arena.allocate(10);
+    s8* p2 = (s8*)arena.allocate(16, 16);
+    s8* p3 = (s8*)arena.allocate(8);
+    DTEST_CHECK(1 == arena.getBlockCount());
+    DTEST_CHECK(0 == ((usz)p2 & 15));
+    DTEST_CHECK(p2 >= p1 + 10 && p2 < p1 + 10 + 16);
+    DTEST_CHECK(p3 == p2 + 16);
+    memset(p1, 1, 10);
+
+    // a big one takes a dedicated block, the current block is kept
+    s8* big = (s8*)arena.allocate(1000);
+    DTEST_CHECK(2 == arena.getBlockCount());
+    memset(big, 2, 1000);
+    s8* p4 = (s8*)arena.allocate(8);
+    DTEST_CHECK(p4 == p3 + 8);
+    DTEST_CHECK(2 == arena.getBlockCount());
+
+    // a new block if the current one is full
+    for (s32 i = 0; i < 8; ++i) {
+        arena.allocate(300);
+    }
+    DTEST_CHECK(arena.getBlockCount() > 2);
+    DTEST_CHECK(13 == arena.getAllocCount());
+
+    arena.reset();
+    DTEST_CHECK(0 == arena.getBlockCount() && 0 == arena.getAllocCount());
+    // blocks from heap after reset
+    DTEST_CHECK(nullptr != arena.allocate(32));
+    DTEST_CHECK(1 == arena.getBlockCount());
+}
+
+
+static void AppTestMemArenaString() {
+    MemArena arena;
+    MemArena other;
+    arena.init(nullptr);
+    other.init(nullptr);
+    const TAllocatorArena<s8> in_arena(&arena);
+    const TAllocatorArena<s8> in_other(&other);
+
+    StringArena str(in_arena);
+    str = G_ARENA_LONG;
+    DTEST_CHECK(1 == arena.getAllocCount());
+
+    // move construction carries the arena and the buffer
+    const s8* buf = str.c_str();
+    StringArena moved(std::move(str));
+    DTEST_CHECK(buf == moved.c_str() && &arena == moved.getAllocator().getArena());
+
+    // copy is allocated by heap
+    StringArena copy(moved);
+    DTEST_CHECK(nullptr == copy.getAllocator().getArena());
+    DTEST_CHECK(copy == moved && copy.c_str() != buf);
+
+    // move to the same arena steals the buffer
+    StringArena same(in_arena);
+    same = std::move(moved);
+    DTEST_CHECK(buf == same.c_str() && 1 == arena.getAllocCount());
+
+    // move to other arena or heap copies, the arena of target is kept
+    StringArena far(in_other);
+    far = std::move(same);
+    DTEST_CHECK(&other == far.getAllocator().getArena());
+    DTEST_CHECK(far.c_str() != buf && 0 == strcmp(G_ARENA_LONG, far.c_str()));
+    DTEST_CHECK(1 == other.getAllocCount());
+    StringArena heap;
+    heap = std::move(far);
+    DTEST_CHECK(nullptr == heap.getAllocator().getArena());
+    DTEST_CHECK(0 == strcmp(G_ARENA_LONG, heap.c_str()));
+
+    // from heap to arena
+    far = std::move(heap);
+    DTEST_CHECK(&other == far.getAllocator().getArena());
+    DTEST_CHECK(0 == strcmp(G_ARENA_LONG, far.c_str()));
+}
+
+
+static void AppTestMemArenaHead() {
+    MemArena arena;
+    MemArena other;
+    arena.init(nullptr);
+    other.init(nullptr);
+    StringView key("Host", sizeof("Host") - 1);
+    StringView val(G_ARENA_LONG, strlen(G_ARENA_LONG));
+
+    net::HeadLine line(key, val, &arena);
+    net::HeadLine dest(key, key, &other);
+    dest = std::move(line);
+    DTEST_CHECK(&other == dest.mVal.getAllocator().getArena());
+    DTEST_CHECK(0 == strcmp(G_ARENA_LONG, dest.mVal.c_str()));
+
+    net::HttpHead src;
+    net::HttpHead dst;
+    src.setArena(&arena);
+    dst.setArena(&other);
+    src.add(key, val);
+    src.setChunked();
+    dst = std::move(src);
+    DTEST_CHECK(2 == dst.size() && dst.isChunked());
+    DTEST_CHECK(&other == dst.getData().getAllocator().getArena());
+    DTEST_CHECK(&other == dst[0].mKey.getAllocator().getArena());
+    DTEST_CHECK(&other == dst[0].mVal.getAllocator().getArena());
+
+    // the source msg is done, its arena is freed
+    src.clear();
+    arena.reset();
+    StringView got = dst.get(key);
+    DTEST_CHECK(got.mLen == val.mLen && 0 == memcmp(got.mData, val.mData, val.mLen));
+
+    // a copy of head is allocated by heap
+    net::HttpHead copy(dst);
+    DTEST_CHECK(2 == copy.size() && nullptr == copy.getData().getAllocator().getArena());
+    DTEST_CHECK(nullptr == copy[0].mVal.getAllocator().getArena());
+}
+
+
+s32 AppTestMemArena(s32 argc, s8** argv) {
+    AppTestMemArenaBlock(nullptr);
+    MemPool* pool = MemPool::createMemPool(64 * 1024);
+    AppTestMemArenaBlock(pool);
+    MemPool::releaseMemPool(pool);
+    AppTestMemArenaString();
+    AppTestMemArenaHead();
+    return 0;
+}
+
+} // namespace app
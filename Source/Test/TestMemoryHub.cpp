@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "MemoryHub.h"
+#include "UnitTest.h"
+
+namespace app {
+
+#ifdef D_THREADSAFE_MEMPOOL
+
+static void AppTestMemoryHubCounter() {
+    MemoryHub* hub = new MemoryHub();
+    std::thread wk([hub]() {
+        MemHubStats st;
+        s8* blk = hub->allocate(64);
+        hub->getStats(MemoryHub::EMT_128, st);
+        DTEST_CHECK(0 == st.mHits && 1 == st.mMisses && 0 == st.mFlushes);
+
+        // a freed block comes back from the cache
+        hub->release(blk);
+        DTEST_CHECK(blk == hub->allocate(64));
+        hub->getStats(MemoryHub::EMT_128, st);
+        DTEST_CHECK(1 == st.mHits && 1 == st.mMisses);
+        hub->release(blk);
+
+        // more blocks than the cache holds are flushed to the shared pool
+        std::vector<s8*> blks;
+        for (s32 i = 0; i < 200; ++i) {
+            blks.push_back(hub->allocate(64));
+        }
+        for (s8* it : blks) {
+            hub->release(it);
+        }
+        hub->getStats(MemoryHub::EMT_128, st);
+        DTEST_CHECK(202 == st.mHits + st.mMisses);
+        DTEST_CHECK(st.mMisses > 1);
+        DTEST_CHECK(st.mFlushes > 0);
+
+        // the other classes are untouched
+        hub->getStats(MemoryHub::EMT_256, st);
+        DTEST_CHECK(0 == st.mHits + st.mMisses + st.mFlushes);
+    });
+    wk.join();
+    hub->drop();
+}
+
+
+static void AppTestMemoryHubExit() {
+    MemoryHub* hub = new MemoryHub();
+    std::vector<s8*> freed;
+    std::thread wk([hub, &freed]() {
+        for (s32 i = 0; i < 8; ++i) {
+            freed.push_back(hub->allocate(64));
+        }
+        for (s8* it : freed) {
+            hub->release(it); // cached, given back when the thread exits
+        }
+    });
+    wk.join();
+
+    // the counters of the exited thread are kept
+    MemHubStats st;
+    hub->getStats(MemoryHub::EMT_128, st);
+    DTEST_CHECK(1 == st.mMisses && 7 == st.mHits);
+
+    // the cached blocks are in the shared pools now
+    hub->setThreadCache(false);
+    std::vector<s8*> blks;
+    for (s32 i = 0; i < 64; ++i) {
+        blks.push_back(hub->allocate(64));
+    }
+    for (s8* it : freed) {
+        DTEST_CHECK(blks.end() != std::find(blks.begin(), blks.end(), it));
+    }
+    for (s8* it : blks) {
+        hub->release(it);
+    }
+
+    // a new thread takes the cache left by the exited one
+    hub->setThreadCache(true);
+    std::thread next([hub]() {
+        hub->release(hub->allocate(64));
+    });
+    next.join();
+    hub->getStats(MemoryHub::EMT_128, st);
+    DTEST_CHECK(2 == st.mMisses && 7 == st.mHits);
+    hub->drop();
+}
+
+
+// destructed after the caches of thread, so it uses the hub while thread exiting
+struct HubLateUser {
+    MemoryHub* mHub = nullptr;
+    ~HubLateUser() {
+        if (mHub) {
+            mHub->release(mHub->allocate(64));
+        }
+    }
+};
+
+
+static void AppTestMemoryHubLate() {
+    MemoryHub* hub = new MemoryHub();
+    std::thread wk([hub]() {
+        static thread_local HubLateUser late; // constructed before the caches
+        late.mHub = hub;
+        hub->release(hub->allocate(64));
+    });
+    wk.join();
+
+    // the late one goes to the shared pools, no cache bound
+    MemHubStats st;
+    hub->getStats(MemoryHub::EMT_128, st);
+    DTEST_CHECK(1 == st.mMisses && 0 == st.mHits);
+
+    // so the cache left is free for others
+    std::thread next([hub]() {
+        hub->release(hub->allocate(64));
+    });
+    next.join();
+    hub->getStats(MemoryHub::EMT_128, st);
+    DTEST_CHECK(2 == st.mMisses && 0 == st.mHits);
+    hub->drop();
+}
+
+#endif // D_THREADSAFE_MEMPOOL
+
+
+s32 AppTestMemoryHub(s32 argc, s8** argv) {
+#ifdef D_THREADSAFE_MEMPOOL
+    AppTestMemoryHubCounter();
+    AppTestMemoryHubExit();
+    AppTestMemoryHubLate();
+#endif
+    return 0;
+}
+
+} // namespace app
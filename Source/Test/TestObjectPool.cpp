@@ -0,0 +1,134 @@
+#include <thread>
+#include <vector>
+#include "ObjectPool.h"
+#include "ThreadLocal.h"
+#include "UnitTest.h"
+
+namespace app {
+
+class PoolItem {
+public:
+    DDECLARE_OBJECT_POOL(PoolItem)
+    s64 mVal[4];
+};
+
+// bigger than PoolItem, so it falls back to the global new/delete
+class PoolItemBig : public PoolItem {
+public:
+    s64 mMore[4];
+};
+
+struct PoolPeek : public ObjectPoolBase {
+    // @return stats of PoolItem in current thread
+    static bool get(ObjectPoolStats& out) {
+        for (ObjectPoolBase* nd = getHead(); nd; nd = nd->*(&PoolPeek::mNext)) {
+            nd->getStats(out);
+            if (0 == strcmp("PoolItem", out.mName)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+
+static void AppTestObjectPoolOwner() {
+    const s32 total = 100;
+    std::vector<PoolItem*> objs;
+    for (s32 i = 0; i < total; ++i) {
+        objs.push_back(new PoolItem());
+    }
+    ObjectPoolStats st;
+    DTEST_CHECK(PoolPeek::get(st));
+    DTEST_CHECK(sizeof(PoolItem) == st.mSize);
+    DTEST_CHECK(total == st.mAllocs && total == st.mLive && total == st.mPeak && st.mPages > 0);
+
+    // owner frees 40
+    for (s32 i = 0; i < 40; ++i) {
+        delete objs[i];
+    }
+    PoolPeek::get(st);
+    DTEST_CHECK(40 == st.mFrees && 60 == st.mLive && 0 == st.mRemoteFrees);
+
+    // another thread frees 30, parked until the owner allocates again
+    std::thread remote([&objs]() {
+        for (s32 i = 40; i < 70; ++i) {
+            delete objs[i];
+        }
+    });
+    remote.join();
+    PoolPeek::get(st);
+    DTEST_CHECK(0 == st.mRemoteFrees && 60 == st.mLive);
+
+    PoolItem* again = new PoolItem();
+    PoolPeek::get(st);
+    DTEST_CHECK(30 == st.mRemoteFrees && 31 == st.mLive && total + 1 == st.mAllocs && total == st.mPeak);
+    delete again;
+
+    // remote frees racing with owner allocations
+    std::vector<PoolItem*> more;
+    std::thread racer([&objs]() {
+        for (s32 i = 70; i < total; ++i) {
+            delete objs[i];
+        }
+    });
+    for (s32 i = 0; i < 1000; ++i) {
+        more.push_back(new PoolItem());
+    }
+    racer.join();
+    for (PoolItem* it : more) {
+        delete it;
+    }
+    new PoolItem(); // collect the rest, and keep it alive at thread exit
+    PoolPeek::get(st);
+    DTEST_CHECK(60 == st.mRemoteFrees && 1 == st.mLive);
+    DTEST_CHECK(st.mAllocs == st.mFrees + st.mRemoteFrees + st.mLive);
+
+    // other sizes are not pooled
+    PoolItemBig* big = new PoolItemBig();
+    PoolPeek::get(st);
+    DTEST_CHECK(1 == st.mLive && total + 1002 == st.mAllocs);
+    delete big;
+    PoolPeek::get(st);
+    DTEST_CHECK(1 == st.mLive);
+}
+
+
+// destructed after the pool of its thread, it's still able to new/delete
+struct PoolLate {
+    ~PoolLate() {
+        DTEST_CHECK(nullptr == ThreadLocal<PoolLate>::get());
+        DTEST_CHECK(ThreadLocal<PoolLate>::ETS_DESTROYED == ThreadLocal<PoolLate>::getState());
+        PoolItem* it = new PoolItem();
+        it->mVal[0] = 8;
+        DTEST_CHECK(8 == it->mVal[0]);
+        delete it;
+    }
+};
+
+
+s32 AppTestObjectPool(s32 argc, s8** argv) {
+    // the owner leaves 1 object alive at exit, its pool must outlive the thread
+    std::thread owner(AppTestObjectPoolOwner);
+    owner.join();
+
+    PoolItem* late = nullptr;
+    std::thread quit([&late]() {
+        late = new PoolItem();
+        late->mVal[0] = 7;
+    });
+    quit.join();
+    DTEST_CHECK(7 == late->mVal[0]);
+    delete late; // a remote free to the orphan pool
+
+    // thread_local objects are destructed in reverse order, PoolLate goes after the pool
+    std::thread exiting([]() {
+        DTEST_CHECK(nullptr != ThreadLocal<PoolLate>::get());
+        DTEST_CHECK(ThreadLocal<PoolLate>::ETS_LIVING == ThreadLocal<PoolLate>::getState());
+        delete new PoolItem();
+    });
+    exiting.join();
+    return 0;
+}
+
+} // namespace app
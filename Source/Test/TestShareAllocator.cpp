@@ -0,0 +1,76 @@
+#include <string.h>
+#include <vector>
+#include "ShareAllocator.h"
+#include "System.h"
+#include "UnitTest.h"
+
+namespace app {
+
+s32 AppTestShareAllocator(s32 argc, s8** argv) {
+    const usz psz = System::getPageSize();
+    const usz size = psz * (4 * 16 + 2);
+    std::vector<s8> mem(size);
+
+    ShareAllocator tiny;
+    DTEST_CHECK(!tiny.create(mem.data(), psz * 4, 4));
+    DTEST_CHECK(!tiny.isLinked());
+
+    ShareAllocator main;
+    DTEST_CHECK(main.create(mem.data(), size, 4));
+    DTEST_CHECK(main.isLinked());
+    DTEST_CHECK(4 == main.getArenaCount());
+    for (u32 i = 0; i < main.getArenaCount(); ++i) {
+        DTEST_CHECK(1 == main.getGeneration(i));
+        DTEST_CHECK(nullptr != main.getArena(i));
+    }
+    DTEST_CHECK(nullptr == main.getArena(4));
+    DTEST_CHECK(0 == main.allocate(0));
+
+    ShareHandle h0 = main.allocate(100);
+    s8* p0 = main.getPointer<s8>(h0);
+    DTEST_CHECK(0 != h0 && nullptr != p0);
+    DTEST_CHECK(h0 == main.getHandle(p0));
+    strcpy(p0, "arena0");
+
+    // attached at the same address, as a forked child
+    ShareAllocator child;
+    DTEST_CHECK(child.attach(mem.data()));
+    DTEST_CHECK(child.isLinked());
+    child.setArena(1);
+    DTEST_CHECK(p0 == child.getPointer(h0));
+    ShareHandle h1 = child.callocate(64);
+    s8* p1 = child.getPointer<s8>(h1);
+    DTEST_CHECK(0 != h1 && nullptr != p1 && 0 == p1[63]);
+    DTEST_CHECK(p1 == main.getPointer(h1));
+    strcpy(p1, "arena1");
+
+    // attached at another address, read only
+    std::vector<s8> copy(mem);
+    ShareAllocator other;
+    DTEST_CHECK(other.attach(copy.data()));
+    DTEST_CHECK(!other.isLinked());
+    DTEST_CHECK(0 == other.allocate(16));
+    DTEST_CHECK(0 == strcmp("arena1", other.getPointer<s8>(h1)));
+    DTEST_CHECK(!other.attach(mem.data() + 8));
+
+    // a dead child resets its own arena only
+    const s32 dead = 0x7FFFFFF0;
+    DTEST_CHECK(0 == main.recover(dead, 4));
+    DTEST_CHECK(0 == main.recover(dead, 64 + 1));
+    DTEST_CHECK(1 == main.getGeneration(1));
+    DTEST_CHECK(1 == main.recover(dead, 1));
+    DTEST_CHECK(2 == main.getGeneration(1));
+    DTEST_CHECK(nullptr == main.getPointer(h1));
+    DTEST_CHECK(1 == main.getGeneration(0));
+    DTEST_CHECK(0 == strcmp("arena0", main.getPointer<s8>(h0)));
+    child.release(h1); // stale, ignored
+
+    // the reset arena serves again with new handles
+    ShareHandle h2 = child.allocate(64);
+    DTEST_CHECK(0 != h2 && h2 != h1 && nullptr != main.getPointer(h2));
+    child.release(h2);
+    main.release(h0);
+    return 0;
+}
+
+} // namespace app
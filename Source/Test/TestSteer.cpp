@@ -0,0 +1,101 @@
+#include <thread>
+#include "Logger.h"
+#include "Net/Socket.h"
+#include "System.h"
+#include "UnitTest.h"
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+#include <sched.h>
+#endif
+
+namespace app {
+
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+static const u32 G_STEER_LISTENERS = 3;
+static const s32 G_STEER_LINKS = 8;
+
+/**
+ * @brief open a reuseport group on loopback, attach the steering program, then connect from current cpu.
+ * @return the index of listener which got all the links, -1 if spread or failed
+ */
+static s32 AppSteerOnce(const u16* cpus) {
+    net::Socket lis[G_STEER_LISTENERS];
+    net::NetAddress addr("127.0.0.1", 0);
+    s32 ret = -1;
+    for (u32 i = 0; i < G_STEER_LISTENERS; ++i) {
+        if (!lis[i].openTCP() || 0 != lis[i].setReusePort(true) || 0 != lis[i].bind(addr)
+            || 0 != lis[i].listen(64) || 0 != lis[i].setBlock(false)) {
+            DTEST_CHECK(0 && "listen");
+            goto GT_END;
+        }
+        if (0 == i) {
+            lis[0].getLocalAddress(addr);
+        }
+    }
+    // the group index is the order of listen(), same as Loop::openHandle()
+    DTEST_CHECK(0 == lis[0].setReusePortCPU(cpus, G_STEER_LISTENERS));
+
+    for (s32 i = 0; i < G_STEER_LINKS; ++i) {
+        net::Socket cli;
+        DTEST_CHECK(cli.openTCP() && 0 == cli.connect(addr));
+        cli.close();
+    }
+    for (u32 i = 0; i < G_STEER_LISTENERS; ++i) {
+        s32 got = 0;
+        net::NetAddress remote;
+        for (net::Socket sk = lis[i].acceptNonblock(remote); sk.isOpen(); sk = lis[i].acceptNonblock(remote)) {
+            sk.close();
+            ++got;
+        }
+        if (G_STEER_LINKS == got) {
+            ret = (s32)i;
+        } else if (got > 0) {
+            ret = -1;
+            break;
+        }
+    }
+
+GT_END:
+    for (u32 i = 0; i < G_STEER_LISTENERS; ++i) {
+        lis[i].close();
+    }
+    return ret;
+}
+
+
+static void AppTestSteerCPU() {
+    s32 ret = sched_getcpu();
+    DTEST_CHECK(ret >= 0 && ret < 0xFFFF - 3);
+    const u16 cpu = ret > 0 ? (u16)ret : 0;
+    // keep SYNs on this cpu, loopback handles them in softirq of the sender
+    DTEST_CHECK(EE_OK == System::bindCPU(&cpu, 1));
+
+    const u16 mid[G_STEER_LISTENERS] = {(u16)(cpu + 1), cpu, (u16)(cpu + 2)};
+    const u16 tail[G_STEER_LISTENERS] = {(u16)(cpu + 1), (u16)(cpu + 2), cpu};
+    const u16 none[G_STEER_LISTENERS] = {(u16)(cpu + 1), (u16)(cpu + 2), (u16)(cpu + 3)};
+    DTEST_CHECK(1 == AppSteerOnce(mid));
+    DTEST_CHECK(2 == AppSteerOnce(tail));
+    DTEST_CHECK((s32)(cpu % G_STEER_LISTENERS) == AppSteerOnce(none)); // fallback: cpu % cnt
+    DTEST_CHECK((s32)(cpu % G_STEER_LISTENERS) == AppSteerOnce(nullptr));
+}
+#endif
+
+
+s32 AppTestSteer(s32 argc, s8** argv) {
+    net::Socket sock;
+    DTEST_CHECK(sock.openTCP());
+#if defined(DOS_LINUX) || defined(DOS_ANDROID)
+    const u16 cpus[2] = {0, 1};
+    DTEST_CHECK(0 != sock.setReusePortCPU(cpus, 0));
+    DTEST_CHECK(0 != sock.setReusePortCPU(nullptr, 1025));
+    sock.close();
+
+    // pin a new thread, don't touch the cpus of main thread
+    std::thread wk(AppTestSteerCPU);
+    wk.join();
+#else
+    sock.close();
+#endif
+    return 0;
+}
+
+} // namespace app
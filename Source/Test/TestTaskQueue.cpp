@@ -0,0 +1,83 @@
+#include <thread>
+#include <vector>
+#include "ThreadPool.h"
+#include "UnitTest.h"
+
+namespace app {
+
+static const s32 G_QUE_PRODUCERS = 4;
+static const s32 G_QUE_TASKS = 50000; // per producer
+
+
+s32 AppTestTaskQueue(s32 argc, s8** argv) {
+    TaskQueue que;
+    DTEST_CHECK(que.empty());
+    DTEST_CHECK(nullptr == que.popAll());
+
+    // single thread: push reports the empty queue, popAllFIFO keeps the order
+    TaskNode nds[3];
+    DTEST_CHECK(que.push(&nds[0]));
+    DTEST_CHECK(!que.push(&nds[1]));
+    DTEST_CHECK(!que.push(&nds[2]));
+    DTEST_CHECK(!que.empty());
+    TaskNode* nd = que.popAllFIFO();
+    DTEST_CHECK(nd == &nds[0] && nd->mNext == &nds[1] && nds[1].mNext == &nds[2] && nullptr == nds[2].mNext);
+    DTEST_CHECK(que.empty());
+
+    // pushList links [head, tail] at once
+    nds[0].mNext = &nds[1];
+    DTEST_CHECK(que.pushList(&nds[0], &nds[1]));
+    nd = que.popAll();
+    DTEST_CHECK(nd == &nds[0] && nd->mNext == &nds[1] && nullptr == nds[1].mNext);
+
+    // multi producers, one consumer drains while they push
+    std::vector<TaskNode> all(G_QUE_PRODUCERS * G_QUE_TASKS);
+    for (usz i = 0; i < all.size(); ++i) {
+        all[i].mData = (void*)(usz)i;
+    }
+    std::vector<std::thread> wks;
+    for (s32 p = 0; p < G_QUE_PRODUCERS; ++p) {
+        wks.emplace_back([&que, &all, p]() {
+            for (s32 i = 0; i < G_QUE_TASKS; ++i) {
+                que.push(&all[p * G_QUE_TASKS + i]);
+            }
+        });
+    }
+    s32 got = 0;
+    s32 batches = 0;
+    s64 lastSeq[G_QUE_PRODUCERS];
+    for (s32 p = 0; p < G_QUE_PRODUCERS; ++p) {
+        lastSeq[p] = -1;
+    }
+    bool ordered = true;
+    while (got < G_QUE_PRODUCERS * G_QUE_TASKS) {
+        nd = que.popAllFIFO();
+        if (!nd) {
+            std::this_thread::yield();
+            continue;
+        }
+        ++batches;
+        for (; nd; nd = nd->mNext) {
+            const usz idx = (usz)nd->mData;
+            const s32 p = (s32)(idx / G_QUE_TASKS);
+            const s64 seq = (s64)(idx % G_QUE_TASKS);
+            // FIFO per producer
+            ordered = ordered && seq == lastSeq[p] + 1;
+            lastSeq[p] = seq;
+            ++got;
+        }
+    }
+    for (std::thread& it : wks) {
+        it.join();
+    }
+    DTEST_CHECK(ordered);
+    DTEST_CHECK(G_QUE_PRODUCERS * G_QUE_TASKS == got);
+    DTEST_CHECK(que.empty());
+    for (s32 p = 0; p < G_QUE_PRODUCERS; ++p) {
+        DTEST_CHECK(G_QUE_TASKS - 1 == lastSeq[p]);
+    }
+    printf("AppTestTaskQueue>>tasks=%d, batches=%d\n", got, batches);
+    return 0;
+}
+
+} // namespace app
@@ -4,6 +4,7 @@
 #include "ThreadPool.h"
 #include "MemoryHub.h"
 #include "Queue.h"
+#include "UnitTest.h"
 
 namespace app {
 
@@ -37,6 +38,50 @@ static void AppTestMemHub() {
 }
 
 
+// alloc and release from many threads, each thread holds a window of live blocks
+static s64 AppBenchMemHub(bool cache, s32 threads, s32 loops) {
+    MemoryHub* hub = new MemoryHub();
+    hub->setThreadCache(cache);
+    auto func = [hub, loops](u32 seed) {
+        const s32 window = 16;
+        s8* live[window] = {nullptr};
+        for (s32 i = 0; i < loops; ++i) {
+            seed = seed * 1103515245 + 12345;
+            s32 pos = i % window;
+            hub->release(live[pos]);
+            live[pos] = hub->allocate(((seed >> 8) % 10000ULL) + 32);
+            live[pos][0] = (s8)i;
+        }
+        for (s32 i = 0; i < window; ++i) {
+            hub->release(live[i]);
+        }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> wks;
+    for (s32 i = 0; i < threads; ++i) {
+        wks.emplace_back(func, (u32)i + 1);
+    }
+    for (std::thread& it : wks) {
+        it.join();
+    }
+    s64 ret = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    MemHubStats st;
+    u64 used = 0;
+    for (s32 i = 0; i < MemoryHub::EMT_DEFAULT; ++i) {
+        hub->getStats((MemoryHub::EMemType)i, st);
+        used += st.mHits + st.mMisses;
+        if (cache) {
+            printf("step4>>mem hub class[%d], hit=%llu, miss=%llu, flush=%llu\n", i, st.mHits, st.mMisses, st.mFlushes);
+            DTEST_CHECK(0 == st.mMisses || st.mHits > st.mMisses);
+        }
+    }
+    // every allocate is a hit or a miss of the thread caches
+    DTEST_CHECK(used == (cache ? (u64)threads * loops : 0));
+    hub->drop();
+    return ret;
+}
+
+
 static void AppMyTask(std::atomic<s64>* val) {
     ++(*val);
     AppTestMemHub();
@@ -201,6 +246,13 @@ s32 AppTestThreadPool(s32 argc, s8** argv) {
     printf("step4>>mem pool total = %d\n\n", posted);
     GHUB->drop();
 
+    const s32 bench_threads = 8;
+    const s32 bench_loops = 1000000;
+    s64 cost_lock = AppBenchMemHub(false, bench_threads, bench_loops);
+    s64 cost_cache = AppBenchMemHub(true, bench_threads, bench_loops);
+    printf("step4>>mem hub bench, threads=%d, loops=%d, shared pools=%lldms, thread cache=%lldms\n\n", bench_threads,
+        bench_loops, cost_lock, cost_cache);
+
 
 
     // test queue
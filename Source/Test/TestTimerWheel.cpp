@@ -0,0 +1,90 @@
+#include "TimerWheel.h"
+#include "UnitTest.h"
+
+namespace app {
+
+struct WheelItem {
+    TimerWheel::STimeNode mNode;
+    s64 mTimeout;
+    s64 mFired;
+};
+
+
+static s32 AppCollectWheel(TimerWheel& wheel, s64 now, s64& last) {
+    Node2 expired;
+    wheel.update(now, expired);
+    s32 ret = 0;
+    while (!expired.empty()) {
+        TimerWheel::STimeNode* nd = DGET_HOLDER(expired.getNext(), TimerWheel::STimeNode, mLinker);
+        nd->mLinker.delink();
+        WheelItem* it = DGET_HOLDER(nd, WheelItem, mNode);
+        DTEST_CHECK(0 == it->mFired);
+        DTEST_CHECK(now >= it->mTimeout);
+        // fired in the step after timeout
+        DTEST_CHECK(now - it->mTimeout <= 2 * wheel.getInterval());
+        DTEST_CHECK(it->mTimeout >= last);
+        it->mFired = now;
+        last = it->mTimeout;
+        ++ret;
+    }
+    return ret;
+}
+
+
+s32 AppTestTimerWheel(s32 argc, s8** argv) {
+    const s32 gap = 10;
+    const s64 start = 1000;
+
+    // wait time of a fresh wheel
+    {
+        TimerWheel wheel(0, gap);
+        WheelItem it;
+        it.mTimeout = 50;
+        it.mFired = 0;
+        DTEST_CHECK(1000 == wheel.getWaitTime(0, 1000));
+        wheel.add(it.mNode, it.mTimeout);
+        const s64 wait = wheel.getWaitTime(0, 1000);
+        DTEST_CHECK(wait >= it.mTimeout && wait <= it.mTimeout + gap + 1);
+        DTEST_CHECK(wheel.remove(it.mNode));
+        DTEST_CHECK(!wheel.remove(it.mNode));
+    }
+
+    // expiry order, across the cascades of slot 1, 2 and 3
+    const s64 outs[] = {5, 30, 30, 250, 2555, 2570, 9000, 163900, 170000, 700000, 11000000};
+    const s32 count = sizeof(outs) / sizeof(outs[0]);
+    TimerWheel wheel(start, gap);
+    WheelItem items[count];
+    for (s32 i = count - 1; i >= 0; --i) {
+        items[i].mTimeout = start + outs[i];
+        items[i].mFired = 0;
+        wheel.add(items[i].mNode, items[i].mTimeout);
+    }
+    WheelItem removed;
+    removed.mTimeout = start + 100;
+    removed.mFired = 0;
+    wheel.add(removed.mNode, removed.mTimeout);
+    wheel.remove(removed.mNode);
+
+    // re-add moves the deadline
+    WheelItem touched;
+    touched.mTimeout = start + 40;
+    touched.mFired = 0;
+    wheel.add(touched.mNode, touched.mTimeout);
+    touched.mTimeout = start + 3000;
+    wheel.add(touched.mNode, touched.mTimeout);
+
+    s64 last = 0;
+    s32 fired = 0;
+    for (s64 now = start; fired < count + 1 && now <= start + outs[count - 1] + 10 * gap; now += gap) {
+        fired += AppCollectWheel(wheel, now, last);
+    }
+    DTEST_CHECK(count + 1 == fired);
+    DTEST_CHECK(0 == removed.mFired);
+    DTEST_CHECK(touched.mFired >= touched.mTimeout && touched.mFired <= touched.mTimeout + 2 * gap);
+    for (s32 i = 0; i < count; ++i) {
+        DTEST_CHECK(items[i].mFired > 0);
+    }
+    return 0;
+}
+
+} // namespace app
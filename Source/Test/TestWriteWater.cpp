@@ -0,0 +1,137 @@
+#include "Engine.h"
+#include "Net/HandleTCP.h"
+#include "UnitTest.h"
+
+namespace app {
+
+static const u32 G_WATER_REQ = 64 * 1024;
+static const s32 G_WATER_REQS = 16;
+static const u32 G_WATER_HIGH = 256 * 1024;
+static const u32 G_WATER_LOW = 64 * 1024;
+
+struct WaterClient {
+    net::HandleTCP mTCP;
+    s32 mConnected = 0; // 1=ok, -1=fail
+    s32 mWrites = 0;
+    s32 mDrains = 0;
+    usz mBytesAtDrain = 0;
+    bool mClosed = false;
+};
+
+static void WaterOnClose(Handle* it) {
+    ((WaterClient*)it->getUser())->mClosed = true;
+}
+
+static void WaterOnConnect(RequestFD* it) {
+    WaterClient& cli = *(WaterClient*)it->mUser;
+    cli.mConnected = 0 == it->mError ? 1 : -1;
+    RequestFD::delRequest(it);
+}
+
+static void WaterOnWrite(RequestFD* it) {
+    WaterClient& cli = *(WaterClient*)it->mUser;
+    DTEST_CHECK(0 == it->mError);
+    ++cli.mWrites;
+    RequestFD::delRequest(it);
+}
+
+static void WaterOnDrain(Handle* it) {
+    WaterClient& cli = *(WaterClient*)it->getUser();
+    ++cli.mDrains;
+    cli.mBytesAtDrain = cli.mTCP.getWriteBytes();
+    DTEST_CHECK(!cli.mTCP.isWriteFull());
+}
+
+
+s32 AppTestWriteWater(s32 argc, s8** argv) {
+    // the counter alone
+    WriteWater water;
+    water.add(100);
+    DTEST_CHECK(!water.mFull && 100 == water.mBytes); // disabled
+    water.mHigh = 1000;
+    water.mLow = 200;
+    water.add(899);
+    DTEST_CHECK(!water.mFull);
+    water.add(1);
+    DTEST_CHECK(water.mFull);
+    DTEST_CHECK(!water.land(700)); // 300 > low
+    DTEST_CHECK(water.mFull);
+    DTEST_CHECK(!water.land(100)); // drained to low, but no callback
+    DTEST_CHECK(!water.mFull && 200 == water.mBytes);
+    water.mCallDrain = WaterOnDrain;
+    water.add(800);
+    DTEST_CHECK(water.mFull);
+    DTEST_CHECK(water.land(900)); // notify once
+    DTEST_CHECK(!water.land(100));
+    DTEST_CHECK(0 == water.mBytes);
+    DTEST_CHECK(!water.land(100)); // never below 0
+    DTEST_CHECK(0 == water.mBytes);
+
+    WaterClient cli;
+    // a peer which doesn't read, so the queued bytes pile up
+    Loop& loop = Engine::getInstance().getLoop();
+    net::Socket listener;
+    net::NetAddress addr("127.0.0.1", 0);
+    DTEST_CHECK(listener.openTCP());
+    DTEST_CHECK(0 == listener.bind(addr));
+    DTEST_CHECK(0 == listener.listen(4));
+    listener.getLocalAddress(addr);
+
+    cli.mTCP.setClose(EHT_TCP_CONNECT, WaterOnClose, &cli);
+    cli.mTCP.setWaterMark(G_WATER_HIGH, G_WATER_LOW, WaterOnDrain);
+    RequestFD* req = RequestFD::newRequest(64);
+    req->mUser = &cli;
+    req->mCall = WaterOnConnect;
+    if (EE_OK != cli.mTCP.open(addr, req)) {
+        RequestFD::delRequest(req);
+        DTEST_CHECK(0 && "connect");
+        return 0;
+    }
+    for (s32 i = 0; i < 1000 && 0 == cli.mConnected; ++i) {
+        loop.run();
+    }
+    DTEST_CHECK(1 == cli.mConnected);
+    net::Socket peer = listener.accept();
+    DTEST_CHECK(peer.isOpen());
+    DTEST_CHECK(0 == peer.setBlock(false));
+
+    for (s32 i = 0; i < G_WATER_REQS; ++i) {
+        req = RequestFD::newRequest(G_WATER_REQ);
+        memset(req->mData, 'w', G_WATER_REQ);
+        req->mUsed = G_WATER_REQ;
+        req->mUser = &cli;
+        req->mCall = WaterOnWrite;
+        DTEST_CHECK(EE_OK == cli.mTCP.write(req));
+        DTEST_CHECK(cli.mTCP.isWriteFull() == ((i + 1) * G_WATER_REQ >= G_WATER_HIGH));
+    }
+    DTEST_CHECK(G_WATER_REQS * G_WATER_REQ == cli.mTCP.getWriteBytes());
+
+    // drain it by the peer
+    s8 buf[16 * 1024];
+    usz got = 0;
+    for (s32 i = 0; i < 100000 && got < G_WATER_REQS * G_WATER_REQ; ++i) {
+        loop.run();
+        for (s32 rd = peer.receive(buf, sizeof(buf)); rd > 0; rd = peer.receive(buf, sizeof(buf))) {
+            got += rd;
+        }
+    }
+    for (s32 i = 0; i < 1000 && cli.mWrites < G_WATER_REQS; ++i) {
+        loop.run();
+    }
+    DTEST_CHECK(G_WATER_REQS * G_WATER_REQ == got);
+    DTEST_CHECK(G_WATER_REQS == cli.mWrites);
+    DTEST_CHECK(1 == cli.mDrains);
+    DTEST_CHECK(cli.mBytesAtDrain <= G_WATER_LOW);
+    DTEST_CHECK(0 == cli.mTCP.getWriteBytes() && !cli.mTCP.isWriteFull());
+
+    cli.mTCP.launchClose();
+    for (s32 i = 0; i < 1000 && !cli.mClosed; ++i) {
+        loop.run();
+    }
+    DTEST_CHECK(cli.mClosed);
+    peer.close();
+    listener.close();
+    return 0;
+}
+
+} // namespace app
@@ -0,0 +1,64 @@
+#include "UnitTest.h"
+
+namespace app {
+
+s32 GUnitFails = 0;
+
+s32 AppTestTimerWheel(s32 argc, s8** argv);
+s32 AppTestTaskQueue(s32 argc, s8** argv);
+s32 AppTestLoopStats(s32 argc, s8** argv);
+s32 AppTestAcceptor(s32 argc, s8** argv);
+s32 AppTestWriteWater(s32 argc, s8** argv);
+s32 AppTestObjectPool(s32 argc, s8** argv);
+s32 AppTestCpuList(s32 argc, s8** argv);
+s32 AppTestSteer(s32 argc, s8** argv);
+s32 AppTestCoroutine(s32 argc, s8** argv);
+s32 AppTestMemoryHub(s32 argc, s8** argv);
+s32 AppTestShareAllocator(s32 argc, s8** argv);
+s32 AppTestMemArena(s32 argc, s8** argv);
+s32 AppTestBufferPool(s32 argc, s8** argv);
+s32 AppTestHugePage(s32 argc, s8** argv);
+s32 AppTestMemAccount(s32 argc, s8** argv);
+
+using FuncUnitTest = s32 (*)(s32, s8**);
+
+struct UnitTestItem {
+    const s8* mName;
+    FuncUnitTest mCall;
+};
+
+static const UnitTestItem GUnitTests[] = {
+    {"TimerWheel", AppTestTimerWheel},
+    {"TaskQueue", AppTestTaskQueue},
+    {"LoopStats", AppTestLoopStats},
+    {"Acceptor", AppTestAcceptor},
+    {"WriteWater", AppTestWriteWater},
+    {"ObjectPool", AppTestObjectPool},
+    {"CpuList", AppTestCpuList},
+    {"Steer", AppTestSteer},
+    {"Coroutine", AppTestCoroutine},
+    {"MemoryHub", AppTestMemoryHub},
+    {"ShareAllocator", AppTestShareAllocator},
+    {"MemArena", AppTestMemArena},
+    {"BufferPool", AppTestBufferPool},
+    {"HugePage", AppTestHugePage},
+    {"MemAccount", AppTestMemAccount},
+};
+
+
+/**
+ * @brief run all unit tests
+ * @return count of failed checks, 0 if all passed
+ */
+s32 AppTestUnits(s32 argc, s8** argv) {
+    GUnitFails = 0;
+    for (const UnitTestItem& it : GUnitTests) {
+        const s32 fails = GUnitFails;
+        it.mCall(argc, argv);
+        printf("AppTestUnits>>%s %s\n", it.mName, fails == GUnitFails ? "ok" : "FAIL");
+    }
+    printf("AppTestUnits>>tests=%d, fails=%d\n", (s32)(sizeof(GUnitTests) / sizeof(GUnitTests[0])), GUnitFails);
+    return GUnitFails;
+}
+
+} // namespace app
@@ -0,0 +1,25 @@
+#ifndef APP_TEST_UNITTEST_H
+#define APP_TEST_UNITTEST_H
+
+#include <stdio.h>
+#include "Config.h"
+
+namespace app {
+
+// count of failed checks, @see AppTestUnits()
+extern s32 GUnitFails;
+
+/**
+ * @brief check a condition in unit test, log and count it if false, the test goes on.
+ */
+#define DTEST_CHECK(T)                                                                                                 \
+    do {                                                                                                               \
+        if (!(T)) {                                                                                                    \
+            ++app::GUnitFails;                                                                                         \
+            printf("FAIL>>%s:%d: %s\n", __FILE__, __LINE__, #T);                                                       \
+        }                                                                                                              \
+    } while (0)
+
+} // namespace app
+
+#endif // APP_TEST_UNITTEST_H
@@ -118,6 +118,22 @@ s64 Timer::getRelativeTime() {
 #endif
 }
 
+s64 Timer::getRelativeMicro() {
+#if defined(DOS_WINDOWS)
+    static LARGE_INTEGER freq = {0};
+    if (0 == freq.QuadPart) {
+        QueryPerformanceFrequency(&freq);
+    }
+    LARGE_INTEGER val;
+    QueryPerformanceCounter(&val);
+    return (val.QuadPart / freq.QuadPart) * 1000000LL + (val.QuadPart % freq.QuadPart) * 1000000LL / freq.QuadPart;
+#elif defined(DOS_LINUX) || defined(DOS_ANDROID)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000LL + ts.tv_nsec / 1000LL);
+#endif
+}
+
 s64 Timer::getTimestamp() {
     return time(nullptr);
 }
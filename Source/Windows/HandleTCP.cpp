@@ -174,6 +174,7 @@ s32 HandleTCP::write(RequestFD* it) {
         return it->mError;
     }
     mLoop->bindFly(this);
+    mWater.add(it->mUsed);
     return EE_OK;
 }
 
@@ -35,20 +35,25 @@
 namespace app {
 
 Loop::Loop() :
-    mTimeHub(HandleTime::lessTime),
-    mRequest(nullptr),
     mTime(Timer::getTime()),
+    mFlyRequest(0),
+    mGrabCount(0),
+    mMaxEvents(128),
     mStop(0),
-    mTaskHead(nullptr),
-    mTaskHeadIdle(nullptr),
+    mTimeHub(HandleTime::lessTime),
+    mTimeWheel(Timer::getTime(), 10),
+    mRequest(nullptr),
+    mStats(nullptr),
+    mStatsSlow(0),
+    mBusyPoll(0),
+    mBusyPollSock(0),
+    mBusyBudget(0),
+    mBusyUntil(0),
     mTaskIdleCount(0),
+    mTaskWake(ETW_AWAKE),
     mTaskIdleMax(1000),
-    mMaxEvents(128),
-    mPackCMD(1024),
-    mFlyRequest(0),
-    mGrabCount(0) {
+    mPackCMD(1024) {
     mEvents = new EventPoller::SEvent[mMaxEvents];
-    mTaskTailPos = reinterpret_cast<void**>(&mTaskHead);
 }
 
 Loop::~Loop() {
@@ -89,6 +94,9 @@ void Loop::onRead(RequestFD* it) {
         case ECT_ACTIVE:
             Logger::logInfo("Loop::onCommands>>pid=%d, active", Engine::getInstance().getPID());
             break;
+        case ECT_MEM_REPORT:
+            Engine::getInstance().logMemory();
+            break;
         case ECT_TASK:
         {
             CommandTask* task = reinterpret_cast<CommandTask*>(cmd);
@@ -115,8 +123,29 @@ void Loop::onRead(RequestFD* it) {
 }
 
 bool Loop::run() {
+    const s64 start = mStats ? Timer::getRelativeMicro() : 0;
+    s64 tick = start;
+    s64 polled = 0;
     u32 timeout = getWaitTime();
+    if (mStats) {
+        tick = markPhase(ELP_TIME, tick);
+    }
+    bool spun = false;
+    if (timeout > 0) {
+        if (isBusyPoll()) {
+            spun = true;
+            timeout = 0; // spinning, no need to be woken by posters
+        } else if (!sleepTask()) {
+            timeout = 0; // tasks posted
+        }
+    }
     s32 max = mPoller.getEvents(mEvents, mMaxEvents, timeout);
+    wakeTask();
+    if (mStats) {
+        polled = tick;
+        tick = markPhase(ELP_POLL, tick);
+        polled = tick - polled;
+    }
     if (max > 0) {
         RequestFD* req;
         for (s32 i = 0; i < max; ++i) {
@@ -127,13 +156,8 @@ bool Loop::run() {
                 } else {
                     Logger::log(ELL_ERROR, "Loop::run>>Handle null");
                 }
-            } else {
-                if (mTaskHead) {
-                    onTask(nullptr);
-                } else {
-                    Logger::log(ELL_ERROR, "Loop::run>>Poll null");
-                }
             }
+            // else: wake event of Loop::postTask(), tasks are done by onTask() bellow
         }
     } else {
         const s32 ecode = System::getAppError();
@@ -141,8 +165,27 @@ bool Loop::run() {
             Logger::log(ELL_ERROR, "Loop::run>>Poll events ecode=%d", ecode);
         }
     }
-    updatePending();
-    updateClosed();
+    s32 tasks;
+    if (mStats) {
+        tick = markPhase(ELP_EVENTS, tick);
+        tasks = onTask();
+        tick = markPhase(ELP_TASK, tick);
+        updatePending();
+        tick = markPhase(ELP_PENDING, tick);
+        updateClosed();
+        tick = markPhase(ELP_CLOSED, tick);
+        mStats->mPhase[ELP_BUSY].add(tick - start - polled);
+        mStats->mSteps.fetch_add(1, std::memory_order_relaxed);
+        mStats->mEvents.fetch_add(max > 0 ? max : 0, std::memory_order_relaxed);
+        mStats->mTasks.fetch_add(tasks, std::memory_order_relaxed);
+    } else {
+        tasks = onTask();
+        updatePending();
+        updateClosed();
+    }
+    if (mBusyPoll > 0) {
+        updateBusyPoll(spun, max > 0 || tasks > 0);
+    }
     return mGrabCount > 0;
 }
 
@@ -156,6 +199,7 @@ void Loop::updatePending() {
     mRequest = nullptr;
     for (RequestFD* req = next; next; req = next) {
         next = req->mNext != first ? req->mNext : nullptr;
+        StatsCall scall(*this, req);
         switch (req->mType) {
         case ERT_CONNECT:
         {
@@ -209,7 +253,11 @@ void Loop::updatePending() {
                 nd->mError = System::convNtstatus2NetError((NTSTATUS)(nd->mOverlapped.Internal));
                 closeHandle(hnd);
             }
-            nd->mCall(nd); //nd maybe deleted
+            if (EHT_TCP_CONNECT == hnd->getType() || EHT_TCP_LINK == hnd->getType()) {
+                landWrite((net::HandleTCP*)hnd, nd); //nd maybe deleted
+            } else {
+                nd->mCall(nd); //nd maybe deleted
+            }
             unbindFly(hnd);
             break;
         }
@@ -275,7 +323,9 @@ u32 Loop::getWaitTime() {
     if (mRequest || !mHandleClose.empty()) {
         return 0;
     }
-    return updateTimeHub();
+    u32 ret = updateTimeHub();
+    // the expired timers closed just now, don't delay their close callback
+    return mHandleClose.empty() ? ret : 0;
 }
 
 
@@ -310,6 +360,11 @@ void Loop::unbindFly(Handle* it) {
 
 
 bool Loop::start(net::Socket& sockRead, net::Socket& sockWrite) {
+    const EngineConfig& cfg = Engine::getInstance().getConfig();
+    mStatsSlow = cfg.mLoopStats;
+    mStats = cfg.mLoopStats > 0 ? &Engine::getInstance().getLoopStats() : nullptr;
+    mBusyPoll = cfg.mBusyPoll;
+    mBusyBudget = cfg.mBusyPoll;
     mCMD.mSock = sockRead;
     mCMD.setClose(EHT_TCP_LINK, LoopOnClose, this);
     mCMD.setTime(LoopOnTime, 15 * 1000, 20 * 1000, -1);
@@ -373,21 +428,48 @@ void Loop::stop() {
 void Loop::relinkTime(HandleTime* handle) {
     DASSERT(handle);
     if (0 == (EHF_CLOSING & handle->mFlag) && handle->mCallTime) {
-        mTimeHub.remove(&handle->mLink);
+        // just push the deadline forward, node will be re-slotted when it's slot expired
         handle->mTimeout = mTime + handle->mTimeGap;
-        mTimeHub.insert(&handle->mLink);
+        if (!handle->mWheel.isLinked()) {
+            mTimeWheel.add(handle->mWheel, handle->mTimeout);
+        }
         //printf("Loop::relinkTime>>%lld, gap=%lld\n", handle->mTimeout, handle->mTimeGap / 1000);
     }
 }
 
 
+void Loop::updateTimeWheel() {
+    Node2 expired;
+    mTimeWheel.update(mTime, expired);
+    HandleTime* handle;
+    while (!expired.empty()) {
+        handle = DGET_HOLDER(expired.getNext(), HandleTime, mWheel.mLinker);
+        handle->mWheel.mLinker.delink();
+        if (handle->mTimeout > mTime) {
+            mTimeWheel.add(handle->mWheel, handle->mTimeout); // touched by relinkTime()
+            continue;
+        }
+        if (EE_OK == handle->mCallTime(handle) && 0 != handle->mRepeat) {
+            if (handle->mRepeat > 0) {
+                --handle->mRepeat;
+            }
+            handle->mTimeout = mTime + handle->mTimeGap;
+            mTimeWheel.add(handle->mWheel, handle->mTimeout);
+        } else {
+            closeHandle(handle);
+        }
+    }
+}
+
+
 u32 Loop::updateTimeHub() {
+    updateTimeWheel();
     HandleTime* handle;
     for (Node3* nd = mTimeHub.getTop(); nd; nd = mTimeHub.getTop()) {
         handle = DGET_HOLDER(nd, HandleTime, mLink);
         if (handle->mTimeout > mTime) {
-            u64 diff = (handle->mTimeout - mTime);
-            return diff > 1000 ? 1000 : (u32)diff;
+            s64 diff = (handle->mTimeout - mTime);
+            return (u32)mTimeWheel.getWaitTime(mTime, diff > 1000 ? 1000 : diff);
             //break;
         }
         if (EE_OK == handle->mCallTime(handle)) {
@@ -414,7 +496,7 @@ u32 Loop::updateTimeHub() {
             addClose(handle);*/
         }
     }
-    return 0;
+    return (u32)mTimeWheel.getWaitTime(mTime, 1000);
 }
 
 
@@ -443,7 +525,7 @@ s32 Loop::closeHandle(Handle* it) {
         net::HandleTCP* nd = reinterpret_cast<net::HandleTCP*>(it);
         ret = nd->close();
         if (nd->mCallTime) {
-            mTimeHub.remove(&nd->mLink);
+            mTimeWheel.remove(nd->mWheel);
         }
         break;
     }
@@ -452,7 +534,7 @@ s32 Loop::closeHandle(Handle* it) {
         net::HandleUDP* nd = reinterpret_cast<net::HandleUDP*>(it);
         ret = nd->close();
         if (nd->mCallTime) {
-            mTimeHub.remove(&nd->mLink);
+            mTimeWheel.remove(nd->mWheel);
         }
         break;
     }
@@ -467,7 +549,7 @@ s32 Loop::closeHandle(Handle* it) {
         HandleFile* nd = reinterpret_cast<HandleFile*>(it);
         ret = nd->close();
         if (nd->mCallTime) {
-            mTimeHub.remove(&nd->mLink);
+            mTimeWheel.remove(nd->mWheel);
         }
         break;
     }
@@ -483,7 +565,7 @@ s32 Loop::closeHandle(Handle* it) {
 }
 
 
-s32 Loop::openHandle(Handle* it) {
+s32 Loop::openHandle(Handle* it, const net::SocketOption* opt) {
     DASSERT(it);
     if (mStop > 0) {
         it->mFlag |= (EHF_CLOSING | EHF_CLOSE);
@@ -522,7 +604,7 @@ s32 Loop::openHandle(Handle* it) {
         } else {
             if (nd->mCallTime) {
                 nd->mTimeout += Timer::getTime();
-                mTimeHub.insert(&nd->mLink);
+                mTimeWheel.add(nd->mWheel, nd->mTimeout);
             }
         }
         break;
@@ -546,16 +628,23 @@ s32 Loop::openHandle(Handle* it) {
             ret = System::getAppError();
             Logger::log(ELL_ERROR, "Loop::openHandle>>tcp.acc, bind, addr=%s, ecode=%d", nd->mLocal.getStr(), ret);
             sock.close();
-        } else if (0 != sock.listen(1024)) {
-            ret = System::getAppError();
-            Logger::log(ELL_ERROR, "Loop::openHandle>>tcp.acc, listen, addr=%s, ecode=%d", nd->mLocal.getStr(), ret);
-            sock.close();
-        } else if (!mPoller.add(sock, nd)) {
-            ret = System::getAppError();
-            Logger::log(ELL_ERROR, "Loop::openHandle>>tcp.acc, add, addr=%s, ecode=%d", nd->mLocal.getStr(), ret);
-            sock.close();
         } else {
-            nd->mFlag |= EHF_READABLE;
+            // before listen(), so the buffers apply to the first SYN
+            if (opt && 0 != sock.setOption(*opt)) {
+                Logger::log(ELL_ERROR, "Loop::openHandle>>tcp.acc, option, addr=%s, ecode=%d", nd->mLocal.getStr(),
+                    System::getAppError());
+            }
+            if (0 != sock.listen(1024)) {
+                ret = System::getAppError();
+                Logger::log(ELL_ERROR, "Loop::openHandle>>tcp.acc, listen, addr=%s, ecode=%d", nd->mLocal.getStr(), ret);
+                sock.close();
+            } else if (!mPoller.add(sock, nd)) {
+                ret = System::getAppError();
+                Logger::log(ELL_ERROR, "Loop::openHandle>>tcp.acc, add, addr=%s, ecode=%d", nd->mLocal.getStr(), ret);
+                sock.close();
+            } else {
+                nd->mFlag |= EHF_READABLE;
+            }
         }
         break;
     }
@@ -570,7 +659,7 @@ s32 Loop::openHandle(Handle* it) {
             nd->mFlag |= (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_WRITE);
             if (nd->mCallTime) {
                 nd->mTimeout += Timer::getTime();
-                mTimeHub.insert(&nd->mLink);
+                mTimeWheel.add(nd->mWheel, nd->mTimeout);
             }
         }
         break;
@@ -593,7 +682,7 @@ s32 Loop::openHandle(Handle* it) {
             nd->mFlag |= (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_WRITE);
             if (nd->mCallTime) {
                 nd->mTimeout += Timer::getTime();
-                mTimeHub.insert(&nd->mLink);
+                mTimeWheel.add(nd->mWheel, nd->mTimeout);
             }
         }
         break;
@@ -609,7 +698,7 @@ s32 Loop::openHandle(Handle* it) {
             nd->mFlag |= (EHF_READABLE | EHF_WRITEABLE | EHF_SYNC_WRITE);
             if (nd->mCallTime) {
                 nd->mTimeout += Timer::getTime();
-                mTimeHub.insert(&nd->mLink);
+                mTimeWheel.add(nd->mWheel, nd->mTimeout);
             }
         }
         break;
@@ -657,15 +746,11 @@ s32 Loop::postTask(TaskNode* task) {
         return EE_ERROR;
     }
 
-    mTaskLock.lock();
-    bool active = (nullptr == mTaskHead);
-    void** link = (void**)((s8*)task + DOFFSET(TaskNode, mNext));
-    *link = nullptr;
-    *mTaskTailPos = (void*)link;
-    mTaskTailPos = link;
-    mTaskLock.unlock();
+    mTasks.push(task);
 
-    if (active) {
+    // only the 1st poster wakes the sleeping loop, @see Loop::sleepTask()
+    s32 expect = ETW_SLEEP;
+    if (mTaskWake.compare_exchange_strong(expect, ETW_POSTED)) {
         EventPoller::SEvent evt;
         evt.mKey = 0;
         evt.mPointer = nullptr;
@@ -674,37 +759,26 @@ s32 Loop::postTask(TaskNode* task) {
         if (!mPoller.postEvent(evt)) {
             DLOG(ELL_ERROR, "fail to active the loop.");
         }
-        /* note: mSendCMD is invalid on Windows, can't success to active the loop.
-        CommandTask activeTask;
-        activeTask.pack(&Loop::onTask, this, (void*)nullptr);
-        if (activeTask.mSize != mSendCMD.send(&activeTask, activeTask.mSize)) {
-            Logger::log(ELL_ERROR, "Loop::postTask>>send cmd, failed to active the loop");
-        }
-        */
     }
     return EE_OK;
 }
 
 
-void Loop::onTask(void* it) {
-    void** head = nullptr;
-
-    mTaskLock.lock();
-    if (mTaskHead) {
-        head = (void**)(mTaskHead);
-        //clear queue
-        mTaskHead = nullptr;
-        mTaskTailPos = reinterpret_cast<void**>(&mTaskHead);
+s32 Loop::onTask() {
+    TaskNode* head = mTasks.popAllFIFO();
+    if (!head) {
+        return 0;
     }
-    mTaskLock.unlock();
-
-    //process all tasks
-    while (head) {
-        TaskNode* nd = reinterpret_cast<TaskNode*>((s8*)head - DOFFSET(TaskNode, mNext));
+    //process all tasks in batch
+    TaskNode* tail = head;
+    s32 cnt = 0;
+    for (TaskNode* nd = head; nd; nd = nd->mNext) {
         (*nd)();
-        head = (void**)(*head); //next
-        pushTaskNode(nd);
+        tail = nd;
+        ++cnt;
     }
+    pushTaskNode(head, tail, cnt);
+    return cnt;
 }
 
 
@@ -28,6 +28,7 @@
 #include "MapFile.h"
 #include "System.h"
 #include "Logger.h"
+#include "HugePage.h"
 
 namespace app {
 
@@ -251,23 +252,37 @@ bool MapFile::createMap(const s8* iMapName, usz iSize) {
     realname = mMemName;
 #endif
     DWORD DesiredAccess = (EMF_WRITE & mFlag) ? PAGE_READWRITE : PAGE_READONLY;
+    SECURITY_ATTRIBUTES sa;
+    SECURITY_DESCRIPTOR sd;
+    SECURITY_ATTRIBUTES* psa = nullptr;
     if (EMF_SHARE & mFlag) {
-        SECURITY_ATTRIBUTES sa;
-        SECURITY_DESCRIPTOR sd;
         InitializeSecurityDescriptor(&sd, SECURITY_DESCRIPTOR_REVISION);
         SetSecurityDescriptorDacl(&sd, TRUE, nullptr, FALSE);
         sa.nLength = sizeof(sa);
         sa.lpSecurityDescriptor = &sd;
         sa.bInheritHandle = FALSE;
+        psa = &sa;
+    }
+    usz lpage = GetLargePageMinimum();
+    if (EHPM_HUGETLB == HugePage::getMode() && INVALID_HANDLE_VALUE == mFile && (EMF_WRITE & mFlag) && lpage > 0) {
+        // need SeLockMemoryPrivilege, fallback to normal pages if failed
+        usz lsize = AppAlignSize(iSize, lpage);
         mMapHandle = CreateFileMapping(mFile,
-            &sa,
-            DesiredAccess,
-            iSize >> 32,
-            iSize & 0xFFFFFFFF,
+            psa,
+            DesiredAccess | SEC_COMMIT | SEC_LARGE_PAGES,
+            lsize >> 32,
+            lsize & 0xFFFFFFFF,
             realname);
-    } else {
+        if (mMapHandle) {
+            mFlag |= EMF_LARGE_PAGE;
+            HugePage::getStats().mTLBBytes += lsize;
+        } else {
+            ++HugePage::getStats().mTLBFails;
+        }
+    }
+    if (!mMapHandle) {
         mMapHandle = CreateFileMapping(mFile,
-            nullptr,
+            psa,
             DesiredAccess,
             iSize >> 32,
             iSize & 0xFFFFFFFF,
@@ -283,6 +298,9 @@ bool MapFile::createMap(const s8* iMapName, usz iSize) {
 
 bool MapFile::createView() {
     DWORD DesiredAccess = (EMF_WRITE & mFlag) ? FILE_MAP_WRITE : FILE_MAP_READ;
+    if (EMF_LARGE_PAGE & mFlag) {
+        DesiredAccess |= FILE_MAP_LARGE_PAGES;
+    }
     mMemory = MapViewOfFile(mMapHandle, DesiredAccess, 0, 0, 0);
     if (mMemory) {
         MEMORY_BASIC_INFORMATION mi;
@@ -116,6 +116,38 @@ u32 System::getCoreCount() {
     return ret;
 }
 
+void System::getCpuInfo(TVector<CpuInfo>& out) {
+    out.resize(0);
+    const u32 cnt = getCoreCount();
+    for (u32 i = 0; i < cnt; ++i) {
+        CpuInfo nd;
+        nd.mID = (u16)i;
+        nd.mCore = (u16)i;
+        UCHAR node = 0;
+        nd.mNode = GetNumaProcessorNode((UCHAR)i, &node) && 0xFF != node ? node : 0;
+        out.pushBack(nd);
+    }
+}
+
+s32 System::bindCPU(const u16* cpus, usz cnt) {
+    if (!cpus || 0 == cnt) {
+        return EE_INVALID_PARAM;
+    }
+    // only the first processor group
+    DWORD_PTR mask = 0;
+    for (usz i = 0; i < cnt; ++i) {
+        if (cpus[i] < sizeof(mask) * 8) {
+            mask |= ((DWORD_PTR)1) << cpus[i];
+        }
+    }
+    return 0 != mask && 0 != SetThreadAffinityMask(GetCurrentThread(), mask) ? EE_OK : getAppError();
+}
+
+s32 System::bindNode(u32 node) {
+    (void)node; // windows allocate from the node of current processor by default
+    return EE_OK;
+}
+
 u32 System::getPageSize() {
     static u32 ret = AppGetPageSize();
     return ret;
@@ -415,6 +447,19 @@ void System::waitProcess(void* handle) {
     CloseHandle(handle);
 }
 
+bool System::isProcessAlive(s32 pid) {
+    if (pid <= 0) {
+        return false;
+    }
+    HANDLE hnd = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+    if (!hnd) {
+        return ERROR_ACCESS_DENIED == GetLastError();
+    }
+    bool ret = WAIT_TIMEOUT == WaitForSingleObject(hnd, 0);
+    CloseHandle(hnd);
+    return ret;
+}
+
 s32 System::createProcess(usz socket, void*& handle) {
     handle = nullptr;
     tchar fpath[MAX_PATH + 32];
@@ -508,6 +553,11 @@ s32 System::createProcess(usz socket, void*& handle) {
     return pinfo.dwProcessId;
 }
 
+s32 System::spawnProcess(const String& file, const TVector<s32>& keep, const TVector<String>& envs) {
+    Logger::log(ELL_ERROR, "System::spawnProcess>>unsupported, file = %s", file.c_str());
+    return EE_ERROR;
+}
+
 String System::getWorkingPath() {
     String wkpath(256);
     tchar tmp[_MAX_PATH];